@@ -782,18 +782,63 @@ if (!(exp))                   \
 /************************************************************************/
 // BASIS Loading
 /************************************************************************/
-static bool loadBASISTextureDesc(FileStream* pStream, TextureDesc* pOutDesc, void** ppOutData, uint32_t* pOutDataSize)
+/// Parsed .basis file. Subresources are transcoded on demand by transcodeBASISSubresource, which may run on several threads at once
+struct BasisTexture
+{
+	BasisTexture(): mCodebook(basist::g_global_selector_cb_size, basist::g_global_selector_cb), mTranscoder(&mCodebook) {}
+	~BasisTexture() { tf_free(pData); }
+
+	basist::etc1_global_selector_codebook mCodebook;
+	basist::basisu_transcoder             mTranscoder;
+	void*                                 pData = NULL;
+	uint32_t                              mDataSize = 0;
+	basist::transcoder_texture_format     mFormat = basist::transcoder_texture_format::cTFTotalTextureFormats;
+};
+
+typedef struct BasisFormatCandidate
+{
+	TinyImageFormat                   mFormat;
+	basist::transcoder_texture_format mBasisFormat;
+} BasisFormatCandidate;
+
+// Picks the first candidate compiled into the transcoder which the GPU can sample. Without caps every format is accepted
+static bool util_select_basis_format(
+	const GPUCapBits* pCaps, const BasisFormatCandidate* pCandidates, uint32_t count, uint32_t width, uint32_t height, BasisFormatCandidate* pOut)
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const BasisFormatCandidate& candidate = pCandidates[i];
+		if (!basist::basis_is_format_supported(candidate.mBasisFormat) || (pCaps && !pCaps->canShaderReadFrom[candidate.mFormat]))
+		{
+			continue;
+		}
+		// PVRTC1 only supports power of two dimensions
+		if (TinyImageFormat_PVRTC1_4BPP_UNORM == candidate.mFormat && ((width & (width - 1)) || (height & (height - 1))))
+		{
+			continue;
+		}
+		*pOut = candidate;
+		return true;
+	}
+	return false;
+}
+
+// Reads the .basis file and picks the transcode target. No subresource is transcoded yet
+static bool loadBASISTextureDesc(FileStream* pStream, const GPUCapBits* pCaps, TextureDesc* pOutDesc, BasisTexture* pOut)
 {
 	if (pStream == NULL || fsGetStreamFileSize(pStream) <= 0)
 		return false;
 
-	basist::etc1_global_selector_codebook sel_codebook(basist::g_global_selector_cb_size, basist::g_global_selector_cb);
-
 	size_t memSize = (size_t)fsGetStreamFileSize(pStream);
-	void* basisData = tf_malloc(memSize);
-	fsReadFromStream(pStream, basisData, memSize);
+	pOut->pData = tf_malloc(memSize);
+	pOut->mDataSize = (uint32_t)memSize;
+	if (fsReadFromStream(pStream, pOut->pData, memSize) != memSize)
+	{
+		return false;
+	}
 
-	basist::basisu_transcoder decoder(&sel_codebook);
+	const void* basisData = pOut->pData;
+	basist::basisu_transcoder& decoder = pOut->mTranscoder;
 
 	basist::basisu_file_info fileinfo;
 	if (!decoder.get_file_info(basisData, (uint32_t)memSize, fileinfo))
@@ -818,6 +863,16 @@ static bool loadBASISTextureDesc(FileStream* pStream, TextureDesc* pOutDesc, voi
 	textureDesc.mDescriptors = DESCRIPTOR_TYPE_TEXTURE;
 	textureDesc.mFormat = TinyImageFormat_UNDEFINED;
 
+	// Images become array layers so they all need the same mip chain
+	for (uint32_t s = 1; s < fileinfo.m_total_images; ++s)
+	{
+		if (fileinfo.m_image_mipmap_levels[s] != textureDesc.mMipLevels)
+		{
+			LOGF(LogLevel::eERROR, "Basis images have different mip counts (%u %u)!", textureDesc.mMipLevels, fileinfo.m_image_mipmap_levels[s]);
+			return false;
+		}
+	}
+
 	bool isNormalMap;
 
 	if (fileinfo.m_userdata0 == 1)
@@ -825,113 +880,84 @@ static bool loadBASISTextureDesc(FileStream* pStream, TextureDesc* pOutDesc, voi
 	else
 		isNormalMap = false;
 
-	basist::transcoder_texture_format basisTextureFormat = basist::transcoder_texture_format::cTFTotalTextureFormats;
-
-#if defined(TARGET_IOS) || defined(__ANDROID__) || defined(NX64)
+	// Ordered by quality. The first format the GPU can sample wins
+	static const BasisFormatCandidate normalMapFormats[] = {
+		{ TinyImageFormat_DXBC5_UNORM, basist::transcoder_texture_format::cTFBC5_RG },
+		{ TinyImageFormat_ETC2_EAC_R11G11_UNORM, basist::transcoder_texture_format::cTFETC2_EAC_RG11 },
+		{ TinyImageFormat_ASTC_4x4_UNORM, basist::transcoder_texture_format::cTFASTC_4x4_RGBA },
+		{ TinyImageFormat_R8G8B8A8_UNORM, basist::transcoder_texture_format::cTFRGBA32 },
+	};
+	static const BasisFormatCandidate alphaFormats[] = {
 #if defined(TARGET_IOS)
-	// Use PVRTC on iOS whenever possible
-	// This makes sure that PVRTC support is maintained
-	if (isPowerOf2(textureDesc.mWidth) && isPowerOf2(textureDesc.mHeight))
-	{
-		textureDesc.mFormat = TinyImageFormat_PVRTC1_4BPP_UNORM;
-		basisTextureFormat = imageinfo.m_alpha_flag ? basist::transcoder_texture_format::cTFPVRTC1_4_RGB : basist::transcoder_texture_format::cTFPVRTC1_4_RGBA;
-	}
+		// Use PVRTC on iOS whenever possible
+		// This makes sure that PVRTC support is maintained
+		{ TinyImageFormat_PVRTC1_4BPP_UNORM, basist::transcoder_texture_format::cTFPVRTC1_4_RGBA },
+#endif
+		{ TinyImageFormat_DXBC7_UNORM, basist::transcoder_texture_format::cTFBC7_M5_RGBA },
+		{ TinyImageFormat_ASTC_4x4_UNORM, basist::transcoder_texture_format::cTFASTC_4x4_RGBA },
+		{ TinyImageFormat_ETC2_R8G8B8A8_UNORM, basist::transcoder_texture_format::cTFETC2_RGBA },
+		{ TinyImageFormat_DXBC3_UNORM, basist::transcoder_texture_format::cTFBC3_RGBA },
+		{ TinyImageFormat_R8G8B8A8_UNORM, basist::transcoder_texture_format::cTFRGBA32 },
+	};
+	static const BasisFormatCandidate opaqueFormats[] = {
+#if defined(TARGET_IOS)
+		{ TinyImageFormat_PVRTC1_4BPP_UNORM, basist::transcoder_texture_format::cTFPVRTC1_4_RGB },
 #endif
-	if (TinyImageFormat_UNDEFINED == textureDesc.mFormat)
+		{ TinyImageFormat_DXBC7_UNORM, basist::transcoder_texture_format::cTFBC7_M6_RGB },
+		{ TinyImageFormat_ASTC_4x4_UNORM, basist::transcoder_texture_format::cTFASTC_4x4_RGBA },
+		{ TinyImageFormat_ETC2_R8G8B8_UNORM, basist::transcoder_texture_format::cTFETC1_RGB },
+		{ TinyImageFormat_DXBC1_RGB_UNORM, basist::transcoder_texture_format::cTFBC1_RGB },
+		{ TinyImageFormat_R8G8B8A8_UNORM, basist::transcoder_texture_format::cTFRGBA32 },
+	};
+
+	const BasisFormatCandidate* pCandidates = opaqueFormats;
+	uint32_t candidateCount = sizeof(opaqueFormats) / sizeof(opaqueFormats[0]);
+	if (isNormalMap)
 	{
-		textureDesc.mFormat = TinyImageFormat_ASTC_4x4_UNORM;
-		basisTextureFormat = basist::transcoder_texture_format::cTFASTC_4x4_RGBA;
+		pCandidates = normalMapFormats;
+		candidateCount = sizeof(normalMapFormats) / sizeof(normalMapFormats[0]);
 	}
-#else
-	if (!isNormalMap)
+	else if (imageinfo.m_alpha_flag)
 	{
-		if (!imageinfo.m_alpha_flag)
-		{
-			textureDesc.mFormat = TinyImageFormat_DXBC7_UNORM;
-			basisTextureFormat = basist::transcoder_texture_format::cTFBC7_M6_RGB;
-		}
-		else
-		{
-			textureDesc.mFormat = TinyImageFormat_DXBC7_UNORM;
-			basisTextureFormat = basist::transcoder_texture_format::cTFBC7_M5;
-		}
+		pCandidates = alphaFormats;
+		candidateCount = sizeof(alphaFormats) / sizeof(alphaFormats[0]);
 	}
-	else
+
+	BasisFormatCandidate format = {};
+	if (!util_select_basis_format(pCaps, pCandidates, candidateCount, textureDesc.mWidth, textureDesc.mHeight, &format))
 	{
-		textureDesc.mFormat = TinyImageFormat_DXBC5_UNORM;
-		basisTextureFormat = basist::transcoder_texture_format::cTFBC5_RG;
+		LOGF(LogLevel::eERROR, "No Basis transcode target is supported by the GPU!");
+		return false;
 	}
-#endif
-
-	decoder.start_transcoding(basisData, (uint32_t)memSize);
-
-	uint32_t requiredSize = util_get_surface_size(textureDesc.mFormat,
-		textureDesc.mWidth, textureDesc.mHeight, textureDesc.mDepth, 1, 1,
-		0, textureDesc.mMipLevels,
-		0, textureDesc.mArraySize);
-	void* startData = tf_malloc(requiredSize);
-	uint8_t* data = (uint8_t*)startData;
+	textureDesc.mFormat = format.mFormat;
+	pOut->mFormat = format.mBasisFormat;
 
-	for (uint32_t s = 0; s < fileinfo.m_total_images; ++s)
+	if (!decoder.start_transcoding(basisData, (uint32_t)memSize))
 	{
-		uint32_t w = textureDesc.mWidth;
-		uint32_t h = textureDesc.mHeight;
-		uint32_t d = textureDesc.mDepth;
-
-		for (uint32_t m = 0; m < fileinfo.m_image_mipmap_levels[s]; ++m)
-		{
-			uint32_t rowPitch = 0;
-			uint32_t numBytes = 0;
-			if (!util_get_surface_info(w, h, textureDesc.mFormat, &numBytes, &rowPitch, NULL))
-			{
-				return false;
-			}
-
-			uint32_t rowPitchInBlocks = rowPitch / (TinyImageFormat_BitSizeOfBlock(textureDesc.mFormat) >> 3);
-			basist::basisu_image_level_info level_info;
-
-			if (!decoder.get_image_level_info(basisData, (uint32_t)memSize, level_info, s, m))
-			{
-				LOGF(LogLevel::eERROR, "Failed retrieving image level information (%u %u)!\n", s, m);
-				tf_free(basisData);
-				tf_free(startData);
-				return false;
-			}
-
-			if (!decoder.transcode_image_level(basisData, (uint32_t)memSize, s, m, data,
-				(uint32_t)(rowPitchInBlocks * imageinfo.m_num_blocks_y), basisTextureFormat, 0, rowPitchInBlocks))
-			{
-				LOGF(LogLevel::eERROR, "Failed transcoding image level (%u %u)!", s, m);
-				tf_free(basisData);
-				tf_free(startData);
-				return false;
-			}
-
-			data += numBytes;
-
-			w = w >> 1;
-			h = h >> 1;
-			d = d >> 1;
-			if (w == 0)
-			{
-				w = 1;
-			}
-			if (h == 0)
-			{
-				h = 1;
-			}
-			if (d == 0)
-			{
-				d = 1;
-			}
-		}
+		LOGF(LogLevel::eERROR, "Failed to start Basis transcoding!");
+		return false;
 	}
 
-	tf_free(basisData);
-
-	*ppOutData = startData;
-	*pOutDataSize = requiredSize;
+	return true;
+}
 
+// Transcodes one layer / mip into pDst. rowPitch is in bytes, rowCount is the number of block rows (pixel rows for uncompressed targets)
+static bool transcodeBASISSubresource(const BasisTexture* pBasis, uint32_t layer, uint32_t mip, void* pDst, uint32_t rowPitch, uint32_t rowCount)
+{
+	const bool uncompressed = basist::basis_transcoder_format_is_uncompressed(pBasis->mFormat);
+	const uint32_t elementSize =
+		uncompressed ? basist::basis_get_uncompressed_bytes_per_pixel(pBasis->mFormat) : basist::basis_get_bytes_per_block(pBasis->mFormat);
+	const uint32_t rowPitchInElements = rowPitch / elementSize;
+
+	// The default state lives in the transcoder. A local one keeps concurrent calls independent
+	basist::basisu_transcoder_state state;
+	if (!pBasis->mTranscoder.transcode_image_level(
+			pBasis->pData, pBasis->mDataSize, layer, mip, pDst, rowPitchInElements * rowCount, pBasis->mFormat, 0, rowPitchInElements, &state,
+			uncompressed ? rowCount : 0))
+	{
+		LOGF(LogLevel::eERROR, "Failed transcoding image level (%u %u)!", layer, mip);
+		return false;
+	}
 	return true;
 }
 /************************************************************************/
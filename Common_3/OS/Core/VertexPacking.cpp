@@ -0,0 +1,754 @@
+/*
+ * Copyright (c) 2019 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+
+#include <string.h>
+#include <math.h>
+
+#include "VertexPacking.h"
+#include "Atomics.h"
+#include "../Interfaces/ILog.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define VERTEX_PACKING_SSE2
+#define VERTEX_PACKING_AVX2
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define VERTEX_PACKING_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define VERTEX_PACKING_TARGET_AVX2 __attribute__((target("avx2,f16c")))
+#endif
+#elif defined(__aarch64__)
+#define VERTEX_PACKING_NEON
+#include <arm_neon.h>
+#endif
+
+// Elements converted per pass when either side is interleaved. Sized so the staging arrays stay on the stack
+#define VERTEX_PACKING_BLOCK_SIZE 256
+// Component patterns are expanded to a whole number of vectors for every component count from 1 to 4 (lcm(3, 4) = 12)
+#define VERTEX_PACKING_PATTERN_SIZE 12
+
+typedef void (*FloatToHalfFunc)(const float* src, uint16_t* dst, size_t count);
+typedef void (*FloatToNormFunc)(PackedNormFormat format, const float* src, void* dst, size_t count, const float* pSub, const float* pMul);
+typedef void (*OctahedralFunc)(PackedNormFormat format, const uint8_t* src, uint32_t srcStride, void* dst, size_t count);
+
+// The contiguous kernels of one instruction set. The strided entry points stage interleaved data through these
+struct VertexPackingKernels
+{
+	FloatToHalfFunc pFloatToHalf;
+	FloatToNormFunc pFloatToNorm;
+	OctahedralFunc  pOctahedral;
+};
+/************************************************************************/
+// Scalar reference
+/************************************************************************/
+// Every vector path below performs exactly the same sequence of IEEE operations so results do not depend on the CPU.
+// Clamps follow the SSE min / max semantics (NaN clamps to the lower bound) and rounding is to nearest even.
+static inline float clampNorm(float v, float lo, float hi)
+{
+	v = v > lo ? v : lo;
+	return v < hi ? v : hi;
+}
+
+static inline int32_t roundNorm(float v) { return (int32_t)lrintf(v); }
+
+static inline void normRange(PackedNormFormat format, float* pLo, float* pHi, float* pRange)
+{
+	const bool isSigned = PACKED_NORM_FORMAT_SNORM8 == format || PACKED_NORM_FORMAT_SNORM16 == format;
+	*pLo = isSigned ? -1.0f : 0.0f;
+	*pHi = 1.0f;
+	switch (format)
+	{
+	case PACKED_NORM_FORMAT_UNORM8: *pRange = 255.0f; break;
+	case PACKED_NORM_FORMAT_SNORM8: *pRange = 127.0f; break;
+	case PACKED_NORM_FORMAT_UNORM16: *pRange = 65535.0f; break;
+	default: *pRange = 32767.0f; break;
+	}
+}
+
+static inline uint32_t packedNormSize(PackedNormFormat format) { return format >= PACKED_NORM_FORMAT_UNORM16 ? 2 : 1; }
+
+static inline void storeNorm(PackedNormFormat format, void* dst, size_t index, int32_t v)
+{
+	switch (format)
+	{
+	case PACKED_NORM_FORMAT_UNORM8: ((uint8_t*)dst)[index] = (uint8_t)v; break;
+	case PACKED_NORM_FORMAT_SNORM8: ((int8_t*)dst)[index] = (int8_t)v; break;
+	case PACKED_NORM_FORMAT_UNORM16: ((uint16_t*)dst)[index] = (uint16_t)v; break;
+	default: ((int16_t*)dst)[index] = (int16_t)v; break;
+	}
+}
+
+static inline uint16_t floatToHalf(float value)
+{
+	const uint32_t f16Max = (127 + 16) << 23;
+	const uint32_t minNormal = (127 - 14) << 23;
+	const uint32_t subnormalMagic = ((127 - 15) + (23 - 10) + 1) << 23;
+
+	uint32_t f = 0;
+	memcpy(&f, &value, sizeof(f));
+	const uint32_t sign = f & 0x80000000u;
+	f ^= sign;
+
+	uint32_t h = 0;
+	if (f >= f16Max)
+	{
+		// Inf stays Inf, NaN is quieted and keeps the top of its payload
+		h = f > 0x7f800000u ? (0x7e00u | ((f >> 13) & 0x3ffu)) : 0x7c00u;
+	}
+	else if (f < minNormal)
+	{
+		// Let the FPU round the mantissa by adding a magic number that aligns it with the half subnormal ulp
+		float magic = 0.0f;
+		float absValue = 0.0f;
+		memcpy(&magic, &subnormalMagic, sizeof(magic));
+		memcpy(&absValue, &f, sizeof(absValue));
+		absValue += magic;
+		memcpy(&h, &absValue, sizeof(h));
+		h -= subnormalMagic;
+	}
+	else
+	{
+		const uint32_t mantissaOdd = (f >> 13) & 1;
+		f += ((uint32_t)(15 - 127) << 23) + 0xfff;
+		f += mantissaOdd;
+		h = f >> 13;
+	}
+	return (uint16_t)(h | (sign >> 16));
+}
+
+static void floatToHalfScalar(const float* src, uint16_t* dst, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+		dst[i] = floatToHalf(src[i]);
+}
+
+static void floatToNormScalar(PackedNormFormat format, const float* src, void* dst, size_t count, const float* pSub, const float* pMul)
+{
+	float lo, hi, range;
+	normRange(format, &lo, &hi, &range);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const size_t c = i % VERTEX_PACKING_PATTERN_SIZE;
+		storeNorm(format, dst, i, roundNorm(clampNorm((src[i] - pSub[c]) * pMul[c], lo, hi) * range));
+	}
+}
+
+static inline void octahedralEncode(const float* v, float* oct)
+{
+	const float absLength = (fabsf(v[0]) + fabsf(v[1])) + fabsf(v[2]);
+	float x = absLength != 0.0f ? v[0] / absLength : 0.0f;
+	float y = absLength != 0.0f ? v[1] / absLength : 0.0f;
+	if (v[2] < 0.0f)
+	{
+		const float wrapX = x < 0.0f ? -(1.0f - fabsf(y)) : (1.0f - fabsf(y));
+		const float wrapY = y < 0.0f ? -(1.0f - fabsf(x)) : (1.0f - fabsf(x));
+		x = wrapX;
+		y = wrapY;
+	}
+	oct[0] = x;
+	oct[1] = y;
+}
+
+static void octahedralScalar(PackedNormFormat format, const uint8_t* src, uint32_t srcStride, void* dst, size_t count)
+{
+	float lo, hi, range;
+	normRange(format, &lo, &hi, &range);
+	const bool isSigned = lo < 0.0f;
+	for (size_t i = 0; i < count; ++i)
+	{
+		float v[3];
+		float oct[2];
+		memcpy(v, src + i * srcStride, sizeof(v));
+		octahedralEncode(v, oct);
+		for (uint32_t c = 0; c < 2; ++c)
+		{
+			const float n = isSigned ? oct[c] : (oct[c] + 1.0f) * 0.5f;
+			storeNorm(format, dst, i * 2 + c, roundNorm(clampNorm(n, lo, hi) * range));
+		}
+	}
+}
+
+static const VertexPackingKernels gScalarKernels = { floatToHalfScalar, floatToNormScalar, octahedralScalar };
+/************************************************************************/
+// SSE2
+/************************************************************************/
+#if defined(VERTEX_PACKING_SSE2)
+static inline __m128i floatToHalf4Sse2(__m128 f)
+{
+	const __m128i f16Max = _mm_set1_epi32((127 + 16) << 23);
+	const __m128i minNormal = _mm_set1_epi32((127 - 14) << 23);
+	const __m128i subnormalMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+	const __m128i normalBias = _mm_set1_epi32(0xfff - ((127 - 15) << 23));
+
+	const __m128  justSign = _mm_and_ps(f, _mm_castsi128_ps(_mm_set1_epi32((int32_t)0x80000000u)));
+	const __m128  absF = _mm_xor_ps(f, justSign);
+	const __m128i absInt = _mm_castps_si128(absF);
+
+	const __m128i isNan = _mm_castps_si128(_mm_cmpunord_ps(absF, absF));
+	const __m128i isRegular = _mm_cmpgt_epi32(f16Max, absInt);
+	const __m128i nanBits =
+		_mm_and_si128(isNan, _mm_or_si128(_mm_set1_epi32(0x200), _mm_and_si128(_mm_srli_epi32(absInt, 13), _mm_set1_epi32(0x3ff))));
+	const __m128i infOrNan = _mm_or_si128(nanBits, _mm_set1_epi32(0x7c00));
+
+	const __m128i isSubnormal = _mm_cmpgt_epi32(minNormal, absInt);
+	const __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absF, _mm_castsi128_ps(subnormalMagic))), subnormalMagic);
+
+	const __m128i mantissaOdd = _mm_srai_epi32(_mm_slli_epi32(absInt, 31 - 13), 31);
+	const __m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(absInt, normalBias), mantissaOdd), 13);
+
+	const __m128i finite = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+	const __m128i joined = _mm_or_si128(_mm_and_si128(isRegular, finite), _mm_andnot_si128(isRegular, infOrNan));
+	// Arithmetic shift keeps negative results in int16 range so the saturating pack leaves them untouched
+	return _mm_or_si128(joined, _mm_srai_epi32(_mm_castps_si128(justSign), 16));
+}
+
+static void floatToHalfSse2(const float* src, uint16_t* dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m128i lo = floatToHalf4Sse2(_mm_loadu_ps(src + i));
+		const __m128i hi = floatToHalf4Sse2(_mm_loadu_ps(src + i + 4));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(lo, hi));
+	}
+	floatToHalfScalar(src + i, dst + i, count - i);
+}
+
+static inline __m128i floatToNorm4Sse2(__m128 v, __m128 lo, __m128 hi, __m128 range)
+{
+	return _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(v, lo), hi), range));
+}
+
+// Stores the four int32 lanes of q, already inside the range of the format
+static inline void storeNormSse2(PackedNormFormat format, void* dst, size_t index, __m128i q)
+{
+	switch (format)
+	{
+	case PACKED_NORM_FORMAT_UNORM8:
+	{
+		const int32_t packed = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(q, q), _mm_setzero_si128()));
+		memcpy((uint8_t*)dst + index, &packed, sizeof(packed));
+		break;
+	}
+	case PACKED_NORM_FORMAT_SNORM8:
+	{
+		const int32_t packed = _mm_cvtsi128_si32(_mm_packs_epi16(_mm_packs_epi32(q, q), _mm_setzero_si128()));
+		memcpy((int8_t*)dst + index, &packed, sizeof(packed));
+		break;
+	}
+	case PACKED_NORM_FORMAT_UNORM16:
+	{
+		// No unsigned 32 -> 16 pack before SSE4.1, bias into the signed range and flip the top bit back
+		const __m128i bias = _mm_set1_epi32(0x8000);
+		const __m128i packed = _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(q, bias), _mm_setzero_si128()), _mm_set1_epi16((int16_t)0x8000));
+		_mm_storel_epi64((__m128i*)((uint16_t*)dst + index), packed);
+		break;
+	}
+	default: _mm_storel_epi64((__m128i*)((int16_t*)dst + index), _mm_packs_epi32(q, q)); break;
+	}
+}
+
+static void floatToNormSse2(PackedNormFormat format, const float* src, void* dst, size_t count, const float* pSub, const float* pMul)
+{
+	float loScalar, hiScalar, rangeScalar;
+	normRange(format, &loScalar, &hiScalar, &rangeScalar);
+	const __m128 lo = _mm_set1_ps(loScalar);
+	const __m128 hi = _mm_set1_ps(hiScalar);
+	const __m128 range = _mm_set1_ps(rangeScalar);
+
+	__m128 sub[3];
+	__m128 mul[3];
+	for (uint32_t k = 0; k < 3; ++k)
+	{
+		sub[k] = _mm_loadu_ps(pSub + k * 4);
+		mul[k] = _mm_loadu_ps(pMul + k * 4);
+	}
+
+	size_t i = 0;
+	for (; i + VERTEX_PACKING_PATTERN_SIZE <= count; i += VERTEX_PACKING_PATTERN_SIZE)
+	{
+		for (uint32_t k = 0; k < 3; ++k)
+		{
+			const __m128 v = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(src + i + k * 4), sub[k]), mul[k]);
+			storeNormSse2(format, dst, i + k * 4, floatToNorm4Sse2(v, lo, hi, range));
+		}
+	}
+
+	for (; i < count; ++i)
+	{
+		const size_t c = i % VERTEX_PACKING_PATTERN_SIZE;
+		storeNorm(format, dst, i, roundNorm(clampNorm((src[i] - pSub[c]) * pMul[c], loScalar, hiScalar) * rangeScalar));
+	}
+}
+
+static void octahedralSse2(PackedNormFormat format, const uint8_t* src, uint32_t srcStride, void* dst, size_t count)
+{
+	float loScalar, hiScalar, rangeScalar;
+	normRange(format, &loScalar, &hiScalar, &rangeScalar);
+	const bool   isSigned = loScalar < 0.0f;
+	const __m128 lo = _mm_set1_ps(loScalar);
+	const __m128 hi = _mm_set1_ps(hiScalar);
+	const __m128 range = _mm_set1_ps(rangeScalar);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32((int32_t)0x80000000u));
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		// Transpose four float3 into SoA registers
+		float xyz[3][4];
+		for (uint32_t e = 0; e < 4; ++e)
+		{
+			float v[3];
+			memcpy(v, src + (i + e) * srcStride, sizeof(v));
+			xyz[0][e] = v[0];
+			xyz[1][e] = v[1];
+			xyz[2][e] = v[2];
+		}
+		const __m128 vx = _mm_loadu_ps(xyz[0]);
+		const __m128 vy = _mm_loadu_ps(xyz[1]);
+		const __m128 vz = _mm_loadu_ps(xyz[2]);
+
+		const __m128 absLength = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, vx), _mm_andnot_ps(signMask, vy)), _mm_andnot_ps(signMask, vz));
+		const __m128 nonZero = _mm_cmpneq_ps(absLength, zero);
+		__m128       x = _mm_and_ps(nonZero, _mm_div_ps(vx, absLength));
+		__m128       y = _mm_and_ps(nonZero, _mm_div_ps(vy, absLength));
+
+		const __m128 wrapX = _mm_xor_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, y)), _mm_and_ps(_mm_cmplt_ps(x, zero), signMask));
+		const __m128 wrapY = _mm_xor_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, x)), _mm_and_ps(_mm_cmplt_ps(y, zero), signMask));
+		const __m128 lowerHemisphere = _mm_cmplt_ps(vz, zero);
+		x = _mm_or_ps(_mm_and_ps(lowerHemisphere, wrapX), _mm_andnot_ps(lowerHemisphere, x));
+		y = _mm_or_ps(_mm_and_ps(lowerHemisphere, wrapY), _mm_andnot_ps(lowerHemisphere, y));
+		if (!isSigned)
+		{
+			x = _mm_mul_ps(_mm_add_ps(x, one), half);
+			y = _mm_mul_ps(_mm_add_ps(y, one), half);
+		}
+
+		const __m128i qx = floatToNorm4Sse2(x, lo, hi, range);
+		const __m128i qy = floatToNorm4Sse2(y, lo, hi, range);
+		// x0 y0 x1 y1 | x2 y2 x3 y3
+		storeNormSse2(format, dst, i * 2, _mm_unpacklo_epi32(qx, qy));
+		storeNormSse2(format, dst, i * 2 + 4, _mm_unpackhi_epi32(qx, qy));
+	}
+	octahedralScalar(format, src + i * srcStride, srcStride, (uint8_t*)dst + i * 2 * packedNormSize(format), count - i);
+}
+
+static const VertexPackingKernels gSse2Kernels = { floatToHalfSse2, floatToNormSse2, octahedralSse2 };
+#endif
+/************************************************************************/
+// AVX2 + F16C
+/************************************************************************/
+#if defined(VERTEX_PACKING_AVX2)
+VERTEX_PACKING_TARGET_AVX2 static void floatToHalfAvx2(const float* src, uint16_t* dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		const __m128i lo = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+		const __m128i hi = _mm256_cvtps_ph(_mm256_loadu_ps(src + i + 8), _MM_FROUND_TO_NEAREST_INT);
+		_mm_storeu_si128((__m128i*)(dst + i), lo);
+		_mm_storeu_si128((__m128i*)(dst + i + 8), hi);
+	}
+	for (; i + 4 <= count; i += 4)
+		_mm_storel_epi64((__m128i*)(dst + i), _mm_cvtps_ph(_mm_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+	floatToHalfScalar(src + i, dst + i, count - i);
+}
+
+// Normalized conversions are bound by the packing shuffles rather than arithmetic and share the SSE2 kernels
+static const VertexPackingKernels gAvx2Kernels = { floatToHalfAvx2, floatToNormSse2, octahedralSse2 };
+
+static bool cpuSupportsAvx2()
+{
+	// AVX state must also be enabled by the OS (OSXSAVE + XCR0 bits 1 and 2)
+#if defined(_MSC_VER)
+	int info[4] = {};
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	const uint32_t ecx1 = (uint32_t)info[2];
+	__cpuidex(info, 7, 0);
+	const uint32_t ebx7 = (uint32_t)info[1];
+#else
+	uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+	if (__get_cpuid_max(0, NULL) < 7)
+		return false;
+	__cpuid(1, eax, ebx, ecx, edx);
+	const uint32_t ecx1 = ecx;
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	const uint32_t ebx7 = ebx;
+#endif
+	const bool osxsave = (ecx1 & (1u << 27)) != 0;
+	const bool avx = (ecx1 & (1u << 28)) != 0;
+	const bool f16c = (ecx1 & (1u << 29)) != 0;
+	const bool avx2 = (ebx7 & (1u << 5)) != 0;
+	if (!osxsave || !avx || !f16c || !avx2)
+		return false;
+
+#if defined(_MSC_VER)
+	const uint64_t xcr0 = _xgetbv(0);
+#else
+	uint32_t xcr0Lo = 0, xcr0Hi = 0;
+	__asm__ volatile("xgetbv" : "=a"(xcr0Lo), "=d"(xcr0Hi) : "c"(0));
+	const uint64_t xcr0 = ((uint64_t)xcr0Hi << 32) | xcr0Lo;
+#endif
+	return (xcr0 & 0x6) == 0x6;
+}
+#endif
+/************************************************************************/
+// NEON
+/************************************************************************/
+#if defined(VERTEX_PACKING_NEON)
+static void floatToHalfNeon(const float* src, uint16_t* dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const float16x8_t h = vcvt_high_f16_f32(vcvt_f16_f32(vld1q_f32(src + i)), vld1q_f32(src + i + 4));
+		vst1q_u16(dst + i, vreinterpretq_u16_f16(h));
+	}
+	floatToHalfScalar(src + i, dst + i, count - i);
+}
+
+// vmaxq / vminq propagate NaN, select explicitly to keep the SSE semantics of the reference
+static inline int32x4_t floatToNorm4Neon(float32x4_t v, float32x4_t lo, float32x4_t hi, float32x4_t range)
+{
+	v = vbslq_f32(vcgtq_f32(v, lo), v, lo);
+	v = vbslq_f32(vcltq_f32(v, hi), v, hi);
+	return vcvtnq_s32_f32(vmulq_f32(v, range));
+}
+
+static inline void storeNormNeon(PackedNormFormat format, void* dst, size_t index, int32x4_t q)
+{
+	const int16x4_t q16 = vmovn_s32(q);
+	switch (format)
+	{
+	case PACKED_NORM_FORMAT_UNORM8:
+	case PACKED_NORM_FORMAT_SNORM8:
+	{
+		const uint32_t packed = vget_lane_u32(vreinterpret_u32_s8(vmovn_s16(vcombine_s16(q16, q16))), 0);
+		memcpy((uint8_t*)dst + index, &packed, sizeof(packed));
+		break;
+	}
+	default: vst1_s16((int16_t*)dst + index, q16); break;
+	}
+}
+
+static void floatToNormNeon(PackedNormFormat format, const float* src, void* dst, size_t count, const float* pSub, const float* pMul)
+{
+	float loScalar, hiScalar, rangeScalar;
+	normRange(format, &loScalar, &hiScalar, &rangeScalar);
+	const float32x4_t lo = vdupq_n_f32(loScalar);
+	const float32x4_t hi = vdupq_n_f32(hiScalar);
+	const float32x4_t range = vdupq_n_f32(rangeScalar);
+
+	float32x4_t sub[3];
+	float32x4_t mul[3];
+	for (uint32_t k = 0; k < 3; ++k)
+	{
+		sub[k] = vld1q_f32(pSub + k * 4);
+		mul[k] = vld1q_f32(pMul + k * 4);
+	}
+
+	size_t i = 0;
+	for (; i + VERTEX_PACKING_PATTERN_SIZE <= count; i += VERTEX_PACKING_PATTERN_SIZE)
+	{
+		for (uint32_t k = 0; k < 3; ++k)
+		{
+			const float32x4_t v = vmulq_f32(vsubq_f32(vld1q_f32(src + i + k * 4), sub[k]), mul[k]);
+			storeNormNeon(format, dst, i + k * 4, floatToNorm4Neon(v, lo, hi, range));
+		}
+	}
+
+	for (; i < count; ++i)
+	{
+		const size_t c = i % VERTEX_PACKING_PATTERN_SIZE;
+		storeNorm(format, dst, i, roundNorm(clampNorm((src[i] - pSub[c]) * pMul[c], loScalar, hiScalar) * rangeScalar));
+	}
+}
+
+static void octahedralNeon(PackedNormFormat format, const uint8_t* src, uint32_t srcStride, void* dst, size_t count)
+{
+	float loScalar, hiScalar, rangeScalar;
+	normRange(format, &loScalar, &hiScalar, &rangeScalar);
+	const bool        isSigned = loScalar < 0.0f;
+	const float32x4_t lo = vdupq_n_f32(loScalar);
+	const float32x4_t hi = vdupq_n_f32(hiScalar);
+	const float32x4_t range = vdupq_n_f32(rangeScalar);
+	const float32x4_t zero = vdupq_n_f32(0.0f);
+	const float32x4_t one = vdupq_n_f32(1.0f);
+	const float32x4_t half = vdupq_n_f32(0.5f);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		float xyz[3][4];
+		for (uint32_t e = 0; e < 4; ++e)
+		{
+			float v[3];
+			memcpy(v, src + (i + e) * srcStride, sizeof(v));
+			xyz[0][e] = v[0];
+			xyz[1][e] = v[1];
+			xyz[2][e] = v[2];
+		}
+		const float32x4_t vx = vld1q_f32(xyz[0]);
+		const float32x4_t vy = vld1q_f32(xyz[1]);
+		const float32x4_t vz = vld1q_f32(xyz[2]);
+
+		const float32x4_t absLength = vaddq_f32(vaddq_f32(vabsq_f32(vx), vabsq_f32(vy)), vabsq_f32(vz));
+		const uint32x4_t  nonZero = vmvnq_u32(vceqq_f32(absLength, zero));
+		float32x4_t       x = vreinterpretq_f32_u32(vandq_u32(nonZero, vreinterpretq_u32_f32(vdivq_f32(vx, absLength))));
+		float32x4_t       y = vreinterpretq_f32_u32(vandq_u32(nonZero, vreinterpretq_u32_f32(vdivq_f32(vy, absLength))));
+
+		const float32x4_t wrapX = vsubq_f32(one, vabsq_f32(y));
+		const float32x4_t wrapY = vsubq_f32(one, vabsq_f32(x));
+		const uint32x4_t  lowerHemisphere = vcltq_f32(vz, zero);
+		const float32x4_t newX = vbslq_f32(vcltq_f32(x, zero), vnegq_f32(wrapX), wrapX);
+		const float32x4_t newY = vbslq_f32(vcltq_f32(y, zero), vnegq_f32(wrapY), wrapY);
+		x = vbslq_f32(lowerHemisphere, newX, x);
+		y = vbslq_f32(lowerHemisphere, newY, y);
+		if (!isSigned)
+		{
+			x = vmulq_f32(vaddq_f32(x, one), half);
+			y = vmulq_f32(vaddq_f32(y, one), half);
+		}
+
+		const int32x4x2_t q = vzipq_s32(floatToNorm4Neon(x, lo, hi, range), floatToNorm4Neon(y, lo, hi, range));
+		storeNormNeon(format, dst, i * 2, q.val[0]);
+		storeNormNeon(format, dst, i * 2 + 4, q.val[1]);
+	}
+	octahedralScalar(format, src + i * srcStride, srcStride, (uint8_t*)dst + i * 2 * packedNormSize(format), count - i);
+}
+
+static const VertexPackingKernels gNeonKernels = { floatToHalfNeon, floatToNormNeon, octahedralNeon };
+#endif
+/************************************************************************/
+// Dispatch
+/************************************************************************/
+// Zero until the first call, then the selected VertexPackingIsa + 1
+static tfrg_atomic32_t gVertexPackingIsa = 0;
+
+static VertexPackingIsa detectVertexPackingIsa()
+{
+#if defined(VERTEX_PACKING_AVX2)
+	if (cpuSupportsAvx2())
+		return VERTEX_PACKING_ISA_AVX2;
+#endif
+#if defined(VERTEX_PACKING_SSE2)
+	return VERTEX_PACKING_ISA_SSE2;
+#elif defined(VERTEX_PACKING_NEON)
+	return VERTEX_PACKING_ISA_NEON;
+#else
+	return VERTEX_PACKING_ISA_SCALAR;
+#endif
+}
+
+VertexPackingIsa getVertexPackingIsa()
+{
+	uint32_t isa = tfrg_atomic32_load_relaxed(&gVertexPackingIsa);
+	if (!isa)
+	{
+		// Detection is idempotent so racing threads simply store the same value
+		isa = (uint32_t)detectVertexPackingIsa() + 1;
+		tfrg_atomic32_store_relaxed(&gVertexPackingIsa, isa);
+	}
+	return (VertexPackingIsa)(isa - 1);
+}
+
+VertexPackingIsa setVertexPackingIsa(VertexPackingIsa isa)
+{
+	const VertexPackingIsa best = detectVertexPackingIsa();
+	bool supported = VERTEX_PACKING_ISA_SCALAR == isa || best == isa;
+#if defined(VERTEX_PACKING_SSE2)
+	supported |= VERTEX_PACKING_ISA_SSE2 == isa;
+#endif
+	if (!supported)
+	{
+		LOGF(eWARNING, "Vertex packing ISA %s is not supported on this CPU, using %s", getVertexPackingIsaName(isa), getVertexPackingIsaName(best));
+		isa = best;
+	}
+	tfrg_atomic32_store_relaxed(&gVertexPackingIsa, (uint32_t)isa + 1);
+	return isa;
+}
+
+const char* getVertexPackingIsaName(VertexPackingIsa isa)
+{
+	switch (isa)
+	{
+	case VERTEX_PACKING_ISA_SSE2: return "SSE2";
+	case VERTEX_PACKING_ISA_AVX2: return "AVX2";
+	case VERTEX_PACKING_ISA_NEON: return "NEON";
+	default: return "Scalar";
+	}
+}
+
+static const VertexPackingKernels* getVertexPackingKernels()
+{
+	switch (getVertexPackingIsa())
+	{
+#if defined(VERTEX_PACKING_SSE2)
+	case VERTEX_PACKING_ISA_SSE2: return &gSse2Kernels;
+#endif
+#if defined(VERTEX_PACKING_AVX2)
+	case VERTEX_PACKING_ISA_AVX2: return &gAvx2Kernels;
+#endif
+#if defined(VERTEX_PACKING_NEON)
+	case VERTEX_PACKING_ISA_NEON: return &gNeonKernels;
+#endif
+	default: return &gScalarKernels;
+	}
+}
+/************************************************************************/
+// Strided entry points
+/************************************************************************/
+void copyStridedElements(uint32_t count, uint32_t elementSize, const void* src, uint32_t srcStride, void* dst, uint32_t dstStride)
+{
+	const uint8_t* pSrc = (const uint8_t*)src;
+	uint8_t*       pDst = (uint8_t*)dst;
+	if (srcStride == elementSize && dstStride == elementSize)
+	{
+		memcpy(pDst, pSrc, (size_t)count * elementSize);
+		return;
+	}
+
+	// Constant sizes let the compiler turn each copy into one or two register moves
+	switch (elementSize)
+	{
+#define COPY_STRIDED_CASE(size)                                              \
+	case size:                                                               \
+		for (uint32_t e = 0; e < count; ++e)                                 \
+			memcpy(pDst + (size_t)e * dstStride, pSrc + (size_t)e * srcStride, size); \
+		break;
+		COPY_STRIDED_CASE(2)
+		COPY_STRIDED_CASE(4)
+		COPY_STRIDED_CASE(8)
+		COPY_STRIDED_CASE(12)
+		COPY_STRIDED_CASE(16)
+#undef COPY_STRIDED_CASE
+	default:
+		for (uint32_t e = 0; e < count; ++e)
+			memcpy(pDst + (size_t)e * dstStride, pSrc + (size_t)e * srcStride, elementSize);
+		break;
+	}
+}
+
+void packFloatToHalf(uint32_t count, uint32_t componentCount, const void* src, uint32_t srcStride, void* dst, uint32_t dstStride)
+{
+	ASSERT(componentCount >= 1 && componentCount <= 4);
+	const VertexPackingKernels* pKernels = getVertexPackingKernels();
+	const uint32_t              srcSize = componentCount * (uint32_t)sizeof(float);
+	const uint32_t              dstSize = componentCount * (uint32_t)sizeof(uint16_t);
+	if (srcStride == srcSize && dstStride == dstSize)
+	{
+		pKernels->pFloatToHalf((const float*)src, (uint16_t*)dst, (size_t)count * componentCount);
+		return;
+	}
+
+	float    srcBlock[VERTEX_PACKING_BLOCK_SIZE * 4];
+	uint16_t dstBlock[VERTEX_PACKING_BLOCK_SIZE * 4];
+	for (uint32_t i = 0; i < count; i += VERTEX_PACKING_BLOCK_SIZE)
+	{
+		const uint32_t n = count - i < VERTEX_PACKING_BLOCK_SIZE ? count - i : VERTEX_PACKING_BLOCK_SIZE;
+		const uint8_t* pSrc = (const uint8_t*)src + (size_t)i * srcStride;
+		uint8_t*       pDst = (uint8_t*)dst + (size_t)i * dstStride;
+		if (srcStride != srcSize)
+		{
+			copyStridedElements(n, srcSize, pSrc, srcStride, srcBlock, srcSize);
+			pSrc = (const uint8_t*)srcBlock;
+		}
+		pKernels->pFloatToHalf((const float*)pSrc, dstStride == dstSize ? (uint16_t*)pDst : dstBlock, (size_t)n * componentCount);
+		if (dstStride != dstSize)
+			copyStridedElements(n, dstSize, dstBlock, dstSize, pDst, dstStride);
+	}
+}
+
+void packFloatToNorm(
+	PackedNormFormat format, uint32_t count, uint32_t componentCount, const float* pScale, const float* pOffset, const void* src,
+	uint32_t srcStride, void* dst, uint32_t dstStride)
+{
+	ASSERT(componentCount >= 1 && componentCount <= 4);
+	const VertexPackingKernels* pKernels = getVertexPackingKernels();
+
+	// Expand the per component remap to the pattern the kernels step through
+	float sub[VERTEX_PACKING_PATTERN_SIZE];
+	float mul[VERTEX_PACKING_PATTERN_SIZE];
+	for (uint32_t i = 0; i < VERTEX_PACKING_PATTERN_SIZE; ++i)
+	{
+		const uint32_t c = i % componentCount;
+		const float    scale = pScale ? pScale[c] : 1.0f;
+		sub[i] = pOffset ? pOffset[c] : 0.0f;
+		mul[i] = scale != 0.0f ? 1.0f / scale : 0.0f;
+	}
+
+	const uint32_t srcSize = componentCount * (uint32_t)sizeof(float);
+	const uint32_t dstSize = componentCount * packedNormSize(format);
+	if (srcStride == srcSize && dstStride == dstSize)
+	{
+		pKernels->pFloatToNorm(format, (const float*)src, dst, (size_t)count * componentCount, sub, mul);
+		return;
+	}
+
+	float    srcBlock[VERTEX_PACKING_BLOCK_SIZE * 4];
+	uint16_t dstBlock[VERTEX_PACKING_BLOCK_SIZE * 4];
+	for (uint32_t i = 0; i < count; i += VERTEX_PACKING_BLOCK_SIZE)
+	{
+		const uint32_t n = count - i < VERTEX_PACKING_BLOCK_SIZE ? count - i : VERTEX_PACKING_BLOCK_SIZE;
+		const uint8_t* pSrc = (const uint8_t*)src + (size_t)i * srcStride;
+		uint8_t*       pDst = (uint8_t*)dst + (size_t)i * dstStride;
+		if (srcStride != srcSize)
+		{
+			copyStridedElements(n, srcSize, pSrc, srcStride, srcBlock, srcSize);
+			pSrc = (const uint8_t*)srcBlock;
+		}
+		pKernels->pFloatToNorm(format, (const float*)pSrc, dstStride == dstSize ? (void*)pDst : (void*)dstBlock, (size_t)n * componentCount, sub, mul);
+		if (dstStride != dstSize)
+			copyStridedElements(n, dstSize, dstBlock, dstSize, pDst, dstStride);
+	}
+}
+
+void packOctahedral(PackedNormFormat format, uint32_t count, const void* src, uint32_t srcStride, void* dst, uint32_t dstStride)
+{
+	const VertexPackingKernels* pKernels = getVertexPackingKernels();
+	const uint32_t              dstSize = 2 * packedNormSize(format);
+	if (dstStride == dstSize)
+	{
+		pKernels->pOctahedral(format, (const uint8_t*)src, srcStride, dst, count);
+		return;
+	}
+
+	// The kernels gather their source with any stride, only the output needs staging
+	uint16_t dstBlock[VERTEX_PACKING_BLOCK_SIZE * 2];
+	for (uint32_t i = 0; i < count; i += VERTEX_PACKING_BLOCK_SIZE)
+	{
+		const uint32_t n = count - i < VERTEX_PACKING_BLOCK_SIZE ? count - i : VERTEX_PACKING_BLOCK_SIZE;
+		pKernels->pOctahedral(format, (const uint8_t*)src + (size_t)i * srcStride, srcStride, dstBlock, n);
+		copyStridedElements(n, dstSize, dstBlock, dstSize, (uint8_t*)dst + (size_t)i * dstStride, dstStride);
+	}
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2019 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// Bulk vertex attribute conversion kernels shared by the resource loader and offline mesh tools.
+// Every kernel reads count elements from src and writes count elements to dst, stepping each side by its own stride,
+// so the same call handles tightly packed arrays as well as attributes interleaved inside a larger vertex.
+// The implementation is selected once per process for the host CPU. All paths produce bit identical results.
+
+typedef enum VertexPackingIsa
+{
+	VERTEX_PACKING_ISA_SCALAR = 0,
+	VERTEX_PACKING_ISA_SSE2,
+	// AVX2 + F16C
+	VERTEX_PACKING_ISA_AVX2,
+	VERTEX_PACKING_ISA_NEON,
+} VertexPackingIsa;
+
+typedef enum PackedNormFormat
+{
+	PACKED_NORM_FORMAT_UNORM8 = 0,
+	PACKED_NORM_FORMAT_SNORM8,
+	PACKED_NORM_FORMAT_UNORM16,
+	PACKED_NORM_FORMAT_SNORM16,
+} PackedNormFormat;
+
+// Best instruction set supported by this CPU and build
+VertexPackingIsa getVertexPackingIsa();
+// Forces the kernels to a specific instruction set, clamped to what the CPU supports. Returns the one in effect.
+// Meant for benchmarking and validating the vector paths against the scalar reference, not for shipping code.
+VertexPackingIsa setVertexPackingIsa(VertexPackingIsa isa);
+const char* getVertexPackingIsaName(VertexPackingIsa isa);
+
+// componentCount floats per element to IEEE half, round to nearest even
+void packFloatToHalf(uint32_t count, uint32_t componentCount, const void* src, uint32_t srcStride, void* dst, uint32_t dstStride);
+
+// componentCount floats per element to normalized integers. Each component is remapped as (v - pOffset[c]) / pScale[c]
+// before clamping to the range of the format. pScale / pOffset can be NULL for the identity mapping, a zero scale writes zero.
+void packFloatToNorm(
+	PackedNormFormat format, uint32_t count, uint32_t componentCount, const float* pScale, const float* pOffset, const void* src,
+	uint32_t srcStride, void* dst, uint32_t dstStride);
+
+// float3 directions to two component octahedral encoding. Unorm formats store the [-1, 1] projection biased to [0, 1]
+void packOctahedral(PackedNormFormat format, uint32_t count, const void* src, uint32_t srcStride, void* dst, uint32_t dstStride);
+
+// Strided element copy used to interleave attribute streams into a vertex or deinterleave them back out
+void copyStridedElements(uint32_t count, uint32_t elementSize, const void* src, uint32_t srcStride, void* dst, uint32_t dstStride);
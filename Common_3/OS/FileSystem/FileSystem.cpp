@@ -28,6 +28,8 @@
 #include "../Interfaces/IMemory.h"
 
 bool PlatformOpenFile(ResourceDirectory resourceDir, const char* fileName, FileMode mode, FileStream* pOut);
+bool PlatformMapFile(ResourceDirectory resourceDir, const char* fileName, void** ppData, ssize_t* pSize);
+void PlatformUnmapFile(void* pData, ssize_t size);
 
 typedef struct ResourceDirectoryInfo
 {
@@ -145,6 +147,14 @@ static bool MemoryStreamIsAtEnd(const FileStream* pStream)
 	return pStream->mMemory.mCursor == pStream->mSize;
 }
 /************************************************************************/
+// Mapped File Stream Functions
+/************************************************************************/
+static bool MappedStreamClose(FileStream* pStream)
+{
+	PlatformUnmapFile(pStream->mMemory.pBuffer, pStream->mSize);
+	return true;
+}
+/************************************************************************/
 // File Stream Functions
 /************************************************************************/
 static bool FileStreamOpen(IFileSystem*, const ResourceDirectory resourceDir, const char* fileName, FileMode mode, FileStream* pOut)
@@ -276,6 +286,19 @@ static IFileSystem gSystemFileIO =
 	FileStreamIsAtEnd
 };
 
+static IFileSystem gMappedFileIO =
+{
+	NULL,
+	MappedStreamClose,
+	MemoryStreamRead,
+	MemoryStreamWrite,
+	MemoryStreamSeek,
+	MemoryStreamGetSeekPosition,
+	MemoryStreamGetSize,
+	MemoryStreamFlush,
+	MemoryStreamIsAtEnd
+};
+
 IFileSystem* pSystemFileIO = &gSystemFileIO;
 
 bool fsOpenStreamFromMemory(const void* buffer, size_t bufferSize, FileMode mode, bool owner, FileStream* pOut)
@@ -305,6 +328,45 @@ bool fsOpenStreamFromPath(const ResourceDirectory resourceDir, const char* fileN
 	return io->Open(io, resourceDir, fileName, mode, pOut);
 }
 
+bool fsOpenMappedStreamFromPath(const ResourceDirectory resourceDir, const char* fileName, FileStream* pOut)
+{
+	const ResourceDirectoryInfo* dir = &gResourceDirectories[resourceDir];
+	if (dir->pIO == pSystemFileIO && !dir->mBundled)
+	{
+		void* pData = NULL;
+		ssize_t size = 0;
+		if (!PlatformMapFile(resourceDir, fileName, &pData, &size))
+		{
+			return false;
+		}
+
+		FileStream stream = {};
+		stream.mMemory.pBuffer = (uint8_t*)pData;
+		stream.mSize = size;
+		stream.mMode = FM_READ_BINARY;
+		stream.pIO = &gMappedFileIO;
+		*pOut = stream;
+		return true;
+	}
+
+	// Bundles and custom file systems can not be mapped. Read the whole file instead
+	FileStream file = {};
+	if (!fsOpenStreamFromPath(resourceDir, fileName, FM_READ_BINARY, &file))
+	{
+		return false;
+	}
+	ssize_t size = fsGetStreamFileSize(&file);
+	void* pData = size > 0 ? tf_malloc(size) : NULL;
+	bool success = size > 0 && fsReadFromStream(&file, pData, size) == (size_t)size;
+	fsCloseStream(&file);
+	if (!success)
+	{
+		tf_free(pData);
+		return false;
+	}
+	return fsOpenStreamFromMemory(pData, size, FM_READ_BINARY, true, pOut);
+}
+
 /// Closes and invalidates the file stream.
 bool fsCloseStream(FileStream* pStream)
 {
@@ -627,6 +689,11 @@ bool fsIsBundledResourceDir(ResourceDirectory resourceDir)
 	return gResourceDirectories[resourceDir].mBundled;
 }
 
+bool fsIsResourceDirectorySet(ResourceDirectory resourceDir)
+{
+	return gResourceDirectories[resourceDir].pIO != NULL;
+}
+
 const char* fsGetResourceDirectory(ResourceDirectory resourceDir)
 {
 	const ResourceDirectoryInfo* dir = &gResourceDirectories[resourceDir];
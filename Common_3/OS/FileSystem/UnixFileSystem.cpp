@@ -23,6 +23,8 @@
 */
 
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -81,6 +83,60 @@ time_t fsGetLastModifiedTime(ResourceDirectory resourceDir, const char* fileName
 	return fileInfo.st_mtime;
 }
 
+bool fsRenameFile(ResourceDirectory resourceDir, const char* fileName, const char* newFileName)
+{
+	const char* resourcePath = fsGetResourceDirectory(resourceDir);
+	char filePath[FS_MAX_PATH] = { 0 };
+	char newFilePath[FS_MAX_PATH] = { 0 };
+	fsAppendPathComponent(resourcePath, fileName, filePath);
+	fsAppendPathComponent(resourcePath, newFileName, newFilePath);
+	return rename(filePath, newFilePath) == 0;
+}
+
+bool fsRemoveFile(ResourceDirectory resourceDir, const char* fileName)
+{
+	const char* resourcePath = fsGetResourceDirectory(resourceDir);
+	char filePath[FS_MAX_PATH] = { 0 };
+	fsAppendPathComponent(resourcePath, fileName, filePath);
+	return unlink(filePath) == 0;
+}
+
+bool PlatformMapFile(ResourceDirectory resourceDir, const char* fileName, void** ppData, ssize_t* pSize)
+{
+	const char* resourcePath = fsGetResourceDirectory(resourceDir);
+	char filePath[FS_MAX_PATH] = {};
+	fsAppendPathComponent(resourcePath, fileName, filePath);
+
+	int fd = open(filePath, O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat fileInfo = {};
+	void* pData = MAP_FAILED;
+	if (fstat(fd, &fileInfo) == 0 && fileInfo.st_size > 0)
+	{
+		pData = mmap(NULL, (size_t)fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	// The mapping stays valid after closing the descriptor
+	close(fd);
+
+	if (MAP_FAILED == pData)
+	{
+		return false;
+	}
+
+	*ppData = pData;
+	*pSize = (ssize_t)fileInfo.st_size;
+	return true;
+}
+
+void PlatformUnmapFile(void* pData, ssize_t size)
+{
+	munmap(pData, (size_t)size);
+}
+
 bool UnixOpenFile(ResourceDirectory resourceDir, const char* fileName, FileMode mode, FileStream* pOut)
 {
 	const char* resourcePath = fsGetResourceDirectory(resourceDir);
@@ -95,6 +151,12 @@ bool UnixOpenFile(ResourceDirectory resourceDir, const char* fileName, FileMode
 		return false;
 	}
 
+	// Unbuffered, every write goes to the O_APPEND descriptor in one piece so appends of other processes can not interleave
+	if (mode & FM_APPEND)
+	{
+		setvbuf(file, NULL, _IONBF, 0);
+	}
+
 	*pOut = {};
 	pOut->pFile = file;
 	pOut->mMode = mode;
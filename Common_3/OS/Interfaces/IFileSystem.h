@@ -89,6 +89,11 @@ typedef enum ResourceDirectory
 	RD_MIDDLEWARE_15,
 
 	____rd_lib_counter_end = ____rd_lib_counter_begin + 99 * 2,
+
+	/// Processed geometry written by the resource loader. Geometry caching is disabled while this directory is not set
+	RD_GEOMETRY_CACHE,
+	/// Textures converted from source images by the resource loader. Source image loading is disabled while this directory is not set
+	RD_TEXTURE_CACHE,
 	RD_COUNT
 } ResourceDirectory;
 
@@ -193,6 +198,12 @@ bool fsOpenStreamFromPath(const ResourceDirectory resourceDir, const char* fileN
 /// Opens a memory buffer as a FileStream, returning a stream that must be closed with `fsCloseStream`.
 bool fsOpenStreamFromMemory(const void* buffer, size_t bufferSize, FileMode mode, bool owner, FileStream* pOut);
 
+/// Maps the file at `fileName` read only into memory, returning a memory stream over the mapping.
+/// `pOut->mMemory.pBuffer` points at the file contents until the stream is closed.
+/// Bundled resource directories fall back to reading the whole file into memory.
+/// Unlike fsOpenStreamFromPath, a missing file is not reported as an error.
+bool fsOpenMappedStreamFromPath(const ResourceDirectory resourceDir, const char* fileName, FileStream* pOut);
+
 /// Closes and invalidates the file stream.
 bool fsCloseStream(FileStream* stream);
 
@@ -201,6 +212,7 @@ size_t fsReadFromStream(FileStream* stream, void* outputBuffer, size_t bufferSiz
 
 /// Reads at most `bufferSizeInBytes` bytes from sourceBuffer and writes them into the file.
 /// Returns the number of bytes written.
+/// Streams opened with FM_APPEND_BINARY write each call in one piece, so processes appending to the same file can not interleave.
 size_t fsWriteToStream(FileStream* stream, const void* sourceBuffer, size_t byteCount);
 
 /// Seeks to the specified position in the file, using `baseOffset` as the reference offset.
@@ -245,6 +257,9 @@ void fsGetPathExtension(const char* path, char* output);
 /// Returns location set for resource directory in fsSetPathForResourceDir.
 const char* fsGetResourceDirectory(ResourceDirectory resourceDir);
 
+/// Returns whether fsSetPathForResourceDir was called for `resourceDir`.
+bool fsIsResourceDirectorySet(ResourceDirectory resourceDir);
+
 /// Sets the relative path for `resourceDir` from `mount` to `bundledFolder`.
 /// The `resourceDir` will making use of the given IFileSystem `pIO` file functions.
 /// When `mount` is set to `RM_CONTENT` for a `resourceDir`, this directory is marked as a bundled resource folder.
@@ -256,6 +271,13 @@ void fsSetPathForResourceDir(IFileSystem* pIO, ResourceMount mount, ResourceDire
 /************************************************************************/
 /// Gets the time of last modification for the file at `fileName`, within 'resourceDir'.
 time_t fsGetLastModifiedTime(ResourceDirectory resourceDir, const char* fileName);
+
+/// Renames `fileName` to `newFileName` within 'resourceDir', replacing `newFileName` if it exists.
+/// Streams still open on the replaced file keep reading its old contents.
+bool fsRenameFile(ResourceDirectory resourceDir, const char* fileName, const char* newFileName);
+
+/// Deletes the file at `fileName`, within 'resourceDir'.
+bool fsRemoveFile(ResourceDirectory resourceDir, const char* fileName);
 /************************************************************************/
 // MARK: - FileMode
 /************************************************************************/
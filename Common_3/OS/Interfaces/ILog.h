@@ -77,9 +77,9 @@ do                                                                             \
 #endif
 
 // Usage: LOGF(LogLevel::eINFO | LogLevel::eDEBUG, "Whatever string %s, this is an int %d", "This is a string", 1)
-#define LOGF(log_level, ...) Log::Write((log_level), __FILE__, __LINE__, __VA_ARGS__)
+#define LOGF(log_level, ...) Log::Dispatch((log_level), __FILE__, __LINE__, __VA_ARGS__)
 // Usage: LOGF_IF(LogLevel::eINFO | LogLevel::eDEBUG, boolean_value && integer_value == 5, "Whatever string %s, this is an int %d", "This is a string", 1)
-#define LOGF_IF(log_level, condition, ...) ((condition) ? Log::Write((log_level), __FILE__, __LINE__, __VA_ARGS__) : (void)0)
+#define LOGF_IF(log_level, condition, ...) ((condition) ? Log::Dispatch((log_level), __FILE__, __LINE__, __VA_ARGS__) : (void)0)
 //
 #define LOGF_SCOPE(log_level, ...) Log::LogScope ANONIMOUS_VARIABLE_LOG(scope_log_){ (log_level), __FILE__, __LINE__, __VA_ARGS__ }
 
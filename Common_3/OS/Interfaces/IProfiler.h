@@ -68,9 +68,42 @@ void setAggregateFrames(uint32_t nFrames);
 // Dump profile data to "profile-(date).html" of recorded frames, until a maximum amount of frames
 void dumpProfileData(Renderer* pRenderer, const char* appName = "" , uint32_t nMaxFrames = 64);
 
-// Dump benchmark data to "benchmark-(data).txt" of recorded frames
-void dumpBenchmarkData(Renderer* pRenderer, IApp::Settings* pSettings, const char* appName = "");
+// Dump recorded frames to "profile-(date).json" in Chrome trace event format, or to "profile-(date).perfetto-trace" as a Perfetto protobuf trace
+void dumpProfileTrace(const char* appName = "", uint32_t nMaxFrames = 64, bool bPerfetto = false);
 
+// Start a continuous capture of every profiled frame, streamed to "capture-(date).tfprof" on a background thread.
+// Memory use is bounded by nMemoryBudgetMB, frames are dropped when the writer falls behind.
+void startProfileCapture(const char* appName = "", uint32_t nMemoryBudgetMB = 64, bool bStreamToDisk = true);
+void stopProfileCapture();
+
+// Save the last seconds of an active capture to "capture-last-(date).tfprof", i.e. after a hitch was detected
+void saveProfileCapture(float fSeconds, const char* appName = "");
+
+// Sample cycles, instructions, cache misses and branch misses in every cpu scope of pGroup (all groups when NULL).
+// Only available on Linux with perf_event access, the counters show up in the timer table, the csv/trace dumps and the benchmark data.
+void setProfileHwCounters(const char* pGroup, bool bEnable);
+
+// Count the tf_malloc/tf_free calls and allocated bytes in every cpu scope of pGroup (all groups when NULL), children included.
+// The counts show up in the timer table, the csv/trace dumps and the benchmark data.
+void setProfileAllocCounters(const char* pGroup, bool bEnable);
+
+// Record the scheduler context switches on a background thread and show them in the profiler. Off by default.
+// Only available on Linux, needs perf_event_paranoid <= 0 or write access to tracefs.
+void setProfileContextSwitchTrace(bool bEnable);
+
+// Dump benchmark data to "benchmark-(data).txt" of recorded frames: average, min, max, p50/p90/p99/p99.9, variance and
+// hitch counts of the gpu groups, every timer and the cpu frame. Frames slower than fHitchThresholdMs count as hitches,
+// 0 uses twice the median frame time. Compare two dumps with Common_3/Tools/Benchmark/compare_benchmarks.py
+void dumpBenchmarkData(Renderer* pRenderer, IApp::Settings* pSettings, const char* appName = "", float fHitchThresholdMs = 0.0f);
+
+
+//------ Counters ------------//
+
+// Counters show up in the counter view of the profiler. pName is a '/' separated path, i.e. "ResourceLoader/QueueDepth"
+// bBytes formats the value as a byte size. Returns PROFILE_INVALID_TOKEN when profiling is disabled, which set / add ignore
+ProfileToken getProfileCounterToken(const char* pName, bool bBytes = false);
+void setProfileCounter(ProfileToken nToken, int64_t nValue);
+void addProfileCounter(ProfileToken nToken, int64_t nValue);
 
 //------ Profiler UI Widget --------//
 
@@ -34,10 +34,54 @@
 #define LOG_LEVEL_SIZE 6
 #define LOG_MESSAGE_OFFSET (LOG_PREAMBLE_SIZE + LOG_LEVEL_SIZE)
 
+#define BINARY_LOG_MAGIC "TFBL"
+#define BINARY_LOG_VERSION 1
+#define BINARY_LOG_CHUNK_SITE 'S'
+#define BINARY_LOG_CHUNK_THREAD 'T'
+// recordSize(u16) siteId(u32) level(u32) timestamp(i64)
+#define BINARY_LOG_RECORD_HEADER_SIZE (sizeof(uint16_t) + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(int64_t))
+#define BINARY_LOG_SITE_CACHE_SIZE 256
+
 static Log* pLogger = NULL;
 
 thread_local char Log::Buffer[MAX_BUFFER + 2];
 bool Log::sConsoleLogging = true;
+tfrg_atomic32_t Log::sBinaryLogging = 0;
+
+struct BinaryLogThreadBuffer
+{
+	struct SiteCacheEntry
+	{
+		const char* pFormat;
+		const char* pFile;
+		int         mLine;
+		uint32_t    mId;
+	};
+
+	uint32_t       mSize;
+	SiteCacheEntry mSiteCache[BINARY_LOG_SITE_CACHE_SIZE];
+	char           mData[BINARY_LOG_BUFFER_SIZE];
+};
+
+// Owns the binary log buffer of a thread. The buffer is only allocated once the thread logs in binary mode.
+struct BinaryLogThreadData
+{
+	~BinaryLogThreadData();
+
+	BinaryLogThreadBuffer* pBuffer = NULL;
+};
+
+static thread_local BinaryLogThreadData gBinaryLogThreadData;
+
+BinaryLogThreadData::~BinaryLogThreadData()
+{
+	if (pBuffer)
+	{
+		Log::FlushBinary();
+		tf_free(pBuffer);
+		pBuffer = NULL;
+	}
+}
 
 eastl::string GetTimeStamp()
 {
@@ -93,12 +137,31 @@ void Log::Init(const char* appName, LogLevel level /* = LogLevel::eALL */)
 	{
 		pLogger = tf_new(Log, appName, level);
 		pLogger->mLogMutex.Init();
+		pLogger->mBinaryMutex.Init();
 		pLogger->AddInitialLogFile(appName);
 	}
 }
 
 void Log::Exit()
 {
+	// Records of threads which are still running at this point are lost
+	SetBinaryLogging(false);
+	if (gBinaryLogThreadData.pBuffer)
+	{
+		tf_free(gBinaryLogThreadData.pBuffer);
+		gBinaryLogThreadData.pBuffer = NULL;
+	}
+	{
+		MutexLock lock{ pLogger->mBinaryMutex };
+		if (pLogger->pBinaryStream)
+		{
+			fsCloseStream(pLogger->pBinaryStream);
+			tf_free(pLogger->pBinaryStream);
+			pLogger->pBinaryStream = NULL;
+		}
+	}
+
+	pLogger->mBinaryMutex.Destroy();
 	pLogger->mLogMutex.Destroy();
 	tf_delete(pLogger);
 	pLogger = NULL;
@@ -297,6 +360,193 @@ void Log::WriteRaw(uint32_t level, bool error, const char* message, ...)
 	}
 }
 
+void Log::SetBinaryLogging(bool bEnable)
+{
+	if (!bEnable)
+	{
+		tfrg_atomic32_store_release(&sBinaryLogging, 0);
+		FlushBinary();
+		return;
+	}
+
+	{
+		MutexLock lock{ pLogger->mBinaryMutex };
+		if (!pLogger->pBinaryStream)
+		{
+			char fileName[FS_MAX_PATH] = { 0 };
+			fsAppendPathExtension(pLogger->mAppName.empty() ? "Log" : pLogger->mAppName.c_str(), "binlog", fileName);
+
+			FileStream fh = {};
+			if (!fsOpenStreamFromPath(RD_LOG, fileName, FM_WRITE_BINARY, &fh))
+			{
+				LOGF(LogLevel::eERROR, "Failed to create binary log file %s", fileName);
+				return;
+			}
+
+			pLogger->pBinaryStream = (FileStream*)tf_malloc(sizeof(FileStream));
+			*pLogger->pBinaryStream = fh;
+
+			// Timestamps of the records are relative to getUSec. Store a reference point so the decoder can print wall clock time.
+			const uint32_t version = BINARY_LOG_VERSION;
+			const int64_t  startUSec = getUSec();
+			const int64_t  startTime = (int64_t)time(NULL);
+			WriteBinary(BINARY_LOG_MAGIC, 4);
+			WriteBinary(&version, sizeof(version));
+			WriteBinary(&startUSec, sizeof(startUSec));
+			WriteBinary(&startTime, sizeof(startTime));
+		}
+	}
+
+	// Release pairs with the acquire in Dispatch so pBinaryStream is visible before the flag
+	tfrg_atomic32_store_release(&sBinaryLogging, 1);
+}
+
+bool Log::IsBinaryLogging() { return tfrg_atomic32_load_acquire(&sBinaryLogging) != 0; }
+
+void Log::FlushBinary()
+{
+	if (gBinaryLogThreadData.pBuffer)
+		FlushBinaryThreadBuffer(gBinaryLogThreadData.pBuffer);
+}
+
+void Log::FlushBinaryThreadBuffer(BinaryLogThreadBuffer* pBuffer)
+{
+	if (!pBuffer->mSize)
+		return;
+
+	if (pLogger)
+	{
+		char threadName[MAX_THREAD_NAME_LENGTH + 1] = { 0 };
+		Thread::GetCurrentThreadName(threadName, MAX_THREAD_NAME_LENGTH + 1);
+		if (!threadName[0])
+			snprintf(threadName, sizeof(threadName), "%llu", (unsigned long long)Thread::GetCurrentThreadID());
+
+		const char type = BINARY_LOG_CHUNK_THREAD;
+
+		MutexLock lock{ pLogger->mBinaryMutex };
+		if (pLogger->pBinaryStream)
+		{
+			WriteBinary(&type, sizeof(type));
+			WriteBinary(threadName, sizeof(threadName));
+			WriteBinary(&pBuffer->mSize, sizeof(pBuffer->mSize));
+			WriteBinary(pBuffer->mData, pBuffer->mSize);
+			fsFlushStream(pLogger->pBinaryStream);
+		}
+	}
+
+	pBuffer->mSize = 0;
+}
+
+// Called with mBinaryMutex held
+void Log::WriteBinary(const void* pData, uint32_t size)
+{
+	fsWriteToStream(pLogger->pBinaryStream, pData, size);
+}
+
+uint32_t Log::RegisterBinarySite(BinaryLogThreadBuffer* pBuffer, const char* message, const char* filename, int line_number)
+{
+	const uint32_t slot = (uint32_t)(((uintptr_t)message >> 2) ^ (uintptr_t)line_number) & (BINARY_LOG_SITE_CACHE_SIZE - 1);
+	BinaryLogThreadBuffer::SiteCacheEntry& entry = pBuffer->mSiteCache[slot];
+	if (entry.pFormat == message && entry.pFile == filename && entry.mLine == line_number)
+		return entry.mId;
+
+	MutexLock lock{ pLogger->mBinaryMutex };
+
+	entry.pFormat = message;
+	entry.pFile = filename;
+	entry.mLine = line_number;
+
+	eastl::unordered_map<const char*, uint32_t>::iterator it = pLogger->mBinarySiteLookup.find(message);
+	uint32_t lastId = UINT32_MAX;
+	if (it != pLogger->mBinarySiteLookup.end())
+	{
+		for (uint32_t id = it->second; id != UINT32_MAX; id = pLogger->mBinarySites[id].mNext)
+		{
+			const BinaryLogSite& site = pLogger->mBinarySites[id];
+			if (site.pFile == filename && site.mLine == line_number)
+			{
+				entry.mId = id;
+				return id;
+			}
+			lastId = id;
+		}
+	}
+
+	const uint32_t id = (uint32_t)pLogger->mBinarySites.size();
+	entry.mId = id;
+	pLogger->mBinarySites.push_back(BinaryLogSite{ message, filename, line_number, UINT32_MAX });
+	if (lastId != UINT32_MAX)
+		pLogger->mBinarySites[lastId].mNext = id;
+	else
+		pLogger->mBinarySiteLookup[message] = id;
+
+	// Site definitions precede every thread chunk referencing them
+	if (pLogger->pBinaryStream)
+	{
+		const char*    file = get_filename(filename);
+		const uint16_t fileLength = (uint16_t)strlen(file);
+		const uint16_t formatLength = (uint16_t)strlen(message);
+		const char     type = BINARY_LOG_CHUNK_SITE;
+		WriteBinary(&type, sizeof(type));
+		WriteBinary(&id, sizeof(id));
+		WriteBinary(&line_number, sizeof(line_number));
+		WriteBinary(&fileLength, sizeof(fileLength));
+		WriteBinary(file, fileLength);
+		WriteBinary(&formatLength, sizeof(formatLength));
+		WriteBinary(message, formatLength);
+	}
+
+	return id;
+}
+
+bool Log::BeginBinaryRecord(uint32_t level, const char* filename, int line_number, const char* message, BinaryRecord* pRecord)
+{
+	if (!pLogger || !pLogger->pBinaryStream)
+		return false;
+
+	BinaryLogThreadBuffer* pBuffer = gBinaryLogThreadData.pBuffer;
+	if (!pBuffer)
+	{
+		pBuffer = (BinaryLogThreadBuffer*)tf_calloc(1, sizeof(BinaryLogThreadBuffer));
+		gBinaryLogThreadData.pBuffer = pBuffer;
+	}
+
+	const uint32_t siteId = RegisterBinarySite(pBuffer, message, filename, line_number);
+
+	if (pBuffer->mSize + BINARY_LOG_RECORD_HEADER_SIZE > BINARY_LOG_BUFFER_SIZE)
+		FlushBinaryThreadBuffer(pBuffer);
+
+	const int64_t timestamp = getUSec();
+	char* pBegin = pBuffer->mData + pBuffer->mSize;
+	// Record size gets patched in EndBinaryRecord
+	memcpy(pBegin + sizeof(uint16_t), &siteId, sizeof(siteId));
+	memcpy(pBegin + sizeof(uint16_t) + sizeof(uint32_t), &level, sizeof(level));
+	memcpy(pBegin + sizeof(uint16_t) + 2 * sizeof(uint32_t), &timestamp, sizeof(timestamp));
+
+	pRecord->pBegin = pBegin;
+	pRecord->pCursor = pBegin + BINARY_LOG_RECORD_HEADER_SIZE;
+	pRecord->pEnd = pBuffer->mData + BINARY_LOG_BUFFER_SIZE;
+	pRecord->mOverflow = false;
+	return true;
+}
+
+bool Log::EndBinaryRecord(BinaryRecord* pRecord)
+{
+	BinaryLogThreadBuffer* pBuffer = gBinaryLogThreadData.pBuffer;
+	const size_t recordSize = pRecord->pCursor - pRecord->pBegin;
+	if (pRecord->mOverflow || recordSize > UINT16_MAX)
+	{
+		// Make room for the retry
+		FlushBinaryThreadBuffer(pBuffer);
+		return false;
+	}
+
+	const uint16_t size = (uint16_t)recordSize;
+	memcpy(pRecord->pBegin, &size, sizeof(size));
+	pBuffer->mSize = (uint32_t)(pRecord->pCursor - pBuffer->mData);
+	return true;
+}
+
 void Log::AddInitialLogFile(const char* appName)
 {
 
@@ -376,6 +626,8 @@ Log::Log(const char* appName, LogLevel level)
 	, mRecordTimestamp(true)
 	, mRecordFile(true)
 	, mRecordThreadName(true)
+	, mAppName(appName ? appName : "")
+	, pBinaryStream(NULL)
 {
 	Thread::SetMainThread();
 	Thread::SetCurrentThreadName("MainThread");
@@ -26,8 +26,11 @@
 
 #include "../../ThirdParty/OpenSource/EASTL/vector.h"
 #include "../../ThirdParty/OpenSource/EASTL/string.h"
+#include "../../ThirdParty/OpenSource/EASTL/unordered_map.h"
+#include "../../ThirdParty/OpenSource/EASTL/type_traits.h"
 
 #include "../../OS/Interfaces/IThread.h"
+#include "../../OS/Core/Atomics.h"
 #include "../../OS/Interfaces/IFileSystem.h"
 
 #ifndef FILENAME_NAME_LENGTH_LOG
@@ -49,6 +52,11 @@
 #define ANONIMOUS_VARIABLE_LOG(str) CONCAT_STR_LOG(str, __LINE__)
 #endif
 
+// Size of the per thread buffer holding binary log records before they are appended to the .binlog file
+#ifndef BINARY_LOG_BUFFER_SIZE
+#define BINARY_LOG_BUFFER_SIZE (64 * 1024)
+#endif
+
 // If you add more levels don't forget to change LOG_LEVELS macro to the actual number of levels
 enum LogLevel
 {
@@ -66,6 +74,22 @@ typedef void(*log_callback_t)(void * user_data, const char* message);
 typedef void(*log_close_t)(void * user_data);
 typedef void(*log_flush_t)(void * user_data);
 
+// Argument tags of a binary log record. Keep in sync with Common_3/Tools/BinaryLog/decode_binlog.py
+enum BinaryLogArgType
+{
+	BINARY_LOG_ARG_INT32 = 0,
+	BINARY_LOG_ARG_UINT32,
+	BINARY_LOG_ARG_INT64,
+	BINARY_LOG_ARG_UINT64,
+	BINARY_LOG_ARG_DOUBLE,
+	BINARY_LOG_ARG_POINTER,
+	BINARY_LOG_ARG_STRING,
+};
+
+// Only string literals can be used as format string ids since their address never changes
+template <typename T> struct BinaryLogLiteralFormat { enum { value = 0 }; };
+template <size_t N> struct BinaryLogLiteralFormat<const char(&)[N]> { enum { value = 1 }; };
+
 /// Logging subsystem.
 class Log
 {
@@ -106,10 +130,120 @@ public:
 
 	static void Write(uint32_t level, const char * filename, int line_number, const char* message, ...);
 	static void WriteRaw(uint32_t level, bool error, const char* message, ...);
+
+	/// Binary logging: LOGF calls with a literal format string only record the format string id and the raw
+	/// argument bytes into a per thread buffer. Formatting happens offline (Common_3/Tools/BinaryLog/decode_binlog.py).
+	/// Errors and non literal format strings are still formatted and written immediately.
+	static void SetBinaryLogging(bool bEnable);
+	static bool IsBinaryLogging();
+	/// Appends the binary records of the calling thread to the .binlog file
+	static void FlushBinary();
+
+	struct BinaryRecord
+	{
+		char* pBegin;
+		char* pCursor;
+		char* pEnd;
+		bool  mOverflow;
+
+		void PutBytes(uint8_t type, const void* pData, uint32_t size)
+		{
+			if (pCursor + 1 + size > pEnd)
+			{
+				mOverflow = true;
+				return;
+			}
+			*pCursor++ = (char)type;
+			memcpy(pCursor, pData, size);
+			pCursor += size;
+		}
+
+		void PutString(const char* str)
+		{
+			size_t length = str ? strlen(str) : 0;
+			uint16_t size = (uint16_t)(length > UINT16_MAX ? UINT16_MAX : length);
+			if (pCursor + 1 + sizeof(size) + size > pEnd)
+			{
+				mOverflow = true;
+				return;
+			}
+			*pCursor++ = (char)BINARY_LOG_ARG_STRING;
+			memcpy(pCursor, &size, sizeof(size));
+			memcpy(pCursor + sizeof(size), str, size);
+			pCursor += sizeof(size) + size;
+		}
+
+		void Put(const char* str) { PutString(str); }
+		void Put(char* str) { PutString(str); }
+		void Put(double value) { PutBytes(BINARY_LOG_ARG_DOUBLE, &value, sizeof(value)); }
+		template <typename T> void Put(T* ptr)
+		{
+			uint64_t value = (uint64_t)(uintptr_t)ptr;
+			PutBytes(BINARY_LOG_ARG_POINTER, &value, sizeof(value));
+		}
+		template <typename T>
+		typename eastl::enable_if<eastl::is_integral<T>::value || eastl::is_enum<T>::value>::type Put(T value)
+		{
+			if (sizeof(T) <= sizeof(uint32_t))
+			{
+				if (eastl::is_signed<T>::value || eastl::is_enum<T>::value)
+				{
+					int32_t v = (int32_t)value;
+					PutBytes(BINARY_LOG_ARG_INT32, &v, sizeof(v));
+				}
+				else
+				{
+					uint32_t v = (uint32_t)value;
+					PutBytes(BINARY_LOG_ARG_UINT32, &v, sizeof(v));
+				}
+			}
+			else
+			{
+				if (eastl::is_signed<T>::value)
+				{
+					int64_t v = (int64_t)value;
+					PutBytes(BINARY_LOG_ARG_INT64, &v, sizeof(v));
+				}
+				else
+				{
+					uint64_t v = (uint64_t)value;
+					PutBytes(BINARY_LOG_ARG_UINT64, &v, sizeof(v));
+				}
+			}
+		}
+	};
+
+	static bool BeginBinaryRecord(uint32_t level, const char* filename, int line_number, const char* message, BinaryRecord* pRecord);
+	static bool EndBinaryRecord(BinaryRecord* pRecord);
+
+	/// Entry point of LOGF. Takes the binary path if it is enabled and the format string is a literal.
+	template <typename Format, typename... Args>
+	static void Dispatch(uint32_t level, const char* filename, int line_number, Format&& message, Args... args)
+	{
+		if (BinaryLogLiteralFormat<Format>::value && !(level & LogLevel::eERROR) && tfrg_atomic32_load_acquire(&sBinaryLogging))
+		{
+			// Second attempt happens after the thread buffer was flushed to make room for the record
+			for (uint32_t attempt = 0; attempt < 2; ++attempt)
+			{
+				BinaryRecord record;
+				if (!BeginBinaryRecord(level, filename, line_number, message, &record))
+					break;
+				int expand[] = { 0, (record.Put(args), 0)... };
+				(void)expand;
+				if (EndBinaryRecord(&record))
+					return;
+			}
+		}
+
+		Write(level, filename, line_number, message, args...);
+	}
 private:
 	static void AddInitialLogFile(const char* appName);
 	static uint32_t WritePreamble(char * buffer, uint32_t buffer_size, const char * file, int line);
 	static bool CallbackExists(const char * id);
+	static void WriteBinary(const void* pData, uint32_t size);
+	static void FlushBinaryThreadBuffer(struct BinaryLogThreadBuffer* pBuffer);
+	static uint32_t RegisterBinarySite(struct BinaryLogThreadBuffer* pBuffer, const char* message, const char* filename, int line_number);
 
 	// Singleton
 	Log(const Log &) = delete;
@@ -145,11 +279,28 @@ private:
 	bool            mRecordTimestamp;
 	bool            mRecordFile;
 	bool            mRecordThreadName;
+	eastl::string   mAppName;
+
+	/// Binary logging state. Call sites are registered once and written to the .binlog file before any record using them.
+	/// Sites sharing the same format string literal are chained through mNext.
+	struct BinaryLogSite
+	{
+		const char* pFormat;
+		const char* pFile;
+		int         mLine;
+		uint32_t    mNext;
+	};
+	Mutex                                        mBinaryMutex;
+	FileStream*                                  pBinaryStream;
+	eastl::vector<BinaryLogSite>                 mBinarySites;
+	eastl::unordered_map<const char*, uint32_t>  mBinarySiteLookup;
 
 	enum{MAX_BUFFER=1024};
 
 	static thread_local char Buffer[MAX_BUFFER+2];
 	static bool sConsoleLogging;
+	// Toggled by SetBinaryLogging while other threads log
+	static tfrg_atomic32_t sBinaryLogging;
 };
 
 eastl::string ToString(const char* formatString, ...);
@@ -49,6 +49,13 @@
 #define MTUNER_FREE(_handle, _ptr)
 #endif
 
+// Allocation counters of the profiler scopes, see ProfileSetAllocCounterGroup.
+// Installed by ProfileInit, NULL in binaries that do not link the profiler
+void (*gProfileAllocHook)(size_t size) = NULL;
+void (*gProfileFreeHook)(void* ptr) = NULL;
+#define PROFILE_ALLOC(_size) do { if (gProfileAllocHook) gProfileAllocHook(_size); } while (0)
+#define PROFILE_FREE(_ptr)   do { if (gProfileFreeHook) gProfileFreeHook(_ptr); } while (0)
+
 #if defined(USE_MEMORY_TRACKING)
 
 #define _CRT_SECURE_NO_WARNINGS 1
@@ -72,6 +79,7 @@ void* tf_memalign_internal(size_t align, size_t size, const char *f, int l, cons
 
 	// If using MTuner, report allocation to rmem.
 	MTUNER_ALIGNED_ALLOC(0, pMemAlign, size, 0, align);
+	PROFILE_ALLOC(size);
 
 	// Return handle to allocated memory.
 	return pMemAlign;
@@ -85,6 +93,7 @@ void* tf_calloc_memalign_internal(size_t count, size_t align, size_t size, const
 
 	// If using MTuner, report allocation to rmem.
 	MTUNER_ALIGNED_ALLOC(0, pMemAlign, size, 0, align);
+	PROFILE_ALLOC(size * count);
 
 	// Return handle to allocated memory.
 	return pMemAlign;
@@ -96,6 +105,7 @@ void* tf_realloc_internal(void* ptr, size_t size, const char *f, int l, const ch
 
 	// If using MTuner, report reallocation to rmem.
 	MTUNER_REALLOC(0, pRealloc, size, 0, ptr);
+	PROFILE_ALLOC(size);
 
 	// Return handle to reallocated memory.
 	return pRealloc;
@@ -105,6 +115,7 @@ void tf_free_internal(void* ptr, const char *f, int l, const char *sf)
 {
 	// If using MTuner, report free to rmem.
 	MTUNER_FREE(0, ptr);
+	PROFILE_FREE(ptr);
 
 	mmgrDeallocator(f, l, sf, m_alloc_free, ptr);
 }
@@ -202,16 +213,16 @@ void tf_free(void* ptr)
 #endif
 }
 
-void* tf_malloc_internal(size_t size, const char *f, int l, const char *sf) { return tf_malloc(size); }
+void* tf_malloc_internal(size_t size, const char *f, int l, const char *sf) { PROFILE_ALLOC(size); return tf_malloc(size); }
 
-void* tf_memalign_internal(size_t align, size_t size, const char *f, int l, const char *sf) { return tf_memalign(align, size); }
+void* tf_memalign_internal(size_t align, size_t size, const char *f, int l, const char *sf) { PROFILE_ALLOC(size); return tf_memalign(align, size); }
 
-void* tf_calloc_internal(size_t count, size_t size, const char *f, int l, const char *sf) { return tf_calloc(count, size); }
+void* tf_calloc_internal(size_t count, size_t size, const char *f, int l, const char *sf) { PROFILE_ALLOC(count * size); return tf_calloc(count, size); }
 
-void* tf_calloc_memalign_internal(size_t count, size_t align, size_t size, const char *f, int l, const char *sf) { return tf_calloc_memalign(count, align, size); }
+void* tf_calloc_memalign_internal(size_t count, size_t align, size_t size, const char *f, int l, const char *sf) { PROFILE_ALLOC(count * size); return tf_calloc_memalign(count, align, size); }
 
-void* tf_realloc_internal(void* ptr, size_t size, const char *f, int l, const char *sf) { return tf_realloc(ptr, size); }
+void* tf_realloc_internal(void* ptr, size_t size, const char *f, int l, const char *sf) { PROFILE_ALLOC(size); return tf_realloc(ptr, size); }
 
-void tf_free_internal(void* ptr, const char *f, int l, const char *sf) { tf_free(ptr); }
+void tf_free_internal(void* ptr, const char *f, int l, const char *sf) { PROFILE_FREE(ptr); tf_free(ptr); }
 
 #endif // defined(USE_MEMORY_TRACKING) || defined(USE_MTUNER)
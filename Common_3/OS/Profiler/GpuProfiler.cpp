@@ -123,6 +123,7 @@ static void calculateTimes(Cmd* pCmd, GpuProfiler* pGpuProfiler, uint32_t index)
 			S->AccumTimers[timerIndex].nCount += S->Frame[timerIndex].nCount;
 			S->AccumMinTimers[timerIndex] = ProfileMin(S->AccumMinTimers[timerIndex], S->Frame[timerIndex].nTicks);
 			S->AccumMaxTimers[timerIndex] = ProfileMax(S->AccumMaxTimers[timerIndex], S->Frame[timerIndex].nTicks);
+			ProfileHistogramAdd(timerIndex, S->Frame[timerIndex].nTicks);
         }  
     }
 
@@ -28,7 +28,17 @@ void initProfiler(Renderer* pRenderer, Queue** ppQueue, const char** ppProfilerN
 void exitProfiler() {}
 void flipProfiler() {}
 void dumpProfileData(Renderer* pRenderer, const char* appName, uint32_t nMaxFrames) {}
-void dumpBenchmarkData(Renderer* pRenderer, IApp::Settings* pSettings, const char* appName) {}
+void dumpProfileTrace(const char* appName, uint32_t nMaxFrames, bool bPerfetto) {}
+void startProfileCapture(const char* appName, uint32_t nMemoryBudgetMB, bool bStreamToDisk) {}
+void stopProfileCapture() {}
+void saveProfileCapture(float fSeconds, const char* appName) {}
+void setProfileHwCounters(const char* pGroup, bool bEnable) {}
+void setProfileAllocCounters(const char* pGroup, bool bEnable) {}
+void setProfileContextSwitchTrace(bool bEnable) {}
+ProfileToken getProfileCounterToken(const char* pName, bool bBytes) { return PROFILE_INVALID_TOKEN; }
+void setProfileCounter(ProfileToken nToken, int64_t nValue) {}
+void addProfileCounter(ProfileToken nToken, int64_t nValue) {}
+void dumpBenchmarkData(Renderer* pRenderer, IApp::Settings* pSettings, const char* appName, float fHitchThresholdMs) {}
 void setAggregateFrames(uint32_t nFrames) {}
 float getCpuProfileTime(const char* pGroup, const char* pName, ThreadID* pThreadID) { return -1.0f; }
 float getCpuProfileAvgTime(const char* pGroup, const char* pName, ThreadID* pThreadID) { return -1.0f; }
@@ -82,6 +92,17 @@ int64_t ProfileGetTick()
 //EASTL Includes
 #include "../../ThirdParty/OpenSource/EASTL/sort.h"
 #include "../../ThirdParty/OpenSource/EASTL/algorithm.h"
+#include "../../ThirdParty/OpenSource/EASTL/vector.h"
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if PROFILE_HW_COUNTERS
+#include <linux/perf_event.h>
+#include <errno.h>
+#endif
 
 #if PROFILE_WEBSERVER
 
@@ -109,19 +130,20 @@ int64_t ProfileGetTick()
 #if PROFILE_WEBSERVER || PROFILE_CONTEXT_SWITCH_TRACE
 typedef ThreadFunction ProfileThreadFunc;
 
+// The thread reads its ThreadDesc after create_thread returns, so it lives next to the handle until ProfileThreadJoin
+struct ProfileThreadData
+{
+	ThreadHandle mHandle;
+	ThreadDesc   mDesc;
+};
+
 inline void ProfileThreadStart(ProfileThread* pThread, ProfileThreadFunc Func)
 {
-	static ThreadDesc desc[5];
-	static int count = 0;
-#if defined(_WINDOWS) || defined(XBOX)
-	*pThread = static_cast<ProfileThread>(tf_malloc(sizeof(ThreadHandle)));
-#else
-	// Need to check if this actually works right
-  *pThread = static_cast<ProfileThread>(tf_malloc(sizeof(ThreadHandle)));
-#endif
-	desc[count].pFunc = Func;
-	desc[count].pData = *pThread;
-	create_thread(&desc[count++]);
+	ProfileThreadData* pData = static_cast<ProfileThreadData*>(tf_calloc(1, sizeof(ProfileThreadData)));
+	*pThread = &pData->mHandle;
+	pData->mDesc.pFunc = Func;
+	pData->mDesc.pData = *pThread;
+	pData->mHandle = create_thread(&pData->mDesc);
 }
 inline void ProfileThreadJoin(ProfileThread* pThread)
 {
@@ -189,6 +211,12 @@ PROFILE_API Profile* ProfileGet()
 }
 
 
+// Defined in MemoryTracking.cpp, called by tf_malloc/tf_free when set
+extern void (*gProfileAllocHook)(size_t size);
+extern void (*gProfileFreeHook)(void* ptr);
+static void ProfileAllocHook(size_t nSize);
+static void ProfileFreeHook(void* pPtr);
+
 void ProfileInit()
 {
 	Mutex& mutex = ProfileMutex();
@@ -237,6 +265,14 @@ void ProfileInit()
 		{
 			S.Graph[i].nToken = PROFILE_INVALID_TOKEN;
 		}
+		for (uint32_t i = 0; i < ProfileHwCounterCount; ++i)
+		{
+			S.HwCounterMeta[i] = PROFILE_INVALID_TOKEN;
+		}
+		for (uint32_t i = 0; i < ProfileAllocCounterCount; ++i)
+		{
+			S.AllocCounterMeta[i] = PROFILE_INVALID_TOKEN;
+		}
 		S.nRunning = 1;
 		S.fReferenceTime = 33.33f;
 		S.fRcpReferenceTime = 1.f / S.fReferenceTime;
@@ -256,6 +292,8 @@ void ProfileInit()
 		}
 #endif
 	}
+	gProfileAllocHook = ProfileAllocHook;
+	gProfileFreeHook = ProfileFreeHook;
 	if (bUseLock)
 		mutex.Release();
 }
@@ -289,6 +327,16 @@ void exitCpuProfiler()
 	ProfileOnThreadExit();
 	ProfileWebServerStop();
 	ProfileContextSwitchTraceStop();
+	ProfileStreamStop();
+
+	Profile & S = g_Profile;
+	for (uint32_t i = 0; i <= PROFILE_MAX_TIMERS; ++i)
+	{
+		tf_free(S.pAccumHistogram[i]);
+		tf_free(S.pAggregateHistogram[i]);
+		S.pAccumHistogram[i] = NULL;
+		S.pAggregateHistogram[i] = NULL;
+	}
 
     g_bOnce = true;
     g_bUseLock = false;
@@ -297,6 +345,8 @@ void exitCpuProfiler()
 void exitProfiler()
 {
 #if PROFILE_ENABLED
+    gProfileAllocHook = NULL;
+    gProfileFreeHook = NULL;
     exitCpuProfiler();
 
 #if GPU_PROFILER_SUPPORTED
@@ -330,6 +380,83 @@ void ProfileSetThreadLog(ProfileThreadLog* pLog)
 #endif
 
 
+#if PROFILE_HW_COUNTERS
+static const char* g_ProfileHwCounterNames[ProfileHwCounterCount] = { "Cycles", "Instructions", "Cache Misses", "Branch Misses" };
+
+static void ProfileHwCountersOpen(ProfileThreadLog* pLog)
+{
+	static const uint64_t nConfigs[ProfileHwCounterCount] =
+	{
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_MISSES,
+	};
+
+	pLog->nHwCounterState = 2;
+	uint8_t nReadIndex = 0;
+	for (uint32_t i = 0; i < ProfileHwCounterCount; ++i)
+	{
+		pLog->nHwCounterFd[i] = -1;
+	}
+	for (uint32_t i = 0; i < ProfileHwCounterCount; ++i)
+	{
+		perf_event_attr Attr = {};
+		Attr.size = sizeof(Attr);
+		Attr.type = PERF_TYPE_HARDWARE;
+		Attr.config = nConfigs[i];
+		Attr.read_format = PERF_FORMAT_GROUP;
+		// User space only, this works with the default perf_event_paranoid setting
+		Attr.exclude_kernel = 1;
+		Attr.exclude_hv = 1;
+
+		// Counts the calling thread on whatever cpu it runs on
+		int nFd = (int)syscall(__NR_perf_event_open, &Attr, 0, -1, pLog->nHwCounterFd[0], 0);
+		if (nFd < 0)
+		{
+			pLog->nHwCounterIndex[i] = 0xff;
+			if (i == 0)
+			{
+				LOGF(LogLevel::eWARNING, "Hardware counters are not available on thread '%s' (errno %d), see /proc/sys/kernel/perf_event_paranoid", pLog->ThreadName, errno);
+				return;
+			}
+			continue;
+		}
+		pLog->nHwCounterFd[i] = nFd;
+		pLog->nHwCounterIndex[i] = nReadIndex++;
+	}
+	pLog->nHwCounterState = 1;
+}
+
+static void ProfileHwCountersClose(ProfileThreadLog* pLog)
+{
+	if (pLog->nHwCounterState == 1)
+	{
+		for (uint32_t i = 0; i < ProfileHwCounterCount; ++i)
+		{
+			if (pLog->nHwCounterFd[i] >= 0)
+				close(pLog->nHwCounterFd[i]);
+		}
+	}
+	pLog->nHwCounterState = 0;
+}
+
+static bool ProfileHwCountersRead(ProfileThreadLog* pLog, uint64_t nValues[ProfileHwCounterCount])
+{
+	uint64_t nBuffer[1 + ProfileHwCounterCount];
+	if (read(pLog->nHwCounterFd[0], nBuffer, sizeof(nBuffer)) < (ssize_t)sizeof(uint64_t))
+		return false;
+
+	for (uint32_t i = 0; i < ProfileHwCounterCount; ++i)
+	{
+		uint8_t nIndex = pLog->nHwCounterIndex[i];
+		nValues[i] = (nIndex < nBuffer[0]) ? nBuffer[1 + nIndex] : 0;
+	}
+	return true;
+}
+
+#endif
+
 PROFILE_API void ProfileRemoveThreadLog(ProfileThreadLog * pLog)
 {
 	MutexLock lock(ProfileMutex());
@@ -360,6 +487,9 @@ PROFILE_API void ProfileRemoveThreadLog(ProfileThreadLog * pLog)
 			S.nMemUsage -= sizeof(ProfileLogEntry) * PROFILE_BUFFER_SIZE;
 		}
 
+#if PROFILE_HW_COUNTERS
+		ProfileHwCountersClose(pLog);
+#endif
 		pLog->~ProfileThreadLog();
 		tf_free(pLog);
 		S.nMemUsage -= sizeof(ProfileThreadLog);
@@ -395,6 +525,11 @@ ProfileThreadLog* ProfileCreateThreadLog(const char* pName)
 	memcpy(&pLog->ThreadName[0], pName, len);
 	pLog->ThreadName[len] = '\0';
 	pLog->nThreadId = Thread::GetCurrentThreadID();
+#if defined(__linux__)
+	pLog->nContextSwitchThreadId = (ThreadID)syscall(SYS_gettid);
+#else
+	pLog->nContextSwitchThreadId = pLog->nThreadId;
+#endif
 	return pLog;
 }
 
@@ -443,6 +578,9 @@ void ProfileOnThreadExit()
 			S.nMemUsage -= sizeof(ProfileLogEntry) * PROFILE_BUFFER_SIZE;
 		}
 
+#if PROFILE_HW_COUNTERS
+		ProfileHwCountersClose(pLog);
+#endif
 		pLog->~ProfileThreadLog();
 		tf_free(pLog);
 		S.nMemUsage -= sizeof(ProfileThreadLog);
@@ -775,6 +913,182 @@ inline void ProfileLogPut(ProfileToken nToken_, uint64_t nTick, uint64_t nBegin,
 	}
 }
 
+#if PROFILE_HW_COUNTERS
+static void ProfileHwCountersEnter(ProfileThreadLog* pLog, ProfileToken nToken)
+{
+	if (!pLog->nHwCounterState)
+		ProfileHwCountersOpen(pLog);
+	if (pLog->nHwCounterState != 1 || pLog->nHwCounterStackPos == PROFILE_STACK_MAX)
+		return;
+
+	uint32_t nPos = pLog->nHwCounterStackPos;
+	if (ProfileHwCountersRead(pLog, pLog->HwCounterStack[nPos]))
+	{
+		pLog->HwCounterStackToken[nPos] = nToken;
+		pLog->nHwCounterStackPos = nPos + 1;
+	}
+}
+
+static void ProfileHwCountersLeave(ProfileThreadLog* pLog, ProfileToken nToken)
+{
+	// Scopes entered before their group was enabled have no entry, leave those alone
+	uint32_t nPos = pLog->nHwCounterStackPos - 1;
+	if (pLog->HwCounterStackToken[nPos] != nToken)
+		return;
+	pLog->nHwCounterStackPos = nPos;
+
+	uint64_t nValues[ProfileHwCounterCount];
+	if (!ProfileHwCountersRead(pLog, nValues))
+		return;
+
+	// Logged as meta counters right before the leave, so they are attributed to this scope
+	Profile & S = g_Profile;
+	for (uint32_t i = 0; i < ProfileHwCounterCount; ++i)
+	{
+		if (pLog->nHwCounterIndex[i] != 0xff)
+			ProfileLogPut(S.HwCounterMeta[i], (nValues[i] - pLog->HwCounterStack[nPos][i]) & P_LOG_TICK_MASK, P_LOG_META, pLog);
+	}
+}
+#endif
+
+void ProfileSetHwCounterGroup(const char* pGroup, bool bEnable)
+{
+#if PROFILE_HW_COUNTERS
+	ProfileInit();
+	MutexLock lock(ProfileMutex());
+	Profile & S = g_Profile;
+	uint64_t nMask = pGroup ? (1ll << ProfileGetGroup(pGroup, ProfileTokenTypeCpu)) : ~0ull;
+	if (bEnable)
+	{
+		for (uint32_t i = 0; i < ProfileHwCounterCount; ++i)
+		{
+			S.HwCounterMeta[i] = ProfileGetMetaToken(g_ProfileHwCounterNames[i]);
+			ProfileEnableMetaCounter(g_ProfileHwCounterNames[i]);
+		}
+		S.nHwCounterGroupMask |= nMask;
+	}
+	else
+	{
+		S.nHwCounterGroupMask &= ~nMask;
+	}
+#else
+	(void)pGroup;
+	(void)bEnable;
+#endif
+}
+
+// Aggregated counts of a timer, indexed by ProfileHwCounter. Returns false if no counters were recorded for it.
+bool ProfileGetHwCounters(uint32_t nTimerIndex, uint64_t nCounters[ProfileHwCounterCount])
+{
+#if PROFILE_HW_COUNTERS
+	Profile & S = g_Profile;
+	if (S.HwCounterMeta[0] == PROFILE_INVALID_TOKEN)
+		return false;
+
+	bool bFound = false;
+	for (uint32_t i = 0; i < ProfileHwCounterCount; ++i)
+	{
+		nCounters[i] = S.MetaCounters[S.HwCounterMeta[i]].nAggregate[nTimerIndex];
+		bFound |= nCounters[i] != 0;
+	}
+	return bFound;
+#else
+	(void)nTimerIndex;
+	(void)nCounters;
+	return false;
+#endif
+}
+
+static const char* g_ProfileAllocCounterNames[ProfileAllocCounterCount] = { "Alloc Bytes", "Allocs", "Frees" };
+
+// Called by tf_malloc/tf_free on every thread, only counts while a group has allocation counters enabled
+static void ProfileAllocHook(size_t nSize)
+{
+	if (g_Profile.nAllocCounterGroupMask)
+	{
+		if (ProfileThreadLog* pLog = ProfileGetThreadLog())
+		{
+			pLog->nAllocCounters[ProfileAllocCounterBytes] += nSize;
+			pLog->nAllocCounters[ProfileAllocCounterAllocs]++;
+		}
+	}
+}
+
+static void ProfileFreeHook(void* pPtr)
+{
+	if (pPtr && g_Profile.nAllocCounterGroupMask)
+	{
+		if (ProfileThreadLog* pLog = ProfileGetThreadLog())
+			pLog->nAllocCounters[ProfileAllocCounterFrees]++;
+	}
+}
+
+static void ProfileAllocCountersEnter(ProfileThreadLog* pLog, ProfileToken nToken)
+{
+	uint32_t nPos = pLog->nAllocStackPos;
+	if (nPos == PROFILE_STACK_MAX)
+		return;
+
+	memcpy(pLog->AllocStack[nPos], pLog->nAllocCounters, sizeof(pLog->nAllocCounters));
+	pLog->AllocStackToken[nPos] = nToken;
+	pLog->nAllocStackPos = nPos + 1;
+}
+
+static void ProfileAllocCountersLeave(ProfileThreadLog* pLog, ProfileToken nToken)
+{
+	// Scopes entered before their group was enabled have no entry, leave those alone
+	uint32_t nPos = pLog->nAllocStackPos - 1;
+	if (pLog->AllocStackToken[nPos] != nToken)
+		return;
+	pLog->nAllocStackPos = nPos;
+
+	// Logged as meta counters right before the leave, so they are attributed to this scope
+	Profile & S = g_Profile;
+	for (uint32_t i = 0; i < ProfileAllocCounterCount; ++i)
+	{
+		uint64_t nDelta = pLog->nAllocCounters[i] - pLog->AllocStack[nPos][i];
+		if (nDelta)
+			ProfileLogPut(S.AllocCounterMeta[i], nDelta & P_LOG_TICK_MASK, P_LOG_META, pLog);
+	}
+}
+
+void ProfileSetAllocCounterGroup(const char* pGroup, bool bEnable)
+{
+	ProfileInit();
+	MutexLock lock(ProfileMutex());
+	Profile & S = g_Profile;
+	uint64_t nMask = pGroup ? (1ll << ProfileGetGroup(pGroup, ProfileTokenTypeCpu)) : ~0ull;
+	if (bEnable)
+	{
+		for (uint32_t i = 0; i < ProfileAllocCounterCount; ++i)
+		{
+			S.AllocCounterMeta[i] = ProfileGetMetaToken(g_ProfileAllocCounterNames[i]);
+			ProfileEnableMetaCounter(g_ProfileAllocCounterNames[i]);
+		}
+		S.nAllocCounterGroupMask |= nMask;
+	}
+	else
+	{
+		S.nAllocCounterGroupMask &= ~nMask;
+	}
+}
+
+// Aggregated allocation counts of a timer, indexed by ProfileAllocCounter. Returns false if the timer did not allocate.
+bool ProfileGetAllocCounters(uint32_t nTimerIndex, uint64_t nCounters[ProfileAllocCounterCount])
+{
+	Profile & S = g_Profile;
+	if (S.AllocCounterMeta[0] == PROFILE_INVALID_TOKEN)
+		return false;
+
+	bool bFound = false;
+	for (uint32_t i = 0; i < ProfileAllocCounterCount; ++i)
+	{
+		nCounters[i] = S.MetaCounters[S.AllocCounterMeta[i]].nAggregate[nTimerIndex];
+		bFound |= nCounters[i] != 0;
+	}
+	return bFound;
+}
+
 uint64_t cpuProfileEnter(ProfileToken nToken_)
 {
 	Profile & S = g_Profile;
@@ -785,6 +1099,12 @@ uint64_t cpuProfileEnter(ProfileToken nToken_)
 		{
 			uint64_t nTick = P_TICK();
 			ProfileLogPut(nToken_, nTick, P_LOG_ENTER, pLog);
+#if PROFILE_HW_COUNTERS
+			if (nGroupMask & S.nHwCounterGroupMask)
+				ProfileHwCountersEnter(pLog, nToken_);
+#endif
+			if (nGroupMask & S.nAllocCounterGroupMask)
+				ProfileAllocCountersEnter(pLog, nToken_);
 			return nTick;
 		}
 	}
@@ -980,6 +1300,12 @@ void cpuProfileLeave(ProfileToken nToken_, uint64_t nTickStart)
 	{
 		if (ProfileThreadLog* pLog = ProfileGetOrCreateThreadLog())
 		{
+#if PROFILE_HW_COUNTERS
+			if (pLog->nHwCounterStackPos)
+				ProfileHwCountersLeave(pLog, nToken_);
+#endif
+			if (pLog->nAllocStackPos)
+				ProfileAllocCountersLeave(pLog, nToken_);
 			uint64_t nTick = P_TICK();
 			ProfileLogPut(nToken_, nTick, P_LOG_LEAVE, pLog);
 		}
@@ -1006,6 +1332,92 @@ void ProfileContextSwitchPut(ProfileContextSwitch* pContextSwitch)
 }
 
 
+static uint32_t ProfileHistogramBucket(uint64_t nTicks)
+{
+	const uint64_t nSubBuckets = 1 << PROFILE_HISTOGRAM_SUB_BUCKET_BITS;
+	if (nTicks < nSubBuckets)
+		return (uint32_t)nTicks;
+
+	uint32_t nOctave = 0;
+	for (uint64_t nValue = nTicks; nValue >>= 1;)
+		++nOctave;
+	uint32_t nShift = nOctave - PROFILE_HISTOGRAM_SUB_BUCKET_BITS;
+	uint32_t nBucket = (nShift + 1) * (uint32_t)nSubBuckets + (uint32_t)((nTicks >> nShift) & (nSubBuckets - 1));
+	return ProfileMin(nBucket, (uint32_t)PROFILE_HISTOGRAM_BUCKETS - 1);
+}
+
+static uint64_t ProfileHistogramBucketStart(uint32_t nBucket)
+{
+	const uint32_t nSubBuckets = 1 << PROFILE_HISTOGRAM_SUB_BUCKET_BITS;
+	if (nBucket < nSubBuckets)
+		return nBucket;
+
+	uint32_t nShift = nBucket / nSubBuckets - 1;
+	return (uint64_t)(nSubBuckets + nBucket % nSubBuckets) << nShift;
+}
+
+void ProfileHistogramAdd(uint32_t nTimerIndex, uint64_t nTicks)
+{
+	Profile & S = g_Profile;
+	ProfileHistogram* pHistogram = S.pAccumHistogram[nTimerIndex];
+	if (!pHistogram)
+	{
+		pHistogram = static_cast<ProfileHistogram*>(tf_calloc(1, sizeof(ProfileHistogram)));
+		S.pAccumHistogram[nTimerIndex] = pHistogram;
+		S.nMemUsage += sizeof(ProfileHistogram);
+	}
+
+	pHistogram->nBuckets[ProfileHistogramBucket(nTicks)]++;
+	pHistogram->nMin = pHistogram->nCount ? ProfileMin(pHistogram->nMin, nTicks) : nTicks;
+	pHistogram->nMax = pHistogram->nCount ? ProfileMax(pHistogram->nMax, nTicks) : nTicks;
+	pHistogram->nCount++;
+	pHistogram->fSum += (double)nTicks;
+	pHistogram->fSumSquares += (double)nTicks * (double)nTicks;
+}
+
+uint64_t ProfileHistogramPercentile(const ProfileHistogram* pHistogram, float fPercentile)
+{
+	if (!pHistogram->nCount)
+		return 0;
+
+	// Nearest rank. The percentile is rounded to three decimals so that 99.9f does not select the sample after rank 999 of 1000
+	double fFraction = ProfileClamp(floor(fPercentile * 1000.0 + 0.5) * 1e-5, 0.0, 1.0);
+	double fRank = ProfileMax(ceil(fFraction * pHistogram->nCount - 1e-6), 1.0);
+	uint64_t nCumulative = 0;
+	for (uint32_t i = 0; i < PROFILE_HISTOGRAM_BUCKETS; ++i)
+	{
+		uint32_t nCount = pHistogram->nBuckets[i];
+		if (nCount && nCumulative + nCount >= fRank)
+		{
+			// Interpolate inside the bucket, samples are assumed to be spread evenly
+			uint64_t nStart = ProfileHistogramBucketStart(i);
+			uint64_t nEnd = i + 1 < PROFILE_HISTOGRAM_BUCKETS ? ProfileHistogramBucketStart(i + 1) : pHistogram->nMax;
+			double fFraction = ProfileClamp((fRank - nCumulative) / nCount, 0.0, 1.0);
+			uint64_t nTicks = nStart + (uint64_t)((nEnd - nStart) * fFraction);
+			return ProfileClamp(nTicks, pHistogram->nMin, pHistogram->nMax);
+		}
+		nCumulative += nCount;
+	}
+	return pHistogram->nMax;
+}
+
+uint32_t ProfileHistogramCountAbove(const ProfileHistogram* pHistogram, uint64_t nTicks)
+{
+	if (!pHistogram->nCount || nTicks >= pHistogram->nMax)
+		return 0;
+
+	uint32_t nFirst = ProfileHistogramBucket(nTicks);
+	uint64_t nStart = ProfileHistogramBucketStart(nFirst);
+	uint64_t nEnd = nFirst + 1 < PROFILE_HISTOGRAM_BUCKETS ? ProfileHistogramBucketStart(nFirst + 1) : pHistogram->nMax;
+	// Part of the bucket holding the threshold, at bucket resolution
+	double fAbove = nEnd > nStart ? pHistogram->nBuckets[nFirst] * (double)(nEnd - nTicks) / (double)(nEnd - nStart) : 0.0;
+	for (uint32_t i = nFirst + 1; i < PROFILE_HISTOGRAM_BUCKETS; ++i)
+	{
+		fAbove += pHistogram->nBuckets[i];
+	}
+	return (uint32_t)(fAbove + 0.5);
+}
+
 void ProfileGetRange(uint32_t nPut, uint32_t nGet, uint32_t nRange[2][2])
 {
 	if (nPut > nGet)
@@ -1026,6 +1438,7 @@ void ProfileGetRange(uint32_t nPut, uint32_t nGet, uint32_t nRange[2][2])
 }
 
 void ProfileDumpToFile(Renderer* pRenderer);
+void ProfileStreamFrame(const ProfileFrameState* pFrameCurrent, const ProfileFrameState* pFrameNext, uint64_t nFrameIndex);
 
 void ProfileFlipCpu()
 {
@@ -1100,6 +1513,7 @@ void ProfileFlipCpu()
 			S.nFlipAggregate += nTick;
             S.nFlipMin = ProfileMin(S.nFlipMin, nTick);
 			S.nFlipMax = ProfileMax(S.nFlipMax, nTick);
+			ProfileHistogramAdd(PROFILE_MAX_TIMERS, nTick);
 		}
 
 		uint8_t* pTimerToGroup = &S.TimerToGroup[0];
@@ -1125,6 +1539,8 @@ void ProfileFlipCpu()
 			}
 		}
 
+		ProfileStreamFrame(pFrameCurrent, pFrameNext, S.nFrameCurrentIndex);
+
 		if (S.nRunning)
 		{
 			uint64_t* pFrameGroup = &S.FrameGroup[0];
@@ -1301,6 +1717,8 @@ void ProfileFlipCpu()
 					S.AccumMinTimers[i] = ProfileMin(S.AccumMinTimers[i], S.Frame[i].nTicks);
 					S.AccumTimersExclusive[i] += S.FrameExclusive[i];
 					S.AccumMaxTimersExclusive[i] = ProfileMax(S.AccumMaxTimersExclusive[i], S.FrameExclusive[i]);
+					if (S.Frame[i].nCount)
+						ProfileHistogramAdd(i, S.Frame[i].nTicks);
 				}
 
 				for (uint32_t i = 0; i < PROFILE_MAX_GROUPS; ++i)
@@ -1356,6 +1774,17 @@ void ProfileFlipCpu()
 		memcpy(&S.AggregateMin[0], &S.AccumMinTimers[0], sizeof(S.AggregateMin[0]) * S.nTotalTimers);
 		memcpy(&S.AggregateExclusive[0], &S.AccumTimersExclusive[0], sizeof(S.AggregateExclusive[0]) * S.nTotalTimers);
 		memcpy(&S.AggregateMaxExclusive[0], &S.AccumMaxTimersExclusive[0], sizeof(S.AggregateMaxExclusive[0]) * S.nTotalTimers);
+		for (uint32_t i = 0; i <= PROFILE_MAX_TIMERS; ++i)
+		{
+			if (!S.pAccumHistogram[i])
+				continue;
+			if (!S.pAggregateHistogram[i])
+			{
+				S.pAggregateHistogram[i] = static_cast<ProfileHistogram*>(tf_malloc(sizeof(ProfileHistogram)));
+				S.nMemUsage += sizeof(ProfileHistogram);
+			}
+			memcpy(S.pAggregateHistogram[i], S.pAccumHistogram[i], sizeof(ProfileHistogram));
+		}
 
 		memcpy(&S.AggregateGroup[0], &S.AccumGroup[0], sizeof(S.AggregateGroup));
 		memcpy(&S.AggregateGroupMax[0], &S.AccumGroupMax[0], sizeof(S.AggregateGroup));
@@ -1408,6 +1837,11 @@ void ProfileFlipCpu()
 			memset(&S.AccumMinTimers[0], 0xFF, sizeof(S.AccumMinTimers[0]) * S.nTotalTimers);
 			memset(&S.AccumTimersExclusive[0], 0, sizeof(S.AggregateExclusive[0]) * S.nTotalTimers);
 			memset(&S.AccumMaxTimersExclusive[0], 0, sizeof(S.AccumMaxTimersExclusive[0]) * S.nTotalTimers);
+			for (uint32_t i = 0; i <= PROFILE_MAX_TIMERS; ++i)
+			{
+				if (S.pAccumHistogram[i])
+					memset(S.pAccumHistogram[i], 0, sizeof(ProfileHistogram));
+			}
 			memset(&S.AccumGroup[0], 0, sizeof(S.AggregateGroup));
 			memset(&S.AccumGroupMax[0], 0, sizeof(S.AggregateGroup));
 
@@ -1919,6 +2353,41 @@ void ProfileDumpCsv(ProfileWriteCallback CB, void* Handle, int nMaxFrames)
 
 	ProfilePrintf(CB, Handle, "\n\n");
 
+#if PROFILE_HW_COUNTERS
+	if (S.nHwCounterGroupMask)
+	{
+		ProfilePrintf(CB, Handle, "group,name,ipc,cycles/call,instructions/call,cachemisses/call,branchmisses/call\n");
+		for (uint32_t i = 0; i < S.nTotalTimers; ++i)
+		{
+			uint64_t nCounters[ProfileHwCounterCount];
+			if (!ProfileGetHwCounters(i, nCounters))
+				continue;
+			double fCalls = (double)(S.Aggregate[i].nCount ? S.Aggregate[i].nCount : 1);
+			double fIpc = nCounters[ProfileHwCounterCycles] ? (double)nCounters[ProfileHwCounterInstructions] / nCounters[ProfileHwCounterCycles] : 0.0;
+			ProfilePrintf(CB, Handle, "\"%s\",\"%s\",%.3f,%.1f,%.1f,%.1f,%.1f\n", S.GroupInfo[S.TimerInfo[i].nGroupIndex].pName, S.TimerInfo[i].pName, fIpc,
+				nCounters[ProfileHwCounterCycles] / fCalls, nCounters[ProfileHwCounterInstructions] / fCalls,
+				nCounters[ProfileHwCounterCacheMisses] / fCalls, nCounters[ProfileHwCounterBranchMisses] / fCalls);
+		}
+		ProfilePrintf(CB, Handle, "\n\n");
+	}
+#endif
+
+	if (S.nAllocCounterGroupMask)
+	{
+		ProfilePrintf(CB, Handle, "group,name,allocs/frame,bytes/frame,frees/frame,allocs/call\n");
+		for (uint32_t i = 0; i < S.nTotalTimers; ++i)
+		{
+			uint64_t nCounters[ProfileAllocCounterCount];
+			if (!ProfileGetAllocCounters(i, nCounters))
+				continue;
+			double fCalls = (double)(S.Aggregate[i].nCount ? S.Aggregate[i].nCount : 1);
+			ProfilePrintf(CB, Handle, "\"%s\",\"%s\",%.2f,%.1f,%.2f,%.2f\n", S.GroupInfo[S.TimerInfo[i].nGroupIndex].pName, S.TimerInfo[i].pName,
+				(double)nCounters[ProfileAllocCounterAllocs] / nAggregateFrames, (double)nCounters[ProfileAllocCounterBytes] / nAggregateFrames,
+				(double)nCounters[ProfileAllocCounterFrees] / nAggregateFrames, nCounters[ProfileAllocCounterAllocs] / fCalls);
+		}
+		ProfilePrintf(CB, Handle, "\n\n");
+	}
+
 	ProfilePrintf(CB, Handle, "group,average,max,total\n");
 	for (uint32_t j = 0; j < PROFILE_MAX_GROUPS; ++j)
 	{
@@ -1991,54 +2460,536 @@ void ProfileDumpCsv(ProfileWriteCallback CB, void* Handle, int nMaxFrames)
 	}
 }
 
-#if PROFILE_EMBED_HTML
-extern const char* g_ProfileHtml_begin[];
-extern size_t g_ProfileHtml_begin_sizes[];
-extern size_t g_ProfileHtml_begin_count;
-extern const char* g_ProfileHtml_end[];
-extern size_t g_ProfileHtml_end_sizes[];
-extern size_t g_ProfileHtml_end_count;
-
-
-void ProfileDumpHtml(ProfileWriteCallback CB, void* Handle, int nMaxFrames, const char* pHost, Renderer* pRenderer)
+// Trace export. Walks the per thread logs of the recorded frames and streams them as events through the write callback,
+// so arbitrarily long captures never have to be held in memory.
+struct ProfileTraceWriter
 {
-	Profile & S = g_Profile;
-	uint32_t nRunning = S.nRunning;
-	S.nRunning = 0;
+	void(*Begin)(ProfileTraceWriter* pWriter);
+	void(*Track)(ProfileTraceWriter* pWriter, uint32_t nTrack, const char* pName, bool bCounter);
+	void(*SliceBegin)(ProfileTraceWriter* pWriter, uint32_t nTrack, int64_t nTimeNs, const char* pName, const char* pCategory);
+	void(*SliceEnd)(ProfileTraceWriter* pWriter, uint32_t nTrack, int64_t nTimeNs, const uint64_t* pMeta);
+	void(*Instant)(ProfileTraceWriter* pWriter, uint32_t nTrack, int64_t nTimeNs, const char* pName);
+	void(*Counter)(ProfileTraceWriter* pWriter, uint32_t nTrack, int64_t nTimeNs, const char* pName, int64_t nValue);
+	void(*End)(ProfileTraceWriter* pWriter);
+
+	ProfileWriteCallback* CB;
+	void* Handle;
+	uint32_t nProcessId;
+	uint32_t nEventCount;
+};
 
-	//stall pushing of timers
-	uint64_t nActiveGroup = S.nActiveGroup;
-	S.nActiveGroup = 0;
-	S.nPauseTicks = P_TICK();
+// Track ids. Thread logs use their pool index, the frame track and counters follow.
+#define PROFILE_TRACE_FRAME_TRACK PROFILE_MAX_THREADS
+#define PROFILE_TRACE_COUNTER_TRACK(i) (PROFILE_MAX_THREADS + 1 + (i))
 
-	for (size_t i = 0; i < g_ProfileHtml_begin_count; ++i)
+void ProfilePrintJsonString(ProfileWriteCallback CB, void* Handle, const char* pData)
+{
+	char Buffer[PROFILE_LABEL_MAX_LEN * 2 + 2];
+	uint32_t nPos = 0;
+	Buffer[nPos++] = '"';
+	for (const char* p = pData; *p && nPos < sizeof(Buffer) - 3; ++p)
 	{
-		CB(Handle, g_ProfileHtml_begin_sizes[i] - 1, g_ProfileHtml_begin[i]);
+		char c = *p;
+		if (c == '"' || c == '\\')
+		{
+			Buffer[nPos++] = '\\';
+			Buffer[nPos++] = c;
+		}
+		else
+		{
+			Buffer[nPos++] = ((unsigned char)c < 0x20) ? ' ' : c;
+		}
 	}
+	Buffer[nPos++] = '"';
+	CB(Handle, nPos, Buffer);
+}
 
-	//dump info
-    if (pRenderer != NULL)
-    {
-        ProfilePrintf(CB, Handle, "var GpuName = '%s';\n", pRenderer->pActiveGpuSettings->mGpuVendorPreset.mGpuName);
-        ProfilePrintf(CB, Handle, "var VendorID = '%s';\n", pRenderer->pActiveGpuSettings->mGpuVendorPreset.mVendorId);
-        ProfilePrintf(CB, Handle, "var ModelID = '%s';\n", pRenderer->pActiveGpuSettings->mGpuVendorPreset.mModelId);
-    }
+// Chrome trace event format (chrome://tracing, Perfetto UI, Speedscope). Timestamps are in microseconds.
+void ProfileJsonTraceSeparator(ProfileTraceWriter* pWriter)
+{
+	ProfilePrintString(pWriter->CB, pWriter->Handle, pWriter->nEventCount++ ? ",\n" : "\n");
+}
 
-	uint64_t nTicks = P_TICK();
+void ProfileJsonTraceBegin(ProfileTraceWriter* pWriter)
+{
+	ProfilePrintString(pWriter->CB, pWriter->Handle, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+}
 
-	float fToMsCPU = ProfileTickToMsMultiplier(ProfileTicksPerSecondCpu());
-	float fAggregateMs = fToMsCPU * (nTicks - S.nAggregateFlipTick);
-	ProfilePrintf(CB, Handle, "var DumpHost = '%s';\n", pHost ? pHost : "");
-	time_t CaptureTime;
-	time(&CaptureTime);
-	ProfilePrintf(CB, Handle, "var DumpUtcCaptureTime = %ld;\n", CaptureTime);
-	ProfilePrintf(CB, Handle, "var AggregateInfo = {'Frames':%d, 'Time':%f};\n", S.nAggregateFrames, fAggregateMs);
+void ProfileJsonTraceTrack(ProfileTraceWriter* pWriter, uint32_t nTrack, const char* pName, bool bCounter)
+{
+	if (bCounter)
+		return;
+	ProfileJsonTraceSeparator(pWriter);
+	ProfilePrintf(pWriter->CB, pWriter->Handle, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":", pWriter->nProcessId, nTrack);
+	ProfilePrintJsonString(pWriter->CB, pWriter->Handle, pName);
+	ProfilePrintString(pWriter->CB, pWriter->Handle, "}}");
+}
 
-	//categories
-	ProfilePrintf(CB, Handle, "var CategoryInfo = Array(%d);\n", S.nCategoryCount);
-	for (uint32_t i = 0; i < S.nCategoryCount; ++i)
+void ProfileJsonTraceSliceBegin(ProfileTraceWriter* pWriter, uint32_t nTrack, int64_t nTimeNs, const char* pName, const char* pCategory)
+{
+	ProfileJsonTraceSeparator(pWriter);
+	ProfilePrintf(pWriter->CB, pWriter->Handle, "{\"ph\":\"B\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"name\":", pWriter->nProcessId, nTrack, nTimeNs / 1000.0);
+	ProfilePrintJsonString(pWriter->CB, pWriter->Handle, pName);
+	ProfilePrintString(pWriter->CB, pWriter->Handle, ",\"cat\":");
+	ProfilePrintJsonString(pWriter->CB, pWriter->Handle, pCategory);
+	ProfilePrintString(pWriter->CB, pWriter->Handle, "}");
+}
+
+// Meta counts of the scope, indexed like Profile::MetaCounters, and the instructions per cycle when hardware counters are on
+static bool ProfileTraceMetaIpc(const uint64_t* pMeta, double* pIpc)
+{
+#if PROFILE_HW_COUNTERS
+	Profile & S = g_Profile;
+	if (S.HwCounterMeta[ProfileHwCounterCycles] != PROFILE_INVALID_TOKEN && pMeta[S.HwCounterMeta[ProfileHwCounterCycles]])
 	{
-		ProfilePrintf(CB, Handle, "CategoryInfo[%d] = \"%s\";\n", i, S.CategoryInfo[i].pName);
+		*pIpc = (double)pMeta[S.HwCounterMeta[ProfileHwCounterInstructions]] / (double)pMeta[S.HwCounterMeta[ProfileHwCounterCycles]];
+		return true;
+	}
+#else
+	(void)pMeta;
+	(void)pIpc;
+#endif
+	return false;
+}
+
+void ProfileJsonTraceSliceEnd(ProfileTraceWriter* pWriter, uint32_t nTrack, int64_t nTimeNs, const uint64_t* pMeta)
+{
+	ProfileJsonTraceSeparator(pWriter);
+	ProfilePrintf(pWriter->CB, pWriter->Handle, "{\"ph\":\"E\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f", pWriter->nProcessId, nTrack, nTimeNs / 1000.0);
+	if (pMeta)
+	{
+		bool bArgs = false;
+		for (uint32_t i = 0; i < PROFILE_META_MAX; ++i)
+		{
+			if (!pMeta[i] || !g_Profile.MetaCounters[i].pName)
+				continue;
+			ProfilePrintString(pWriter->CB, pWriter->Handle, bArgs ? "," : ",\"args\":{");
+			ProfilePrintJsonString(pWriter->CB, pWriter->Handle, g_Profile.MetaCounters[i].pName);
+			ProfilePrintf(pWriter->CB, pWriter->Handle, ":%llu", (unsigned long long)pMeta[i]);
+			bArgs = true;
+		}
+		double fIpc = 0.0;
+		if (bArgs && ProfileTraceMetaIpc(pMeta, &fIpc))
+			ProfilePrintf(pWriter->CB, pWriter->Handle, ",\"IPC\":%.3f", fIpc);
+		if (bArgs)
+			ProfilePrintString(pWriter->CB, pWriter->Handle, "}");
+	}
+	ProfilePrintString(pWriter->CB, pWriter->Handle, "}");
+}
+
+void ProfileJsonTraceInstant(ProfileTraceWriter* pWriter, uint32_t nTrack, int64_t nTimeNs, const char* pName)
+{
+	ProfileJsonTraceSeparator(pWriter);
+	ProfilePrintf(pWriter->CB, pWriter->Handle, "{\"ph\":\"i\",\"s\":\"t\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"name\":", pWriter->nProcessId, nTrack, nTimeNs / 1000.0);
+	ProfilePrintJsonString(pWriter->CB, pWriter->Handle, pName);
+	ProfilePrintString(pWriter->CB, pWriter->Handle, "}");
+}
+
+void ProfileJsonTraceCounter(ProfileTraceWriter* pWriter, uint32_t nTrack, int64_t nTimeNs, const char* pName, int64_t nValue)
+{
+	(void)nTrack;
+	ProfileJsonTraceSeparator(pWriter);
+	ProfilePrintf(pWriter->CB, pWriter->Handle, "{\"ph\":\"C\",\"pid\":%u,\"ts\":%.3f,\"name\":", pWriter->nProcessId, nTimeNs / 1000.0);
+	ProfilePrintJsonString(pWriter->CB, pWriter->Handle, pName);
+	ProfilePrintf(pWriter->CB, pWriter->Handle, ",\"args\":{\"value\":%lld}}", (long long)nValue);
+}
+
+void ProfileJsonTraceEnd(ProfileTraceWriter* pWriter)
+{
+	ProfilePrintString(pWriter->CB, pWriter->Handle, "\n]}\n");
+}
+
+// Perfetto protobuf trace (ui.perfetto.dev, trace_processor). Every TracePacket is encoded on the stack and written
+// as one repeated field of the top level Trace message.
+struct ProfileProtoBuffer
+{
+	uint8_t Data[PROFILE_LABEL_MAX_LEN + PROFILE_NAME_MAX_LEN * 2 + 64];
+	uint32_t nSize;
+};
+
+void ProfileProtoVarint(ProfileProtoBuffer* pBuffer, uint64_t nValue)
+{
+	do
+	{
+		P_ASSERT(pBuffer->nSize < sizeof(pBuffer->Data));
+		uint8_t nByte = nValue & 0x7f;
+		nValue >>= 7;
+		pBuffer->Data[pBuffer->nSize++] = nByte | (nValue ? 0x80 : 0);
+	} while (nValue);
+}
+
+void ProfileProtoUInt(ProfileProtoBuffer* pBuffer, uint32_t nField, uint64_t nValue)
+{
+	ProfileProtoVarint(pBuffer, (nField << 3) | 0);
+	ProfileProtoVarint(pBuffer, nValue);
+}
+
+void ProfileProtoBytes(ProfileProtoBuffer* pBuffer, uint32_t nField, const void* pData, uint32_t nSize)
+{
+	nSize = ProfileMin(nSize, (uint32_t)(sizeof(pBuffer->Data) - pBuffer->nSize - 16));
+	ProfileProtoVarint(pBuffer, (nField << 3) | 2);
+	ProfileProtoVarint(pBuffer, nSize);
+	memcpy(&pBuffer->Data[pBuffer->nSize], pData, nSize);
+	pBuffer->nSize += nSize;
+}
+
+void ProfileProtoString(ProfileProtoBuffer* pBuffer, uint32_t nField, const char* pString)
+{
+	ProfileProtoBytes(pBuffer, nField, pString, (uint32_t)strlen(pString));
+}
+
+enum
+{
+	PROFILE_PERFETTO_TRACE_PACKET = 1,
+	PROFILE_PERFETTO_PACKET_TIMESTAMP = 8,
+	PROFILE_PERFETTO_PACKET_SEQUENCE_ID = 10,
+	PROFILE_PERFETTO_PACKET_TRACK_EVENT = 11,
+	PROFILE_PERFETTO_PACKET_SEQUENCE_FLAGS = 13,
+	PROFILE_PERFETTO_PACKET_TRACK_DESCRIPTOR = 60,
+	PROFILE_PERFETTO_TRACK_UUID = 1,
+	PROFILE_PERFETTO_TRACK_NAME = 2,
+	PROFILE_PERFETTO_TRACK_PROCESS = 3,
+	PROFILE_PERFETTO_TRACK_PARENT_UUID = 5,
+	PROFILE_PERFETTO_TRACK_COUNTER = 8,
+	PROFILE_PERFETTO_PROCESS_PID = 1,
+	PROFILE_PERFETTO_EVENT_TYPE = 9,
+	PROFILE_PERFETTO_EVENT_TRACK_UUID = 11,
+	PROFILE_PERFETTO_EVENT_CATEGORIES = 22,
+	PROFILE_PERFETTO_EVENT_NAME = 23,
+	PROFILE_PERFETTO_EVENT_COUNTER_VALUE = 30,
+	PROFILE_PERFETTO_EVENT_DEBUG_ANNOTATIONS = 4,
+	PROFILE_PERFETTO_ANNOTATION_UINT_VALUE = 3,
+	PROFILE_PERFETTO_ANNOTATION_DOUBLE_VALUE = 5,
+	PROFILE_PERFETTO_ANNOTATION_NAME = 10,
+	PROFILE_PERFETTO_TYPE_SLICE_BEGIN = 1,
+	PROFILE_PERFETTO_TYPE_SLICE_END = 2,
+	PROFILE_PERFETTO_TYPE_INSTANT = 3,
+	PROFILE_PERFETTO_TYPE_COUNTER = 4,
+	PROFILE_PERFETTO_SEQ_INCREMENTAL_STATE_CLEARED = 1,
+	PROFILE_PERFETTO_SEQUENCE_ID = 1,
+	PROFILE_PERFETTO_PROCESS_UUID = 1,
+	PROFILE_PERFETTO_TRACK_UUID_BASE = 0x1000,
+};
+
+void ProfilePerfettoWritePacket(ProfileTraceWriter* pWriter, ProfileProtoBuffer* pPacket)
+{
+	ProfileProtoBuffer Header;
+	Header.nSize = 0;
+	ProfileProtoVarint(&Header, (PROFILE_PERFETTO_TRACE_PACKET << 3) | 2);
+	ProfileProtoVarint(&Header, pPacket->nSize);
+	pWriter->CB(pWriter->Handle, Header.nSize, (const char*)Header.Data);
+	pWriter->CB(pWriter->Handle, pPacket->nSize, (const char*)pPacket->Data);
+}
+
+void ProfilePerfettoWriteEvent(ProfileTraceWriter* pWriter, int64_t nTimeNs, ProfileProtoBuffer* pEvent)
+{
+	ProfileProtoBuffer Packet;
+	Packet.nSize = 0;
+	ProfileProtoUInt(&Packet, PROFILE_PERFETTO_PACKET_TIMESTAMP, (uint64_t)nTimeNs);
+	ProfileProtoUInt(&Packet, PROFILE_PERFETTO_PACKET_SEQUENCE_ID, PROFILE_PERFETTO_SEQUENCE_ID);
+	ProfileProtoBytes(&Packet, PROFILE_PERFETTO_PACKET_TRACK_EVENT, pEvent->Data, pEvent->nSize);
+	ProfilePerfettoWritePacket(pWriter, &Packet);
+}
+
+void ProfilePerfettoTraceBegin(ProfileTraceWriter* pWriter)
+{
+	ProfileProtoBuffer Process;
+	Process.nSize = 0;
+	ProfileProtoUInt(&Process, PROFILE_PERFETTO_PROCESS_PID, pWriter->nProcessId);
+
+	ProfileProtoBuffer Track;
+	Track.nSize = 0;
+	ProfileProtoUInt(&Track, PROFILE_PERFETTO_TRACK_UUID, PROFILE_PERFETTO_PROCESS_UUID);
+	ProfileProtoBytes(&Track, PROFILE_PERFETTO_TRACK_PROCESS, Process.Data, Process.nSize);
+
+	ProfileProtoBuffer Packet;
+	Packet.nSize = 0;
+	ProfileProtoUInt(&Packet, PROFILE_PERFETTO_PACKET_SEQUENCE_ID, PROFILE_PERFETTO_SEQUENCE_ID);
+	ProfileProtoUInt(&Packet, PROFILE_PERFETTO_PACKET_SEQUENCE_FLAGS, PROFILE_PERFETTO_SEQ_INCREMENTAL_STATE_CLEARED);
+	ProfileProtoBytes(&Packet, PROFILE_PERFETTO_PACKET_TRACK_DESCRIPTOR, Track.Data, Track.nSize);
+	ProfilePerfettoWritePacket(pWriter, &Packet);
+}
+
+void ProfilePerfettoTraceTrack(ProfileTraceWriter* pWriter, uint32_t nTrack, const char* pName, bool bCounter)
+{
+	ProfileProtoBuffer Track;
+	Track.nSize = 0;
+	ProfileProtoUInt(&Track, PROFILE_PERFETTO_TRACK_UUID, PROFILE_PERFETTO_TRACK_UUID_BASE + nTrack);
+	ProfileProtoString(&Track, PROFILE_PERFETTO_TRACK_NAME, pName);
+	ProfileProtoUInt(&Track, PROFILE_PERFETTO_TRACK_PARENT_UUID, PROFILE_PERFETTO_PROCESS_UUID);
+	if (bCounter)
+		ProfileProtoBytes(&Track, PROFILE_PERFETTO_TRACK_COUNTER, NULL, 0);
+
+	ProfileProtoBuffer Packet;
+	Packet.nSize = 0;
+	ProfileProtoUInt(&Packet, PROFILE_PERFETTO_PACKET_SEQUENCE_ID, PROFILE_PERFETTO_SEQUENCE_ID);
+	ProfileProtoBytes(&Packet, PROFILE_PERFETTO_PACKET_TRACK_DESCRIPTOR, Track.Data, Track.nSize);
+	ProfilePerfettoWritePacket(pWriter, &Packet);
+}
+
+void ProfilePerfettoTraceSliceBegin(ProfileTraceWriter* pWriter, uint32_t nTrack, int64_t nTimeNs, const char* pName, const char* pCategory)
+{
+	ProfileProtoBuffer Event;
+	Event.nSize = 0;
+	ProfileProtoUInt(&Event, PROFILE_PERFETTO_EVENT_TYPE, PROFILE_PERFETTO_TYPE_SLICE_BEGIN);
+	ProfileProtoUInt(&Event, PROFILE_PERFETTO_EVENT_TRACK_UUID, PROFILE_PERFETTO_TRACK_UUID_BASE + nTrack);
+	ProfileProtoString(&Event, PROFILE_PERFETTO_EVENT_CATEGORIES, pCategory);
+	ProfileProtoString(&Event, PROFILE_PERFETTO_EVENT_NAME, pName);
+	ProfilePerfettoWriteEvent(pWriter, nTimeNs, &Event);
+}
+
+void ProfilePerfettoTraceSliceEnd(ProfileTraceWriter* pWriter, uint32_t nTrack, int64_t nTimeNs, const uint64_t* pMeta)
+{
+	ProfileProtoBuffer Event;
+	Event.nSize = 0;
+	ProfileProtoUInt(&Event, PROFILE_PERFETTO_EVENT_TYPE, PROFILE_PERFETTO_TYPE_SLICE_END);
+	ProfileProtoUInt(&Event, PROFILE_PERFETTO_EVENT_TRACK_UUID, PROFILE_PERFETTO_TRACK_UUID_BASE + nTrack);
+	if (pMeta)
+	{
+		// Debug annotations of the end event are merged into the args of the slice
+		for (uint32_t i = 0; i < PROFILE_META_MAX; ++i)
+		{
+			if (!pMeta[i] || !g_Profile.MetaCounters[i].pName)
+				continue;
+			ProfileProtoBuffer Annotation;
+			Annotation.nSize = 0;
+			ProfileProtoString(&Annotation, PROFILE_PERFETTO_ANNOTATION_NAME, g_Profile.MetaCounters[i].pName);
+			ProfileProtoUInt(&Annotation, PROFILE_PERFETTO_ANNOTATION_UINT_VALUE, pMeta[i]);
+			ProfileProtoBytes(&Event, PROFILE_PERFETTO_EVENT_DEBUG_ANNOTATIONS, Annotation.Data, Annotation.nSize);
+		}
+		double fIpc = 0.0;
+		if (ProfileTraceMetaIpc(pMeta, &fIpc))
+		{
+			ProfileProtoBuffer Annotation;
+			Annotation.nSize = 0;
+			ProfileProtoString(&Annotation, PROFILE_PERFETTO_ANNOTATION_NAME, "IPC");
+			ProfileProtoVarint(&Annotation, (PROFILE_PERFETTO_ANNOTATION_DOUBLE_VALUE << 3) | 1);
+			memcpy(&Annotation.Data[Annotation.nSize], &fIpc, sizeof(fIpc));
+			Annotation.nSize += sizeof(fIpc);
+			ProfileProtoBytes(&Event, PROFILE_PERFETTO_EVENT_DEBUG_ANNOTATIONS, Annotation.Data, Annotation.nSize);
+		}
+	}
+	ProfilePerfettoWriteEvent(pWriter, nTimeNs, &Event);
+}
+
+void ProfilePerfettoTraceInstant(ProfileTraceWriter* pWriter, uint32_t nTrack, int64_t nTimeNs, const char* pName)
+{
+	ProfileProtoBuffer Event;
+	Event.nSize = 0;
+	ProfileProtoUInt(&Event, PROFILE_PERFETTO_EVENT_TYPE, PROFILE_PERFETTO_TYPE_INSTANT);
+	ProfileProtoUInt(&Event, PROFILE_PERFETTO_EVENT_TRACK_UUID, PROFILE_PERFETTO_TRACK_UUID_BASE + nTrack);
+	ProfileProtoString(&Event, PROFILE_PERFETTO_EVENT_NAME, pName);
+	ProfilePerfettoWriteEvent(pWriter, nTimeNs, &Event);
+}
+
+void ProfilePerfettoTraceCounter(ProfileTraceWriter* pWriter, uint32_t nTrack, int64_t nTimeNs, const char* pName, int64_t nValue)
+{
+	(void)pName;
+	ProfileProtoBuffer Event;
+	Event.nSize = 0;
+	ProfileProtoUInt(&Event, PROFILE_PERFETTO_EVENT_TYPE, PROFILE_PERFETTO_TYPE_COUNTER);
+	ProfileProtoUInt(&Event, PROFILE_PERFETTO_EVENT_TRACK_UUID, PROFILE_PERFETTO_TRACK_UUID_BASE + nTrack);
+	ProfileProtoUInt(&Event, PROFILE_PERFETTO_EVENT_COUNTER_VALUE, (uint64_t)nValue);
+	ProfilePerfettoWriteEvent(pWriter, nTimeNs, &Event);
+}
+
+void ProfilePerfettoTraceEnd(ProfileTraceWriter* pWriter)
+{
+	(void)pWriter;
+}
+
+void ProfileDumpTrace(ProfileWriteCallback CB, void* Handle, int nMaxFrames, ProfileDumpType eType)
+{
+	P_ASSERT(eType == ProfileDumpTypeChromeTrace || eType == ProfileDumpTypePerfetto);
+	Profile & S = g_Profile;
+	uint32_t nRunning = S.nRunning;
+	S.nRunning = 0;
+
+	//stall pushing of timers
+	uint64_t nActiveGroup = S.nActiveGroup;
+	S.nActiveGroup = 0;
+	S.nPauseTicks = P_TICK();
+
+	ProfileTraceWriter Writer = {};
+	if (eType == ProfileDumpTypeChromeTrace)
+	{
+		Writer.Begin = ProfileJsonTraceBegin;
+		Writer.Track = ProfileJsonTraceTrack;
+		Writer.SliceBegin = ProfileJsonTraceSliceBegin;
+		Writer.SliceEnd = ProfileJsonTraceSliceEnd;
+		Writer.Instant = ProfileJsonTraceInstant;
+		Writer.Counter = ProfileJsonTraceCounter;
+		Writer.End = ProfileJsonTraceEnd;
+	}
+	else
+	{
+		Writer.Begin = ProfilePerfettoTraceBegin;
+		Writer.Track = ProfilePerfettoTraceTrack;
+		Writer.SliceBegin = ProfilePerfettoTraceSliceBegin;
+		Writer.SliceEnd = ProfilePerfettoTraceSliceEnd;
+		Writer.Instant = ProfilePerfettoTraceInstant;
+		Writer.Counter = ProfilePerfettoTraceCounter;
+		Writer.End = ProfilePerfettoTraceEnd;
+	}
+	Writer.CB = CB;
+	Writer.Handle = Handle;
+	Writer.nProcessId = (uint32_t)P_GETCURRENTPROCESSID();
+
+	uint32_t nNumFrames = (PROFILE_MAX_FRAME_HISTORY - PROFILE_GPU_FRAME_DELAY - 3); //leave a few to not overwrite
+	nNumFrames = ProfileMin(nNumFrames, (uint32_t)nMaxFrames);
+
+	const uint32_t nFirstFrame = (S.nFrameCurrent + PROFILE_MAX_FRAME_HISTORY - nNumFrames) % PROFILE_MAX_FRAME_HISTORY;
+	const uint32_t nLastFrame = (nFirstFrame + nNumFrames) % PROFILE_MAX_FRAME_HISTORY;
+	const int64_t nTickStart = S.Frames[nFirstFrame].nFrameStartCpu;
+	const int64_t nTickEnd = S.Frames[nLastFrame].nFrameStartCpu;
+	const double fCpuTickToNs = 1e9 / (double)ProfileTicksPerSecondCpu();
+
+	Writer.Begin(&Writer);
+
+	Writer.Track(&Writer, PROFILE_TRACE_FRAME_TRACK, "Frames", false);
+	for (uint32_t j = 0; j < PROFILE_MAX_THREADS; ++j)
+	{
+		if (S.Pool[j])
+			Writer.Track(&Writer, j, S.Pool[j]->ThreadName, false);
+	}
+	for (uint32_t i = 0; i < S.nNumCounters; ++i)
+	{
+		Writer.Track(&Writer, PROFILE_TRACE_COUNTER_TRACK(i), ProfileCounterFullName(i), true);
+	}
+
+	// Time 0 is the start of the first dumped frame
+	for (uint32_t i = 0; i < nNumFrames; ++i)
+	{
+		uint32_t nFrameIndex = (nFirstFrame + i) % PROFILE_MAX_FRAME_HISTORY;
+		uint32_t nFrameIndexNext = (nFrameIndex + 1) % PROFILE_MAX_FRAME_HISTORY;
+		char FrameName[32];
+		snprintf(FrameName, sizeof(FrameName), "Frame %u", i);
+		Writer.SliceBegin(&Writer, PROFILE_TRACE_FRAME_TRACK, (int64_t)(ProfileLogTickDifference(nTickStart, S.Frames[nFrameIndex].nFrameStartCpu) * fCpuTickToNs), FrameName, "Frame");
+		Writer.SliceEnd(&Writer, PROFILE_TRACE_FRAME_TRACK, (int64_t)(ProfileLogTickDifference(nTickStart, S.Frames[nFrameIndexNext].nFrameStartCpu) * fCpuTickToNs), NULL);
+	}
+
+	for (uint32_t j = 0; j < PROFILE_MAX_THREADS; ++j)
+	{
+		ProfileThreadLog* pLog = S.Pool[j];
+		if (!pLog || !pLog->Log)
+			continue;
+
+		// Gpu timestamps are in their own time domain. Align the start of the first gpu frame with the first cpu frame.
+		int64_t nStartTick = pLog->nGpu ? S.Frames[nFirstFrame].nFrameStartGpu[j] : nTickStart;
+		double fTickToNs = pLog->nGpu ? 1e9 / (double)getGpuProfileTicksPerSecond(pLog->nGpuToken) : fCpuTickToNs;
+
+		uint32_t nStackPos = 0;
+		int64_t nLastTimeNs = 0;
+		// Meta counts (and hardware counters) are logged before the leave of the innermost scope
+		uint64_t nMetaStack[PROFILE_STACK_MAX][PROFILE_META_MAX];
+		uint32_t nLogStart = S.Frames[nFirstFrame].nLogStart[j];
+		uint32_t nLogEnd = S.Frames[nLastFrame].nLogStart[j];
+		for (uint32_t k = nLogStart; k != nLogEnd; k = (k + 1) % PROFILE_BUFFER_SIZE)
+		{
+			ProfileLogEntry LE = pLog->Log[k];
+			uint64_t nType = ProfileLogType(LE);
+			if (P_LOG_ENTER == nType || P_LOG_LEAVE == nType)
+			{
+				int64_t nTimeNs = (int64_t)(ProfileLogTickDifference(nStartTick, LE) * fTickToNs);
+				nLastTimeNs = ProfileMax(nLastTimeNs, nTimeNs);
+				uint32_t nTimer = (uint32_t)ProfileLogTimerIndex(LE);
+				if (P_LOG_ENTER == nType)
+				{
+					Writer.SliceBegin(&Writer, j, nTimeNs, S.TimerInfo[nTimer].pName, S.GroupInfo[S.TimerInfo[nTimer].nGroupIndex].pName);
+					if (nStackPos < PROFILE_STACK_MAX)
+						memset(nMetaStack[nStackPos], 0, sizeof(nMetaStack[nStackPos]));
+					nStackPos++;
+				}
+				else if (nStackPos)
+				{
+					// Leaves of scopes entered before the first dumped frame are dropped
+					nStackPos--;
+					Writer.SliceEnd(&Writer, j, nTimeNs, nStackPos < PROFILE_STACK_MAX ? nMetaStack[nStackPos] : NULL);
+				}
+			}
+			else if (P_LOG_META == nType)
+			{
+				uint64_t nMetaIndex = ProfileLogTimerIndex(LE);
+				if (nStackPos && nStackPos <= PROFILE_STACK_MAX && nMetaIndex < PROFILE_META_MAX)
+					nMetaStack[nStackPos - 1][nMetaIndex] += ProfileLogGetTick(LE);
+			}
+			else if (P_LOG_LABEL == nType || P_LOG_LABEL_LITERAL == nType)
+			{
+				const char* pLabelName = ProfileGetLabel((uint32_t)nType, ProfileLogGetTick(LE));
+				if (pLabelName)
+					Writer.Instant(&Writer, j, nLastTimeNs, pLabelName);
+			}
+		}
+
+		// Close scopes still open at the end of the last dumped frame
+		for (; nStackPos; --nStackPos)
+		{
+			Writer.SliceEnd(&Writer, j, nLastTimeNs, NULL);
+		}
+	}
+
+	// Counters have no per frame history, write their current value at the end of the capture
+	const int64_t nCounterTimeNs = (int64_t)(ProfileLogTickDifference(nTickStart, nTickEnd) * fCpuTickToNs);
+	for (uint32_t i = 0; i < S.nNumCounters; ++i)
+	{
+		int64_t nCounter = tfrg_atomic64_load_relaxed(&S.Counters[i]);
+		Writer.Counter(&Writer, PROFILE_TRACE_COUNTER_TRACK(i), nCounterTimeNs, ProfileCounterFullName(i), nCounter);
+	}
+
+	Writer.End(&Writer);
+
+	S.nActiveGroup = nActiveGroup;
+	S.nRunning = nRunning;
+}
+
+#if PROFILE_EMBED_HTML
+extern const char* g_ProfileHtml_begin[];
+extern size_t g_ProfileHtml_begin_sizes[];
+extern size_t g_ProfileHtml_begin_count;
+extern const char* g_ProfileHtml_end[];
+extern size_t g_ProfileHtml_end_sizes[];
+extern size_t g_ProfileHtml_end_count;
+
+
+void ProfileDumpHtml(ProfileWriteCallback CB, void* Handle, int nMaxFrames, const char* pHost, Renderer* pRenderer)
+{
+	Profile & S = g_Profile;
+	uint32_t nRunning = S.nRunning;
+	S.nRunning = 0;
+
+	//stall pushing of timers
+	uint64_t nActiveGroup = S.nActiveGroup;
+	S.nActiveGroup = 0;
+	S.nPauseTicks = P_TICK();
+
+	for (size_t i = 0; i < g_ProfileHtml_begin_count; ++i)
+	{
+		CB(Handle, g_ProfileHtml_begin_sizes[i] - 1, g_ProfileHtml_begin[i]);
+	}
+
+	//dump info
+    if (pRenderer != NULL)
+    {
+        ProfilePrintf(CB, Handle, "var GpuName = '%s';\n", pRenderer->pActiveGpuSettings->mGpuVendorPreset.mGpuName);
+        ProfilePrintf(CB, Handle, "var VendorID = '%s';\n", pRenderer->pActiveGpuSettings->mGpuVendorPreset.mVendorId);
+        ProfilePrintf(CB, Handle, "var ModelID = '%s';\n", pRenderer->pActiveGpuSettings->mGpuVendorPreset.mModelId);
+    }
+
+	uint64_t nTicks = P_TICK();
+
+	float fToMsCPU = ProfileTickToMsMultiplier(ProfileTicksPerSecondCpu());
+	float fAggregateMs = fToMsCPU * (nTicks - S.nAggregateFlipTick);
+	ProfilePrintf(CB, Handle, "var DumpHost = '%s';\n", pHost ? pHost : "");
+	time_t CaptureTime;
+	time(&CaptureTime);
+	ProfilePrintf(CB, Handle, "var DumpUtcCaptureTime = %ld;\n", CaptureTime);
+	ProfilePrintf(CB, Handle, "var AggregateInfo = {'Frames':%d, 'Time':%f};\n", S.nAggregateFrames, fAggregateMs);
+
+	//categories
+	ProfilePrintf(CB, Handle, "var CategoryInfo = Array(%d);\n", S.nCategoryCount);
+	for (uint32_t i = 0; i < S.nCategoryCount; ++i)
+	{
+		ProfilePrintf(CB, Handle, "CategoryInfo[%d] = \"%s\";\n", i, S.CategoryInfo[i].pName);
 	}
 
 	//groups
@@ -2141,7 +3092,8 @@ void ProfileDumpHtml(ProfileWriteCallback CB, void* Handle, int nMaxFrames, cons
 	{
 		if (!S.Pool[i])
 			continue;
-		ProfilePrintUIntComma(CB, Handle, i);
+		// Gpu logs have no context switches of their own
+		ProfilePrintUIntComma(CB, Handle, S.Pool[i]->nGpu ? 0 : S.Pool[i]->nContextSwitchThreadId);
 	}
 	ProfilePrintString(CB, Handle, "];\n\n");
 
@@ -2427,8 +3379,8 @@ void ProfileDumpHtml(ProfileWriteCallback CB, void* Handle, int nMaxFrames, cons
 	{
 		ProfileContextSwitch CS = S.ContextSwitch[j];
 		int nCpu = CS.nCpu;
-		ProfilePrintUIntComma(CB, Handle, 0);
-		ProfilePrintUIntComma(CB, Handle, 0);
+		ProfilePrintUIntComma(CB, Handle, CS.nThreadIn);
+		ProfilePrintUIntComma(CB, Handle, CS.nThreadOut);
 		ProfilePrintUIntComma(CB, Handle, nCpu);
 	}
 	ProfilePrintString(CB, Handle, "];\n");
@@ -2477,114 +3429,758 @@ void ProfileDumpHtml(ProfileWriteCallback CB, void* Handle, int nMaxFrames, cons
 	memset(nGroupCounter, 0, sizeof(uint32_t) * S.nGroupCount);
 	for (uint32_t i = 0; i < S.nTotalTimers; ++i)
 	{
-		uint32_t nGroupIndex = S.TimerInfo[i].nGroupIndex;
-		nGroupCounter[nGroupIndex] += nTimerCounter[i];
+		uint32_t nGroupIndex = S.TimerInfo[i].nGroupIndex;
+		nGroupCounter[nGroupIndex] += nTimerCounter[i];
+	}
+
+	uint32_t* nGroupCounterSort = (uint32_t*)tf_calloc(S.nGroupCount, sizeof(uint32_t));
+	uint32_t* nTimerCounterSort = (uint32_t*)tf_calloc(S.nTotalTimers, sizeof(uint32_t));
+	for (uint32_t i = 0; i < S.nGroupCount; ++i)
+	{
+		nGroupCounterSort[i] = i;
+	}
+	for (uint32_t i = 0; i < S.nTotalTimers; ++i)
+	{
+		nTimerCounterSort[i] = i;
+	}
+	eastl::sort(nGroupCounterSort, nGroupCounterSort + S.nGroupCount,
+		[nGroupCounter](const uint32_t l, const uint32_t r)
+	{
+		return nGroupCounter[l] > nGroupCounter[r];
+	}
+	);
+
+	eastl::sort(nTimerCounterSort, nTimerCounterSort + S.nTotalTimers,
+		[nTimerCounter](const uint32_t l, const uint32_t r)
+	{
+		return nTimerCounter[l] > nTimerCounter[r];
+	}
+	);
+
+	ProfilePrintf(CB, Handle, "\n<!--\nMarker Per Group\n");
+	for (uint32_t i = 0; i < S.nGroupCount; ++i)
+	{
+		uint32_t idx = nGroupCounterSort[i];
+		ProfilePrintf(CB, Handle, "%8d:%s\n", nGroupCounter[idx], S.GroupInfo[idx].pName);
+	}
+	ProfilePrintf(CB, Handle, "Marker Per Timer\n");
+	for (uint32_t i = 0; i < S.nTotalTimers; ++i)
+	{
+		uint32_t idx = nTimerCounterSort[i];
+		ProfilePrintf(CB, Handle, "%8d:%s(%s)\n", nTimerCounter[idx], S.TimerInfo[idx].pName, S.GroupInfo[S.TimerInfo[idx].nGroupIndex].pName);
+	}
+	ProfilePrintf(CB, Handle, "\n-->\n");
+
+	S.nActiveGroup = nActiveGroup;
+	S.nRunning = nRunning;
+
+    tf_free(nTimerCounterSort);
+    tf_free(nGroupCounterSort);
+    tf_free(nGroupCounter);
+    tf_free(nTimerCounter);
+    tf_free(pTimers);
+
+#if PROFILE_DEBUG
+	int64_t nTicksEnd = P_TICK();
+	float fMs = fToMsCpu * (nTicksEnd - S.nPauseTicks);
+	printf("html dump took %6.2fms\n", fMs);
+#endif
+}
+#else
+void ProfileDumpHtml(ProfileWriteCallback CB, void* Handle, int nMaxFrames, const char* pHost)
+{
+	ProfilePrintString(CB, Handle, "HTML output is disabled because PROFILE_EMBED_HTML is 0\n");
+}
+#endif
+
+void ProfileWriteFile(void* Handle, size_t nSize, const char* pData)
+{
+	fsWriteToStream((FileStream*)Handle, pData, nSize);
+}
+
+void ProfileDumpToFile(Renderer* pRenderer)
+{
+    MutexLock lock(ProfileMutex());
+	Profile & S = g_Profile;
+	
+	FileStream fh = {};
+	FileMode eMode = S.eDumpType == ProfileDumpTypePerfetto ? FM_WRITE_BINARY : FM_WRITE;
+	if (fsOpenStreamFromPath(RD_LOG, S.DumpFile, eMode, &fh))
+	{
+		if (S.eDumpType == ProfileDumpTypeHtml)
+			ProfileDumpHtml(ProfileWriteFile, &fh, S.nDumpFrames, 0, pRenderer);
+		else if (S.eDumpType == ProfileDumpTypeCsv)
+			ProfileDumpCsv(ProfileWriteFile, &fh, S.nDumpFrames);
+		else if (S.eDumpType == ProfileDumpTypeChromeTrace || S.eDumpType == ProfileDumpTypePerfetto)
+			ProfileDumpTrace(ProfileWriteFile, &fh, S.nDumpFrames, S.eDumpType);
+
+        fsCloseStream(&fh);
+	}
+}
+
+void dumpProfileData(Renderer* pRenderer, const char* appName, uint32_t nMaxFrames)
+{
+    MutexLock lock(ProfileMutex());
+    // Dump frames to file.
+    time_t t = time(0);
+
+	char tempName[128];
+	sprintf(tempName, "%s", appName);
+	strcat(tempName, R"(Profile-%Y-%m-%d-%H.%M.%S.html)");
+
+    char name[128] = {};
+    strftime(name, sizeof(name), tempName, localtime(&t));
+	FileStream fh = {};
+    if (fsOpenStreamFromPath(RD_LOG, name, FM_WRITE, &fh))
+    {
+        ProfileDumpHtml(ProfileWriteFile, &fh, nMaxFrames, 0, pRenderer);
+        fsCloseStream(&fh);
+    }
+}
+
+void dumpProfileTrace(const char* appName, uint32_t nMaxFrames, bool bPerfetto)
+{
+    MutexLock lock(ProfileMutex());
+    time_t t = time(0);
+
+	char tempName[128];
+	sprintf(tempName, "%s", appName);
+	strcat(tempName, bPerfetto ? R"(Profile-%Y-%m-%d-%H.%M.%S.perfetto-trace)" : R"(Profile-%Y-%m-%d-%H.%M.%S.json)");
+
+    char name[128] = {};
+    strftime(name, sizeof(name), tempName, localtime(&t));
+	FileStream fh = {};
+    if (fsOpenStreamFromPath(RD_LOG, name, bPerfetto ? FM_WRITE_BINARY : FM_WRITE, &fh))
+    {
+        ProfileDumpTrace(ProfileWriteFile, &fh, nMaxFrames, bPerfetto ? ProfileDumpTypePerfetto : ProfileDumpTypeChromeTrace);
+        fsCloseStream(&fh);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Continuous capture
+//////////////////////////////////////////////////////////////////////////
+// Every completed frame is serialized out of the per thread rings by ProfileFlipCpu into a chain of fixed size chunks.
+// A writer thread appends the chunks to disk, and the most recent chunks are kept as a history for ProfileStreamSave.
+// The total amount of chunks is bounded, frames that do not fit are dropped and recorded as such in the stream.
+#define PROFILE_STREAM_CHUNK_SIZE (256 << 10)
+#define PROFILE_STREAM_MIN_CHUNKS 4
+#define PROFILE_STREAM_VERSION 1
+#define PROFILE_STREAM_INVALID_OFFSET 0xffffffff
+
+enum ProfileStreamRecord
+{
+	ProfileStreamRecordHeader = 'H',
+	ProfileStreamRecordGroup = 'G',
+	ProfileStreamRecordTimer = 'N',
+	ProfileStreamRecordThread = 'T',
+	ProfileStreamRecordDropped = 'D',
+	ProfileStreamRecordFrame = 'F',
+};
+
+struct ProfileStreamChunk
+{
+	uint32_t nSize;
+	uint32_t nFirstFrameOffset; // Offset of the first frame starting in this chunk, chunks can begin with the tail of a previous frame
+	int64_t nLastFrameTick;     // Cpu tick of the end of the last frame written to this chunk
+	uint32_t nPinned;           // Chunk is being written to disk, it cannot be recycled
+	uint8_t Data[PROFILE_STREAM_CHUNK_SIZE];
+};
+
+struct ProfileStream
+{
+	Mutex StreamMutex;
+	ConditionVariable StreamCond;
+	ThreadDesc WriterDesc;
+	ThreadHandle WriterThread;
+
+	bool bInitialized;
+	bool bActive;
+	bool bStop;
+	bool bFileOpen;
+	FileStream File;
+
+	uint32_t nMaxChunks;
+	uint32_t nAllocatedChunks;
+	ProfileStreamChunk* pCurrent;
+	eastl::vector<ProfileStreamChunk*> Free;
+	eastl::vector<ProfileStreamChunk*> Pending;
+	eastl::vector<ProfileStreamChunk*> History;
+
+	bool bSaveRequested;
+	int64_t nSaveFromTick;
+	char SaveFileName[256];
+	eastl::vector<uint8_t> SaveHeader;
+
+	uint32_t nDroppedFrames;
+	uint32_t nTotalDroppedFrames;
+	uint32_t nGroupsWritten;
+	uint32_t nTimersWritten;
+	char ThreadNames[PROFILE_MAX_THREADS][64];
+};
+
+static ProfileStream g_ProfileStream;
+
+struct ProfileStreamWriter
+{
+	ProfileStream* pStream;
+	eastl::vector<uint8_t>* pBuffer; // Write to a buffer instead of the chunk chain
+	uint64_t nSize;
+	int64_t nFrameTick;
+	bool bMeasure;                   // Only compute the size of the data
+};
+
+static void ProfileStreamReleaseCurrent(ProfileStream& T)
+{
+	if (!T.pCurrent)
+		return;
+
+	if (T.bFileOpen)
+	{
+		T.Pending.push_back(T.pCurrent);
+		T.StreamCond.WakeAll();
+	}
+	else
+	{
+		T.History.push_back(T.pCurrent);
+	}
+	T.pCurrent = NULL;
+}
+
+static uint32_t ProfileStreamRecyclableChunks(ProfileStream& T)
+{
+	uint32_t nCount = 0;
+	while (nCount < T.History.size() && !T.History[nCount]->nPinned)
+		++nCount;
+	return nCount;
+}
+
+static void ProfileStreamNextChunk(ProfileStream& T)
+{
+	ProfileStreamReleaseCurrent(T);
+
+	ProfileStreamChunk* pChunk = NULL;
+	if (!T.Free.empty())
+	{
+		pChunk = T.Free.back();
+		T.Free.pop_back();
+	}
+	else if (T.nAllocatedChunks < T.nMaxChunks)
+	{
+		pChunk = (ProfileStreamChunk*)tf_malloc(sizeof(ProfileStreamChunk));
+		T.nAllocatedChunks++;
+	}
+	else
+	{
+		// Capacity is checked before writing a frame so the oldest history chunk is always free to reuse here
+		P_ASSERT(!T.History.empty() && !T.History.front()->nPinned);
+		pChunk = T.History.front();
+		T.History.erase(T.History.begin());
+	}
+
+	pChunk->nSize = 0;
+	pChunk->nFirstFrameOffset = PROFILE_STREAM_INVALID_OFFSET;
+	pChunk->nLastFrameTick = 0;
+	pChunk->nPinned = 0;
+	T.pCurrent = pChunk;
+}
+
+static void ProfileStreamWrite(ProfileStreamWriter* pWriter, const void* pData, uint32_t nSize)
+{
+	pWriter->nSize += nSize;
+	if (pWriter->bMeasure)
+		return;
+
+	if (pWriter->pBuffer)
+	{
+		pWriter->pBuffer->insert(pWriter->pBuffer->end(), (const uint8_t*)pData, (const uint8_t*)pData + nSize);
+		return;
+	}
+
+	ProfileStream& T = *pWriter->pStream;
+	const uint8_t* pSrc = (const uint8_t*)pData;
+	while (nSize)
+	{
+		if (!T.pCurrent || T.pCurrent->nSize == PROFILE_STREAM_CHUNK_SIZE)
+			ProfileStreamNextChunk(T);
+
+		uint32_t nCopy = ProfileMin(nSize, PROFILE_STREAM_CHUNK_SIZE - T.pCurrent->nSize);
+		memcpy(&T.pCurrent->Data[T.pCurrent->nSize], pSrc, nCopy);
+		T.pCurrent->nSize += nCopy;
+		T.pCurrent->nLastFrameTick = pWriter->nFrameTick;
+		pSrc += nCopy;
+		nSize -= nCopy;
+	}
+}
+
+template <typename T>
+static void ProfileStreamWrite(ProfileStreamWriter* pWriter, T nValue)
+{
+	ProfileStreamWrite(pWriter, &nValue, sizeof(nValue));
+}
+
+static void ProfileStreamWriteString(ProfileStreamWriter* pWriter, const char* pString)
+{
+	uint16_t nLength = (uint16_t)ProfileMin(strlen(pString), (size_t)0xffff);
+	ProfileStreamWrite(pWriter, nLength);
+	ProfileStreamWrite(pWriter, pString, nLength);
+}
+
+static void ProfileStreamWriteGroup(ProfileStreamWriter* pWriter, uint32_t nGroup)
+{
+	Profile & S = g_Profile;
+	ProfileStreamWrite(pWriter, (uint8_t)ProfileStreamRecordGroup);
+	ProfileStreamWrite(pWriter, nGroup);
+	ProfileStreamWrite(pWriter, (uint8_t)S.GroupInfo[nGroup].Type);
+	ProfileStreamWriteString(pWriter, S.GroupInfo[nGroup].pName);
+}
+
+static void ProfileStreamWriteTimer(ProfileStreamWriter* pWriter, uint32_t nTimer)
+{
+	Profile & S = g_Profile;
+	ProfileStreamWrite(pWriter, (uint8_t)ProfileStreamRecordTimer);
+	ProfileStreamWrite(pWriter, nTimer);
+	ProfileStreamWrite(pWriter, (uint32_t)S.TimerInfo[nTimer].nGroupIndex);
+	ProfileStreamWriteString(pWriter, S.TimerInfo[nTimer].pName);
+}
+
+static void ProfileStreamWriteThread(ProfileStreamWriter* pWriter, uint32_t nThread)
+{
+	ProfileThreadLog* pLog = g_Profile.Pool[nThread];
+	ProfileStreamWrite(pWriter, (uint8_t)ProfileStreamRecordThread);
+	ProfileStreamWrite(pWriter, nThread);
+	ProfileStreamWrite(pWriter, (uint8_t)pLog->nGpu);
+	ProfileStreamWrite(pWriter, (uint64_t)(pLog->nGpu ? getGpuProfileTicksPerSecond(pLog->nGpuToken) : 0));
+	ProfileStreamWriteString(pWriter, pLog->ThreadName);
+}
+
+// Full name tables, written at the start of every file so it can be decoded on its own
+static void ProfileStreamWriteHeader(ProfileStreamWriter* pWriter)
+{
+	Profile & S = g_Profile;
+	ProfileStreamWrite(pWriter, "TFPS", 4);
+	ProfileStreamWrite(pWriter, (uint32_t)PROFILE_STREAM_VERSION);
+	ProfileStreamWrite(pWriter, (uint8_t)ProfileStreamRecordHeader);
+	ProfileStreamWrite(pWriter, (int64_t)ProfileTicksPerSecondCpu());
+	ProfileStreamWrite(pWriter, (uint32_t)P_GETCURRENTPROCESSID());
+	for (uint32_t i = 0; i < S.nGroupCount; ++i)
+		ProfileStreamWriteGroup(pWriter, i);
+	for (uint32_t i = 0; i < S.nTotalTimers; ++i)
+		ProfileStreamWriteTimer(pWriter, i);
+	for (uint32_t i = 0; i < PROFILE_MAX_THREADS; ++i)
+	{
+		if (S.Pool[i])
+			ProfileStreamWriteThread(pWriter, i);
+	}
+}
+
+static void ProfileStreamWriteFrame(ProfileStreamWriter* pWriter, const ProfileFrameState* pFrameCurrent, const ProfileFrameState* pFrameNext, uint64_t nFrameIndex)
+{
+	Profile & S = g_Profile;
+	ProfileStream& T = *pWriter->pStream;
+	const bool bCommit = !pWriter->bMeasure;
+
+	// Names registered since the last frame
+	for (uint32_t i = T.nGroupsWritten; i < S.nGroupCount; ++i)
+		ProfileStreamWriteGroup(pWriter, i);
+	for (uint32_t i = T.nTimersWritten; i < S.nTotalTimers; ++i)
+		ProfileStreamWriteTimer(pWriter, i);
+	if (bCommit)
+	{
+		T.nGroupsWritten = S.nGroupCount;
+		T.nTimersWritten = S.nTotalTimers;
+	}
+
+	uint32_t nThreadCount = 0;
+	for (uint32_t i = 0; i < PROFILE_MAX_THREADS; ++i)
+	{
+		ProfileThreadLog* pLog = S.Pool[i];
+		if (!pLog || !pLog->Log || pFrameCurrent->nLogStart[i] == pFrameNext->nLogStart[i])
+			continue;
+
+		++nThreadCount;
+		if (strcmp(T.ThreadNames[i], pLog->ThreadName) != 0)
+		{
+			ProfileStreamWriteThread(pWriter, i);
+			if (bCommit)
+			{
+				strncpy(T.ThreadNames[i], pLog->ThreadName, sizeof(T.ThreadNames[i]) - 1);
+			}
+		}
+	}
+
+	if (T.nDroppedFrames)
+	{
+		ProfileStreamWrite(pWriter, (uint8_t)ProfileStreamRecordDropped);
+		ProfileStreamWrite(pWriter, T.nDroppedFrames);
+		if (bCommit)
+			T.nDroppedFrames = 0;
+	}
+
+	ProfileStreamWrite(pWriter, (uint8_t)ProfileStreamRecordFrame);
+	ProfileStreamWrite(pWriter, nFrameIndex);
+	ProfileStreamWrite(pWriter, (int64_t)pFrameCurrent->nFrameStartCpu);
+	ProfileStreamWrite(pWriter, (int64_t)pFrameNext->nFrameStartCpu);
+	ProfileStreamWrite(pWriter, nThreadCount);
+
+	for (uint32_t i = 0; i < PROFILE_MAX_THREADS; ++i)
+	{
+		ProfileThreadLog* pLog = S.Pool[i];
+		if (!pLog || !pLog->Log || pFrameCurrent->nLogStart[i] == pFrameNext->nLogStart[i])
+			continue;
+
+		uint32_t nRange[2][2] = { {0, 0}, {0, 0}, };
+		ProfileGetRange(pFrameNext->nLogStart[i], pFrameCurrent->nLogStart[i], nRange);
+
+		ProfileStreamWrite(pWriter, i);
+		ProfileStreamWrite(pWriter, (int64_t)pFrameCurrent->nFrameStartGpu[i]);
+		ProfileStreamWrite(pWriter, (nRange[0][1] - nRange[0][0]) + (nRange[1][1] - nRange[1][0]));
+		for (uint32_t j = 0; j < 2; ++j)
+		{
+			ProfileStreamWrite(pWriter, &pLog->Log[nRange[j][0]], (nRange[j][1] - nRange[j][0]) * sizeof(ProfileLogEntry));
+		}
+
+		// Label strings live in a ring of their own and are gone after a while, store them after the entries
+		for (uint32_t j = 0; j < 2; ++j)
+		{
+			for (uint32_t k = nRange[j][0]; k < nRange[j][1]; ++k)
+			{
+				uint64_t nType = ProfileLogType(pLog->Log[k]);
+				if (P_LOG_LABEL == nType || P_LOG_LABEL_LITERAL == nType)
+				{
+					const char* pLabel = ProfileGetLabel((uint32_t)nType, ProfileLogGetTick(pLog->Log[k]));
+					ProfileStreamWriteString(pWriter, pLabel ? pLabel : "");
+				}
+			}
+		}
+	}
+}
+
+static void ProfileStreamWriteChunk(FileStream* pFile, const ProfileStreamChunk* pChunk, uint32_t nOffset)
+{
+	fsWriteToStream(pFile, &pChunk->Data[nOffset], pChunk->nSize - nOffset);
+}
+
+static void ProfileStreamSaveHistory(ProfileStream& T)
+{
+	// Called with the stream mutex held. The selected chunks are pinned while they are written without the lock.
+	eastl::vector<ProfileStreamChunk*> Chunks;
+	for (ProfileStreamChunk* pChunk : T.History)
+	{
+		if (Chunks.empty() && (pChunk->nLastFrameTick < T.nSaveFromTick || pChunk->nFirstFrameOffset == PROFILE_STREAM_INVALID_OFFSET))
+			continue;
+		pChunk->nPinned++;
+		Chunks.push_back(pChunk);
 	}
 
-	uint32_t* nGroupCounterSort = (uint32_t*)tf_calloc(S.nGroupCount, sizeof(uint32_t));
-	uint32_t* nTimerCounterSort = (uint32_t*)tf_calloc(S.nTotalTimers, sizeof(uint32_t));
-	for (uint32_t i = 0; i < S.nGroupCount; ++i)
+	eastl::vector<uint8_t> Header;
+	Header.swap(T.SaveHeader);
+	char FileName[256];
+	strcpy(FileName, T.SaveFileName);
+	T.bSaveRequested = false;
+
+	T.StreamMutex.Release();
+	FileStream fh = {};
+	if (fsOpenStreamFromPath(RD_LOG, FileName, FM_WRITE_BINARY, &fh))
 	{
-		nGroupCounterSort[i] = i;
+		fsWriteToStream(&fh, Header.data(), Header.size());
+		for (uint32_t i = 0; i < (uint32_t)Chunks.size(); ++i)
+		{
+			ProfileStreamWriteChunk(&fh, Chunks[i], i == 0 ? Chunks[i]->nFirstFrameOffset : 0);
+		}
+		fsCloseStream(&fh);
 	}
-	for (uint32_t i = 0; i < S.nTotalTimers; ++i)
+	T.StreamMutex.Acquire();
+
+	for (ProfileStreamChunk* pChunk : Chunks)
 	{
-		nTimerCounterSort[i] = i;
+		pChunk->nPinned--;
 	}
-	eastl::sort(nGroupCounterSort, nGroupCounterSort + S.nGroupCount,
-		[nGroupCounter](const uint32_t l, const uint32_t r)
+}
+
+static void ProfileStreamWriterThread(void* pData)
+{
+	ProfileStream& T = *(ProfileStream*)pData;
+	T.StreamMutex.Acquire();
+	for (;;)
 	{
-		return nGroupCounter[l] > nGroupCounter[r];
+		while (!T.Pending.empty())
+		{
+			ProfileStreamChunk* pChunk = T.Pending.front();
+			T.Pending.erase(T.Pending.begin());
+			pChunk->nPinned++;
+			T.StreamMutex.Release();
+			ProfileStreamWriteChunk(&T.File, pChunk, 0);
+			T.StreamMutex.Acquire();
+			pChunk->nPinned--;
+			T.History.push_back(pChunk);
+		}
+
+		if (T.bSaveRequested)
+		{
+			ProfileStreamSaveHistory(T);
+			continue;
+		}
+
+		if (T.bStop)
+			break;
+
+		T.StreamCond.Wait(T.StreamMutex);
 	}
-	);
+	T.StreamMutex.Release();
+}
 
-	eastl::sort(nTimerCounterSort, nTimerCounterSort + S.nTotalTimers,
-		[nTimerCounter](const uint32_t l, const uint32_t r)
+// Called from ProfileFlipCpu with the profile mutex held, once the log range of a frame is final
+void ProfileStreamFrame(const ProfileFrameState* pFrameCurrent, const ProfileFrameState* pFrameNext, uint64_t nFrameIndex)
+{
+	ProfileStream& T = g_ProfileStream;
+	if (!T.bActive)
+		return;
+
+	PROFILER_SET_CPU_SCOPE("Profile", "Stream", 0x3355ee);
+	MutexLock lock(T.StreamMutex);
+
+	ProfileStreamWriter Writer = {};
+	Writer.pStream = &T;
+	Writer.nFrameTick = pFrameNext->nFrameStartCpu;
+	Writer.bMeasure = true;
+	ProfileStreamWriteFrame(&Writer, pFrameCurrent, pFrameNext, nFrameIndex);
+
+	uint64_t nAvailable = (T.pCurrent ? PROFILE_STREAM_CHUNK_SIZE - T.pCurrent->nSize : 0) +
+		(uint64_t)(T.Free.size() + (T.nMaxChunks - T.nAllocatedChunks) + ProfileStreamRecyclableChunks(T)) * PROFILE_STREAM_CHUNK_SIZE;
+	if (Writer.nSize > nAvailable)
 	{
-		return nTimerCounter[l] > nTimerCounter[r];
+		T.nDroppedFrames++;
+		T.nTotalDroppedFrames++;
+		return;
 	}
-	);
 
-	ProfilePrintf(CB, Handle, "\n<!--\nMarker Per Group\n");
-	for (uint32_t i = 0; i < S.nGroupCount; ++i)
+	// Make sure the frame offset is recorded in the chunk the frame actually starts in
+	if (!T.pCurrent || T.pCurrent->nSize == PROFILE_STREAM_CHUNK_SIZE)
+		ProfileStreamNextChunk(T);
+	if (T.pCurrent->nFirstFrameOffset == PROFILE_STREAM_INVALID_OFFSET)
+		T.pCurrent->nFirstFrameOffset = T.pCurrent->nSize;
+
+	Writer.nSize = 0;
+	Writer.bMeasure = false;
+	ProfileStreamWriteFrame(&Writer, pFrameCurrent, pFrameNext, nFrameIndex);
+}
+
+void ProfileStreamStop()
+{
+	MutexLock lock(ProfileMutex());
+	ProfileStream& T = g_ProfileStream;
+	if (!T.bActive)
+		return;
+
+	T.StreamMutex.Acquire();
+	ProfileStreamReleaseCurrent(T);
+	T.bStop = true;
+	T.StreamCond.WakeAll();
+	T.StreamMutex.Release();
+	join_thread(T.WriterThread);
+
+	if (T.bFileOpen)
+		fsCloseStream(&T.File);
+
+	P_ASSERT(T.Pending.empty());
+	for (ProfileStreamChunk* pChunk : T.Free)
+		tf_free(pChunk);
+	for (ProfileStreamChunk* pChunk : T.History)
+		tf_free(pChunk);
+	T.Free.set_capacity(0);
+	T.History.set_capacity(0);
+	T.Pending.set_capacity(0);
+	T.SaveHeader.set_capacity(0);
+
+	T.StreamMutex.Destroy();
+	T.StreamCond.Destroy();
+	T.bInitialized = false;
+	T.bActive = false;
+}
+
+void ProfileStreamStart(const char* pFileName, uint32_t nMemoryBudget)
+{
+	MutexLock lock(ProfileMutex());
+	ProfileStreamStop();
+
+	Profile & S = g_Profile;
+	ProfileStream& T = g_ProfileStream;
+	if (!T.bInitialized)
 	{
-		uint32_t idx = nGroupCounterSort[i];
-		ProfilePrintf(CB, Handle, "%8d:%s\n", nGroupCounter[idx], S.GroupInfo[idx].pName);
+		T.StreamMutex.Init();
+		T.StreamCond.Init();
+		T.bInitialized = true;
 	}
-	ProfilePrintf(CB, Handle, "Marker Per Timer\n");
-	for (uint32_t i = 0; i < S.nTotalTimers; ++i)
+
+	T.bStop = false;
+	T.bFileOpen = false;
+	T.bSaveRequested = false;
+	T.nMaxChunks = ProfileMax(nMemoryBudget / (uint32_t)sizeof(ProfileStreamChunk), (uint32_t)PROFILE_STREAM_MIN_CHUNKS);
+	T.nAllocatedChunks = 0;
+	T.pCurrent = NULL;
+	T.nDroppedFrames = 0;
+	T.nTotalDroppedFrames = 0;
+	T.nGroupsWritten = S.nGroupCount;
+	T.nTimersWritten = S.nTotalTimers;
+	memset(T.ThreadNames, 0, sizeof(T.ThreadNames));
+
+	if (pFileName)
 	{
-		uint32_t idx = nTimerCounterSort[i];
-		ProfilePrintf(CB, Handle, "%8d:%s(%s)\n", nTimerCounter[idx], S.TimerInfo[idx].pName, S.GroupInfo[S.TimerInfo[idx].nGroupIndex].pName);
+		T.File = {};
+		T.bFileOpen = fsOpenStreamFromPath(RD_LOG, pFileName, FM_WRITE_BINARY, &T.File);
+		if (T.bFileOpen)
+		{
+			eastl::vector<uint8_t> Header;
+			ProfileStreamWriter Writer = {};
+			Writer.pStream = &T;
+			Writer.pBuffer = &Header;
+			ProfileStreamWriteHeader(&Writer);
+			fsWriteToStream(&T.File, Header.data(), Header.size());
+			for (uint32_t i = 0; i < PROFILE_MAX_THREADS; ++i)
+			{
+				if (S.Pool[i])
+					strncpy(T.ThreadNames[i], S.Pool[i]->ThreadName, sizeof(T.ThreadNames[i]) - 1);
+			}
+		}
 	}
-	ProfilePrintf(CB, Handle, "\n-->\n");
 
-	S.nActiveGroup = nActiveGroup;
-	S.nRunning = nRunning;
+	T.WriterDesc.pFunc = ProfileStreamWriterThread;
+	T.WriterDesc.pData = &T;
+	T.WriterThread = create_thread(&T.WriterDesc);
+	T.bActive = true;
+}
 
-    tf_free(nTimerCounterSort);
-    tf_free(nGroupCounterSort);
-    tf_free(nGroupCounter);
-    tf_free(nTimerCounter);
-    tf_free(pTimers);
+void ProfileStreamSave(float fSeconds, const char* pFileName)
+{
+	MutexLock lock(ProfileMutex());
+	ProfileStream& T = g_ProfileStream;
+	if (!T.bActive)
+		return;
 
-#if PROFILE_DEBUG
-	int64_t nTicksEnd = P_TICK();
-	float fMs = fToMsCpu * (nTicksEnd - S.nPauseTicks);
-	printf("html dump took %6.2fms\n", fMs);
-#endif
+	eastl::vector<uint8_t> Header;
+	ProfileStreamWriter Writer = {};
+	Writer.pStream = &T;
+	Writer.pBuffer = &Header;
+	ProfileStreamWriteHeader(&Writer);
+
+	MutexLock streamLock(T.StreamMutex);
+	if (T.bSaveRequested)
+		return;
+
+	// The frames still in the current chunk are part of the request
+	ProfileStreamReleaseCurrent(T);
+	T.nSaveFromTick = P_TICK() - (int64_t)(fSeconds * ProfileTicksPerSecondCpu());
+	strncpy(T.SaveFileName, pFileName, sizeof(T.SaveFileName) - 1);
+	T.SaveFileName[sizeof(T.SaveFileName) - 1] = '\0';
+	T.SaveHeader.swap(Header);
+	T.bSaveRequested = true;
+	T.StreamCond.WakeAll();
 }
-#else
-void ProfileDumpHtml(ProfileWriteCallback CB, void* Handle, int nMaxFrames, const char* pHost)
+
+uint32_t ProfileStreamDroppedFrames()
 {
-	ProfilePrintString(CB, Handle, "HTML output is disabled because PROFILE_EMBED_HTML is 0\n");
+	MutexLock lock(ProfileMutex());
+	return g_ProfileStream.nTotalDroppedFrames;
 }
-#endif
 
-void ProfileWriteFile(void* Handle, size_t nSize, const char* pData)
+static void ProfileStreamFileName(char* pName, size_t nSize, const char* appName, const char* pSuffix)
 {
-	fsWriteToStream((FileStream*)Handle, pData, nSize);
+	time_t t = time(0);
+	char tempName[128];
+	snprintf(tempName, sizeof(tempName), "%s%s", appName, pSuffix);
+	strftime(pName, nSize, tempName, localtime(&t));
 }
 
-void ProfileDumpToFile(Renderer* pRenderer)
+void startProfileCapture(const char* appName, uint32_t nMemoryBudgetMB, bool bStreamToDisk)
 {
-    MutexLock lock(ProfileMutex());
-	Profile & S = g_Profile;
-	
-	FileStream fh = {};
-	if (fsOpenStreamFromPath(RD_LOG, S.DumpFile, FM_WRITE, &fh))
-	{
-		if (S.eDumpType == ProfileDumpTypeHtml)
-			ProfileDumpHtml(ProfileWriteFile, &fh, S.nDumpFrames, 0, pRenderer);
-		else if (S.eDumpType == ProfileDumpTypeCsv)
-			ProfileDumpCsv(ProfileWriteFile, &fh, S.nDumpFrames);
+	char name[128] = {};
+	ProfileStreamFileName(name, sizeof(name), appName, R"(Capture-%Y-%m-%d-%H.%M.%S.tfprof)");
+	ProfileStreamStart(bStreamToDisk ? name : NULL, nMemoryBudgetMB << 20);
+}
 
-        fsCloseStream(&fh);
+void stopProfileCapture()
+{
+	ProfileStreamStop();
+}
+
+void saveProfileCapture(float fSeconds, const char* appName)
+{
+	char name[128] = {};
+	ProfileStreamFileName(name, sizeof(name), appName, R"(Capture-Last-%Y-%m-%d-%H.%M.%S.tfprof)");
+	ProfileStreamSave(fSeconds, name);
+}
+
+void setProfileHwCounters(const char* pGroup, bool bEnable)
+{
+	ProfileSetHwCounterGroup(pGroup, bEnable);
+}
+
+void setProfileAllocCounters(const char* pGroup, bool bEnable)
+{
+	ProfileSetAllocCounterGroup(pGroup, bEnable);
+}
+
+void setProfileContextSwitchTrace(bool bEnable)
+{
+	MutexLock lock(ProfileMutex());
+	if (bEnable)
+		ProfileContextSwitchTraceStart();
+	else
+		ProfileContextSwitchTraceStop();
+}
+
+ProfileToken getProfileCounterToken(const char* pName, bool bBytes)
+{
+	ProfileToken nToken = ProfileGetCounterToken(pName);
+	if (bBytes)
+	{
+		g_Profile.CounterInfo[nToken].eFormat = PROFILE_COUNTER_FORMAT_BYTES;
 	}
+	return nToken;
 }
 
-void dumpProfileData(Renderer* pRenderer, const char* appName, uint32_t nMaxFrames)
+void setProfileCounter(ProfileToken nToken, int64_t nValue)
 {
-    MutexLock lock(ProfileMutex());
-    // Dump frames to file.
-    time_t t = time(0);
+	if (PROFILE_INVALID_TOKEN != nToken)
+	{
+		ProfileCounterSet(nToken, nValue);
+	}
+}
 
-	char tempName[128];
-	sprintf(tempName, "%s", appName);
-	strcat(tempName, R"(Profile-%Y-%m-%d-%H.%M.%S.html)");
+void addProfileCounter(ProfileToken nToken, int64_t nValue)
+{
+	if (PROFILE_INVALID_TOKEN != nToken)
+	{
+		ProfileCounterAdd(nToken, nValue);
+	}
+}
 
-    char name[128] = {};
-    strftime(name, sizeof(name), tempName, localtime(&t));
-	FileStream fh = {};
-    if (fsOpenStreamFromPath(RD_LOG, name, FM_WRITE, &fh))
-    {
-        ProfileDumpHtml(ProfileWriteFile, &fh, nMaxFrames, 0, pRenderer);
-        fsCloseStream(&fh);
-    }
+// Distribution of a timer over the aggregated frames. Hitches are frames slower than nHitchTicks,
+// or twice the median when no threshold is given.
+static void ProfileAppendBenchmarkStats(eastl::string& output, const ProfileHistogram* pHistogram, float fToMs, uint64_t nHitchTicks)
+{
+	static const ProfileHistogram EmptyHistogram = {};
+	const ProfileHistogram& H = pHistogram ? *pHistogram : EmptyHistogram;
+	double fMean = H.nCount ? H.fSum / H.nCount : 0.0;
+	double fVariance = H.nCount ? ProfileMax(H.fSumSquares / H.nCount - fMean * fMean, 0.0) : 0.0;
+	uint64_t nMedian = ProfileHistogramPercentile(&H, 50.0f);
+	if (!nHitchTicks)
+		nHitchTicks = 2 * nMedian;
+
+	output.append_sprintf("\"P50\": %0.4f, \n", fToMs * nMedian);
+	output.append_sprintf("\"P90\": %0.4f, \n", fToMs * ProfileHistogramPercentile(&H, 90.0f));
+	output.append_sprintf("\"P99\": %0.4f, \n", fToMs * ProfileHistogramPercentile(&H, 99.0f));
+	output.append_sprintf("\"P99.9\": %0.4f, \n", fToMs * ProfileHistogramPercentile(&H, 99.9f));
+	output.append_sprintf("\"StdDev\": %0.4f, \n", fToMs * sqrt(fVariance));
+	output.append_sprintf("\"Variance\": %0.6f, \n", fToMs * fToMs * fVariance);
+	output.append_sprintf("\"HitchThreshold\": %0.4f, \n", fToMs * nHitchTicks);
+	output.append_sprintf("\"Hitches\": %u, \n", ProfileHistogramCountAbove(&H, nHitchTicks));
 }
 
-void dumpBenchmarkData(Renderer* pRenderer, IApp::Settings* pSettings, const char* appName)
+void dumpBenchmarkData(Renderer* pRenderer, IApp::Settings* pSettings, const char* appName, float fHitchThresholdMs)
 {
+    MutexLock lock(ProfileMutex());
     time_t t = time(0);
     eastl::string tempName = eastl::string().sprintf("%s", appName) + eastl::string(R"(Benchmark-%Y-%m-%d-%H.%M.%S.txt)");
     char name[128] = {};
@@ -2603,6 +4199,7 @@ void dumpBenchmarkData(Renderer* pRenderer, IApp::Settings* pSettings, const cha
 		output.append_sprintf("\"ModelID\": \"%s\", \n\n", pRenderer->pActiveGpuSettings->mGpuVendorPreset.mModelId);
 
         const Profile& S = *ProfileGet();
+        uint32_t nAggregateFrames = S.nAggregateFrames ? S.nAggregateFrames : 1;
         for (uint32_t groupIndex = 0; groupIndex < S.nGroupCount; ++groupIndex)
         {
             if (S.GroupInfo[groupIndex].Type != ProfileTokenTypeGpu)
@@ -2615,7 +4212,6 @@ void dumpBenchmarkData(Renderer* pRenderer, IApp::Settings* pSettings, const cha
 					output.append_sprintf("\"%s\": { \n", S.GroupInfo[groupIndex].pName);
 
                     float fToMs = ProfileTickToMsMultiplier(getGpuProfileTicksPerSecond(S.GroupInfo[groupIndex].nGpuProfileToken));
-                    uint32_t nAggregateFrames = S.nAggregateFrames ? S.nAggregateFrames : 1;
                     uint32_t nAggregateCount = S.Aggregate[timerIndex].nCount ? S.Aggregate[timerIndex].nCount : 1;
                     float fAverage = fToMs * (S.Aggregate[timerIndex].nTicks / nAggregateFrames);
                     float fMax = fToMs * (S.AggregateMax[timerIndex]);
@@ -2624,6 +4220,7 @@ void dumpBenchmarkData(Renderer* pRenderer, IApp::Settings* pSettings, const cha
 					output.append_sprintf("\"Average\": %0.4f, \n", fAverage);
 					output.append_sprintf("\"Min\": %0.4f, \n", fMin);
 					output.append_sprintf("\"Max\": %0.4f, \n", fMax);
+					ProfileAppendBenchmarkStats(output, S.pAggregateHistogram[timerIndex], fToMs, 0);
 					output.append_sprintf("\"Frames\": %d \n", nAggregateCount);
 					output.append_sprintf("}, \n\n");
                     break;
@@ -2631,10 +4228,54 @@ void dumpBenchmarkData(Renderer* pRenderer, IApp::Settings* pSettings, const cha
             }
         }
 
+		// Every timer that ran during the aggregated frames, cpu and gpu
+		output.append_sprintf("\"Timers\": { \n");
+		bool bFirstTimer = true;
+		for (uint32_t timerIndex = 0; timerIndex < S.nTotalTimers; ++timerIndex)
+		{
+			if (!S.pAggregateHistogram[timerIndex] || !S.pAggregateHistogram[timerIndex]->nCount)
+				continue;
+			const ProfileHistogram& H = *S.pAggregateHistogram[timerIndex];
+
+			const ProfileGroupInfo& Group = S.GroupInfo[S.TimerInfo[timerIndex].nGroupIndex];
+			bool bGpu = Group.Type == ProfileTokenTypeGpu;
+			float fToMs = ProfileTickToMsMultiplier(bGpu ? getGpuProfileTicksPerSecond(Group.nGpuProfileToken) : ProfileTicksPerSecondCpu());
+
+			output.append_sprintf("%s\"%s/%s\": { \n", bFirstTimer ? "" : ", \n", Group.pName, S.TimerInfo[timerIndex].pName);
+			output.append_sprintf("\"Type\": \"%s\", \n", bGpu ? "Gpu" : "Cpu");
+			output.append_sprintf("\"Average\": %0.4f, \n", fToMs * (S.Aggregate[timerIndex].nTicks / nAggregateFrames));
+			output.append_sprintf("\"Min\": %0.4f, \n", fToMs * H.nMin);
+			output.append_sprintf("\"Max\": %0.4f, \n", fToMs * H.nMax);
+			ProfileAppendBenchmarkStats(output, &H, fToMs, 0);
+			uint64_t nCounters[ProfileHwCounterCount];
+			if (!bGpu && ProfileGetHwCounters(timerIndex, nCounters))
+			{
+				double fCalls = (double)(S.Aggregate[timerIndex].nCount ? S.Aggregate[timerIndex].nCount : 1);
+				double fIpc = nCounters[ProfileHwCounterCycles] ? (double)nCounters[ProfileHwCounterInstructions] / nCounters[ProfileHwCounterCycles] : 0.0;
+				output.append_sprintf("\"IPC\": %0.4f, \n", fIpc);
+				output.append_sprintf("\"CacheMissesPerCall\": %0.2f, \n", nCounters[ProfileHwCounterCacheMisses] / fCalls);
+				output.append_sprintf("\"BranchMissesPerCall\": %0.2f, \n", nCounters[ProfileHwCounterBranchMisses] / fCalls);
+			}
+			uint64_t nAllocCounters[ProfileAllocCounterCount];
+			if (!bGpu && ProfileGetAllocCounters(timerIndex, nAllocCounters))
+			{
+				output.append_sprintf("\"AllocsPerFrame\": %0.2f, \n", (double)nAllocCounters[ProfileAllocCounterAllocs] / nAggregateFrames);
+				output.append_sprintf("\"AllocBytesPerFrame\": %0.1f, \n", (double)nAllocCounters[ProfileAllocCounterBytes] / nAggregateFrames);
+				output.append_sprintf("\"FreesPerFrame\": %0.2f, \n", (double)nAllocCounters[ProfileAllocCounterFrees] / nAggregateFrames);
+			}
+			output.append_sprintf("\"Frames\": %u \n", H.nCount);
+			output.append_sprintf("}");
+			bFirstTimer = false;
+		}
+		output.append_sprintf("\n}, \n\n");
+
+		float fCpuToMs = ProfileTickToMsMultiplier(ProfileTicksPerSecondCpu());
+		uint64_t nHitchTicks = fHitchThresholdMs > 0.0f ? ProfileMsToTick(fHitchThresholdMs, ProfileTicksPerSecondCpu()) : 0;
 		output.append_sprintf("\"Cpu\": { \n");
         output.append_sprintf("\"Average\": %0.4f, \n", getCpuAvgFrameTime());
         output.append_sprintf("\"Min\": %0.4f, \n", getCpuMinFrameTime());
         output.append_sprintf("\"Max\": %0.4f, \n", getCpuMaxFrameTime());
+		ProfileAppendBenchmarkStats(output, S.pAggregateHistogram[PROFILE_MAX_TIMERS], fCpuToMs, nHitchTicks);
         output.append_sprintf("\"Frames\": %d \n", S.nAggregateFrames);
         output.append_sprintf("} \n");
         output.append_sprintf("}");
@@ -3118,7 +4759,7 @@ uint32_t ProfileContextSwitchGatherThreads(uint32_t nContextSwitchStart, uint32_
 		if (!S.Pool[i])
 			continue;
 		Threads[nNumThreads].nProcessId = nCurrentProcessId;
-		Threads[nNumThreads].nThreadId = S.Pool[i]->nThreadId;
+		Threads[nNumThreads].nThreadId = S.Pool[i]->nContextSwitchThreadId;
 		nNumThreads++;
 	}
 
@@ -3274,6 +4915,321 @@ void ProfileTraceThread(void*)
 		S.bContextSwitchRunning = false;
 	}
 }
+#elif defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+
+#define PROFILE_CONTEXT_SWITCH_MAX_CPUS 128 // ProfileContextSwitch::nCpu is 8 bits
+#define PROFILE_CONTEXT_SWITCH_BATCH 4096
+#define PROFILE_PERF_SWITCH_RING_PAGES 64
+
+const char* ProfileGetProcessName(ProfileProcessIdType nId, char* Buffer, uint32_t nSize)
+{
+	char Path[64];
+	snprintf(Path, sizeof(Path), "/proc/%u/comm", nId);
+	int fd = open(Path, O_RDONLY);
+	if (fd < 0)
+		return nullptr;
+
+	ssize_t nRead = read(fd, Buffer, nSize - 1);
+	close(fd);
+	if (nRead <= 0)
+		return nullptr;
+
+	Buffer[nRead] = '\0';
+	if (char* pNewLine = strchr(Buffer, '\n'))
+		*pNewLine = '\0';
+	return Buffer;
+}
+
+// Switches are read per cpu, sort them so a thread migrating between cpus switches out before it switches in again
+static void ProfileContextSwitchPutBatch(ProfileContextSwitch* pSwitches, uint32_t nCount)
+{
+	eastl::sort(pSwitches, pSwitches + nCount, [](const ProfileContextSwitch& l, const ProfileContextSwitch& r) { return l.nTicks < r.nTicks; });
+	for (uint32_t i = 0; i < nCount; ++i)
+		ProfileContextSwitchPut(&pSwitches[i]);
+}
+
+// PERF_RECORD_SWITCH_CPU_WIDE followed by the sample_id of PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_CPU
+struct ProfilePerfSwitchRecord
+{
+	perf_event_header Header;
+	uint32_t nNextPrevPid;
+	uint32_t nNextPrevTid;
+	uint32_t nPid;
+	uint32_t nTid;
+	uint64_t nTime;
+	uint32_t nCpu;
+	uint32_t nReserved;
+};
+
+static void ProfilePerfRingRead(const uint8_t* pData, uint64_t nDataSize, uint64_t nOffset, void* pDst, uint64_t nSize)
+{
+	uint64_t nStart = nOffset % nDataSize;
+	uint64_t nFirst = ProfileMin(nSize, nDataSize - nStart);
+	memcpy(pDst, pData + nStart, nFirst);
+	memcpy((uint8_t*)pDst + nFirst, pData, nSize - nFirst);
+}
+
+// Records the switches of every cpu with one dummy software event per cpu. Returns false if perf_event is not permitted.
+static bool ProfileTracePerf(ProfileContextSwitch* pBatch)
+{
+#ifdef PERF_RECORD_MISC_SWITCH_OUT // Linux 4.3 headers, the first with context switch records
+	Profile & S = g_Profile;
+	const uint32_t nCpus = (uint32_t)ProfileMin(sysconf(_SC_NPROCESSORS_CONF), (long)PROFILE_CONTEXT_SWITCH_MAX_CPUS);
+	const uint64_t nPageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+	const uint64_t nDataSize = PROFILE_PERF_SWITCH_RING_PAGES * nPageSize;
+
+	perf_event_attr Attr;
+	memset(&Attr, 0, sizeof(Attr));
+	Attr.size = sizeof(Attr);
+	Attr.type = PERF_TYPE_SOFTWARE;
+	Attr.config = PERF_COUNT_SW_DUMMY;
+	Attr.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_CPU;
+	Attr.sample_id_all = 1;
+	Attr.context_switch = 1;
+	Attr.use_clockid = 1;
+	Attr.clockid = CLOCK_MONOTONIC;
+	Attr.watermark = 1;
+	Attr.wakeup_watermark = (uint32_t)(nDataSize / 4);
+
+	pollfd Polls[PROFILE_CONTEXT_SWITCH_MAX_CPUS];
+	uint8_t* pRings[PROFILE_CONTEXT_SWITCH_MAX_CPUS];
+	uint32_t nRings = 0;
+	bool bFailed = false;
+	for (uint32_t nCpu = 0; nCpu < nCpus && !bFailed; ++nCpu)
+	{
+		int fd = (int)syscall(SYS_perf_event_open, &Attr, -1, (int)nCpu, -1, PERF_FLAG_FD_CLOEXEC);
+		if (fd < 0)
+		{
+			// Offline cpus are skipped, anything else means we are not allowed to trace
+			bFailed = errno != ENODEV;
+			continue;
+		}
+		void* pRing = mmap(NULL, nPageSize + nDataSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (MAP_FAILED == pRing)
+		{
+			close(fd);
+			bFailed = true;
+			continue;
+		}
+		Polls[nRings].fd = fd;
+		Polls[nRings].events = POLLIN;
+		pRings[nRings++] = (uint8_t*)pRing;
+	}
+
+	if (!bFailed && nRings)
+	{
+		S.bContextSwitchRunning = true;
+		while (!S.bContextSwitchStop)
+		{
+			poll(Polls, nRings, 100);
+
+			uint32_t nCount = 0;
+			for (uint32_t i = 0; i < nRings; ++i)
+			{
+				perf_event_mmap_page* pHeader = (perf_event_mmap_page*)pRings[i];
+				const uint8_t* pData = pRings[i] + nPageSize;
+				uint64_t nHead = __atomic_load_n(&pHeader->data_head, __ATOMIC_ACQUIRE);
+				uint64_t nTail = pHeader->data_tail;
+				while (nTail < nHead)
+				{
+					ProfilePerfSwitchRecord Record;
+					ProfilePerfRingRead(pData, nDataSize, nTail, &Record.Header, sizeof(Record.Header));
+					// Only switch outs, the matching switch in on the same cpu carries the same pair of threads
+					if (PERF_RECORD_SWITCH_CPU_WIDE == Record.Header.type && (Record.Header.misc & PERF_RECORD_MISC_SWITCH_OUT) && Record.Header.size >= sizeof(Record))
+					{
+						ProfilePerfRingRead(pData, nDataSize, nTail, &Record, sizeof(Record));
+						if (nCount == PROFILE_CONTEXT_SWITCH_BATCH)
+						{
+							ProfileContextSwitchPutBatch(pBatch, nCount);
+							nCount = 0;
+						}
+						ProfileContextSwitch& Switch = pBatch[nCount++];
+						Switch.nThreadOut = Record.nTid;
+						Switch.nThreadIn = Record.nNextPrevTid;
+						Switch.nProcessIn = Record.nNextPrevPid;
+						Switch.nCpu = Record.nCpu;
+						Switch.nTicks = (int64_t)Record.nTime;
+					}
+					nTail += ProfileMax(Record.Header.size, (uint16_t)sizeof(perf_event_header));
+				}
+				__atomic_store_n(&pHeader->data_tail, nTail, __ATOMIC_RELEASE);
+			}
+			ProfileContextSwitchPutBatch(pBatch, nCount);
+		}
+		S.bContextSwitchRunning = false;
+	}
+
+	for (uint32_t i = 0; i < nRings; ++i)
+	{
+		munmap(pRings[i], nPageSize + nDataSize);
+		close(Polls[i].fd);
+	}
+	return !bFailed && nRings;
+#else
+	(void)pBatch;
+	return false;
+#endif
+}
+
+static bool ProfileTraceFsWrite(const char* pInstance, const char* pFile, const char* pValue)
+{
+	char Path[256];
+	snprintf(Path, sizeof(Path), "%s/%s", pInstance, pFile);
+	int fd = open(Path, O_WRONLY | O_TRUNC | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+	bool bWritten = write(fd, pValue, strlen(pValue)) == (ssize_t)strlen(pValue);
+	close(fd);
+	return bWritten;
+}
+
+// ftrace only reports the thread id of the switched in thread, look its process up once
+static ProfileProcessIdType ProfileTraceProcessId(uint32_t nThreadId)
+{
+	static uint32_t ProcessCache[1024][2];
+	if (!nThreadId)
+		return 0;
+
+	uint32_t* pEntry = ProcessCache[nThreadId % 1024];
+	if (pEntry[0] == nThreadId)
+		return pEntry[1];
+
+	// Threads that exited before the lookup are reported as their own process
+	uint32_t nProcessId = nThreadId;
+	char Path[64];
+	char StatusText[1024];
+	snprintf(Path, sizeof(Path), "/proc/%u/status", nThreadId);
+	int fd = open(Path, O_RDONLY | O_CLOEXEC);
+	if (fd >= 0)
+	{
+		ssize_t nRead = read(fd, StatusText, sizeof(StatusText) - 1);
+		close(fd);
+		StatusText[nRead > 0 ? nRead : 0] = '\0';
+		if (const char* pTgid = strstr(StatusText, "Tgid:"))
+			nProcessId = (uint32_t)strtoul(pTgid + 5, NULL, 10);
+	}
+	pEntry[0] = nThreadId;
+	pEntry[1] = nProcessId;
+	return nProcessId;
+}
+
+// Parses "<comm>-<tid> [<cpu>] <flags> <sec>.<usec>: sched_switch: prev_comm=.. prev_pid=.. .. ==> next_comm=.. next_pid=.."
+static bool ProfileTraceParseSwitch(const char* pLine, ProfileContextSwitch* pSwitch)
+{
+	const char* pEvent = strstr(pLine, ": sched_switch: ");
+	const char* pCpu = strchr(pLine, '[');
+	if (!pEvent || !pCpu || pCpu > pEvent)
+		return false;
+	const char* pPrev = strstr(pEvent, " prev_pid=");
+	const char* pNext = strstr(pEvent, " next_pid=");
+	if (!pPrev || !pNext)
+		return false;
+
+	const char* pTime = pEvent;
+	while (pTime > pCpu && pTime[-1] != ' ')
+		--pTime;
+	char* pEnd = NULL;
+	uint64_t nSeconds = strtoull(pTime, &pEnd, 10);
+	if ('.' != *pEnd)
+		return false;
+	uint64_t nFraction = 0;
+	uint32_t nDigits = 0;
+	for (const char* p = pEnd + 1; *p >= '0' && *p <= '9' && nDigits < 9; ++p, ++nDigits)
+		nFraction = nFraction * 10 + (*p - '0');
+	for (; nDigits < 9; ++nDigits)
+		nFraction *= 10;
+
+	uint32_t nThreadIn = (uint32_t)strtoul(pNext + 10, NULL, 10);
+	pSwitch->nThreadOut = (ThreadID)strtoul(pPrev + 10, NULL, 10);
+	pSwitch->nThreadIn = nThreadIn;
+	pSwitch->nProcessIn = ProfileTraceProcessId(nThreadIn);
+	pSwitch->nCpu = strtol(pCpu + 1, NULL, 10);
+	pSwitch->nTicks = (int64_t)(nSeconds * 1000000000ull + nFraction);
+	return true;
+}
+
+// Records sched_switch in a private ftrace instance, so the global trace settings are left alone
+static bool ProfileTraceFtrace(ProfileContextSwitch* pBatch)
+{
+	Profile & S = g_Profile;
+	const char* pTraceFs = 0 == access("/sys/kernel/tracing/instances", W_OK) ? "/sys/kernel/tracing" : "/sys/kernel/debug/tracing";
+	char Instance[128];
+	snprintf(Instance, sizeof(Instance), "%s/instances/theforge-%d", pTraceFs, (int)getpid());
+	if (0 != mkdir(Instance, 0700) && EEXIST != errno)
+		return false;
+
+	char Path[192];
+	snprintf(Path, sizeof(Path), "%s/trace_pipe", Instance);
+	int fd = -1;
+	if (ProfileTraceFsWrite(Instance, "trace_clock", "mono") && ProfileTraceFsWrite(Instance, "events/sched/sched_switch/enable", "1") &&
+		ProfileTraceFsWrite(Instance, "tracing_on", "1"))
+	{
+		fd = open(Path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	}
+
+	if (fd >= 0)
+	{
+		S.bContextSwitchRunning = true;
+		char Buffer[16 * 1024];
+		uint32_t nBuffered = 0;
+		while (!S.bContextSwitchStop)
+		{
+			pollfd Poll = { fd, POLLIN, 0 };
+			poll(&Poll, 1, 100);
+
+			uint32_t nCount = 0;
+			ssize_t nRead;
+			while ((nRead = read(fd, Buffer + nBuffered, sizeof(Buffer) - 1 - nBuffered)) > 0)
+			{
+				nBuffered += (uint32_t)nRead;
+				Buffer[nBuffered] = '\0';
+
+				char* pLine = Buffer;
+				while (char* pNewLine = strchr(pLine, '\n'))
+				{
+					*pNewLine = '\0';
+					if (nCount == PROFILE_CONTEXT_SWITCH_BATCH)
+					{
+						ProfileContextSwitchPutBatch(pBatch, nCount);
+						nCount = 0;
+					}
+					if (ProfileTraceParseSwitch(pLine, &pBatch[nCount]))
+						++nCount;
+					pLine = pNewLine + 1;
+				}
+
+				// Keep the partial line, drop it if it fills the whole buffer
+				nBuffered = (uint32_t)(Buffer + nBuffered - pLine);
+				if (nBuffered == sizeof(Buffer) - 1)
+					nBuffered = 0;
+				memmove(Buffer, pLine, nBuffered);
+			}
+			ProfileContextSwitchPutBatch(pBatch, nCount);
+		}
+		S.bContextSwitchRunning = false;
+		close(fd);
+	}
+
+	ProfileTraceFsWrite(Instance, "events/sched/sched_switch/enable", "0");
+	rmdir(Instance);
+	return fd >= 0;
+}
+
+void ProfileTraceThread(void*)
+{
+	ProfileContextSwitch* pBatch = (ProfileContextSwitch*)tf_malloc(PROFILE_CONTEXT_SWITCH_BATCH * sizeof(ProfileContextSwitch));
+	if (!ProfileTracePerf(pBatch) && !ProfileTraceFtrace(pBatch))
+	{
+		LOGF(LogLevel::eINFO, "Profiler: context switch trace unavailable, needs perf_event_paranoid <= 0 or write access to tracefs");
+	}
+	tf_free(pBatch);
+}
 #endif
 #else
 void ProfileContextSwitchTraceStart()
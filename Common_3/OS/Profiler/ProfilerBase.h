@@ -116,10 +116,19 @@
 #define ProfileGetForceMetaCounters() 0
 #define ProfileEnableMetaCounter(c) do{} while(0)
 #define ProfileDisableMetaCounter(c) do{} while(0)
+#define ProfileSetHwCounterGroup(g,e) do{} while(0)
+#define ProfileGetHwCounters(t,c) false
+#define ProfileSetAllocCounterGroup(g,e) do{} while(0)
+#define ProfileGetAllocCounters(t,c) false
 #define ProfileContextSwitchTraceStart() do{} while(0)
 #define ProfileContextSwitchTraceStop() do{} while(0)
 #define ProfileDumpFile(path,type,frames) do{} while(0)
 #define ProfileDumpHtml(cb,handle,frames,host) do{} while(0)
+#define ProfileDumpTrace(cb,handle,frames,type) do{} while(0)
+#define ProfileStreamStart(file,budget) do{} while(0)
+#define ProfileStreamStop() do{} while(0)
+#define ProfileStreamSave(seconds,file) do{} while(0)
+#define ProfileStreamDroppedFrames() 0
 #define ProfileWebServerStart() do{} while(0)
 #define ProfileWebServerStop() do{} while(0)
 #define ProfileWebServerPort() 0
@@ -186,7 +195,12 @@ inline int64_t ProfileTicksPerSecondCpu()
 inline int64_t ProfileGetTick()
 {
 	timespec ts;
+#if defined(__linux__)
+	// Same clock as the perf_event and ftrace context switch records, and small enough for ProfileContextSwitch::nTicks
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
 	clock_gettime(CLOCK_REALTIME, &ts);
+#endif
 	return 1000000000ll * ts.tv_sec + ts.tv_nsec;
 }
 #define strcpy_s(pDest, size, pSrc) strncpy(pDest,pSrc, size)
@@ -268,8 +282,9 @@ typedef uint16_t ProfileGroupId;
 #define PROFILE_PRINTF printf
 #endif
 
+// The hardware and allocation counters take 7 of the meta counter slots when enabled
 #ifndef PROFILE_META_MAX
-#define PROFILE_META_MAX 8
+#define PROFILE_META_MAX 16
 #endif
 
 #ifndef PROFILE_WEBSERVER_PORT
@@ -332,7 +347,26 @@ enum ProfileTokenType
 enum ProfileDumpType
 {
 	ProfileDumpTypeHtml,
-	ProfileDumpTypeCsv
+	ProfileDumpTypeCsv,
+	ProfileDumpTypeChromeTrace,
+	ProfileDumpTypePerfetto
+};
+
+enum ProfileHwCounter
+{
+	ProfileHwCounterCycles,
+	ProfileHwCounterInstructions,
+	ProfileHwCounterCacheMisses,
+	ProfileHwCounterBranchMisses,
+	ProfileHwCounterCount
+};
+
+enum ProfileAllocCounter
+{
+	ProfileAllocCounterBytes,
+	ProfileAllocCounterAllocs,
+	ProfileAllocCounterFrees,
+	ProfileAllocCounterCount
 };
 
 #ifdef __GNUC__
@@ -378,6 +412,14 @@ PROFILE_API void ProfileSetForceMetaCounters(bool bEnable);
 PROFILE_API bool ProfileGetForceMetaCounters();
 PROFILE_API void ProfileEnableMetaCounter(const char* pMet);
 PROFILE_API void ProfileDisableMetaCounter(const char* pMet);
+// Samples the hardware counters at enter/leave of the cpu scopes in pGroup (all groups when null). The counts show
+// up as the "Cycles", "Instructions", "Cache Misses" and "Branch Misses" meta counters of each timer.
+PROFILE_API void ProfileSetHwCounterGroup(const char* pGroup, bool bEnable);
+PROFILE_API bool ProfileGetHwCounters(uint32_t nTimerIndex, uint64_t nCounters[ProfileHwCounterCount]);
+// Counts the tf_malloc/tf_free calls made inside the cpu scopes in pGroup (all groups when null). The counts include the
+// child scopes and show up as the "Alloc Bytes", "Allocs" and "Frees" meta counters of each timer.
+PROFILE_API void ProfileSetAllocCounterGroup(const char* pGroup, bool bEnable);
+PROFILE_API bool ProfileGetAllocCounters(uint32_t nTimerIndex, uint64_t nCounters[ProfileAllocCounterCount]);
 PROFILE_API int ProfileGetAggregateFrames();
 PROFILE_API int ProfileGetCurrentAggregateFrames();
 PROFILE_API Profile* ProfileGet();
@@ -404,6 +446,14 @@ PROFILE_API void ProfileDumpFile(const char* pPath, ProfileDumpType eType, uint3
 
 typedef void ProfileWriteCallback(void* Handle, size_t size, const char* pData);
 PROFILE_API void ProfileDumpHtml(ProfileWriteCallback CB, void* Handle, int nMaxFrames, const char* pHost, Renderer* pRenderer);
+PROFILE_API void ProfileDumpTrace(ProfileWriteCallback CB, void* Handle, int nMaxFrames, ProfileDumpType eType);
+
+// Continuous capture. Streams every frame to pFileName (or only keeps a history when null) using at most nMemoryBudget bytes
+PROFILE_API void ProfileStreamStart(const char* pFileName, uint32_t nMemoryBudget);
+PROFILE_API void ProfileStreamStop();
+// Writes the frames of the last fSeconds still held in the capture history to pFileName
+PROFILE_API void ProfileStreamSave(float fSeconds, const char* pFileName);
+PROFILE_API uint32_t ProfileStreamDroppedFrames();
 
 PROFILE_API int ProfileFormatCounter(int eFormat, int64_t nCounter, char* pOut, uint32_t nBufferSize);
 
@@ -475,19 +525,33 @@ struct ProfileScopeHandlerCpu
 #define PROFILE_DEFAULT_PRESET "Default"
 #endif
 
-// We disable context switch trace because it's unable to open the file needed, and because
-// no documentation was found on how to use this
+// We disable context switch trace on Windows and macOS because it's unable to open the file needed, and because
+// no documentation was found on how to use this.
+// On Linux the scheduler switches are read from perf_event (needs perf_event_paranoid <= 0 or CAP_PERFMON),
+// with a fallback to the sched_switch ftrace event (needs write access to tracefs).
 #ifndef PROFILE_CONTEXT_SWITCH_TRACE
 #if defined(_WINDOWS) || defined(XBOX)
 #define PROFILE_CONTEXT_SWITCH_TRACE 0
 #elif defined(__APPLE__) && !TARGET_OS_IPHONE
 #define PROFILE_CONTEXT_SWITCH_TRACE 0
+#elif defined(__linux__) && !defined(__ANDROID__)
+#define PROFILE_CONTEXT_SWITCH_TRACE 1
 #else
 #define PROFILE_CONTEXT_SWITCH_TRACE 0
 #endif
 #endif
 
 
+// Hardware performance counters per cpu scope, read through perf_event_open. Only the scopes of the groups
+// enabled with ProfileSetHwCounterGroup pay for reading the counters.
+#ifndef PROFILE_HW_COUNTERS
+#if defined(__linux__) && !defined(__ANDROID__)
+#define PROFILE_HW_COUNTERS 1
+#else
+#define PROFILE_HW_COUNTERS 0
+#endif
+#endif
+
 #if PROFILE_CONTEXT_SWITCH_TRACE
 #define PROFILE_CONTEXT_SWITCH_BUFFER_SIZE (128*1024) //2mb with 16 byte entry size
 #else
@@ -565,6 +629,20 @@ struct ProfileTimer
 	uint32_t nCount;
 };
 
+// Log-linear histogram of per frame ticks. Values below 2^PROFILE_HISTOGRAM_SUB_BUCKET_BITS are exact,
+// above that every power of two is split into 2^PROFILE_HISTOGRAM_SUB_BUCKET_BITS buckets (~3% wide).
+#define PROFILE_HISTOGRAM_SUB_BUCKET_BITS 5
+#define PROFILE_HISTOGRAM_BUCKETS 1152
+struct ProfileHistogram
+{
+	uint32_t nBuckets[PROFILE_HISTOGRAM_BUCKETS];
+	uint32_t nCount;
+	uint64_t nMin;
+	uint64_t nMax;
+	double fSum;
+	double fSumSquares;
+};
+
 struct ProfileCategory
 {
 	char pName[PROFILE_NAME_MAX_LEN];
@@ -647,6 +725,7 @@ struct ProfileThreadLog
 
 	uint32_t 				nGpu;
 	ThreadID 				nThreadId;
+	ThreadID				nContextSwitchThreadId; // Id of the thread in the context switch records, the kernel tid on Linux
 	uint32_t 				nLogIndex;
     ProfileToken            nGpuToken;
 
@@ -662,6 +741,20 @@ struct ProfileThreadLog
 		THREAD_MAX_LEN = 64,
 	};
 	char					ThreadName[64];
+
+#if PROFILE_HW_COUNTERS
+	int						nHwCounterFd[ProfileHwCounterCount]; // The cycles counter leads the group and reads all of them at once
+	uint32_t				nHwCounterState;	// 0 not opened yet, 1 open, 2 unavailable
+	uint8_t					nHwCounterIndex[ProfileHwCounterCount]; // Position in the group read, 0xff if the counter is missing
+	uint32_t				nHwCounterStackPos;
+	ProfileToken			HwCounterStackToken[PROFILE_STACK_MAX];
+	uint64_t				HwCounterStack[PROFILE_STACK_MAX][ProfileHwCounterCount];
+#endif
+
+	uint64_t				nAllocCounters[ProfileAllocCounterCount]; // Running totals of this thread, updated by the tf_malloc/tf_free hooks
+	uint32_t				nAllocStackPos;
+	ProfileToken			AllocStackToken[PROFILE_STACK_MAX];
+	uint64_t				AllocStack[PROFILE_STACK_MAX][ProfileAllocCounterCount];
 };
 
 
@@ -739,6 +832,15 @@ struct Profile
 	uint64_t				AggregateExclusive[PROFILE_MAX_TIMERS];
 	uint64_t				AggregateMaxExclusive[PROFILE_MAX_TIMERS];
 
+	uint64_t				nHwCounterGroupMask;
+	ProfileToken			HwCounterMeta[ProfileHwCounterCount];
+	uint64_t				nAllocCounterGroupMask;
+	ProfileToken			AllocCounterMeta[ProfileAllocCounterCount];
+
+	// Per frame distribution of every timer, allocated on first use. The entry at PROFILE_MAX_TIMERS is the cpu frame time
+	ProfileHistogram*		pAccumHistogram[PROFILE_MAX_TIMERS + 1];
+	ProfileHistogram*		pAggregateHistogram[PROFILE_MAX_TIMERS + 1];
+
 
 	uint64_t 				FrameGroup[PROFILE_MAX_GROUPS];
 	uint64_t 				AccumGroup[PROFILE_MAX_GROUPS];
@@ -906,6 +1008,10 @@ inline float ProfileTickToMsMultiplier(int64_t nTicksPerSecond)
 	return 1000.f / nTicksPerSecond;
 }
 
+void ProfileHistogramAdd(uint32_t nTimerIndex, uint64_t nTicks);
+uint64_t ProfileHistogramPercentile(const ProfileHistogram* pHistogram, float fPercentile);
+uint32_t ProfileHistogramCountAbove(const ProfileHistogram* pHistogram, uint64_t nTicks);
+
 inline uint16_t ProfileGetGroupIndex(ProfileToken t)
 {
 	return (uint16_t)ProfileGet()->TimerToGroup[ProfileGetTimerIndex(t)];
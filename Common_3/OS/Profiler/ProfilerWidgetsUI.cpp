@@ -916,9 +916,18 @@ void profileDrawPlotMode(Profile& S)
 }
 
 // Timer mode functions.
+// Time columns of the timer table, followed by the allocation counters and the hardware counters when available.
+#define PROFILE_TIMER_TIME_COLUMNS 9
+#define PROFILE_TIMER_ALLOC_COLUMNS (PROFILE_TIMER_TIME_COLUMNS + 2)
+#if PROFILE_HW_COUNTERS
+#define PROFILE_TIMER_DATA_COLUMNS (PROFILE_TIMER_ALLOC_COLUMNS + 3)
+#else
+#define PROFILE_TIMER_DATA_COLUMNS PROFILE_TIMER_ALLOC_COLUMNS
+#endif
+
 void profileDrawTimerMode(Profile& S)
 {
-	const char* headerNames[10] =
+	const char* headerNames[PROFILE_TIMER_DATA_COLUMNS + 1] =
 	{
 		"Group/Timer",
 		"Time",
@@ -929,13 +938,20 @@ void profileDrawTimerMode(Profile& S)
 		"Call Count",
 		"Exclusive Time",
 		"Exclusive Average",
-		"Exclusive Max Time"
+		"Exclusive Max Time",
+		"Allocs/Frame",
+		"Alloc KB/Frame",
+#if PROFILE_HW_COUNTERS
+		"IPC",
+		"Cache Miss/Call",
+		"Branch Miss/Call",
+#endif
 	};
 
 	// Create the table header.
 	eastl::vector<IWidget*> header;
 
-	for (uint32_t i = 0; i < 10; ++i)
+	for (uint32_t i = 0; i < PROFILE_TIMER_DATA_COLUMNS + 1; ++i)
 	{
 		IWidget* pLabel = (IWidget*)tf_calloc(1, sizeof(IWidget));
 		pLabel->mType = WIDGET_TYPE_COLOR_LABEL;
@@ -982,8 +998,8 @@ void profileDrawTimerMode(Profile& S)
 				eastl::vector<char*> timeRowData;
 				eastl::vector<float4*> timeColorData;
 
-				// There are 9 time categories in the header above.
-				for (uint32_t i = 0; i < 9; ++i)
+				// One dynamic text per data category in the header above.
+				for (uint32_t i = 0; i < PROFILE_TIMER_DATA_COLUMNS; ++i)
 				{
 					char* timeResult = (char*)tf_calloc(MAX_TIME_STR_LEN, sizeof(char));
 					sprintf(timeResult, "-");
@@ -1026,24 +1042,11 @@ void profileResetTimerModeData(uint32_t tableLocation)
 {
 	eastl::vector<char*>& timeCol = gTimerData[tableLocation];
 	eastl::vector<float4*>& timeColor = gTimerColorData[tableLocation];
-	sprintf(timeCol[0], "-");
-	sprintf(timeCol[1], "-");
-	sprintf(timeCol[2], "-");
-	sprintf(timeCol[3], "-");
-	sprintf(timeCol[4], "-");
-	sprintf(timeCol[5], "-");
-	sprintf(timeCol[6], "-");
-	sprintf(timeCol[7], "-");
-	sprintf(timeCol[8], "-");
-	*timeColor[0] = gNormalColor;
-	*timeColor[1] = gNormalColor;
-	*timeColor[2] = gNormalColor;
-	*timeColor[3] = gNormalColor;
-	*timeColor[4] = gNormalColor;
-	*timeColor[5] = gNormalColor;
-	*timeColor[6] = gNormalColor;
-	*timeColor[7] = gNormalColor;
-	*timeColor[8] = gNormalColor;
+	for (uint32_t i = 0; i < PROFILE_TIMER_DATA_COLUMNS; ++i)
+	{
+		sprintf(timeCol[i], "-");
+		*timeColor[i] = gNormalColor;
+	}
 }
 
 /// Get data for timer mode functionality.
@@ -1141,6 +1144,37 @@ void profileUpdateTimerModeData(Profile& S, uint32_t groupIndex, uint32_t timerI
 	fFrameMsExclusive > criticalTime ? *timeColor[6] = gCriticalColor : float4(0.0f);
 	fAverageExclusive > criticalTime ? *timeColor[7] = gCriticalColor : float4(0.0f);
 	fMaxExclusive > criticalTime ? *timeColor[8] = gCriticalColor : float4(0.0f);
+
+	// Allocations are only counted for cpu groups enabled with ProfileSetAllocCounterGroup.
+	uint64_t nAllocCounters[ProfileAllocCounterCount];
+	if (!bGpu && ProfileGetAllocCounters(timerIndex, nAllocCounters))
+	{
+		snprintf(timeCol[PROFILE_TIMER_TIME_COLUMNS + 0], MAX_TIME_STR_LEN, "%.1f", (float)nAllocCounters[ProfileAllocCounterAllocs] / nAggregateFrames);
+		snprintf(timeCol[PROFILE_TIMER_TIME_COLUMNS + 1], MAX_TIME_STR_LEN, "%.1f", (float)nAllocCounters[ProfileAllocCounterBytes] / (1024.0f * nAggregateFrames));
+	}
+	else
+	{
+		sprintf(timeCol[PROFILE_TIMER_TIME_COLUMNS + 0], "-");
+		sprintf(timeCol[PROFILE_TIMER_TIME_COLUMNS + 1], "-");
+	}
+
+#if PROFILE_HW_COUNTERS
+	// Hardware counters are only sampled for cpu groups enabled with ProfileSetHwCounterGroup.
+	uint64_t nCounters[ProfileHwCounterCount];
+	if (!bGpu && ProfileGetHwCounters(timerIndex, nCounters))
+	{
+		float fIpc = nCounters[ProfileHwCounterCycles] ? (float)nCounters[ProfileHwCounterInstructions] / nCounters[ProfileHwCounterCycles] : 0.0f;
+		snprintf(timeCol[PROFILE_TIMER_ALLOC_COLUMNS + 0], MAX_TIME_STR_LEN, "%.2f", fIpc);
+		snprintf(timeCol[PROFILE_TIMER_ALLOC_COLUMNS + 1], MAX_TIME_STR_LEN, "%.1f", (float)nCounters[ProfileHwCounterCacheMisses] / nAggregateCount);
+		snprintf(timeCol[PROFILE_TIMER_ALLOC_COLUMNS + 2], MAX_TIME_STR_LEN, "%.1f", (float)nCounters[ProfileHwCounterBranchMisses] / nAggregateCount);
+	}
+	else
+	{
+		sprintf(timeCol[PROFILE_TIMER_ALLOC_COLUMNS + 0], "-");
+		sprintf(timeCol[PROFILE_TIMER_ALLOC_COLUMNS + 1], "-");
+		sprintf(timeCol[PROFILE_TIMER_ALLOC_COLUMNS + 2], "-");
+	}
+#endif
 }
 
 void resetProfilerUI()
@@ -23,6 +23,8 @@
 */
 
 #include <functional>
+#include <io.h>
+#include <fcntl.h>
 
 #if !defined(XBOX)
 #include "shlobj.h"
@@ -166,6 +168,84 @@ time_t fsGetLastModifiedTime(ResourceDirectory resourceDir, const char* fileName
 	return fileInfo.st_mtime;
 }
 
+bool fsRenameFile(ResourceDirectory resourceDir, const char* fileName, const char* newFileName)
+{
+	const char* resourcePath = fsGetResourceDirectory(resourceDir);
+	char filePath[FS_MAX_PATH] = { 0 };
+	char newFilePath[FS_MAX_PATH] = { 0 };
+	fsAppendPathComponent(resourcePath, fileName, filePath);
+	fsAppendPathComponent(resourcePath, newFileName, newFilePath);
+
+	size_t filePathLen = strlen(filePath);
+	wchar_t* pathStr = (wchar_t*)alloca((filePathLen + 1) * sizeof(wchar_t));
+	size_t pathStrLength = MultiByteToWideChar(CP_UTF8, 0, filePath, (int)filePathLen, pathStr, (int)filePathLen);
+	pathStr[pathStrLength] = 0;
+
+	size_t newFilePathLen = strlen(newFilePath);
+	wchar_t* newPathStr = (wchar_t*)alloca((newFilePathLen + 1) * sizeof(wchar_t));
+	size_t newPathStrLength = MultiByteToWideChar(CP_UTF8, 0, newFilePath, (int)newFilePathLen, newPathStr, (int)newFilePathLen);
+	newPathStr[newPathStrLength] = 0;
+
+	// Fails if the destination is mapped or open without FILE_SHARE_DELETE
+	return MoveFileExW(pathStr, newPathStr, MOVEFILE_REPLACE_EXISTING) ? true : false;
+}
+
+bool fsRemoveFile(ResourceDirectory resourceDir, const char* fileName)
+{
+	const char* resourcePath = fsGetResourceDirectory(resourceDir);
+	char filePath[FS_MAX_PATH] = { 0 };
+	fsAppendPathComponent(resourcePath, fileName, filePath);
+	return withUTF16Path<bool>(filePath, [](const wchar_t* pathStr)
+	{
+		return ::DeleteFileW(pathStr) ? true : false;
+	});
+}
+
+bool PlatformMapFile(ResourceDirectory resourceDir, const char* fileName, void** ppData, ssize_t* pSize)
+{
+	const char* resourcePath = fsGetResourceDirectory(resourceDir);
+	char filePath[FS_MAX_PATH] = {};
+	fsAppendPathComponent(resourcePath, fileName, filePath);
+
+	HANDLE file = withUTF16Path<HANDLE>(filePath, [](const wchar_t* pathStr)
+	{
+		return ::CreateFileW(pathStr, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	});
+	if (INVALID_HANDLE_VALUE == file)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size = {};
+	void* pData = NULL;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+	{
+		HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping)
+		{
+			pData = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			// The view keeps the mapping and the file alive
+			CloseHandle(mapping);
+		}
+	}
+	CloseHandle(file);
+
+	if (!pData)
+	{
+		return false;
+	}
+
+	*ppData = pData;
+	*pSize = (ssize_t)size.QuadPart;
+	return true;
+}
+
+void PlatformUnmapFile(void* pData, ssize_t size)
+{
+	UNREF_PARAM(size);
+	UnmapViewOfFile(pData);
+}
+
 bool PlatformOpenFile(ResourceDirectory resourceDir, const char* fileName, FileMode mode, FileStream* pOut)
 {
 	const char* resourcePath = fsGetResourceDirectory(resourceDir);
@@ -185,7 +265,25 @@ bool PlatformOpenFile(ResourceDirectory resourceDir, const char* fileName, FileM
 	mbstowcs(modeWStr, modeStr, 4);
 
 	FILE* fp = NULL;
-	if (mode & FM_ALLOW_READ)
+	if ((mode & FM_APPEND) && !(mode & FM_READ))
+	{
+		// Without FILE_WRITE_DATA every write lands at the current end of the file, the CRT seek to the end is not atomic
+		HANDLE file = ::CreateFileW(
+			pathStr, FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (INVALID_HANDLE_VALUE != file)
+		{
+			int fd = _open_osfhandle((intptr_t)file, (mode & FM_BINARY) ? _O_BINARY : _O_TEXT);
+			if (fd < 0)
+			{
+				CloseHandle(file);
+			}
+			else if (!(fp = _fdopen(fd, modeStr)))
+			{
+				_close(fd);
+			}
+		}
+	}
+	else if (mode & FM_ALLOW_READ)
 	{
 		fp = _wfsopen(pathStr, modeWStr, _SH_DENYWR);
 	}
@@ -196,6 +294,12 @@ bool PlatformOpenFile(ResourceDirectory resourceDir, const char* fileName, FileM
 
 	if (fp)
 	{
+		// Unbuffered, so every binary write is a single WriteFile that appends of other processes can not interleave with
+		if (mode & FM_APPEND)
+		{
+			setvbuf(fp, NULL, _IONBF, 0);
+		}
+
 		*pOut = {};
 		pOut->pFile = fp;
 		pOut->mMode = mode;
@@ -64,8 +64,24 @@ typedef struct BufferLoadDesc
 	BufferDesc  mDesc;
 	/// Force Reset buffer to NULL
 	bool        mForceReset;
+	/// Requests with higher priority are processed first, but never ahead of earlier requests on the same resource
+	uint32_t    mPriority;
 } BufferLoadDesc;
 
+typedef enum TextureLoadFlags
+{
+	TEXTURE_LOAD_FLAG_NONE = 0,
+	/// Only the mip tail is uploaded by the load. Higher mips are streamed in afterwards, see updateTextureStreaming
+	/// The texture is returned through ppStreamedTexture. Only DDS and KTX files stream, other containers load all mips
+	TEXTURE_LOAD_FLAG_STREAM_MIPS = 0x1,
+	/// Loads of the same file, container, creation flags and node return one reference counted texture
+	/// removeResource frees it once the last load is removed. Ignored for streamed and file less loads
+	TEXTURE_LOAD_FLAG_SHARED = 0x2,
+} TextureLoadFlags;
+MAKE_ENUM_FLAG(uint32_t, TextureLoadFlags)
+
+struct StreamedTexture;
+
 typedef struct TextureLoadDesc
 {
 	Texture**            ppTexture;
@@ -79,6 +95,11 @@ typedef struct TextureLoadDesc
 	TextureCreationFlags mCreationFlag;
 	/// The texture file format (dds/ktx/...)
 	TextureContainerType mContainer;
+	/// Requests with higher priority are processed first, but never ahead of earlier requests on the same resource
+	uint32_t             mPriority;
+	TextureLoadFlags     mFlags;
+	/// Output of TEXTURE_LOAD_FLAG_STREAM_MIPS loads. ppTexture is ignored for those
+	StreamedTexture**    ppStreamedTexture;
 } TextureLoadDesc;
 
 typedef struct Geometry
@@ -95,6 +116,32 @@ typedef struct Geometry
 		void*                   pAttributes[MAX_VERTEX_ATTRIBS];
 	};
 
+	struct Meshlet
+	{
+		/// First index of the meshlet in the index buffer. Triangles of a meshlet are contiguous
+		uint32_t                mIndexStart;
+		uint32_t                mTriangleCount;
+		/// Index of the draw in pDrawArgs the meshlet belongs to
+		uint32_t                mDrawIndex;
+		/// Bounding sphere
+		float                   mCenter[3];
+		float                   mRadius;
+		/// Axis aligned bounding box
+		float                   mAabbMin[3];
+		float                   mAabbMax[3];
+		/// Normal cone. The meshlet is backfacing if dot(normalize(mConeApex - cameraPosition), mConeAxis) >= mConeCutoff
+		float                   mConeApex[3];
+		float                   mConeAxis[3];
+		float                   mConeCutoff;
+	};
+
+	struct Dequantization
+	{
+		/// Attribute value = quantized value * mScale + mOffset
+		float                   mScale[4];
+		float                   mOffset[4];
+	};
+
 	/// Index buffer to bind when drawing this geometry
 	Buffer*                     pIndexBuffer;
 	/// The array of vertex buffers to bind when drawing this geometry
@@ -108,6 +155,8 @@ typedef struct Geometry
 	mat4*                       pInverseBindPoses;
 	/// The array of data to remap skin batch local joint ids to global joint ids
 	uint32_t*                   pJointRemaps;
+	/// The array of meshlets if GEOMETRY_LOAD_FLAG_MESHLETS was requested
+	Meshlet*                    pMeshlets;
 	/// The array of vertex buffer strides to bind when drawing this geometry
 	uint32_t                    mVertexStrides[MAX_VERTEX_BINDINGS];
 	/// Hair data
@@ -125,8 +174,11 @@ typedef struct Geometry
 	uint32_t                    mIndexCount;
 	/// Number of vertices in the geometry
 	uint32_t                    mVertexCount;
+	/// Number of meshlets in pMeshlets
+	uint32_t                    mMeshletCount;
 
-	uint32_t                     mPad[3];
+	/// Per semantic dequantization of attributes loaded with a GeometryQuantization mode. Identity for everything else
+	Dequantization              mDequantization[SEMANTIC_TEXCOORD9 + 1];
 } Geometry;
 static_assert(sizeof(Geometry) % 16 == 0, "GLTFContainer size must be a multiple of 16");
 
@@ -136,21 +188,57 @@ typedef enum GeometryLoadFlags
 	GEOMETRY_LOAD_FLAG_SHADOWED = 0x1,
 	/// Use structured buffers instead of raw buffers
 	GEOMETRY_LOAD_FLAG_STRUCTURED_BUFFERS = 0x2,
+	/// Merge vertices whose data is identical in every vertex stream
+	GEOMETRY_LOAD_FLAG_REMOVE_DUPLICATE_VERTICES = 0x4,
+	/// Reorder triangles of each draw for post-transform vertex cache efficiency
+	GEOMETRY_LOAD_FLAG_OPTIMIZE_VERTEX_CACHE = 0x8,
+	/// Reorder triangles of each draw to reduce overdraw. Implies GEOMETRY_LOAD_FLAG_OPTIMIZE_VERTEX_CACHE
+	GEOMETRY_LOAD_FLAG_OPTIMIZE_OVERDRAW = 0x10,
+	/// Reorder vertices of each draw in first use order and drop unreferenced ones to improve vertex fetch locality
+	GEOMETRY_LOAD_FLAG_OPTIMIZE_VERTEX_FETCH = 0x20,
+	/// Run every optimization pass. Results are stored in the geometry cache so the cost is paid once per asset
+	GEOMETRY_LOAD_FLAG_OPTIMIZE = GEOMETRY_LOAD_FLAG_REMOVE_DUPLICATE_VERTICES | GEOMETRY_LOAD_FLAG_OPTIMIZE_VERTEX_CACHE |
+		GEOMETRY_LOAD_FLAG_OPTIMIZE_OVERDRAW | GEOMETRY_LOAD_FLAG_OPTIMIZE_VERTEX_FETCH,
+	/// Split each draw into spatially coherent meshlets of up to 64 vertices and 124 triangles with culling bounds in Geometry::pMeshlets
+	/// Triangles of each draw are reordered so every meshlet is a contiguous index range
+	GEOMETRY_LOAD_FLAG_MESHLETS = 0x40,
+	/// Loads of the same file, flags, vertex layout, quantization and node return one reference counted geometry
+	/// removeResource frees it once the last load is removed
+	GEOMETRY_LOAD_FLAG_SHARED = 0x80,
 } GeometryLoadFlags;
 MAKE_ENUM_FLAG(uint32_t, GeometryLoadFlags)
 
+typedef enum GeometryQuantization
+{
+	GEOMETRY_QUANTIZATION_NONE = 0,
+	/// Each component mapped to [-1, 1] over the geometry bounds. Meant for positions. Vertex format R16G16B16A16_SNORM, w is 1
+	GEOMETRY_QUANTIZATION_SNORM16_BOUNDS,
+	/// Octahedral encoding of unit vectors (normals, tangents). Vertex format R8G8_SNORM or R16G16_SNORM,
+	/// or R16G16B16A16_SNORM which keeps the tangent handedness in w
+	GEOMETRY_QUANTIZATION_OCTAHEDRAL,
+	/// Each component mapped to [0, 1] over the geometry bounds. Meant for texture coordinates. Vertex format R16G16_UNORM
+	GEOMETRY_QUANTIZATION_UNORM16_BOUNDS,
+	/// Components renormalized to sum to one. Meant for joint weights. Vertex format R8G8B8A8_UNORM
+	GEOMETRY_QUANTIZATION_UNORM8_WEIGHTS,
+} GeometryQuantization;
+
 typedef struct GeometryLoadDesc
 {
 	/// Output geometry
-	Geometry**        ppGeometry;
+	Geometry**           ppGeometry;
 	/// Filename of geometry container
-	const char*       pFileName;
+	const char*          pFileName;
 	/// Loading flags
-	GeometryLoadFlags mFlags;
+	GeometryLoadFlags    mFlags;
 	/// Linked gpu node
-	uint32_t          mNodeIndex;
+	uint32_t             mNodeIndex;
 	/// Specifies how to arrange the vertex data loaded from the file into GPU memory
-	VertexLayout*     pVertexLayout;
+	VertexLayout*        pVertexLayout;
+	/// Requests with higher priority are processed first, but never ahead of earlier requests on the same resource
+	uint32_t             mPriority;
+	/// Quantization of each vertex layout attribute, indexed by semantic. The layout format of a quantized attribute must match its mode
+	/// Dequantization parameters are returned in Geometry::mDequantization
+	GeometryQuantization mQuantization[SEMANTIC_TEXCOORD9 + 1];
 } GeometryLoadDesc;
 
 typedef struct VirtualTexturePageInfo
@@ -181,6 +269,7 @@ typedef struct BufferUpdateDesc
 	struct
 	{
 		MappedMemoryRange    mMappedRange;
+		uint32_t             mPriority;
 	} mInternal;
 } BufferUpdateDesc;
 
@@ -263,13 +352,82 @@ typedef struct PipelineCacheSaveDesc
 
 typedef uint64_t SyncToken;
 
+/// Called once the token of a load or update is completed. See addResource
+typedef void (*ResourceLoadCallback)(void* pUserData, SyncToken token);
+
+// Pick the decode thread count from the number of CPU cores
+#define RESOURCE_LOADER_DECODE_THREADS_AUTO UINT32_MAX
+
 typedef struct ResourceLoaderDesc
 {
 	uint64_t mBufferSize;
 	uint32_t mBufferCount;
 	bool     mSingleThreaded;
+	/// Worker threads reading and decoding texture / geometry files ahead of the streamer thread
+	/// 0 does all decoding on the streamer thread. Ignored if mSingleThreaded is set
+	uint32_t mDecodeThreadCount;
+	/// Streamed textures initially load the mips whose width and height are at most this size. 0 picks the default
+	uint32_t mStreamingMipTailSize;
+	/// Memory streamed textures may use in bytes. Lower priority textures are evicted to their mip tail to stay below it
+	/// 0 is unlimited
+	uint64_t mStreamingBudget;
+	/// Keep the stage timings of every texture / geometry load for saveResourceLoadReport
+	bool     mRecordLoadReport;
 } ResourceLoaderDesc;
 
+/// Texture loaded with TEXTURE_LOAD_FLAG_STREAM_MIPS
+/// The resident mips are always the smallest mips of the file. pTexture only contains those, so its mip 0 is the
+/// mip mMipLevels - mResidentMipLevels of the file. Sampling it is the same as sampling the full texture with a clamped min LOD
+typedef struct StreamedTexture
+{
+	/// Texture holding the resident mips. Replaced by updateTextureStreaming whenever mips are streamed in or evicted
+	Texture*             pTexture;
+	/// Mip count of the texture file
+	uint32_t             mMipLevels;
+	/// Mips currently in pTexture
+	uint32_t             mResidentMipLevels;
+	/// Mips uploaded by the initial load. Streaming never evicts below them
+	uint32_t             mTailMipLevels;
+	/// Incremented every time pTexture is replaced. Descriptor sets referencing pTexture have to be updated when it changes
+	uint32_t             mVersion;
+	/// Mips streaming should reach, clamped to [mTailMipLevels, mMipLevels]. Lowering it evicts mips. Defaults to all mips
+	uint32_t             mRequestedMipLevels;
+	/// Higher priority textures stream first and may evict lower priority ones when over the streaming budget
+	uint32_t             mPriority;
+
+	/// Loader state, do not modify
+	TextureDesc          mDesc;
+	char*                pFileName;
+	TextureContainerType mContainer;
+	TextureCreationFlags mCreationFlag;
+	uint32_t             mNodeIndex;
+	/// Texture with mPendingMipLevels mips being uploaded under mPendingToken
+	Texture*             pPendingTexture;
+	uint32_t             mPendingMipLevels;
+	SyncToken            mPendingToken;
+	tfrg_atomic32_t      mState;
+} StreamedTexture;
+
+typedef struct ResourceLoaderStreamingStats
+{
+	uint32_t mTextureCount;
+	/// Streamed textures with mips being streamed in or evicted
+	uint32_t mPendingCount;
+	/// Memory of the resident mips, including pending uploads
+	uint64_t mResidentSize;
+	uint64_t mBudget;
+} ResourceLoaderStreamingStats;
+
+typedef struct ResourceLoadBatchDesc
+{
+	BufferLoadDesc*   pBufferLoads;
+	uint32_t          mBufferLoadCount;
+	TextureLoadDesc*  pTextureLoads;
+	uint32_t          mTextureLoadCount;
+	GeometryLoadDesc* pGeometryLoads;
+	uint32_t          mGeometryLoadCount;
+} ResourceLoadBatchDesc;
+
 extern ResourceLoaderDesc gDefaultResourceLoaderDesc;
 
 // MARK: - Resource Loader Functions
@@ -286,20 +444,32 @@ void exitResourceLoaderInterface(Renderer* pRenderer);
 
 /// If token is NULL, the resource will be available when allResourceLoadsCompleted() returns true.
 /// If token is non NULL, the resource will be available after isTokenCompleted(token) returns true.
-void addResource(BufferLoadDesc* pBufferDesc, SyncToken* token);
-void addResource(TextureLoadDesc* pTextureDesc, SyncToken* token);
-void addResource(GeometryLoadDesc* pGeomDesc, SyncToken* token);
+/// If pCallback is non NULL, it is called with pUserData and the token of the call once the resource is available.
+/// The callback runs on the resource loader thread (or inside the calling thread if nothing had to be queued or
+/// the resource loader is single threaded), so it should be short and must not wait for other tokens.
+/// Cancelled loads invoke the callback as well. Callbacks still pending in exitResourceLoaderInterface are dropped.
+void addResource(BufferLoadDesc* pBufferDesc, SyncToken* token, ResourceLoadCallback pCallback = NULL, void* pUserData = NULL);
+void addResource(TextureLoadDesc* pTextureDesc, SyncToken* token, ResourceLoadCallback pCallback = NULL, void* pUserData = NULL);
+void addResource(GeometryLoadDesc* pGeomDesc, SyncToken* token, ResourceLoadCallback pCallback = NULL, void* pUserData = NULL);
+
+/// Loads all resources of the batch under one token. The requests are submitted together once the whole batch is known,
+/// reordered for file locality and upload size. mPriority of the individual descs still applies.
+void addResources(ResourceLoadBatchDesc* pBatchDesc, SyncToken* token, ResourceLoadCallback pCallback = NULL, void* pUserData = NULL);
 
 void beginUpdateResource(BufferUpdateDesc* pBufferDesc);
 void beginUpdateResource(TextureUpdateDesc* pTextureDesc);
-void endUpdateResource(BufferUpdateDesc* pBuffer, SyncToken* token);
-void endUpdateResource(TextureUpdateDesc* pTexture, SyncToken* token);
+void endUpdateResource(BufferUpdateDesc* pBuffer, SyncToken* token, ResourceLoadCallback pCallback = NULL, void* pUserData = NULL);
+void endUpdateResource(TextureUpdateDesc* pTexture, SyncToken* token, ResourceLoadCallback pCallback = NULL, void* pUserData = NULL);
 
 // MARK: removeResource
 
+/// Textures / geometry loaded with TEXTURE_LOAD_FLAG_SHARED / GEOMETRY_LOAD_FLAG_SHARED are only freed by the last
+/// removeResource call matching one of their loads
 void removeResource(Buffer* pBuffer);
 void removeResource(Texture* pTexture);
 void removeResource(Geometry* pGeom);
+/// The load of the streamed texture has to be completed. Streaming requests still in flight are cancelled or waited on
+void removeResource(StreamedTexture* pStreamedTexture);
 
 // MARK: Waiting for Loads
 
@@ -322,13 +492,100 @@ SyncToken getLastTokenCompleted();
 bool isTokenCompleted(const SyncToken* token);
 void waitForToken(const SyncToken* token);
 
+/// Requests of equal priority are processed in submission order.
+/// Requests on the same buffer / texture always keep their submission order: a request is not moved ahead of an
+/// earlier pending request on the same resource, whatever its priority.
+/// The streamer stops taking requests once the staging buffer of the current set is full,
+/// so higher priority requests submitted later can overtake the rest.
+/// token is the value written by the addResource call of the request.
+/// Returns false if the request was already picked up by the streamer.
+bool setResourceLoadPriority(const SyncToken* token, uint32_t priority);
+/// Cancels a texture / geometry file load which the streamer has not started yet.
+/// The output resource stays NULL and the token is signaled like a completed load.
+/// Loads sharing one resource (TEXTURE_LOAD_FLAG_SHARED / GEOMETRY_LOAD_FLAG_SHARED) share its token. Cancelling
+/// one of them drops a single reference and the load carries on until every sharer cancelled. Outputs of cancelled
+/// sharers may still receive the resource then and must not be passed to removeResource.
+bool cancelResourceLoad(const SyncToken* token);
+
+typedef struct ResourceLoaderStagingStats
+{
+	/// Size of the staging ring shared by all copy sets
+	uint64_t mRingSize;
+	/// Ring memory the GPU may still be reading from
+	uint64_t mRingUsed;
+	uint64_t mRingPeakUsed;
+	/// Total bytes staged through the ring
+	uint64_t mStagedBytes;
+	/// Uploads larger than the ring which needed a temporary buffer
+	uint64_t mTempBufferBytes;
+	uint64_t mTempBufferCount;
+	/// Times the streamer waited on a copy fence because the ring was full, and the total time spent waiting
+	uint64_t mStallCount;
+	uint64_t mStallTimeUs;
+} ResourceLoaderStagingStats;
+
+/// Staging counters of the resource loader since initResourceLoaderInterface.
+void getResourceLoaderStagingStats(ResourceLoaderStagingStats* pOutStats);
+
+typedef enum ResourceLoadStage
+{
+	/// Submitted until the streamer thread picks the request up
+	RESOURCE_LOAD_STAGE_QUEUE_WAIT = 0,
+	/// Opening and reading the file, on a decode thread or the streamer thread
+	RESOURCE_LOAD_STAGE_FILE_READ,
+	/// CPU work on the file data, i.e. transcoding or packing vertices
+	RESOURCE_LOAD_STAGE_DECODE,
+	/// Resource creation and copying into staging memory on the streamer thread
+	RESOURCE_LOAD_STAGE_STAGING_COPY,
+	/// Copy commands submitted until their fence was seen completed
+	RESOURCE_LOAD_STAGE_GPU_COMPLETION,
+	RESOURCE_LOAD_STAGE_COUNT,
+} ResourceLoadStage;
+
+typedef struct ResourceLoaderThroughputStats
+{
+	/// Requests whose copy commands completed on the GPU
+	uint64_t mCompletedRequests;
+	/// Summed time of the completed requests per stage and the slowest request per stage
+	uint64_t mStageTimeUs[RESOURCE_LOAD_STAGE_COUNT];
+	uint64_t mMaxStageTimeUs[RESOURCE_LOAD_STAGE_COUNT];
+	/// Bytes uploaded by the completed requests, and over the last second
+	uint64_t mUploadedBytes;
+	uint64_t mBytesPerSecond;
+	/// Requests submitted but not picked up by the streamer thread yet
+	uint32_t mQueueDepth;
+	uint32_t mPeakQueueDepth;
+} ResourceLoaderThroughputStats;
+
+/// Per stage timings of the resource loader since initResourceLoaderInterface.
+/// The counters are published to the profiler under "ResourceLoader" as well, staging counters included.
+void getResourceLoaderThroughputStats(ResourceLoaderThroughputStats* pOutStats);
+
+/// Writes the stage timings of every texture / geometry load recorded so far to pFileName in RD_LOG, slowest first.
+/// Needs ResourceLoaderDesc::mRecordLoadReport. A ".json" extension writes JSON, everything else CSV.
+bool saveResourceLoadReport(const char* pFileName);
+
+/// Swaps in streamed textures whose pending mips finished uploading and queues the next mips in priority order,
+/// evicting lower priority textures when over the streaming budget. Call once per frame from the thread rendering.
+/// Replaced textures are released a few calls later since the GPU may still be reading them.
+/// Returns the number of streamed textures whose pTexture changed.
+uint32_t updateTextureStreaming();
+
+/// Residency of all streamed textures. Per texture residency is StreamedTexture::mResidentMipLevels
+void getTextureStreamingStats(ResourceLoaderStreamingStats* pOutStats);
+
 /// Return the semaphore for the last copy operation of a specific GPU.
 /// Could be NULL if no operations have been executed.
 Semaphore* getLastSemaphoreCompleted(uint32_t nodeIndex);
 
-/// Either loads the cached shader bytecode or compiles the shader to create new bytecode depending on whether source is newer than binary
+/// Either loads the cached shader bytecode or compiles the shader to create new bytecode if the cache has none for its sources and macros
 void addShader(Renderer* pRenderer, const ShaderLoadDesc* pDesc, Shader** pShader);
 
+/// Same as addShader for every element of pDescs. Stages missing from the shader cache compile concurrently on the
+/// resource loader decode threads, stages shared by several descs compile once. Shaders are created on the calling
+/// thread in array order. GLES and console renderers compile serially
+void addShaders(Renderer* pRenderer, uint32_t shaderCount, const ShaderLoadDesc* pDescs, Shader** ppShaders);
+
 /// Save/Load pipeline cache from disk
 void loadPipelineCache(Renderer* pRenderer, const PipelineCacheLoadDesc* pDesc, PipelineCache** ppPipelineCache);
 void savePipelineCache(Renderer* pRenderer, PipelineCache* pPipelineCache, PipelineCacheSaveDesc* pDesc);
@@ -30,15 +30,26 @@
 #define TINYKTX_IMPLEMENTATION
 #include "../ThirdParty/OpenSource/tinyktx/tinyktx.h"
 
+#define TINYDDS_IMPLEMENTATION
+#include "../ThirdParty/OpenSource/tinydds/tinydds.h"
+
 #include "../ThirdParty/OpenSource/basis_universal/transcoder/basisu_transcoder.h"
 
 #define CGLTF_IMPLEMENTATION
 #include "../ThirdParty/OpenSource/cgltf/cgltf.h"
 
+#include "../ThirdParty/OpenSource/meshoptimizer/src/meshoptimizer.h"
+
+#include "../ThirdParty/OpenSource/EASTL/sort.h"
+#include "../ThirdParty/OpenSource/EASTL/heap.h"
+#include "../ThirdParty/OpenSource/EASTL/string.h"
+#include "../ThirdParty/OpenSource/EASTL/hash_map.h"
+
 #include "IRenderer.h"
 #include "IResourceLoader.h"
 #include "../OS/Interfaces/ILog.h"
 #include "../OS/Interfaces/IThread.h"
+#include "../OS/Interfaces/IProfiler.h"
 
 #if defined(__ANDROID__) && defined(VULKAN)
 #include <shaderc/shaderc.h>
@@ -49,11 +60,30 @@
 #endif
 
 #include "../OS/Core/TextureContainers.h"
+#include "../OS/Core/VertexPacking.h"
 
 #include "../OS/Interfaces/IMemory.h"
 
-#ifdef NX64
 #include "../ThirdParty/OpenSource/murmurhash3/MurmurHash3_32.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_MALLOC tf_malloc
+#define STBI_REALLOC tf_realloc
+#define STBI_FREE tf_free
+#define STBI_ASSERT ASSERT
+#define STBI_NO_STDIO
+#define STBI_ONLY_PNG
+#define STBI_ONLY_JPEG
+#define STBI_ONLY_HDR
+#include "../ThirdParty/OpenSource/Nothings/stb_image.h"
+#include "../ThirdParty/OpenSource/TinyEXR/tinyexr.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define MIP_FILTER_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#define MIP_FILTER_NEON
+#include <arm_neon.h>
 #endif
 
 struct SubresourceDataDesc
@@ -101,8 +131,12 @@ extern RendererApi gSelectedRendererApi;
 #endif
 
 #define MAX_FRAMES 3U
+#define MAX_DECODE_THREADS 8U
+#define REQUEST_NODE_CHUNK_SIZE 256U
+#define MAX_REQUEST_NODE_CHUNKS 4096U
+#define DEFAULT_STREAMING_MIP_TAIL_SIZE 128U
 
-ResourceLoaderDesc gDefaultResourceLoaderDesc = { 8ull << 20, 2 };
+ResourceLoaderDesc gDefaultResourceLoaderDesc = { 8ull << 20, 2, false, RESOURCE_LOADER_DECODE_THREADS_AUTO, DEFAULT_STREAMING_MIP_TAIL_SIZE, 0, false };
 /************************************************************************/
 // Surface Utils
 /************************************************************************/
@@ -221,93 +255,14 @@ static inline constexpr TinyImageFormat util_cgltf_type_to_image_format(cgltf_ty
 	}
 }
 
-#define F16_EXPONENT_BITS 0x1F
-#define F16_EXPONENT_SHIFT 10
-#define F16_EXPONENT_BIAS 15
-#define F16_MANTISSA_BITS 0x3ff
-#define F16_MANTISSA_SHIFT (23 - F16_EXPONENT_SHIFT)
-#define F16_MAX_EXPONENT (F16_EXPONENT_BITS << F16_EXPONENT_SHIFT)
-
-static inline uint16_t util_float_to_half(float val)
-{
-	uint32_t           f32 = (*(uint32_t*)&val);
-	uint16_t           f16 = 0;
-	/* Decode IEEE 754 little-endian 32-bit floating-point value */
-	int sign = (f32 >> 16) & 0x8000;
-	/* Map exponent to the range [-127,128] */
-	int exponent = ((f32 >> 23) & 0xff) - 127;
-	int mantissa = f32 & 0x007fffff;
-	if (exponent == 128)
-	{ /* Infinity or NaN */
-		f16 = (uint16_t)(sign | F16_MAX_EXPONENT);
-		if (mantissa)
-			f16 |= (mantissa & F16_MANTISSA_BITS);
-	}
-	else if (exponent > 15)
-	{ /* Overflow - flush to Infinity */
-		f16 = (unsigned short)(sign | F16_MAX_EXPONENT);
-	}
-	else if (exponent > -15)
-	{ /* Representable value */
-		exponent += F16_EXPONENT_BIAS;
-		mantissa >>= F16_MANTISSA_SHIFT;
-		f16 = (unsigned short)(sign | exponent << F16_EXPONENT_SHIFT | mantissa);
-	}
-	else
-	{
-		f16 = (unsigned short)sign;
-	}
-	return f16;
-}
-
-static inline void util_pack_float2_to_half2(uint32_t count, uint32_t stride, uint32_t offset, const uint8_t* src, uint8_t* dst)
-{
-	struct f2 { float x; float y; };
-	f2* f = (f2*)src;
-	for (uint32_t e = 0; e < count; ++e)
-	{
-		*(uint32_t*)(dst + e * sizeof(uint32_t) + offset) = (
-			(util_float_to_half(f[e].x) & 0x0000FFFF) | ((util_float_to_half(f[e].y) << 16) & 0xFFFF0000));
-	}
-}
-
-static inline uint32_t util_float2_to_unorm2x16(const float* v)
+static inline void util_pack_float2_to_half2(uint32_t count, uint32_t srcStride, const uint8_t* src, uint8_t* dst, uint32_t dstStride)
 {
-	uint32_t x = (uint32_t)round(clamp(v[0], 0, 1) * 65535.0f);
-	uint32_t y = (uint32_t)round(clamp(v[1], 0, 1) * 65535.0f);
-	return ((uint32_t)0x0000FFFF & x) | ((y << 16) & (uint32_t)0xFFFF0000);
+	packFloatToHalf(count, 2, src, srcStride, dst, dstStride);
 }
 
-#define OCT_WRAP(v, w) ((1.0f - abs((w))) * ((v) >= 0.0f ? 1.0f : -1.0f))
-
-static inline void util_pack_float3_direction_to_half2(uint32_t count, uint32_t stride, uint32_t offset, const uint8_t* src, uint8_t* dst)
+static inline void util_pack_float3_direction_to_half2(uint32_t count, uint32_t srcStride, const uint8_t* src, uint8_t* dst, uint32_t dstStride)
 {
-	struct f3 { float x; float y; float z; };
-	for (uint32_t e = 0; e < count; ++e)
-	{
-		f3 f = *(f3*)(src + e * stride);
-		float absLength = (abs(f.x) + abs(f.y) + abs(f.z));
-		f3 enc = {};
-		if (absLength)
-		{
-			enc.x = f.x / absLength;
-			enc.y = f.y / absLength;
-			enc.z = f.z / absLength;
-			if (enc.z < 0)
-			{
-				float oldX = enc.x;
-				enc.x = OCT_WRAP(enc.x, enc.y);
-				enc.y = OCT_WRAP(enc.y, oldX);
-			}
-			enc.x = enc.x * 0.5f + 0.5f;
-			enc.y = enc.y * 0.5f + 0.5f;
-			*(uint32_t*)(dst + e * sizeof(uint32_t) + offset) = util_float2_to_unorm2x16(&enc.x);
-		}
-		else
-		{
-			*(uint32_t*)(dst + e * sizeof(uint32_t) + offset) = 0;
-		}
-	}
+	packOctahedral(PACKED_NORM_FORMAT_UNORM16, count, src, srcStride, dst, dstStride);
 }
 /************************************************************************/
 // Internal Structures
@@ -325,45 +280,89 @@ typedef struct TextureUpdateDescInternal
 	uint32_t          mLayerCount;
 	PreMipStepFn      pPreMipFunc;
 	bool              mMipsAfterSlice;
+	/// Leading mips in the stream which are not part of pTexture. They are skipped when reading
+	/// Their size is taken from mSrcWidth / mSrcHeight / mSrcDepth, the dimensions of the first mip in the stream
+	uint32_t          mSkipMipLevels;
+	uint32_t          mSrcWidth;
+	uint32_t          mSrcHeight;
+	uint32_t          mSrcDepth;
+	/// Basis file transcoded straight into staging memory instead of reading mStream. Owned by the update
+	BasisTexture*     pBasisTexture;
 } TextureUpdateDescInternal;
 
+typedef enum UpdateRequestType
+{
+	UPDATE_REQUEST_UPDATE_BUFFER,
+	UPDATE_REQUEST_UPDATE_TEXTURE,
+	UPDATE_REQUEST_BUFFER_BARRIER,
+	UPDATE_REQUEST_TEXTURE_BARRIER,
+	UPDATE_REQUEST_LOAD_TEXTURE,
+	UPDATE_REQUEST_LOAD_GEOMETRY,
+	UPDATE_REQUEST_INVALID,
+} UpdateRequestType;
+
+/// Stage timings of a request, completed once the copy set it was recorded into finished on the GPU
+typedef struct LoadRecord
+{
+	/// File name of texture / geometry loads, only kept for the load report
+	eastl::string     mName;
+	UpdateRequestType mType;
+	uint64_t          mStageTimeUs[RESOURCE_LOAD_STAGE_COUNT];
+	uint64_t          mBytes;
+} LoadRecord;
+
 typedef struct CopyResourceSet
 {
 	Fence*                 pFence;
 	Cmd*                   pCmd;
 	CmdPool*               pCmdPool;
-	Buffer*                mBuffer;
-	uint64_t               mAllocatedSpace;
+	/// Staging ring position after the last allocation of this set. The ring is released up to here once pFence completes
+	uint64_t               mRingEnd;
+	/// Staging memory handed out for this set including temporary buffers
+	uint64_t               mStagedSize;
 
-	/// Buffers created in case we ran out of space in the original staging buffer
+	/// Buffers created for uploads larger than the staging ring
 	/// Will be cleaned up after the fence for this set is complete
 	eastl::vector<Buffer*> mTempBuffers;
 
+	/// Requests recorded into this set and the time it was last submitted
+	eastl::vector<LoadRecord> mLoadRecords;
+	int64_t                mSubmitTimeUs;
+
 	Semaphore*            pCopyCompletedSemaphore;
 } CopyResourceSet;
 
+/// Written by the streamer thread, read by getResourceLoaderStagingStats
+typedef struct StagingCounters
+{
+	tfrg_atomic64_t mRingUsed;
+	tfrg_atomic64_t mRingPeakUsed;
+	tfrg_atomic64_t mStagedBytes;
+	tfrg_atomic64_t mTempBufferBytes;
+	tfrg_atomic64_t mTempBufferCount;
+	tfrg_atomic64_t mStallCount;
+	tfrg_atomic64_t mStallTimeUs;
+} StagingCounters;
+
 //Synchronization?
 typedef struct CopyEngine
 {
 	Queue*           pQueue;
 	CopyResourceSet* resourceSets;
+	/// Staging budget of a single set
 	uint64_t         bufferSize;
 	uint32_t         bufferCount;
 	bool             isRecording;
 	Semaphore*       pLastCompletedSemaphore;
 
-} CopyEngine;
+	/// Staging buffer shared by all sets. Head and tail are monotonic positions, the buffer offset is the position modulo mRingSize
+	Buffer*          pStagingRing;
+	uint64_t         mRingSize;
+	uint64_t         mRingHead;
+	uint64_t         mRingTail;
+	StagingCounters  mCounters;
 
-typedef enum UpdateRequestType
-{
-	UPDATE_REQUEST_UPDATE_BUFFER,
-	UPDATE_REQUEST_UPDATE_TEXTURE,
-	UPDATE_REQUEST_BUFFER_BARRIER,
-	UPDATE_REQUEST_TEXTURE_BARRIER,
-	UPDATE_REQUEST_LOAD_TEXTURE,
-	UPDATE_REQUEST_LOAD_GEOMETRY,
-	UPDATE_REQUEST_INVALID,
-} UpdateRequestType;
+} CopyEngine;
 
 typedef enum UploadFunctionResult
 {
@@ -372,6 +371,88 @@ typedef enum UploadFunctionResult
 	UPLOAD_FUNCTION_RESULT_INVALID_REQUEST
 } UploadFunctionResult;
 
+typedef enum DecodeJobState
+{
+	DECODE_JOB_PENDING,
+	DECODE_JOB_RUNNING,
+	DECODE_JOB_DONE,
+} DecodeJobState;
+
+/// CPU side result of a texture load. Stream holds the subresource data in memory
+typedef struct TextureDecodeData
+{
+	TextureDesc               mDesc;
+	TextureUpdateDescInternal mUpdateDesc;
+} TextureDecodeData;
+
+/// CPU side result of a geometry load. Index / vertex data is packed in the final layout
+typedef struct GeometryDecodeData
+{
+	Geometry*  pGeometry;
+	void*      pIndexData;
+	uint32_t   mIndexStride;
+	void*      pVertexData[MAX_VERTEX_BINDINGS];
+	uint32_t   mVertexStrides[MAX_VERTEX_BINDINGS];
+	/// Mapped geometry cache file. While open, index / vertex data point into the mapping instead of owning an allocation
+	FileStream mCacheStream;
+} GeometryDecodeData;
+
+/// Texture / geometry load decoded by a worker thread ahead of the streamer thread
+typedef struct DecodeJob
+{
+	UpdateRequestType  mType;
+	DecodeJobState     mState;
+	bool               mSuccess;
+	/// Time of the whole job and the part of it spent reading files
+	uint64_t           mDecodeTimeUs;
+	uint64_t           mReadTimeUs;
+	TextureLoadDesc    mTexLoadDesc;
+	GeometryLoadDesc   mGeomLoadDesc;
+	TextureDecodeData  mTexture;
+	GeometryDecodeData mGeometry;
+} DecodeJob;
+
+typedef void (*DecodeTaskFunc)(void* pUserData, uint32_t index);
+
+/// Independent work items of a running decode job. Idle decode threads help the owning thread with them
+typedef struct DecodeTask
+{
+	DecodeTaskFunc  pFunc;
+	void*           pUserData;
+	uint32_t        mCount;
+	tfrg_atomic32_t mNextIndex;
+	/// Decode threads currently working on items. Protected by mDecodeMutex
+	uint32_t        mHelperCount;
+} DecodeTask;
+
+typedef enum StreamedTextureState
+{
+	STREAMED_TEXTURE_STATE_LOADING,
+	/// Mip tail is uploaded. mDesc and the mip counts of the streamed texture are valid
+	STREAMED_TEXTURE_STATE_READY,
+} StreamedTextureState;
+
+/// Texture replaced by streaming. Released once the GPU can no longer be using it
+typedef struct RetiredTexture
+{
+	Texture* pTexture;
+	uint64_t mFrame;
+} RetiredTexture;
+
+/// Texture / geometry shared by all loads with the same key. Protected by mSharedMutex
+typedef struct SharedResource
+{
+	eastl::string         mKey;
+	/// Texture* / Geometry*. NULL until the load was processed by the streamer
+	void*                 pResource;
+	uint32_t              mRefCount;
+	/// Token of the load. 0 while the load is collected in pBatch
+	SyncToken             mToken;
+	struct RequestBatch*  pBatch;
+	/// ppTexture / ppGeometry of the loads sharing the pending load
+	eastl::vector<void**> mOutputs;
+} SharedResource;
+
 struct UpdateRequest
 {
 	UpdateRequest(const BufferUpdateDesc& buffer) :           mType(UPDATE_REQUEST_UPDATE_BUFFER), bufUpdateDesc(buffer) {}
@@ -384,6 +465,17 @@ struct UpdateRequest
 	UpdateRequestType             mType = UPDATE_REQUEST_INVALID;
 	uint64_t                      mWaitIndex = 0;
 	Buffer*                       pUploadBuffer = NULL;
+	DecodeJob*                    pDecodeJob = NULL;
+	uint32_t                      mPriority = 0;
+	/// mPriority capped by the earlier pending requests on the same resource. Set by sortRequestQueue
+	uint32_t                      mOrderPriority = 0;
+	/// Texture loads of a streamed texture. 0 mip levels is the initial load of the mip tail
+	StreamedTexture*              pStreamedTexture = NULL;
+	uint32_t                      mStreamMipLevels = 0;
+	/// Set on the load all loads of a shared texture / geometry wait for
+	SharedResource*               pSharedResource = NULL;
+	/// Submission time, start of the queue wait stage
+	int64_t                       mQueueTimeUs = 0;
 	union
 	{
 		BufferUpdateDesc          bufUpdateDesc;
@@ -395,6 +487,94 @@ struct UpdateRequest
 	};
 };
 
+/// Node of the submission queue. Nodes live in pooled chunks which are only freed with the resource loader
+typedef struct RequestNode
+{
+	tfrg_atomicptr_t mNext;
+	/// Pool index + 1 of the next node in the free list
+	tfrg_atomic32_t  mNextFree;
+	uint32_t         mIndex;
+	UpdateRequest    mRequest;
+} RequestNode;
+
+/// Lock free node pool. mFreeHead packs the node index + 1 of the first free node with an ABA tag in the upper 32 bits
+typedef struct RequestNodePool
+{
+	RequestNode*     pChunks[MAX_REQUEST_NODE_CHUNKS];
+	tfrg_atomic32_t  mChunkCount;
+	tfrg_atomic64_t  mFreeHead;
+} RequestNodePool;
+
+/// Multi producer single consumer queue. pHead is the last consumed node which is kept as stub
+typedef struct RequestQueue
+{
+	tfrg_atomicptr_t mTail;
+	RequestNode*     pHead;
+} RequestQueue;
+
+typedef struct TokenCallback
+{
+	SyncToken            mToken;
+	ResourceLoadCallback pCallback;
+	void*                pUserData;
+} TokenCallback;
+
+static bool operator>(const TokenCallback& lhs, const TokenCallback& rhs) { return lhs.mToken > rhs.mToken; }
+
+typedef struct BatchedRequest
+{
+	UpdateRequest mRequest;
+	uint32_t      mNodeIndex;
+	/// Position in the batch, keeps the sort stable
+	uint32_t      mOrder;
+} BatchedRequest;
+
+/// Requests collected by addResources. They are sorted and submitted together once the whole batch is known
+typedef struct RequestBatch
+{
+	eastl::vector<BatchedRequest> mRequests;
+} RequestBatch;
+
+/// Read / decode time of the request the streamer thread is processing. Only touched by the streamer thread
+typedef struct RequestTiming
+{
+	uint64_t mReadUs;
+	uint64_t mDecodeUs;
+	/// Part of the above the streamer thread spent itself or waiting for a decode thread. Not part of the staging copy
+	uint64_t mStreamerUs;
+} RequestTiming;
+
+typedef enum LoaderCounter
+{
+	LOADER_COUNTER_QUEUE_DEPTH,
+	LOADER_COUNTER_BYTES_PER_SECOND,
+	LOADER_COUNTER_UPLOADED_BYTES,
+	LOADER_COUNTER_STAGING_RING_USED,
+	LOADER_COUNTER_TEMP_BUFFER_COUNT,
+	LOADER_COUNTER_TEMP_BUFFER_BYTES,
+	LOADER_COUNTER_STALL_COUNT,
+	/// One counter per ResourceLoadStage
+	LOADER_COUNTER_STAGE_TIME,
+	LOADER_COUNTER_COUNT = LOADER_COUNTER_STAGE_TIME + RESOURCE_LOAD_STAGE_COUNT,
+} LoaderCounter;
+
+static const char* gLoaderCounterNames[LOADER_COUNTER_COUNT] = {
+	"ResourceLoader/QueueDepth",
+	"ResourceLoader/BytesPerSecond",
+	"ResourceLoader/UploadedBytes",
+	"ResourceLoader/Staging/RingUsed",
+	"ResourceLoader/Staging/TempBuffers",
+	"ResourceLoader/Staging/TempBufferBytes",
+	"ResourceLoader/Staging/Stalls",
+	"ResourceLoader/StageTimeUs/QueueWait",
+	"ResourceLoader/StageTimeUs/FileRead",
+	"ResourceLoader/StageTimeUs/Decode",
+	"ResourceLoader/StageTimeUs/StagingCopy",
+	"ResourceLoader/StageTimeUs/GpuCompletion",
+};
+
+static const char* gResourceLoadStageNames[RESOURCE_LOAD_STAGE_COUNT] = { "QueueWait", "FileRead", "Decode", "StagingCopy", "GpuCompletion" };
+
 struct ResourceLoader
 {
 	Renderer*                    pRenderer;
@@ -405,14 +585,25 @@ struct ResourceLoader
 	ThreadDesc                   mThreadDesc;
 	ThreadHandle                 mThread;
 
+	/// Producers push without locking. mQueueMutex only guards the consumer side
+	RequestNodePool              mRequestNodePool;
+	RequestQueue                 mRequestQueue[MAX_LINKED_GPUS];
+	tfrg_atomic32_t              mStreamerSleeping;
+
 	Mutex                        mQueueMutex;
 	ConditionVariable            mQueueCond;
 	Mutex                        mTokenMutex;
 	ConditionVariable            mTokenCond;
-	eastl::vector<UpdateRequest> mRequestQueue[MAX_LINKED_GPUS];
+	/// Requests taken out of mRequestQueue which were not processed yet. Protected by mQueueMutex
+	eastl::vector<UpdateRequest> mPendingRequests[MAX_LINKED_GPUS];
 
 	tfrg_atomic64_t              mTokenCompleted;
 	tfrg_atomic64_t              mTokenCounter;
+	/// Tokens completed above mTokenWatermark. Min heap, protected by mQueueMutex
+	eastl::vector<SyncToken>     mCompletedTokens;
+	SyncToken                    mTokenWatermark;
+	/// Callbacks waiting for mTokenCompleted to pass their token. Min heap, protected by mTokenMutex
+	eastl::vector<TokenCallback> mTokenCallbacks;
 
 	Mutex                        mSemaphoreMutex;
 
@@ -422,6 +613,39 @@ struct ResourceLoader
 	uint32_t                     mNextSet;
 	uint32_t                     mSubmittedSets;
 
+	ThreadDesc                   mDecodeThreadDesc;
+	ThreadHandle                 mDecodeThreads[MAX_DECODE_THREADS];
+	uint32_t                     mDecodeThreadCount;
+	Mutex                        mDecodeMutex;
+	ConditionVariable            mDecodeCond;
+	ConditionVariable            mDecodeDoneCond;
+	eastl::vector<DecodeJob*>    mDecodeQueue;
+	/// Tasks of running decode jobs. Served before mDecodeQueue since their job is already in flight
+	eastl::vector<DecodeTask*>   mDecodeTasks;
+
+	/// Guards mStreamedTextures. Everything else of the streaming state is only touched by updateTextureStreaming
+	Mutex                        mStreamingMutex;
+	eastl::vector<StreamedTexture*> mStreamedTextures;
+	eastl::vector<StreamedTexture*> mStreamingCandidates;
+	eastl::vector<RetiredTexture> mRetiredTextures;
+	uint64_t                     mStreamingFrame;
+
+	Mutex                        mSharedMutex;
+	eastl::hash_map<eastl::string, SharedResource*> mSharedResources;
+	/// Loaded shared resources by their Texture* / Geometry*
+	eastl::hash_map<const void*, SharedResource*>   mSharedLookup;
+
+	RequestTiming                mActiveTiming;
+	tfrg_atomic32_t              mQueueDepth;
+	tfrg_atomic32_t              mPeakQueueDepth;
+	/// Guards mStats, the throughput window and mLoadReport. mQueueDepth / mPeakQueueDepth are read without it
+	Mutex                        mStatsMutex;
+	ResourceLoaderThroughputStats mStats;
+	int64_t                      mWindowStartUs;
+	uint64_t                     mWindowBytes;
+	eastl::vector<LoadRecord>    mLoadReport;
+	ProfileToken                 mCounters[LOADER_COUNTER_COUNT];
+
 #if defined(NX64)
 	ThreadTypeNX                 mThreadType;
 	void*                        mThreadStackPtr;
@@ -430,6 +654,37 @@ struct ResourceLoader
 
 static ResourceLoader* pResourceLoader = NULL;
 
+static bool waitDecodeJob(ResourceLoader* pLoader, DecodeJob* pJob);
+static void runDecodeTask(ResourceLoader* pLoader, DecodeTaskFunc pFunc, void* pUserData, uint32_t count);
+static void releaseDecodeJob(DecodeJob* pJob);
+static void drainRequestQueues(ResourceLoader* pLoader);
+static void resolveSharedResource(ResourceLoader* pLoader, struct SharedResource* pShared, void* pResource);
+
+// Read / decode work done by the streamer thread itself. It is not part of the staging copy stage of the request
+static void addStreamerLoadTime(ResourceLoader* pLoader, ResourceLoadStage stage, uint64_t timeUs)
+{
+	RequestTiming* pTiming = &pLoader->mActiveTiming;
+	if (RESOURCE_LOAD_STAGE_FILE_READ == stage)
+	{
+		pTiming->mReadUs += timeUs;
+	}
+	else
+	{
+		pTiming->mDecodeUs += timeUs;
+	}
+	pTiming->mStreamerUs += timeUs;
+}
+
+static void addQueueDepth(ResourceLoader* pLoader, int32_t count)
+{
+	uint32_t depth = tfrg_atomic32_add_relaxed(&pLoader->mQueueDepth, count) + count;
+	if (count > 0)
+	{
+		tfrg_atomic32_max_relaxed(&pLoader->mPeakQueueDepth, depth);
+	}
+	setProfileCounter(pLoader->mCounters[LOADER_COUNTER_QUEUE_DEPTH], depth);
+}
+
 static uint32_t util_get_texture_row_alignment(Renderer* pRenderer)
 {
 	return max(1u, pRenderer->pActiveGpuSettings->mUploadBufferTextureRowAlignment);
@@ -514,13 +769,20 @@ static void setupCopyEngine(Renderer* pRenderer, CopyEngine* pCopyEngine, uint32
 
 		addSemaphore(pRenderer, &resourceSet.pCopyCompletedSemaphore);
 
-		resourceSet.mBuffer = allocateUploadMemory(pRenderer, size, util_get_texture_subresource_alignment(pRenderer)).pBuffer;
+		resourceSet.mRingEnd = 0;
+		resourceSet.mSubmitTimeUs = 0;
 	}
 
 	pCopyEngine->bufferSize = size;
 	pCopyEngine->bufferCount = bufferCount;
 	pCopyEngine->isRecording = false;
 	pCopyEngine->pLastCompletedSemaphore = NULL;
+
+	pCopyEngine->mRingSize = size * bufferCount;
+	pCopyEngine->pStagingRing = allocateUploadMemory(pRenderer, pCopyEngine->mRingSize, util_get_texture_subresource_alignment(pRenderer)).pBuffer;
+	pCopyEngine->mRingHead = 0;
+	pCopyEngine->mRingTail = 0;
+	pCopyEngine->mCounters = {};
 }
 
 static void cleanupCopyEngine(Renderer* pRenderer, CopyEngine* pCopyEngine)
@@ -528,7 +790,6 @@ static void cleanupCopyEngine(Renderer* pRenderer, CopyEngine* pCopyEngine)
 	for (uint32_t i = 0; i < pCopyEngine->bufferCount; ++i)
 	{
 		CopyResourceSet& resourceSet = pCopyEngine->resourceSets[i];
-		removeBuffer(pRenderer, resourceSet.mBuffer);
 
 		removeSemaphore(pRenderer, resourceSet.pCopyCompletedSemaphore);
 
@@ -546,18 +807,19 @@ static void cleanupCopyEngine(Renderer* pRenderer, CopyEngine* pCopyEngine)
 			removeBuffer(pRenderer, buffer);
 		}
 		pCopyEngine->resourceSets[i].mTempBuffers.set_capacity(0);
+		pCopyEngine->resourceSets[i].mLoadRecords.set_capacity(0);
 	}
 
 	tf_free(pCopyEngine->resourceSets);
 
+	removeBuffer(pRenderer, pCopyEngine->pStagingRing);
+
 	removeQueue(pRenderer, pCopyEngine->pQueue);
 }
 
-static bool waitCopyEngineSet(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t activeSet, bool wait)
+static bool waitCopyResourceSet(Renderer* pRenderer, CopyResourceSet& resourceSet, bool wait)
 {
-	ASSERT(!pCopyEngine->isRecording);
-	CopyResourceSet& resourceSet = pCopyEngine->resourceSets[activeSet];
-	bool             completed = true;
+	bool completed = true;
 #if defined(DIRECT3D11)
 	if (gSelectedRendererApi != RENDERER_API_D3D11)
 	{
@@ -574,17 +836,25 @@ static bool waitCopyEngineSet(Renderer* pRenderer, CopyEngine* pCopyEngine, size
 	else
 	{
 		UNREF_PARAM(pRenderer);
-		UNREF_PARAM(pCopyEngine);
-		UNREF_PARAM(activeSet);
+		UNREF_PARAM(resourceSet);
 	}
 #endif
 	return completed;
 }
 
+static bool waitCopyEngineSet(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t activeSet, bool wait)
+{
+	ASSERT(!pCopyEngine->isRecording);
+	return waitCopyResourceSet(pRenderer, pCopyEngine->resourceSets[activeSet], wait);
+}
+
 static void resetCopyEngineSet(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t activeSet)
 {
 	ASSERT(!pCopyEngine->isRecording);
-	pCopyEngine->resourceSets[activeSet].mAllocatedSpace = 0;
+	// Sets complete in submission order, so everything the ring handed out before this set's last allocation is free
+	pCopyEngine->mRingTail = max(pCopyEngine->mRingTail, pCopyEngine->resourceSets[activeSet].mRingEnd);
+	tfrg_atomic64_store_relaxed(&pCopyEngine->mCounters.mRingUsed, pCopyEngine->mRingHead - pCopyEngine->mRingTail);
+	pCopyEngine->resourceSets[activeSet].mStagedSize = 0;
 	pCopyEngine->isRecording = false;
 
 	for (Buffer*& buffer : pCopyEngine->resourceSets[activeSet].mTempBuffers)
@@ -610,7 +880,9 @@ static void streamerFlush(CopyEngine* pCopyEngine, size_t activeSet)
 {
 	if (pCopyEngine->isRecording)
 	{
+		PROFILER_SET_CPU_SCOPE("ResourceLoader", "Submit", 0x3355ee);
 		CopyResourceSet& resourceSet = pCopyEngine->resourceSets[activeSet];
+		resourceSet.mSubmitTimeUs = getUSec();
 		endCmd(resourceSet.pCmd);
 		QueueSubmitDesc submitDesc = {};
 		submitDesc.mCmdCount = 1;
@@ -625,62 +897,297 @@ static void streamerFlush(CopyEngine* pCopyEngine, size_t activeSet)
 	}
 }
 
-/// Return memory from pre-allocated staging buffer or create a temporary buffer if the streamer ran out of memory
-static MappedMemoryRange allocateStagingMemory(uint64_t memoryRequirement, uint32_t alignment)
+// Takes memoryRequirement bytes from the head of the staging ring. Returns false if the GPU still uses the space
+static bool allocateStagingRing(CopyEngine* pCopyEngine, uint64_t memoryRequirement, uint32_t alignment, uint64_t* pOffset)
 {
-	// Use the copy engine for GPU 0.
-	CopyEngine* pCopyEngine = &pResourceLoader->pCopyEngines[0];
-
-	uint64_t offset = pCopyEngine->resourceSets[pResourceLoader->mNextSet].mAllocatedSpace;
-	if (alignment != 0)
+	const uint64_t ringSize = pCopyEngine->mRingSize;
+	if (pCopyEngine->mRingHead == pCopyEngine->mRingTail)
 	{
-		offset = round_up_64(offset, alignment);
+		// Nothing in flight. Restart at the beginning of the buffer so the whole ring is available
+		uint64_t start = ((pCopyEngine->mRingHead + ringSize - 1) / ringSize) * ringSize;
+		pCopyEngine->mRingHead = start;
+		pCopyEngine->mRingTail = start;
 	}
 
-	CopyResourceSet* pResourceSet = &pCopyEngine->resourceSets[pResourceLoader->mNextSet];
-	uint64_t size = (uint64_t)pResourceSet->mBuffer->mSize;
-	bool memoryAvailable = (offset < size) && (memoryRequirement <= size - offset);
-	if (memoryAvailable && pResourceSet->mBuffer->pCpuMappedAddress)
+	uint64_t head = pCopyEngine->mRingHead;
+	uint64_t offset = head % ringSize;
+	uint64_t alignedOffset = alignment ? round_up_64(offset, alignment) : offset;
+	if (alignedOffset + memoryRequirement > ringSize)
 	{
-		Buffer* buffer = pResourceSet->mBuffer;
-		ASSERT(buffer->pCpuMappedAddress);
-		uint8_t* pDstData = (uint8_t*)buffer->pCpuMappedAddress + offset;
-		pCopyEngine->resourceSets[pResourceLoader->mNextSet].mAllocatedSpace = offset + memoryRequirement;
-		return { pDstData, buffer, offset, memoryRequirement };
+		// Wrap around. The rest of the buffer stays unused until the tail passes it
+		head += ringSize - offset;
+		alignedOffset = 0;
 	}
 	else
 	{
-		if (pCopyEngine->bufferSize < memoryRequirement)
+		head += alignedOffset - offset;
+	}
+
+	if (head + memoryRequirement - pCopyEngine->mRingTail > ringSize)
+	{
+		return false;
+	}
+
+	pCopyEngine->mRingHead = head + memoryRequirement;
+	*pOffset = alignedOffset;
+	return true;
+}
+
+// Waits for the oldest submitted set which still holds ring memory. Returns false if only activeSet holds any
+static bool releaseOldestStagingSet(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t activeSet)
+{
+	for (uint32_t i = 1; i < pCopyEngine->bufferCount; ++i)
+	{
+		CopyResourceSet& resourceSet = pCopyEngine->resourceSets[(activeSet + i) % pCopyEngine->bufferCount];
+		if (resourceSet.mRingEnd > pCopyEngine->mRingTail)
+		{
+			waitCopyResourceSet(pRenderer, resourceSet, true);
+			pCopyEngine->mRingTail = resourceSet.mRingEnd;
+			return true;
+		}
+	}
+	return false;
+}
+
+// The set being recorded uses the whole ring. Submit what it has so far and wait for it so the upload can continue.
+// The copy semaphore is only signaled by the final submission of the set in streamerThreadFunc
+static void flushStagingSet(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t activeSet)
+{
+	CopyResourceSet& resourceSet = pCopyEngine->resourceSets[activeSet];
+	if (pCopyEngine->isRecording)
+	{
+		endCmd(resourceSet.pCmd);
+		QueueSubmitDesc submitDesc = {};
+		submitDesc.mCmdCount = 1;
+		submitDesc.ppCmds = &resourceSet.pCmd;
+		submitDesc.pSignalFence = resourceSet.pFence;
+		queueSubmit(pCopyEngine->pQueue, &submitDesc);
+		pCopyEngine->isRecording = false;
+	}
+	waitCopyResourceSet(pRenderer, resourceSet, true);
+	pCopyEngine->mRingTail = pCopyEngine->mRingHead;
+}
+
+/// Return memory from the staging ring, waiting for older sets if it is full.
+/// Only allocations larger than the whole ring get a temporary buffer, so callers split large uploads into chunks
+static MappedMemoryRange allocateStagingMemory(uint64_t memoryRequirement, uint32_t alignment)
+{
+	Renderer* pRenderer = pResourceLoader->pRenderer;
+	// Use the copy engine for GPU 0.
+	CopyEngine* pCopyEngine = &pResourceLoader->pCopyEngines[0];
+	size_t activeSet = pResourceLoader->mNextSet;
+	StagingCounters* pCounters = &pCopyEngine->mCounters;
+
+	CopyResourceSet* pResourceSet = &pCopyEngine->resourceSets[activeSet];
+	pResourceSet->mStagedSize += memoryRequirement;
+
+	Buffer* pRing = pCopyEngine->pStagingRing;
+	if (pRing->pCpuMappedAddress && memoryRequirement <= pCopyEngine->mRingSize)
+	{
+		uint64_t offset = 0;
+		if (!allocateStagingRing(pCopyEngine, memoryRequirement, alignment, &offset))
+		{
+			PROFILER_SET_CPU_SCOPE("ResourceLoader", "StagingStall", 0xee3333);
+			int64_t stallStart = getUSec();
+			bool allocated = false;
+			while (!allocated && releaseOldestStagingSet(pRenderer, pCopyEngine, activeSet))
+			{
+				allocated = allocateStagingRing(pCopyEngine, memoryRequirement, alignment, &offset);
+			}
+			if (!allocated)
+			{
+				flushStagingSet(pRenderer, pCopyEngine, activeSet);
+				allocated = allocateStagingRing(pCopyEngine, memoryRequirement, alignment, &offset);
+			}
+			ASSERT(allocated);
+
+			tfrg_atomic64_add_relaxed(&pCounters->mStallCount, 1);
+			tfrg_atomic64_add_relaxed(&pCounters->mStallTimeUs, (uint64_t)(getUSec() - stallStart));
+		}
+		pResourceSet->mRingEnd = pCopyEngine->mRingHead;
+
+		uint64_t used = pCopyEngine->mRingHead - pCopyEngine->mRingTail;
+		tfrg_atomic64_store_relaxed(&pCounters->mRingUsed, used);
+		if (used > tfrg_atomic64_load_relaxed(&pCounters->mRingPeakUsed))
 		{
-			MappedMemoryRange range = allocateUploadMemory(pResourceLoader->pRenderer, memoryRequirement, alignment);
-			//LOGF(LogLevel::eINFO, "Allocating temporary staging buffer. Required allocation size of %llu is larger than the staging buffer capacity of %llu", memoryRequirement, size);
-			pResourceSet->mTempBuffers.emplace_back(range.pBuffer);
-			return range;
+			tfrg_atomic64_store_relaxed(&pCounters->mRingPeakUsed, used);
 		}
+		tfrg_atomic64_add_relaxed(&pCounters->mStagedBytes, memoryRequirement);
+
+		return { (uint8_t*)pRing->pCpuMappedAddress + offset, pRing, offset, memoryRequirement };
 	}
 
-	MappedMemoryRange range = allocateUploadMemory(pResourceLoader->pRenderer, memoryRequirement, alignment);
-	//LOGF(LogLevel::eINFO, "Allocating temporary staging buffer. Required allocation size of %llu is larger than the staging buffer capacity of %llu", memoryRequirement, size);
+	MappedMemoryRange range = allocateUploadMemory(pRenderer, memoryRequirement, alignment);
+	//LOGF(LogLevel::eINFO, "Allocating temporary staging buffer. Required allocation size of %llu is larger than the staging ring capacity of %llu", memoryRequirement, pCopyEngine->mRingSize);
 	pResourceSet->mTempBuffers.emplace_back(range.pBuffer);
+	tfrg_atomic64_add_relaxed(&pCounters->mTempBufferCount, 1);
+	tfrg_atomic64_add_relaxed(&pCounters->mTempBufferBytes, memoryRequirement);
 	return range;
 }
 
 static void freeAllUploadMemory()
 {
+	drainRequestQueues(pResourceLoader);
+
 	for (size_t i = 0; i < MAX_LINKED_GPUS; ++i)
 	{
-		for (UpdateRequest& request : pResourceLoader->mRequestQueue[i])
+		for (UpdateRequest& request : pResourceLoader->mPendingRequests[i])
 		{
 			if (request.pUploadBuffer)
 			{
 				removeBuffer(pResourceLoader->pRenderer, request.pUploadBuffer);
 			}
+			// Decode threads are stopped at this point
+			if (request.pDecodeJob)
+			{
+				releaseDecodeJob(request.pDecodeJob);
+			}
+		}
+	}
+}
+
+typedef struct BasisSubresource
+{
+	uint32_t mLayer;
+	uint32_t mMip;
+	uint32_t mRowPitch;
+	uint32_t mRowCount;
+	uint64_t mOffset;
+} BasisSubresource;
+
+typedef struct BasisTranscodeTask
+{
+	const BasisTexture*     pBasis;
+	const BasisSubresource* pSubresources;
+	uint8_t*                pDst;
+	tfrg_atomic32_t         mFailed;
+} BasisTranscodeTask;
+
+static void transcodeBasisSubresource(void* pUserData, uint32_t index)
+{
+	BasisTranscodeTask* pTask = (BasisTranscodeTask*)pUserData;
+	const BasisSubresource& sub = pTask->pSubresources[index];
+	if (!transcodeBASISSubresource(pTask->pBasis, sub.mLayer, sub.mMip, pTask->pDst + sub.mOffset, sub.mRowPitch, sub.mRowCount))
+	{
+		tfrg_atomic32_store_relaxed(&pTask->mFailed, 1);
+	}
+}
+
+// Transcodes the subresources of a Basis file directly into staging memory.
+// Subresources are staged in groups of up to one set's staging budget. Each group is a single allocation which is filled
+// by the decode threads in parallel before its copies are recorded, so a flush of the set never sees unwritten memory
+static UploadFunctionResult updateBasisTexture(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t activeSet, const TextureUpdateDescInternal& texUpdateDesc)
+{
+	BasisTexture* pBasis = texUpdateDesc.pBasisTexture;
+	Texture* texture = texUpdateDesc.pTexture;
+	const TinyImageFormat fmt = (TinyImageFormat)texture->mFormat;
+	Cmd* cmd = acquireCmd(pCopyEngine, activeSet);
+
+	const uint32_t sliceAlignment = util_get_texture_subresource_alignment(pRenderer, fmt);
+	// PVRTC1 is swizzled, the transcoder ignores the row pitch
+	const uint32_t rowAlignment = TinyImageFormat_PVRTC1_4BPP_UNORM == fmt ? 1 : util_get_texture_row_alignment(pRenderer);
+
+#if defined(VULKAN)
+	TextureBarrier barrier;
+	if (gSelectedRendererApi == RENDERER_API_VULKAN)
+	{
+		barrier = { texture, RESOURCE_STATE_UNDEFINED, RESOURCE_STATE_COPY_DEST };
+		cmdResourceBarrier(cmd, 0, NULL, 1, &barrier, 0, NULL);
+	}
+#endif
+
+	UploadFunctionResult result = UPLOAD_FUNCTION_RESULT_COMPLETED;
+	eastl::vector<BasisSubresource> subresources;
+	subresources.reserve(texUpdateDesc.mLayerCount * texUpdateDesc.mMipLevels);
+	for (uint32_t layer = texUpdateDesc.mBaseArrayLayer; layer < texUpdateDesc.mBaseArrayLayer + texUpdateDesc.mLayerCount; ++layer)
+	{
+		for (uint32_t mip = texUpdateDesc.mBaseMipLevel; mip < texUpdateDesc.mBaseMipLevel + texUpdateDesc.mMipLevels; ++mip)
+		{
+			uint32_t rowBytes = 0;
+			uint32_t numRows = 0;
+			if (!util_get_surface_info(MIP_REDUCE(texture->mWidth, mip), MIP_REDUCE(texture->mHeight, mip), fmt, NULL, &rowBytes, &numRows))
+			{
+				result = UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+				break;
+			}
+			BasisSubresource sub = { layer, mip, round_up(rowBytes, rowAlignment), numRows, 0 };
+			subresources.push_back(sub);
+		}
+		if (UPLOAD_FUNCTION_RESULT_COMPLETED != result)
+		{
+			break;
+		}
+	}
+
+	uint32_t first = 0;
+	while (UPLOAD_FUNCTION_RESULT_COMPLETED == result && first < (uint32_t)subresources.size())
+	{
+		// Offsets relative to the group allocation. The allocation itself is slice aligned
+		uint64_t groupSize = 0;
+		uint32_t last = first;
+		for (; last < (uint32_t)subresources.size(); ++last)
+		{
+			BasisSubresource& sub = subresources[last];
+			uint64_t offset = round_up_64(groupSize, sliceAlignment);
+			uint64_t end = offset + (uint64_t)sub.mRowPitch * sub.mRowCount;
+			if (last > first && end > pCopyEngine->bufferSize)
+			{
+				break;
+			}
+			sub.mOffset = offset;
+			groupSize = end;
+		}
+
+		MappedMemoryRange upload = allocateStagingMemory(groupSize, sliceAlignment);
+		// Allocation can submit the set to free up ring space
+		cmd = acquireCmd(pCopyEngine, activeSet);
+
+		BasisTranscodeTask task = { pBasis, subresources.data() + first, upload.pData, 0 };
+		int64_t transcodeStart = getUSec();
+		runDecodeTask(pResourceLoader, transcodeBasisSubresource, &task, last - first);
+		addStreamerLoadTime(pResourceLoader, RESOURCE_LOAD_STAGE_DECODE, getUSec() - transcodeStart);
+		if (tfrg_atomic32_load_relaxed(&task.mFailed))
+		{
+			result = UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+			break;
+		}
+
+		for (uint32_t i = first; i < last; ++i)
+		{
+			const BasisSubresource& sub = subresources[i];
+			SubresourceDataDesc subresourceDesc = {};
+			subresourceDesc.mArrayLayer = sub.mLayer;
+			subresourceDesc.mMipLevel = sub.mMip;
+			subresourceDesc.mSrcOffset = upload.mOffset + sub.mOffset;
+#if defined(DIRECT3D11) || defined(METAL) || defined(VULKAN)
+			subresourceDesc.mRowPitch = sub.mRowPitch;
+			subresourceDesc.mSlicePitch = sub.mRowPitch * sub.mRowCount;
+#endif
+			cmdUpdateSubresource(cmd, texture, upload.pBuffer, &subresourceDesc);
 		}
+
+		first = last;
+	}
+
+#if defined(VULKAN)
+	if (gSelectedRendererApi == RENDERER_API_VULKAN)
+	{
+		barrier = { texture, RESOURCE_STATE_COPY_DEST, RESOURCE_STATE_SHADER_RESOURCE };
+		cmdResourceBarrier(cmd, 0, NULL, 1, &barrier, 0, NULL);
 	}
+#endif
+
+	tf_delete(pBasis);
+	return result;
 }
 
 static UploadFunctionResult updateTexture(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t activeSet, const TextureUpdateDescInternal& texUpdateDesc)
 {
+	if (texUpdateDesc.pBasisTexture)
+	{
+		return updateBasisTexture(pRenderer, pCopyEngine, activeSet, texUpdateDesc);
+	}
+
 	// When this call comes from updateResource, staging buffer data is already filled
 	// All that is left to do is record and execute the Copy commands
 	bool dataAlreadyFilled = texUpdateDesc.mRange.pBuffer ? true : false;
@@ -693,11 +1200,6 @@ static UploadFunctionResult updateTexture(Renderer* pRenderer, CopyEngine* pCopy
 
 	const uint32_t sliceAlignment = util_get_texture_subresource_alignment(pRenderer, fmt);
 	const uint32_t rowAlignment = util_get_texture_row_alignment(pRenderer);
-	const uint64_t requiredSize = util_get_surface_size(fmt, texture->mWidth, texture->mHeight, texture->mDepth,
-		rowAlignment,
-		sliceAlignment,
-		texUpdateDesc.mBaseMipLevel, texUpdateDesc.mMipLevels,
-		texUpdateDesc.mBaseArrayLayer, texUpdateDesc.mLayerCount);
 
 #if defined(VULKAN)
 	TextureBarrier barrier;
@@ -708,7 +1210,8 @@ static UploadFunctionResult updateTexture(Renderer* pRenderer, CopyEngine* pCopy
 	}
 #endif
 
-	MappedMemoryRange upload = dataAlreadyFilled ? texUpdateDesc.mRange : allocateStagingMemory(requiredSize, sliceAlignment);
+	// Loads stage one subresource at a time so large textures stream through the staging ring
+	MappedMemoryRange upload = texUpdateDesc.mRange;
 	uint64_t offset = 0;
 
 	// #TODO: Investigate - fsRead crashes if we pass the upload buffer mapped address. Allocating temporary buffer as a workaround. Does NX support loading from disk to GPU shared memory?
@@ -731,15 +1234,21 @@ static UploadFunctionResult updateTexture(Renderer* pRenderer, CopyEngine* pCopy
 	}
 #endif
 
-	if (!upload.pData)
+	if (dataAlreadyFilled && !upload.pData)
 	{
 		return UPLOAD_FUNCTION_RESULT_STAGING_BUFFER_FULL;
 	}
 
-	uint32_t firstStart = texUpdateDesc.mMipsAfterSlice ? texUpdateDesc.mBaseMipLevel : texUpdateDesc.mBaseArrayLayer;
-	uint32_t firstEnd = texUpdateDesc.mMipsAfterSlice ? (texUpdateDesc.mBaseMipLevel + texUpdateDesc.mMipLevels) : (texUpdateDesc.mBaseArrayLayer + texUpdateDesc.mLayerCount);
-	uint32_t secondStart = texUpdateDesc.mMipsAfterSlice ? texUpdateDesc.mBaseArrayLayer : texUpdateDesc.mBaseMipLevel;
-	uint32_t secondEnd = texUpdateDesc.mMipsAfterSlice ? (texUpdateDesc.mBaseArrayLayer + texUpdateDesc.mLayerCount) : (texUpdateDesc.mBaseMipLevel + texUpdateDesc.mMipLevels);
+	// Mips are iterated in stream order. The first mSkipMipLevels mips of the stream are not part of the texture
+	const uint32_t skipMipLevels = texUpdateDesc.mSkipMipLevels;
+	const uint32_t mipStart = texUpdateDesc.mBaseMipLevel;
+	const uint32_t mipEnd = texUpdateDesc.mBaseMipLevel + skipMipLevels + texUpdateDesc.mMipLevels;
+	ASSERT(!skipMipLevels || !dataAlreadyFilled);
+
+	uint32_t firstStart = texUpdateDesc.mMipsAfterSlice ? mipStart : texUpdateDesc.mBaseArrayLayer;
+	uint32_t firstEnd = texUpdateDesc.mMipsAfterSlice ? mipEnd : (texUpdateDesc.mBaseArrayLayer + texUpdateDesc.mLayerCount);
+	uint32_t secondStart = texUpdateDesc.mMipsAfterSlice ? texUpdateDesc.mBaseArrayLayer : mipStart;
+	uint32_t secondEnd = texUpdateDesc.mMipsAfterSlice ? (texUpdateDesc.mBaseArrayLayer + texUpdateDesc.mLayerCount) : mipEnd;
 
 	for (uint32_t p = 0; p < 1; ++p)
 	{
@@ -760,6 +1269,18 @@ static UploadFunctionResult updateTexture(Renderer* pRenderer, CopyEngine* pCopy
 				uint32_t mip = texUpdateDesc.mMipsAfterSlice ? j : i;
 				uint32_t layer = texUpdateDesc.mMipsAfterSlice ? i : j;
 
+				if (mip < mipStart + skipMipLevels)
+				{
+					uint32_t skipBytes = 0;
+					if (!util_get_surface_info(MIP_REDUCE(texUpdateDesc.mSrcWidth, mip), MIP_REDUCE(texUpdateDesc.mSrcHeight, mip), fmt, &skipBytes, NULL, NULL) ||
+						!fsSeekStream(&stream, SBO_CURRENT_POSITION, (ssize_t)skipBytes * MIP_REDUCE(texUpdateDesc.mSrcDepth, mip)))
+					{
+						return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+					}
+					continue;
+				}
+				mip -= skipMipLevels;
+
 				uint32_t w = MIP_REDUCE(texture->mWidth, mip);
 				uint32_t h = MIP_REDUCE(texture->mHeight, mip);
 				uint32_t d = MIP_REDUCE(texture->mDepth, mip);
@@ -779,6 +1300,14 @@ static UploadFunctionResult updateTexture(Renderer* pRenderer, CopyEngine* pCopy
 				uint32_t subNumRows = numRows;
 				uint32_t subDepth = d;
 				uint32_t subRowSize = rowBytes;
+
+				if (!dataAlreadyFilled)
+				{
+					upload = allocateStagingMemory((uint64_t)subDepth * subSlicePitch, sliceAlignment);
+					offset = 0;
+					// Allocation can submit the set to free up ring space
+					cmd = acquireCmd(pCopyEngine, activeSet);
+				}
 				uint8_t* data = upload.pData + offset;
 
 				if (!dataAlreadyFilled)
@@ -826,793 +1355,2934 @@ static UploadFunctionResult updateTexture(Renderer* pRenderer, CopyEngine* pCopy
 	return UPLOAD_FUNCTION_RESULT_COMPLETED;
 }
 
-static UploadFunctionResult loadTexture(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t activeSet, const UpdateRequest& pTextureUpdate)
-{
-	const TextureLoadDesc* pTextureDesc = &pTextureUpdate.texLoadDesc;
+static const char* gTextureContainerExtensions[] = { NULL, "dds", "ktx", "gnf", "basis", "svt" };
 
-	if (pTextureDesc->pFileName)
+static TextureContainerType util_get_texture_container(const TextureLoadDesc* pTextureDesc)
+{
+	TextureContainerType container = pTextureDesc->mContainer;
+	if (TEXTURE_CONTAINER_DEFAULT == container)
 	{
-		FileStream stream = {};
-		char fileName[FS_MAX_PATH] = {};
-		bool success = false;
-
-		TextureUpdateDescInternal updateDesc = {};
-		TextureContainerType container = pTextureDesc->mContainer;
-		static const char* extensions[] = { NULL, "dds", "ktx", "gnf", "basis", "svt" };
-
-		if (TEXTURE_CONTAINER_DEFAULT == container)
-		{
 #if defined(TARGET_IOS) || defined(__ANDROID__) || defined(NX64)
-			container = TEXTURE_CONTAINER_KTX;
+		container = TEXTURE_CONTAINER_KTX;
 #elif defined(_WINDOWS) || defined(XBOX) || defined(__APPLE__) || defined(__linux__)
-			container = TEXTURE_CONTAINER_DDS;
+		container = TEXTURE_CONTAINER_DDS;
 #elif defined(ORBIS) || defined(PROSPERO)
-			container = TEXTURE_CONTAINER_GNF;
+		container = TEXTURE_CONTAINER_GNF;
 #endif
-		}
+	}
+	return container;
+}
 
-		TextureDesc textureDesc = {};
-		textureDesc.pName = pTextureDesc->pFileName;
+// Containers which are parsed on the CPU only. The others create the texture while reading the file
+static bool util_is_decodable_texture_container(TextureContainerType container)
+{
+	switch (container)
+	{
+#if !defined(XBOX)
+	case TEXTURE_CONTAINER_DDS:
+#endif
+	case TEXTURE_CONTAINER_KTX:
+	case TEXTURE_CONTAINER_BASIS:
+		return true;
+	default:
+		return false;
+	}
+}
 
-		// Validate that we have found the file format now
-		ASSERT(container != TEXTURE_CONTAINER_DEFAULT);  //-V547
-		if (TEXTURE_CONTAINER_DEFAULT == container)      //-V547
-		{
-			return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
-		}
+/************************************************************************/
+// Source images
+/************************************************************************/
+// Development mode: while RD_TEXTURE_CACHE is set, a dds / ktx missing from RD_TEXTURES is built from a png / jpg / hdr / exr
+// of the same name. The image is decoded, gets a full mip chain and is written to RD_TEXTURE_CACHE as a regular container,
+// which later runs load directly as long as it is newer than the source
+static const char* gSourceImageExtensions[] = { "png", "jpg", "jpeg", "hdr", "exr" };
 
-		fsAppendPathExtension(pTextureDesc->pFileName, extensions[container], fileName);
+// Rows of the next mip filtered by one decode task
+#define MIP_FILTER_TASK_ROWS 32
+#define SOURCE_IMAGE_MAX_MIP_LEVELS 16
 
-		switch (container)
-		{
-		case TEXTURE_CONTAINER_DDS:
+static float gSrgbToLinear[256];
+
+static void initSourceImageTables()
+{
+	for (uint32_t i = 0; i < 256; ++i)
+	{
+		const float c = i / 255.0f;
+		gSrgbToLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+	}
+}
+
+/// Decoded source image with all mips packed tightly one after the other
+typedef struct SourceImage
+{
+	uint8_t*        pData;
+	uint32_t        mWidth;
+	uint32_t        mHeight;
+	uint32_t        mMipLevels;
+	TinyImageFormat mFormat;
+	uint32_t        mMipSizes[SOURCE_IMAGE_MAX_MIP_LEVELS];
+	const void*     pMips[SOURCE_IMAGE_MAX_MIP_LEVELS];
+} SourceImage;
+
+typedef struct MipFilterTask
+{
+	const uint8_t*  pSrc;
+	uint8_t*        pDst;
+	uint32_t        mSrcWidth;
+	uint32_t        mSrcHeight;
+	uint32_t        mDstWidth;
+	uint32_t        mDstHeight;
+	TinyImageFormat mFormat;
+} MipFilterTask;
+
+/// Growable buffer the container writers append to
+typedef struct TextureWriteBuffer
+{
+	uint8_t* pData;
+	size_t   mSize;
+	size_t   mCapacity;
+} TextureWriteBuffer;
+
+// 8 bit rows are filtered in float. sRGB color channels are converted to linear first
+static void util_decode_mip_row(const uint8_t* pSrc, uint32_t count, bool srgb, float* pDst)
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		pDst[i] = (srgb && 3 != (i & 3)) ? gSrgbToLinear[pSrc[i]] : pSrc[i] * (1.0f / 255.0f);
+	}
+}
+
+static void util_encode_mip_row(const float* pSrc, uint32_t count, bool srgb, uint8_t* pDst)
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		float v = clamp(pSrc[i], 0.0f, 1.0f);
+		if (srgb && 3 != (i & 3))
 		{
-#if defined(XBOX)
-			success = fsOpenStreamFromPath(RD_TEXTURES, fileName, FM_READ_BINARY, &stream);
-			uint32_t res = 1;
-			if (success)
-			{
-				extern uint32_t loadXDDSTexture(Renderer* pRenderer, FileStream* stream, const char* name, TextureCreationFlags flags, Texture** ppTexture);
-				res = loadXDDSTexture(pRenderer, &stream, fileName, pTextureDesc->mCreationFlag, pTextureDesc->ppTexture);
-				fsCloseStream(&stream);
-			}
+			v = v <= 0.0031308f ? v * 12.92f : 1.055f * powf(v, 1.0f / 2.4f) - 0.055f;
+		}
+		pDst[i] = (uint8_t)(v * 255.0f + 0.5f);
+	}
+}
 
-			return res ? UPLOAD_FUNCTION_RESULT_INVALID_REQUEST : UPLOAD_FUNCTION_RESULT_COMPLETED;
+// 2x2 box filter of two float4 rows into one row of the next mip. The last column of odd widths is repeated
+static void filterMipRow(const float* pRow0, const float* pRow1, uint32_t srcWidth, float* pDst, uint32_t dstWidth)
+{
+	for (uint32_t x = 0; x < dstWidth; ++x)
+	{
+		const uint32_t x0 = min(2 * x, srcWidth - 1) * 4;
+		const uint32_t x1 = min(2 * x + 1, srcWidth - 1) * 4;
+#if defined(MIP_FILTER_SSE2)
+		const __m128 sum = _mm_add_ps(
+			_mm_add_ps(_mm_loadu_ps(pRow0 + x0), _mm_loadu_ps(pRow0 + x1)), _mm_add_ps(_mm_loadu_ps(pRow1 + x0), _mm_loadu_ps(pRow1 + x1)));
+		_mm_storeu_ps(pDst + x * 4, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#elif defined(MIP_FILTER_NEON)
+		const float32x4_t sum =
+			vaddq_f32(vaddq_f32(vld1q_f32(pRow0 + x0), vld1q_f32(pRow0 + x1)), vaddq_f32(vld1q_f32(pRow1 + x0), vld1q_f32(pRow1 + x1)));
+		vst1q_f32(pDst + x * 4, vmulq_n_f32(sum, 0.25f));
 #else
-			success = fsOpenStreamFromPath(RD_TEXTURES, fileName, FM_READ_BINARY, &stream);
-			if (success)
-			{
-				success = loadDDSTextureDesc(&stream, &textureDesc);
-			}
-#endif
-			break;
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			pDst[x * 4 + c] = (pRow0[x0 + c] + pRow0[x1 + c] + pRow1[x0 + c] + pRow1[x1 + c]) * 0.25f;
 		}
-		case TEXTURE_CONTAINER_KTX:
+#endif
+	}
+}
+
+static void filterMipRows(void* pUserData, uint32_t index)
+{
+	const MipFilterTask* pTask = (const MipFilterTask*)pUserData;
+	const bool isFloat = TinyImageFormat_R32G32B32A32_SFLOAT == pTask->mFormat;
+	const bool srgb = TinyImageFormat_R8G8B8A8_SRGB == pTask->mFormat;
+	const uint32_t srcCount = pTask->mSrcWidth * 4;
+	const uint32_t dstCount = pTask->mDstWidth * 4;
+	float* pScratch = isFloat ? NULL : (float*)tf_malloc((2 * srcCount + dstCount) * sizeof(float));
+
+	const uint32_t firstRow = index * MIP_FILTER_TASK_ROWS;
+	const uint32_t lastRow = min(firstRow + MIP_FILTER_TASK_ROWS, pTask->mDstHeight);
+	for (uint32_t y = firstRow; y < lastRow; ++y)
+	{
+		const uint32_t y0 = min(2 * y, pTask->mSrcHeight - 1);
+		const uint32_t y1 = min(2 * y + 1, pTask->mSrcHeight - 1);
+		if (isFloat)
 		{
-			success = fsOpenStreamFromPath(RD_TEXTURES, fileName, FM_READ_BINARY, &stream);
-			if (success)
-			{
-				success = loadKTXTextureDesc(&stream, &textureDesc);
-				updateDesc.mMipsAfterSlice = true;
-				// KTX stores mip size before the mip data
-				// This function gets called to skip the mip size so we read the mip data
-				updateDesc.pPreMipFunc = [](FileStream* pStream, uint32_t)
-				{
-					uint32_t mipSize = 0;
-					fsReadFromStream(pStream, &mipSize, sizeof(mipSize));
-				};
-			}
-			break;
+			const float* pSrc = (const float*)pTask->pSrc;
+			filterMipRow(pSrc + y0 * srcCount, pSrc + y1 * srcCount, pTask->mSrcWidth, (float*)pTask->pDst + y * dstCount, pTask->mDstWidth);
 		}
-		case TEXTURE_CONTAINER_BASIS:
+		else
 		{
-			void* data = NULL;
-			uint32_t dataSize = 0;
-			success = fsOpenStreamFromPath(RD_TEXTURES, fileName, FM_READ_BINARY, &stream);
-			if (success)
-			{
-				success = loadBASISTextureDesc(&stream, &textureDesc, &data, &dataSize);
-				if (success)
-				{
-					fsCloseStream(&stream);
-					fsOpenStreamFromMemory(data, dataSize, FM_READ_BINARY, true, &stream);
-				}
-			}
-			break;
+			float* pRow0 = pScratch;
+			float* pRow1 = pRow0 + srcCount;
+			float* pRow = pRow1 + srcCount;
+			util_decode_mip_row(pTask->pSrc + y0 * srcCount, srcCount, srgb, pRow0);
+			util_decode_mip_row(pTask->pSrc + y1 * srcCount, srcCount, srgb, pRow1);
+			filterMipRow(pRow0, pRow1, pTask->mSrcWidth, pRow, pTask->mDstWidth);
+			util_encode_mip_row(pRow, dstCount, srgb, pTask->pDst + y * dstCount);
 		}
-		case TEXTURE_CONTAINER_GNF:
+	}
+
+	if (pScratch)
+	{
+		tf_free(pScratch);
+	}
+}
+
+// Decodes the source to RGBA8 (png / jpg) or RGBA32F (hdr / exr) and generates the mip chain on the decode threads
+static bool decodeSourceImage(const char* sourceName, bool srgb, SourceImage* pOut)
+{
+	FileStream file = {};
+	if (!fsOpenMappedStreamFromPath(RD_TEXTURES, sourceName, &file))
+	{
+		return false;
+	}
+
+	char extension[FS_MAX_PATH] = {};
+	fsGetPathExtension(sourceName, extension);
+
+	int width = 0;
+	int height = 0;
+	void* pPixels = NULL;
+	const char* error = NULL;
+	if (!strcmp(extension, "exr"))
+	{
+		if (!ParseEXRHeaderFromMemory(&width, &height, file.mMemory.pBuffer) && width > 0 && height > 0)
 		{
-#if defined(ORBIS) || defined(PROSPERO)
-			success = fsOpenStreamFromPath(RD_TEXTURES, fileName, FM_READ_BINARY, &stream);
-			uint32_t res = 1;
-			if (success)
+			pPixels = tf_malloc((size_t)width * height * 4 * sizeof(float));
+			if (LoadEXRFromMemory((float*)pPixels, file.mMemory.pBuffer, &error))
 			{
-				extern uint32_t loadGnfTexture(Renderer* pRenderer, FileStream* stream, const char* name, TextureCreationFlags flags, Texture** ppTexture);
-				res = loadGnfTexture(pRenderer, &stream, fileName, pTextureDesc->mCreationFlag, pTextureDesc->ppTexture);
-				fsCloseStream(&stream);
+				tf_free(pPixels);
+				pPixels = NULL;
 			}
-
-			return res ? UPLOAD_FUNCTION_RESULT_INVALID_REQUEST : UPLOAD_FUNCTION_RESULT_COMPLETED;
-#endif
-		}
-		default:
-			break;
 		}
-
-		if (success)
+		pOut->mFormat = TinyImageFormat_R32G32B32A32_SFLOAT;
+	}
+	else
+	{
+		int components = 0;
+		const int size = (int)file.mSize;
+		if (stbi_is_hdr_from_memory(file.mMemory.pBuffer, size))
 		{
-			textureDesc.mStartState = RESOURCE_STATE_COMMON;
-			textureDesc.mFlags |= pTextureDesc->mCreationFlag;
-			textureDesc.mNodeIndex = pTextureDesc->mNodeIndex;
-#if defined (VULKAN)
-			if (NULL != pTextureDesc->pDesc)
-				textureDesc.pVkSamplerYcbcrConversionInfo = pTextureDesc->pDesc->pVkSamplerYcbcrConversionInfo;
-#endif
-			addTexture(pRenderer, &textureDesc, pTextureDesc->ppTexture);
-
-			updateDesc.mStream = stream;
-			updateDesc.pTexture = *pTextureDesc->ppTexture;
-			updateDesc.mBaseMipLevel = 0;
-			updateDesc.mMipLevels = textureDesc.mMipLevels;
-			updateDesc.mBaseArrayLayer = 0;
-			updateDesc.mLayerCount = textureDesc.mArraySize;
-
-			return updateTexture(pRenderer, pCopyEngine, activeSet, updateDesc);
+			pPixels = stbi_loadf_from_memory(file.mMemory.pBuffer, size, &width, &height, &components, 4);
+			pOut->mFormat = TinyImageFormat_R32G32B32A32_SFLOAT;
 		}
-		/************************************************************************/
-		// Sparse Tetxtures
-		/************************************************************************/
-#if defined(DIRECT3D12) || defined(VULKAN)
-		if (TEXTURE_CONTAINER_SVT == container)
+		else
 		{
-			if (fsOpenStreamFromPath(RD_TEXTURES, fileName, FM_READ_BINARY, &stream))
-			{
-				success = loadSVTTextureDesc(&stream, &textureDesc);
-				if (success)
-				{
-					ssize_t dataSize = fsGetStreamFileSize(&stream) - fsGetStreamSeekPosition(&stream);
-					void* data = tf_malloc(dataSize);
-					fsReadFromStream(&stream, data, dataSize);
-
-					textureDesc.mStartState = RESOURCE_STATE_COPY_DEST;
-					textureDesc.mFlags |= pTextureDesc->mCreationFlag;
-					textureDesc.mNodeIndex = pTextureDesc->mNodeIndex;
-					addVirtualTexture(acquireCmd(pCopyEngine, activeSet), &textureDesc, pTextureDesc->ppTexture, data);
-					/************************************************************************/
-					// Create visibility buffer
-					/************************************************************************/
-					eastl::vector<VirtualTexturePage>* pPageTable = (eastl::vector<VirtualTexturePage>*)(*pTextureDesc->ppTexture)->pSvt->pPages;
-
-					if (pPageTable == NULL)
-						return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+			pPixels = stbi_load_from_memory(file.mMemory.pBuffer, size, &width, &height, &components, 4);
+			pOut->mFormat = srgb ? TinyImageFormat_R8G8B8A8_SRGB : TinyImageFormat_R8G8B8A8_UNORM;
+		}
+		error = stbi_failure_reason();
+	}
+	fsCloseStream(&file);
 
-					BufferLoadDesc visDesc = {};
-					visDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_RW_BUFFER;
-					visDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_GPU_ONLY;
-					visDesc.mDesc.mStructStride = sizeof(uint);
-					visDesc.mDesc.mElementCount = (uint64_t)pPageTable->size();
-					visDesc.mDesc.mSize = visDesc.mDesc.mStructStride * visDesc.mDesc.mElementCount;
-					visDesc.mDesc.mStartState = RESOURCE_STATE_COMMON;
-					visDesc.mDesc.pName = "Vis Buffer for Sparse Texture";
-					visDesc.ppBuffer = &(*pTextureDesc->ppTexture)->pSvt->mVisibility;
-					addResource(&visDesc, NULL);
+	if (!pPixels)
+	{
+		LOGF(eERROR, "Failed to decode texture source %s: %s", sourceName, error ? error : "unknown error");
+		return false;
+	}
 
-					BufferLoadDesc prevVisDesc = {};
-					prevVisDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_RW_BUFFER;
-					prevVisDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_GPU_ONLY;
-					prevVisDesc.mDesc.mStructStride = sizeof(uint);
-					prevVisDesc.mDesc.mElementCount = (uint64_t)pPageTable->size();
-					prevVisDesc.mDesc.mSize = prevVisDesc.mDesc.mStructStride * prevVisDesc.mDesc.mElementCount;
-					prevVisDesc.mDesc.mStartState = RESOURCE_STATE_COMMON;
-					prevVisDesc.mDesc.pName = "Prev Vis Buffer for Sparse Texture";
-					prevVisDesc.ppBuffer = &(*pTextureDesc->ppTexture)->pSvt->mPrevVisibility;
-					addResource(&prevVisDesc, NULL);
+	pOut->mWidth = (uint32_t)width;
+	pOut->mHeight = (uint32_t)height;
+	pOut->mMipLevels = min((uint32_t)SOURCE_IMAGE_MAX_MIP_LEVELS, (uint32_t)log2(max(width, height)) + 1);
 
-					BufferLoadDesc alivePageDesc = {};
-					alivePageDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_RW_BUFFER;
-					alivePageDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_CPU_TO_GPU;
+	const uint32_t texelSize = TinyImageFormat_BitSizeOfBlock(pOut->mFormat) / 8;
+	size_t dataSize = 0;
+	for (uint32_t mip = 0; mip < pOut->mMipLevels; ++mip)
+	{
+		pOut->mMipSizes[mip] = MIP_REDUCE(pOut->mWidth, mip) * MIP_REDUCE(pOut->mHeight, mip) * texelSize;
+		dataSize += pOut->mMipSizes[mip];
+	}
 
-					alivePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT | BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
-#if defined(DIRECT3D12)
-					if(gSelectedRendererApi == RENDERER_API_D3D12)
-						alivePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
-#endif
-#if defined(VULKAN)
-					if(gSelectedRendererApi == RENDERER_API_VULKAN)
-						alivePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT;
-#endif
+	pOut->pData = (uint8_t*)tf_malloc(dataSize);
+	memcpy(pOut->pData, pPixels, pOut->mMipSizes[0]);
+	// stb_image allocates through tf_malloc as well
+	tf_free(pPixels);
 
-					alivePageDesc.mDesc.mStructStride = sizeof(uint);
-					alivePageDesc.mDesc.mElementCount = (uint64_t)pPageTable->size();
-					alivePageDesc.mDesc.mSize = alivePageDesc.mDesc.mStructStride * alivePageDesc.mDesc.mElementCount;
-					alivePageDesc.mDesc.pName = "Alive pages buffer for Sparse Texture";
-					alivePageDesc.ppBuffer = &(*pTextureDesc->ppTexture)->pSvt->mAlivePage;
-					addResource(&alivePageDesc, NULL);
+	// Every mip is filtered from the previous one. Rows of a mip are independent and are spread over the decode threads
+	uint8_t* pMip = pOut->pData;
+	pOut->pMips[0] = pMip;
+	for (uint32_t mip = 1; mip < pOut->mMipLevels; ++mip)
+	{
+		MipFilterTask task = {};
+		task.pSrc = pMip;
+		task.pDst = pMip + pOut->mMipSizes[mip - 1];
+		task.mSrcWidth = MIP_REDUCE(pOut->mWidth, mip - 1);
+		task.mSrcHeight = MIP_REDUCE(pOut->mHeight, mip - 1);
+		task.mDstWidth = MIP_REDUCE(pOut->mWidth, mip);
+		task.mDstHeight = MIP_REDUCE(pOut->mHeight, mip);
+		task.mFormat = pOut->mFormat;
+		runDecodeTask(pResourceLoader, filterMipRows, &task, (task.mDstHeight + MIP_FILTER_TASK_ROWS - 1) / MIP_FILTER_TASK_ROWS);
+
+		pMip = task.pDst;
+		pOut->pMips[mip] = pMip;
+	}
 
-					BufferLoadDesc removePageDesc = {};
-					removePageDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_RW_BUFFER;
-					removePageDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_CPU_TO_GPU;
-					removePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT | BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
-#if defined(DIRECT3D12)
-					if (gSelectedRendererApi == RENDERER_API_D3D12)
-						removePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
-#endif
-#if defined(VULKAN)
-					if (gSelectedRendererApi == RENDERER_API_VULKAN)
-						removePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT;
-#endif
+	return true;
+}
 
-					removePageDesc.mDesc.mStructStride = sizeof(uint);
-					removePageDesc.mDesc.mElementCount = (uint64_t)pPageTable->size();
-					removePageDesc.mDesc.mSize = removePageDesc.mDesc.mStructStride * removePageDesc.mDesc.mElementCount;
-					removePageDesc.mDesc.pName = "Remove pages buffer for Sparse Texture";
-					removePageDesc.ppBuffer = &(*pTextureDesc->ppTexture)->pSvt->mRemovePage;
-					addResource(&removePageDesc, NULL);
+static void writeTextureBuffer(void* user, const void* buffer, size_t byteCount)
+{
+	TextureWriteBuffer* pBuffer = (TextureWriteBuffer*)user;
+	if (pBuffer->mSize + byteCount > pBuffer->mCapacity)
+	{
+		pBuffer->mCapacity = max(pBuffer->mSize + byteCount, pBuffer->mCapacity * 2);
+		pBuffer->pData = (uint8_t*)tf_realloc(pBuffer->pData, pBuffer->mCapacity);
+	}
+	memcpy(pBuffer->pData + pBuffer->mSize, buffer, byteCount);
+	pBuffer->mSize += byteCount;
+}
 
-					BufferLoadDesc pageCountsDesc = {};
-					pageCountsDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_RW_BUFFER;
-					pageCountsDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_CPU_TO_GPU;
-					pageCountsDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT | BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
-#if defined(DIRECT3D12)
-					if (gSelectedRendererApi == RENDERER_API_D3D12)
-						pageCountsDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
-#endif
-#if defined(VULKAN)
-					if (gSelectedRendererApi == RENDERER_API_VULKAN)
-						pageCountsDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT;
-#endif
-					pageCountsDesc.mDesc.mStructStride = sizeof(uint);
-					pageCountsDesc.mDesc.mElementCount = 4;
-					pageCountsDesc.mDesc.mSize = pageCountsDesc.mDesc.mStructStride * pageCountsDesc.mDesc.mElementCount;
-					pageCountsDesc.mDesc.pName = "Page count buffer for Sparse Texture";
-					pageCountsDesc.ppBuffer = &(*pTextureDesc->ppTexture)->pSvt->mPageCounts;
-					addResource(&pageCountsDesc, NULL);
+static bool writeSourceImageContainer(TextureContainerType container, SourceImage* pImage, TextureWriteBuffer* pOut)
+{
+	size_t dataSize = 0;
+	for (uint32_t mip = 0; mip < pImage->mMipLevels; ++mip)
+	{
+		dataSize += pImage->mMipSizes[mip];
+	}
+	// Headers plus the KTX mip sizes
+	pOut->mCapacity = dataSize + 256 + pImage->mMipLevels * sizeof(uint32_t);
+	pOut->pData = (uint8_t*)tf_malloc(pOut->mCapacity);
 
-					fsCloseStream(&stream);
+	if (TEXTURE_CONTAINER_KTX == container)
+	{
+		TinyKtx_WriteCallbacks callbacks
+		{
+			[](void*, char const* msg) { LOGF(eERROR, "%s", msg); },
+			[](void*, size_t size) { return tf_malloc(size); },
+			[](void*, void* memory) { tf_free(memory); },
+			writeTextureBuffer
+		};
+		return TinyKtx_WriteImage(
+			&callbacks, pOut, pImage->mWidth, pImage->mHeight, 1, 1, pImage->mMipLevels, TinyImageFormat_ToTinyKtxFormat(pImage->mFormat),
+			false, pImage->mMipSizes, pImage->pMips);
+	}
 
-					return UPLOAD_FUNCTION_RESULT_COMPLETED;
-				}
-			}
+	TinyDDS_WriteCallbacks callbacks
+	{
+		[](void*, char const* msg) { LOGF(eERROR, "%s", msg); },
+		[](void*, size_t size) { return tf_malloc(size); },
+		[](void*, void* memory) { tf_free(memory); },
+		writeTextureBuffer
+	};
+	return TinyDDS_WriteImage(
+		&callbacks, pOut, pImage->mWidth, pImage->mHeight, 1, 1, pImage->mMipLevels, TinyImageFormat_ToTinyDDSFormat(pImage->mFormat), false,
+		true, pImage->mMipSizes, pImage->pMips);
+}
 
-			return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+// Cache entries are flat. Sub directories become part of the name, sRGB conversions are kept apart from linear ones
+static void getTextureCacheName(TextureContainerType container, const char* fileName, bool srgb, char* pOut)
+{
+	char baseName[FS_MAX_PATH] = {};
+	strncpy(baseName, fileName, FS_MAX_PATH - 1);
+	char* pExtension = strrchr(baseName, '.');
+	if (pExtension)
+	{
+		*pExtension = 0;
+	}
+	for (char* c = baseName; *c; ++c)
+	{
+		if ('/' == *c || '\\' == *c)
+		{
+			*c = '_';
 		}
-#endif
 	}
-
-	return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+	snprintf(pOut, FS_MAX_PATH, "%s%s.%s", baseName, srgb ? "_srgb" : "", gTextureContainerExtensions[container]);
 }
 
-static UploadFunctionResult updateBuffer(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t activeSet, const BufferUpdateDesc& bufUpdateDesc)
+// Opens the converted container of the first source image found for fileName, converting it if the cache is missing or stale
+static bool openSourceTexture(TextureContainerType container, const char* fileName, TextureCreationFlags flags, FileStream* pStream)
 {
-	ASSERT(pCopyEngine->pQueue->mNodeIndex == bufUpdateDesc.pBuffer->mNodeIndex);
-	Buffer* pBuffer = bufUpdateDesc.pBuffer;
-	ASSERT(pBuffer->mMemoryUsage == RESOURCE_MEMORY_USAGE_GPU_ONLY || pBuffer->mMemoryUsage == RESOURCE_MEMORY_USAGE_GPU_TO_CPU);
-
-	Cmd* pCmd = acquireCmd(pCopyEngine, activeSet);
-
-	MappedMemoryRange range = bufUpdateDesc.mInternal.mMappedRange;
-	cmdUpdateBuffer(pCmd, pBuffer, bufUpdateDesc.mDstOffset, range.pBuffer, range.mOffset, range.mSize);
+	char sourceName[FS_MAX_PATH] = {};
+	time_t sourceTime = 0;
+	for (uint32_t i = 0; i < sizeof(gSourceImageExtensions) / sizeof(gSourceImageExtensions[0]) && !sourceTime; ++i)
+	{
+		fsReplacePathExtension(fileName, gSourceImageExtensions[i], sourceName);
+		sourceTime = fsGetLastModifiedTime(RD_TEXTURES, sourceName);
+	}
+	if (!sourceTime)
+	{
+		LOGF(eERROR, "Texture %s not found and no source image to convert it from", fileName);
+		return false;
+	}
 
-	return UPLOAD_FUNCTION_RESULT_COMPLETED;
-}
+	const bool srgb = (flags & TEXTURE_CREATION_FLAG_SRGB) != 0;
+	char cacheName[FS_MAX_PATH] = {};
+	getTextureCacheName(container, fileName, srgb, cacheName);
+	if (fsGetLastModifiedTime(RD_TEXTURE_CACHE, cacheName) >= sourceTime)
+	{
+		return fsOpenStreamFromPath(RD_TEXTURE_CACHE, cacheName, FM_READ_BINARY, pStream);
+	}
 
-static UploadFunctionResult loadGeometry(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t activeSet, UpdateRequest& pGeometryLoad)
-{
-	GeometryLoadDesc* pDesc = &pGeometryLoad.geomLoadDesc;
+	SourceImage image = {};
+	if (!decodeSourceImage(sourceName, srgb, &image))
+	{
+		return false;
+	}
 
-	char iext[FS_MAX_PATH] = { 0 };
-	fsGetPathExtension(pDesc->pFileName, iext);
+	TextureWriteBuffer buffer = {};
+	const bool success = writeSourceImageContainer(container, &image, &buffer);
+	tf_free(image.pData);
+	if (!success)
+	{
+		LOGF(eERROR, "Failed to convert texture source %s", sourceName);
+		tf_free(buffer.pData);
+		return false;
+	}
 
-	// Geometry in gltf container
-	if (iext[0] != 0 && (stricmp(iext, "gltf") == 0 || stricmp(iext, "glb") == 0))
+	// Same scheme as the geometry cache. Concurrent conversions of one texture never observe a partially written file
+	char tempName[FS_MAX_PATH] = {};
+	snprintf(tempName, sizeof(tempName), "%s.%llx.tmp", cacheName, (unsigned long long)(uintptr_t)Thread::GetCurrentThreadID());
+	FileStream cache = {};
+	bool written = fsOpenStreamFromPath(RD_TEXTURE_CACHE, tempName, FM_WRITE_BINARY, &cache);
+	if (written)
 	{
-		FileStream file = {};
-		if (!fsOpenStreamFromPath(RD_MESHES, pDesc->pFileName, FM_READ_BINARY, &file))
+		written = fsWriteToStream(&cache, buffer.pData, buffer.mSize) == buffer.mSize;
+		fsCloseStream(&cache);
+		written = written && fsRenameFile(RD_TEXTURE_CACHE, tempName, cacheName);
+		if (!written)
 		{
-			LOGF(eERROR, "Failed to open gltf file %s", pDesc->pFileName);
-			ASSERT(false);
-			return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+			fsRemoveFile(RD_TEXTURE_CACHE, tempName);
 		}
+	}
 
-		ssize_t fileSize = fsGetStreamFileSize(&file);
-		void* fileData = tf_malloc(fileSize);
+	if (written)
+	{
+		LOGF(eINFO, "Converted texture source %s to %s", sourceName, cacheName);
+	}
+	else
+	{
+		LOGF(eWARNING, "Failed to write texture cache %s", cacheName);
+	}
 
-		fsReadFromStream(&file, fileData, fileSize);
+	// The converted container is used straight from memory
+	return fsOpenStreamFromMemory(buffer.pData, buffer.mSize, FM_READ_BINARY, true, pStream);
+}
 
-		cgltf_options options = {};
-		cgltf_data* data = NULL;
-		options.memory_alloc = [](void* user, cgltf_size size) { return tf_malloc(size); };
-		options.memory_free = [](void* user, void* ptr) { tf_free(ptr); };
-		cgltf_result result = cgltf_parse(&options, fileData, fileSize, &data);
-		fsCloseStream(&file);
+static bool openTextureFile(TextureContainerType container, const char* fileName, TextureCreationFlags flags, FileStream* pStream)
+{
+	if ((TEXTURE_CONTAINER_DDS == container || TEXTURE_CONTAINER_KTX == container) && fsIsResourceDirectorySet(RD_TEXTURE_CACHE) &&
+		!fsGetLastModifiedTime(RD_TEXTURES, fileName))
+	{
+		return openSourceTexture(container, fileName, flags, pStream);
+	}
+	return fsOpenStreamFromPath(RD_TEXTURES, fileName, FM_READ_BINARY, pStream);
+}
 
-		if (cgltf_result_success != result)
+// Opens the texture file and parses the container header
+// On success the stream is positioned at the first subresource
+static bool openTextureContainer(
+	TextureContainerType container, const char* fileName, TextureCreationFlags flags, FileStream* pStream, TextureDesc* pTextureDesc,
+	TextureUpdateDescInternal* pUpdateDesc)
+{
+	bool success = false;
+
+	switch (container)
+	{
+	case TEXTURE_CONTAINER_DDS:
+	{
+		success = openTextureFile(container, fileName, flags, pStream);
+		if (success)
 		{
-			LOGF(eERROR, "Failed to parse gltf file %s with error %u", pDesc->pFileName, (uint32_t)result);
-			ASSERT(false);
-			tf_free(fileData);
-			return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+			success = loadDDSTextureDesc(pStream, pTextureDesc);
 		}
-
-#if defined(FORGE_DEBUG)
-		result = cgltf_validate(data);
-		if (cgltf_result_success != result)
+		break;
+	}
+	case TEXTURE_CONTAINER_KTX:
+	{
+		success = openTextureFile(container, fileName, flags, pStream);
+		if (success)
 		{
-			LOGF(eWARNING, "GLTF validation finished with error %u for file %s", (uint32_t)result, pDesc->pFileName);
+			success = loadKTXTextureDesc(pStream, pTextureDesc);
+			pUpdateDesc->mMipsAfterSlice = true;
+			// KTX stores mip size before the mip data
+			// This function gets called to skip the mip size so we read the mip data
+			pUpdateDesc->pPreMipFunc = [](FileStream* pStream, uint32_t)
+			{
+				uint32_t mipSize = 0;
+				fsReadFromStream(pStream, &mipSize, sizeof(mipSize));
+			};
 		}
-#endif
-
-		// Load buffers located in separate files (.bin) using our file system
-		for (uint32_t i = 0; i < data->buffers_count; ++i)
+		break;
+	}
+	case TEXTURE_CONTAINER_BASIS:
+	{
+		success = fsOpenStreamFromPath(RD_TEXTURES, fileName, FM_READ_BINARY, pStream);
+		if (success)
 		{
-			const char* uri = data->buffers[i].uri;
-
-			if (!uri || data->buffers[i].data)
+			// The whole file is kept in memory. Subresources are transcoded by updateBasisTexture
+			BasisTexture* pBasis = tf_new(BasisTexture);
+			success = loadBASISTextureDesc(pStream, pResourceLoader->pRenderer->pCapBits, pTextureDesc, pBasis);
+			fsCloseStream(pStream);
+			*pStream = {};
+			if (success)
 			{
-				continue;
+				pUpdateDesc->pBasisTexture = pBasis;
 			}
-
-			if (strncmp(uri, "data:", 5) != 0 && !strstr(uri, "://"))
+			else
 			{
-				char parent[FS_MAX_PATH] = { 0 };
-				fsGetParentPath(pDesc->pFileName, parent);
-				char path[FS_MAX_PATH] = { 0 };
-				fsAppendPathComponent(parent, uri, path);
-				FileStream fs = {};
-				if (fsOpenStreamFromPath(RD_MESHES, path, FM_READ_BINARY, &fs))
-				{
-					ASSERT(fsGetStreamFileSize(&fs) >= (ssize_t)data->buffers[i].size);
-					data->buffers[i].data = tf_malloc(data->buffers[i].size);
-					fsReadFromStream(&fs, data->buffers[i].data, data->buffers[i].size);
-				}
-				fsCloseStream(&fs);
+				tf_delete(pBasis);
 			}
 		}
+		break;
+	}
+	default:
+		break;
+	}
 
-		result = cgltf_load_buffers(&options, data, pDesc->pFileName);
-		if (cgltf_result_success != result)
+	return success;
+}
+
+static bool decodeTexture(const TextureLoadDesc* pTextureDesc, TextureDecodeData* pOut, uint64_t* pReadTimeUs)
+{
+	TextureContainerType container = util_get_texture_container(pTextureDesc);
+	char fileName[FS_MAX_PATH] = {};
+	fsAppendPathExtension(pTextureDesc->pFileName, gTextureContainerExtensions[container], fileName);
+
+	// Opening the container and pulling its data into memory counts as file read
+	int64_t readStart = getUSec();
+	FileStream stream = {};
+	pOut->mDesc.pName = pTextureDesc->pFileName;
+	if (!openTextureContainer(container, fileName, pTextureDesc->mCreationFlag, &stream, &pOut->mDesc, &pOut->mUpdateDesc))
+	{
+		*pReadTimeUs += getUSec() - readStart;
+		if (stream.pIO)
 		{
-			LOGF(eERROR, "Failed to load buffers from gltf file %s with error %u", pDesc->pFileName, (uint32_t)result);
-			ASSERT(false);
-			tf_free(fileData);
-			return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+			fsCloseStream(&stream);
 		}
+		return false;
+	}
 
-		typedef void (*PackingFunction)(uint32_t count, uint32_t stride, uint32_t offset, const uint8_t* src, uint8_t* dst);
+	// Basis keeps the parsed file in memory. Pull the rest of the file into memory so the streamer thread only copies
+	if (TEXTURE_CONTAINER_BASIS != container)
+	{
+		ssize_t dataSize = fsGetStreamFileSize(&stream) - fsGetStreamSeekPosition(&stream);
+		void* data = tf_malloc(dataSize);
+		ssize_t bytesRead = fsReadFromStream(&stream, data, dataSize);
+		fsCloseStream(&stream);
+		if (bytesRead != dataSize)
+		{
+			tf_free(data);
+			return false;
+		}
+		fsOpenStreamFromMemory(data, dataSize, FM_READ_BINARY, true, &stream);
+	}
+	*pReadTimeUs += getUSec() - readStart;
 
-		uint32_t vertexStrides[SEMANTIC_TEXCOORD9 + 1] = {};
-		uint32_t vertexAttribCount[SEMANTIC_TEXCOORD9 + 1] = {};
-		uint32_t vertexOffsets[SEMANTIC_TEXCOORD9 + 1] = {};
-		uint32_t vertexBindings[SEMANTIC_TEXCOORD9 + 1] = {};
-		cgltf_attribute* vertexAttribs[SEMANTIC_TEXCOORD9 + 1] = {};
-		PackingFunction vertexPacking[SEMANTIC_TEXCOORD9 + 1] = {};
-		for (uint32_t i = 0; i < SEMANTIC_TEXCOORD9 + 1; ++i)
-			vertexOffsets[i] = UINT_MAX;
+	pOut->mUpdateDesc.mStream = stream;
+	return true;
+}
 
-		uint32_t indexCount = 0;
-		uint32_t vertexCount = 0;
-		uint32_t drawCount = 0;
-		uint32_t jointCount = 0;
-		uint32_t vertexBufferCount = 0;
+// Streamed textures are created without their largest mips. Block compressed textures need a block aligned mip 0
+static bool util_is_streamable_mip(const TextureDesc* pDesc, uint32_t mip)
+{
+	const TinyImageFormat fmt = pDesc->mFormat;
+	return !mip || (!(MIP_REDUCE(pDesc->mWidth, mip) % TinyImageFormat_WidthOfBlock(fmt)) &&
+					!(MIP_REDUCE(pDesc->mHeight, mip) % TinyImageFormat_HeightOfBlock(fmt)));
+}
 
-		// Find number of traditional draw calls required to draw this piece of geometry
-		// Find total index count, total vertex count
-		for (uint32_t i = 0; i < data->meshes_count; ++i)
-		{
-			for (uint32_t p = 0; p < data->meshes[i].primitives_count; ++p)
-			{
-				const cgltf_primitive* prim = &data->meshes[i].primitives[p];
-				indexCount += (uint32_t)prim->indices->count;
-				vertexCount += (uint32_t)prim->attributes->data->count;
-				++drawCount;
+// Rounds a resident mip count up to the next one whose largest mip can be created
+static uint32_t util_get_streamable_mip_levels(const StreamedTexture* pStreamed, uint32_t mipLevels)
+{
+	mipLevels = clamp(mipLevels, pStreamed->mTailMipLevels, pStreamed->mMipLevels);
+	while (mipLevels < pStreamed->mMipLevels && !util_is_streamable_mip(&pStreamed->mDesc, pStreamed->mMipLevels - mipLevels))
+	{
+		++mipLevels;
+	}
+	return mipLevels;
+}
 
-				for (uint32_t i = 0; i < prim->attributes_count; ++i)
-					vertexAttribs[util_cgltf_attrib_type_to_semantic(prim->attributes[i].type, prim->attributes[i].index)] = &prim->attributes[i];
-			}
-		}
+// Memory of the smallest mipLevels mips
+static uint64_t util_get_streamed_texture_size(const StreamedTexture* pStreamed, uint32_t mipLevels)
+{
+	const TextureDesc& desc = pStreamed->mDesc;
+	uint64_t size = 0;
+	for (uint32_t mip = desc.mMipLevels - mipLevels; mip < desc.mMipLevels; ++mip)
+	{
+		uint32_t numBytes = 0;
+		util_get_surface_info(MIP_REDUCE(desc.mWidth, mip), MIP_REDUCE(desc.mHeight, mip), desc.mFormat, &numBytes, NULL, NULL);
+		size += (uint64_t)numBytes * MIP_REDUCE(desc.mDepth, mip);
+	}
+	return size * desc.mArraySize;
+}
 
-		uint32_t defaultTexcoordSemantic = SEMANTIC_UNDEFINED;
-		uint32_t defaultTexcoordStride = 0;
+// Initial load of a streamed texture. The mip tail starts at the first mip fitting into tailSize
+static void initStreamedTexture(StreamedTexture* pStreamed, TextureContainerType container, const TextureDesc* pDesc, uint32_t tailSize)
+{
+	pStreamed->mDesc = *pDesc;
+	pStreamed->mDesc.pName = pStreamed->pFileName;
+	pStreamed->mMipLevels = pDesc->mMipLevels;
 
-		// Determine vertex stride for each binding
-		for (uint32_t i = 0; i < pDesc->pVertexLayout->mAttribCount; ++i)
+	uint32_t tailMip = 0;
+	// Other containers are not read as raw subresources so they cannot skip mips
+	if (TEXTURE_CONTAINER_DDS == container || TEXTURE_CONTAINER_KTX == container)
+	{
+		for (uint32_t mip = 0; mip < pDesc->mMipLevels; ++mip)
 		{
-			const VertexAttrib* attr = &pDesc->pVertexLayout->mAttribs[i];
-			const cgltf_attribute* cgltfAttr = vertexAttribs[attr->mSemantic];
-			
-			bool defaultTexcoords = !cgltfAttr && (attr->mSemantic >= SEMANTIC_TEXCOORD0 && attr->mSemantic <= SEMANTIC_TEXCOORD9);
-			ASSERT(cgltfAttr || defaultTexcoords);
+			if (max(MIP_REDUCE(pDesc->mWidth, mip), MIP_REDUCE(pDesc->mHeight, mip)) <= tailSize && util_is_streamable_mip(pDesc, mip))
+			{
+				tailMip = mip;
+				break;
+			}
+		}
+	}
 
-			const uint32_t dstFormatSize = TinyImageFormat_BitSizeOfBlock(attr->mFormat) >> 3;
+	pStreamed->mTailMipLevels = pDesc->mMipLevels - tailMip;
+	pStreamed->mResidentMipLevels = pStreamed->mTailMipLevels;
+}
 
-			if (defaultTexcoords)
-			{
-				// Make sure there are only 1 set of default texcoords
-				ASSERT(defaultTexcoordSemantic == SEMANTIC_UNDEFINED);
+static UploadFunctionResult loadTexture(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t activeSet, const UpdateRequest& pTextureUpdate)
+{
+	const TextureLoadDesc* pTextureDesc = &pTextureUpdate.texLoadDesc;
 
-				defaultTexcoordStride = dstFormatSize ? dstFormatSize : 2 * sizeof(float); // (0.f, 0.f)
-				defaultTexcoordSemantic = attr->mSemantic;
+	if (pTextureDesc->pFileName)
+	{
+		FileStream stream = {};
+		char fileName[FS_MAX_PATH] = {};
+		bool success = false;
 
-				vertexStrides[attr->mBinding] += defaultTexcoordStride;
-				vertexOffsets[defaultTexcoordSemantic] = attr->mOffset;
-				vertexBindings[defaultTexcoordSemantic] = attr->mBinding;
-				++vertexAttribCount[attr->mBinding];
-				
-				continue;
-			}
+		TextureUpdateDescInternal updateDesc = {};
+		TextureContainerType container = util_get_texture_container(pTextureDesc);
 
-			const uint32_t srcFormatSize = (uint32_t)cgltfAttr->data->stride; //-V522
+		TextureDesc textureDesc = {};
+		textureDesc.pName = pTextureDesc->pFileName;
 
-			vertexStrides[attr->mBinding] += dstFormatSize ? dstFormatSize : srcFormatSize;
-			vertexOffsets[attr->mSemantic] = attr->mOffset;
-			vertexBindings[attr->mSemantic] = attr->mBinding;
-			++vertexAttribCount[attr->mBinding];
+		// Validate that we have found the file format now
+		ASSERT(container != TEXTURE_CONTAINER_DEFAULT);  //-V547
+		if (TEXTURE_CONTAINER_DEFAULT == container)      //-V547
+		{
+			return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+		}
 
-			// Compare vertex attrib format to the gltf attrib type
-			// Select a packing function if dst format is packed version
-			// Texcoords - Pack float2 to half2
-			// Directions - Pack float3 to float2 to unorm2x16 (Normal, Tangent)
-			// Position - No packing yet
-			const TinyImageFormat srcFormat = util_cgltf_type_to_image_format(cgltfAttr->data->type, cgltfAttr->data->component_type);
-			const TinyImageFormat dstFormat = attr->mFormat == TinyImageFormat_UNDEFINED ? srcFormat : attr->mFormat;
+		fsAppendPathExtension(pTextureDesc->pFileName, gTextureContainerExtensions[container], fileName);
 
-			if (dstFormat != srcFormat)
+		if (pTextureUpdate.pDecodeJob)
+		{
+			// Header and subresource data were read by a decode thread
+			DecodeJob* pJob = pTextureUpdate.pDecodeJob;
+			success = waitDecodeJob(pResourceLoader, pJob);
+			if (success)
 			{
-				// Select appropriate packing function which will be used when filling the vertex buffer
-				switch (cgltfAttr->type)
-				{
-				case cgltf_attribute_type_texcoord:
-				{
-					if (sizeof(uint32_t) == dstFormatSize && sizeof(float[2]) == srcFormatSize)
-						vertexPacking[attr->mSemantic] = util_pack_float2_to_half2;
-					// #TODO: Add more variations if needed
-					break;
-				}
-				case cgltf_attribute_type_normal:
-				case cgltf_attribute_type_tangent:
+				textureDesc = pJob->mTexture.mDesc;
+				updateDesc = pJob->mTexture.mUpdateDesc;
+				stream = updateDesc.mStream;
+				// Ownership of the stream moves to updateTexture
+				pJob->mTexture.mUpdateDesc.mStream = {};
+				pJob->mTexture.mUpdateDesc.pBasisTexture = NULL;
+			}
+		}
+		else
+		{
+			switch (container)
+			{
+#if defined(XBOX)
+			case TEXTURE_CONTAINER_DDS:
+			{
+				success = fsOpenStreamFromPath(RD_TEXTURES, fileName, FM_READ_BINARY, &stream);
+				uint32_t res = 1;
+				if (success)
 				{
-					if (sizeof(uint32_t) == dstFormatSize && (sizeof(float[3]) == srcFormatSize || sizeof(float[4]) == srcFormatSize))
-						vertexPacking[attr->mSemantic] = util_pack_float3_direction_to_half2;
-					// #TODO: Add more variations if needed
-					break;
-				}
-				default:
-					break;
+					extern uint32_t loadXDDSTexture(Renderer* pRenderer, FileStream* stream, const char* name, TextureCreationFlags flags, Texture** ppTexture);
+					res = loadXDDSTexture(pRenderer, &stream, fileName, pTextureDesc->mCreationFlag, pTextureDesc->ppTexture);
+					fsCloseStream(&stream);
 				}
+
+				return res ? UPLOAD_FUNCTION_RESULT_INVALID_REQUEST : UPLOAD_FUNCTION_RESULT_COMPLETED;
 			}
+#endif
+			case TEXTURE_CONTAINER_GNF:
+			{
+#if defined(ORBIS) || defined(PROSPERO)
+				success = fsOpenStreamFromPath(RD_TEXTURES, fileName, FM_READ_BINARY, &stream);
+				uint32_t res = 1;
+				if (success)
+				{
+					extern uint32_t loadGnfTexture(Renderer* pRenderer, FileStream* stream, const char* name, TextureCreationFlags flags, Texture** ppTexture);
+					res = loadGnfTexture(pRenderer, &stream, fileName, pTextureDesc->mCreationFlag, pTextureDesc->ppTexture);
+					fsCloseStream(&stream);
+				}
+
+				return res ? UPLOAD_FUNCTION_RESULT_INVALID_REQUEST : UPLOAD_FUNCTION_RESULT_COMPLETED;
+#endif
+				break;
+			}
+			default:
+			{
+				int64_t readStart = getUSec();
+				success = openTextureContainer(container, fileName, pTextureDesc->mCreationFlag, &stream, &textureDesc, &updateDesc);
+				addStreamerLoadTime(pResourceLoader, RESOURCE_LOAD_STAGE_FILE_READ, getUSec() - readStart);
+				break;
+			}
+			}
+		}
+
+		if (success)
+		{
+			textureDesc.mStartState = RESOURCE_STATE_COMMON;
+			textureDesc.mFlags |= pTextureDesc->mCreationFlag;
+			textureDesc.mNodeIndex = pTextureDesc->mNodeIndex;
+#if defined (VULKAN)
+			if (NULL != pTextureDesc->pDesc)
+				textureDesc.pVkSamplerYcbcrConversionInfo = pTextureDesc->pDesc->pVkSamplerYcbcrConversionInfo;
+#endif
+			// Streamed textures only get their smallest mips. The larger ones are skipped in the file
+			StreamedTexture* pStreamed = pTextureUpdate.pStreamedTexture;
+			if (pStreamed)
+			{
+				uint32_t mipLevels = pTextureUpdate.mStreamMipLevels;
+				if (!mipLevels)
+				{
+					initStreamedTexture(pStreamed, container, &textureDesc, pResourceLoader->mDesc.mStreamingMipTailSize);
+					mipLevels = pStreamed->mTailMipLevels;
+				}
+				else if (textureDesc.mMipLevels != pStreamed->mMipLevels || textureDesc.mWidth != pStreamed->mDesc.mWidth ||
+						 textureDesc.mHeight != pStreamed->mDesc.mHeight || textureDesc.mFormat != pStreamed->mDesc.mFormat)
+				{
+					LOGF(eWARNING, "Texture %s changed since it was loaded. Mips are not streamed", pTextureDesc->pFileName);
+					if (stream.pIO)
+						fsCloseStream(&stream);
+					if (updateDesc.pBasisTexture)
+						tf_delete(updateDesc.pBasisTexture);
+					return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+				}
+
+				updateDesc.mSkipMipLevels = textureDesc.mMipLevels - mipLevels;
+				updateDesc.mSrcWidth = textureDesc.mWidth;
+				updateDesc.mSrcHeight = textureDesc.mHeight;
+				updateDesc.mSrcDepth = textureDesc.mDepth;
+				textureDesc.mWidth = MIP_REDUCE(textureDesc.mWidth, updateDesc.mSkipMipLevels);
+				textureDesc.mHeight = MIP_REDUCE(textureDesc.mHeight, updateDesc.mSkipMipLevels);
+				textureDesc.mDepth = MIP_REDUCE(textureDesc.mDepth, updateDesc.mSkipMipLevels);
+				textureDesc.mMipLevels = mipLevels;
+			}
+
+			addTexture(pRenderer, &textureDesc, pTextureDesc->ppTexture);
+
+			updateDesc.mStream = stream;
+			updateDesc.pTexture = *pTextureDesc->ppTexture;
+			updateDesc.mBaseMipLevel = 0;
+			updateDesc.mMipLevels = textureDesc.mMipLevels;
+			updateDesc.mBaseArrayLayer = 0;
+			updateDesc.mLayerCount = textureDesc.mArraySize;
+
+			UploadFunctionResult result = updateTexture(pRenderer, pCopyEngine, activeSet, updateDesc);
+			if (pStreamed && !pTextureUpdate.mStreamMipLevels && UPLOAD_FUNCTION_RESULT_COMPLETED == result)
+			{
+				// Published to updateTextureStreaming
+				tfrg_atomic32_store_release(&pStreamed->mState, STREAMED_TEXTURE_STATE_READY);
+			}
+			return result;
+		}
+		/************************************************************************/
+		// Sparse Tetxtures
+		/************************************************************************/
+#if defined(DIRECT3D12) || defined(VULKAN)
+		if (TEXTURE_CONTAINER_SVT == container)
+		{
+			if (fsOpenStreamFromPath(RD_TEXTURES, fileName, FM_READ_BINARY, &stream))
+			{
+				success = loadSVTTextureDesc(&stream, &textureDesc);
+				if (success)
+				{
+					ssize_t dataSize = fsGetStreamFileSize(&stream) - fsGetStreamSeekPosition(&stream);
+					void* data = tf_malloc(dataSize);
+					fsReadFromStream(&stream, data, dataSize);
+
+					textureDesc.mStartState = RESOURCE_STATE_COPY_DEST;
+					textureDesc.mFlags |= pTextureDesc->mCreationFlag;
+					textureDesc.mNodeIndex = pTextureDesc->mNodeIndex;
+					addVirtualTexture(acquireCmd(pCopyEngine, activeSet), &textureDesc, pTextureDesc->ppTexture, data);
+					/************************************************************************/
+					// Create visibility buffer
+					/************************************************************************/
+					eastl::vector<VirtualTexturePage>* pPageTable = (eastl::vector<VirtualTexturePage>*)(*pTextureDesc->ppTexture)->pSvt->pPages;
+
+					if (pPageTable == NULL)
+						return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+
+					BufferLoadDesc visDesc = {};
+					visDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_RW_BUFFER;
+					visDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_GPU_ONLY;
+					visDesc.mDesc.mStructStride = sizeof(uint);
+					visDesc.mDesc.mElementCount = (uint64_t)pPageTable->size();
+					visDesc.mDesc.mSize = visDesc.mDesc.mStructStride * visDesc.mDesc.mElementCount;
+					visDesc.mDesc.mStartState = RESOURCE_STATE_COMMON;
+					visDesc.mDesc.pName = "Vis Buffer for Sparse Texture";
+					visDesc.ppBuffer = &(*pTextureDesc->ppTexture)->pSvt->mVisibility;
+					addResource(&visDesc, NULL);
+
+					BufferLoadDesc prevVisDesc = {};
+					prevVisDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_RW_BUFFER;
+					prevVisDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_GPU_ONLY;
+					prevVisDesc.mDesc.mStructStride = sizeof(uint);
+					prevVisDesc.mDesc.mElementCount = (uint64_t)pPageTable->size();
+					prevVisDesc.mDesc.mSize = prevVisDesc.mDesc.mStructStride * prevVisDesc.mDesc.mElementCount;
+					prevVisDesc.mDesc.mStartState = RESOURCE_STATE_COMMON;
+					prevVisDesc.mDesc.pName = "Prev Vis Buffer for Sparse Texture";
+					prevVisDesc.ppBuffer = &(*pTextureDesc->ppTexture)->pSvt->mPrevVisibility;
+					addResource(&prevVisDesc, NULL);
+
+					BufferLoadDesc alivePageDesc = {};
+					alivePageDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_RW_BUFFER;
+					alivePageDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_CPU_TO_GPU;
+
+					alivePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT | BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
+#if defined(DIRECT3D12)
+					if(gSelectedRendererApi == RENDERER_API_D3D12)
+						alivePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
+#endif
+#if defined(VULKAN)
+					if(gSelectedRendererApi == RENDERER_API_VULKAN)
+						alivePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT;
+#endif
+
+					alivePageDesc.mDesc.mStructStride = sizeof(uint);
+					alivePageDesc.mDesc.mElementCount = (uint64_t)pPageTable->size();
+					alivePageDesc.mDesc.mSize = alivePageDesc.mDesc.mStructStride * alivePageDesc.mDesc.mElementCount;
+					alivePageDesc.mDesc.pName = "Alive pages buffer for Sparse Texture";
+					alivePageDesc.ppBuffer = &(*pTextureDesc->ppTexture)->pSvt->mAlivePage;
+					addResource(&alivePageDesc, NULL);
+
+					BufferLoadDesc removePageDesc = {};
+					removePageDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_RW_BUFFER;
+					removePageDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_CPU_TO_GPU;
+					removePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT | BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
+#if defined(DIRECT3D12)
+					if (gSelectedRendererApi == RENDERER_API_D3D12)
+						removePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
+#endif
+#if defined(VULKAN)
+					if (gSelectedRendererApi == RENDERER_API_VULKAN)
+						removePageDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT;
+#endif
+
+					removePageDesc.mDesc.mStructStride = sizeof(uint);
+					removePageDesc.mDesc.mElementCount = (uint64_t)pPageTable->size();
+					removePageDesc.mDesc.mSize = removePageDesc.mDesc.mStructStride * removePageDesc.mDesc.mElementCount;
+					removePageDesc.mDesc.pName = "Remove pages buffer for Sparse Texture";
+					removePageDesc.ppBuffer = &(*pTextureDesc->ppTexture)->pSvt->mRemovePage;
+					addResource(&removePageDesc, NULL);
+
+					BufferLoadDesc pageCountsDesc = {};
+					pageCountsDesc.mDesc.mDescriptors = DESCRIPTOR_TYPE_RW_BUFFER;
+					pageCountsDesc.mDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_CPU_TO_GPU;
+					pageCountsDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT | BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
+#if defined(DIRECT3D12)
+					if (gSelectedRendererApi == RENDERER_API_D3D12)
+						pageCountsDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_OWN_MEMORY_BIT;
+#endif
+#if defined(VULKAN)
+					if (gSelectedRendererApi == RENDERER_API_VULKAN)
+						pageCountsDesc.mDesc.mFlags = BUFFER_CREATION_FLAG_PERSISTENT_MAP_BIT;
+#endif
+					pageCountsDesc.mDesc.mStructStride = sizeof(uint);
+					pageCountsDesc.mDesc.mElementCount = 4;
+					pageCountsDesc.mDesc.mSize = pageCountsDesc.mDesc.mStructStride * pageCountsDesc.mDesc.mElementCount;
+					pageCountsDesc.mDesc.pName = "Page count buffer for Sparse Texture";
+					pageCountsDesc.ppBuffer = &(*pTextureDesc->ppTexture)->pSvt->mPageCounts;
+					addResource(&pageCountsDesc, NULL);
+
+					fsCloseStream(&stream);
+
+					return UPLOAD_FUNCTION_RESULT_COMPLETED;
+				}
+			}
+
+			return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+		}
+#endif
+	}
+
+	return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+}
+
+static UploadFunctionResult updateBuffer(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t activeSet, const BufferUpdateDesc& bufUpdateDesc)
+{
+	ASSERT(pCopyEngine->pQueue->mNodeIndex == bufUpdateDesc.pBuffer->mNodeIndex);
+	Buffer* pBuffer = bufUpdateDesc.pBuffer;
+	ASSERT(pBuffer->mMemoryUsage == RESOURCE_MEMORY_USAGE_GPU_ONLY || pBuffer->mMemoryUsage == RESOURCE_MEMORY_USAGE_GPU_TO_CPU);
+
+	Cmd* pCmd = acquireCmd(pCopyEngine, activeSet);
+
+	MappedMemoryRange range = bufUpdateDesc.mInternal.mMappedRange;
+	cmdUpdateBuffer(pCmd, pBuffer, bufUpdateDesc.mDstOffset, range.pBuffer, range.mOffset, range.mSize);
+
+	return UPLOAD_FUNCTION_RESULT_COMPLETED;
+}
+
+// Copies CPU data into a GPU buffer. The data goes through the staging ring in chunks of one set's staging budget
+static void uploadBufferData(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t activeSet, Buffer* pBuffer, const void* pData, uint64_t size)
+{
+#if UMA
+	UNREF_PARAM(pRenderer);
+	UNREF_PARAM(pCopyEngine);
+	UNREF_PARAM(activeSet);
+	memcpy(pBuffer->pCpuMappedAddress, pData, (size_t)size);
+#else
+	const uint64_t chunkSize = pResourceLoader->pCopyEngines[0].bufferSize;
+	for (uint64_t offset = 0; offset < size; offset += chunkSize)
+	{
+		BufferUpdateDesc updateDesc = {};
+		updateDesc.pBuffer = pBuffer;
+		updateDesc.mDstOffset = offset;
+		updateDesc.mSize = min(chunkSize, size - offset);
+		updateDesc.mInternal.mMappedRange = allocateStagingMemory(updateDesc.mSize, RESOURCE_BUFFER_ALIGNMENT);
+		memcpy(updateDesc.mInternal.mMappedRange.pData, (const uint8_t*)pData + offset, (size_t)updateDesc.mSize);
+		updateBuffer(pRenderer, pCopyEngine, activeSet, updateDesc);
+	}
+#endif
+}
+
+/************************************************************************/
+// Geometry Cache
+/************************************************************************/
+#define GEOMETRY_CACHE_MAGIC 0x43474654u // "TFGC"
+#define GEOMETRY_CACHE_VERSION 3u
+#define GEOMETRY_CACHE_ALIGNMENT 16u
+
+/// External buffer a cached geometry was built from. Only the first mSize bytes are referenced by the gltf file
+typedef struct GeometryCacheDependency
+{
+	char     mPath[FS_MAX_PATH];
+	uint64_t mSize;
+} GeometryCacheDependency;
+
+/// Header of a processed geometry file in RD_GEOMETRY_CACHE
+/// All offsets are relative to the start of the file and aligned to GEOMETRY_CACHE_ALIGNMENT so index / vertex
+/// streams can be uploaded straight from the mapped file
+typedef struct GeometryCacheHeader
+{
+	uint32_t                 mMagic;
+	uint32_t                 mVersion;
+	/// Content hash of the gltf file and every external buffer it references
+	uint64_t                 mSourceHash;
+	/// Hash of the file name, vertex layout, quantization and load flags the data was packed for
+	uint64_t                 mLayoutHash;
+	uint64_t                 mFileSize;
+	uint32_t                 mDependencyCount;
+	uint32_t                 mIndexStride;
+	uint32_t                 mIndexCount;
+	uint32_t                 mVertexCount;
+	uint32_t                 mDrawArgCount;
+	uint32_t                 mJointCount;
+	uint32_t                 mMeshletCount;
+	uint32_t                 mVertexStrides[MAX_VERTEX_BINDINGS];
+	Geometry::Hair           mHair;
+	Geometry::Dequantization mDequantization[SEMANTIC_TEXCOORD9 + 1];
+	uint64_t                 mDependencyOffset;
+	uint64_t                 mIndexOffset;
+	uint64_t                 mVertexOffsets[MAX_VERTEX_BINDINGS];
+	uint64_t                 mDrawArgsOffset;
+	uint64_t                 mInverseBindPosesOffset;
+	uint64_t                 mJointRemapsOffset;
+	uint64_t                 mMeshletsOffset;
+	/// Shadow copy laid out as [ indices | positions | normals ]. Size is zero if the geometry is not shadowed
+	uint64_t                 mShadowOffset;
+	uint64_t                 mShadowSize;
+	uint64_t                 mShadowPositionOffset;
+	uint64_t                 mShadowNormalOffset;
+} GeometryCacheHeader;
+
+// Two differently seeded 32 bit murmur chains give a 64 bit hash. Large inputs are hashed in chunks
+static uint64_t hashData(const void* pData, uint64_t size, uint64_t seed)
+{
+	uint32_t lo = (uint32_t)seed;
+	uint32_t hi = (uint32_t)(seed >> 32) ^ 0x9E3779B9u;
+	const uint8_t* pSrc = (const uint8_t*)pData;
+	do
+	{
+		const int chunk = (int)min(size, (uint64_t)(1u << 30));
+		MurmurHash3_x86_32(pSrc, chunk, lo, &lo);
+		MurmurHash3_x86_32(pSrc, chunk, hi, &hi);
+		pSrc += chunk;
+		size -= chunk;
+	} while (size);
+	return ((uint64_t)hi << 32) | lo;
+}
+
+static uint64_t getGeometryLayoutHash(const GeometryLoadDesc* pDesc)
+{
+	uint64_t hash = hashData(pDesc->pFileName, strlen(pDesc->pFileName), GEOMETRY_CACHE_VERSION);
+
+	const VertexLayout* pLayout = pDesc->pVertexLayout;
+	for (uint32_t i = 0; i < pLayout->mAttribCount; ++i)
+	{
+		const VertexAttrib* attr = &pLayout->mAttribs[i];
+		const uint32_t key[4] = { (uint32_t)attr->mSemantic, (uint32_t)attr->mFormat, attr->mBinding, attr->mOffset };
+		hash = hashData(key, sizeof(key), hash);
+	}
+
+	hash = hashData(pDesc->mQuantization, sizeof(pDesc->mQuantization), hash);
+
+	// Structured buffers only change the buffer descriptors, not the packed data
+	const uint32_t flags = (uint32_t)(pDesc->mFlags & ~GEOMETRY_LOAD_FLAG_STRUCTURED_BUFFERS);
+	return hashData(&flags, sizeof(flags), hash);
+}
+
+static void getGeometryCacheName(const GeometryLoadDesc* pDesc, uint64_t layoutHash, char* pOut)
+{
+	char fileName[FS_MAX_PATH] = { 0 };
+	fsGetPathFileName(pDesc->pFileName, fileName);
+	snprintf(pOut, FS_MAX_PATH, "%s_%016llx.geom", fileName, (unsigned long long)layoutHash);
+}
+
+// Hashes the current contents of the gltf file and its external buffers to validate a cache entry
+static bool hashGeometrySource(const char* pFileName, const GeometryCacheDependency* pDependencies, uint32_t dependencyCount, uint64_t* pOutHash)
+{
+	FileStream file = {};
+	if (!fsOpenMappedStreamFromPath(RD_MESHES, pFileName, &file))
+	{
+		return false;
+	}
+	uint64_t hash = hashData(file.mMemory.pBuffer, file.mSize, 0);
+	fsCloseStream(&file);
+
+	for (uint32_t i = 0; i < dependencyCount; ++i)
+	{
+		if (!fsOpenMappedStreamFromPath(RD_MESHES, pDependencies[i].mPath, &file))
+		{
+			return false;
+		}
+		const bool valid = (uint64_t)file.mSize >= pDependencies[i].mSize;
+		if (valid)
+		{
+			hash = hashData(file.mMemory.pBuffer, pDependencies[i].mSize, hash);
+		}
+		fsCloseStream(&file);
+		if (!valid)
+		{
+			return false;
+		}
+	}
+
+	*pOutHash = hash;
+	return true;
+}
+
+// Geometry, draw args, inverse bind poses and joint remaps share one allocation
+static Geometry* allocGeometry(uint32_t drawCount, uint32_t jointCount)
+{
+	uint32_t totalSize = 0;
+	totalSize += round_up(sizeof(Geometry), 16);
+	totalSize += round_up(drawCount * sizeof(IndirectDrawIndexArguments), 16);
+	totalSize += round_up(jointCount * sizeof(mat4), 16);
+	totalSize += round_up(jointCount * sizeof(uint32_t), 16);
+
+	Geometry* geom = (Geometry*)tf_calloc(1, totalSize);
+	ASSERT(geom);
+
+	geom->pDrawArgs = (IndirectDrawIndexArguments*)(geom + 1); //-V1027
+	geom->pInverseBindPoses = (mat4*)((uint8_t*)geom->pDrawArgs + round_up(drawCount * sizeof(*geom->pDrawArgs), 16));
+	geom->pJointRemaps = (uint32_t*)((uint8_t*)geom->pInverseBindPoses + round_up(jointCount * sizeof(*geom->pInverseBindPoses), 16));
+
+	for (uint32_t s = 0; s < SEMANTIC_TEXCOORD9 + 1; ++s)
+		for (uint32_t c = 0; c < 4; ++c)
+			geom->mDequantization[s].mScale[c] = 1.0f;
+
+	return geom;
+}
+
+static void freeGeometryDecodeData(GeometryDecodeData* pData)
+{
+	if (pData->mCacheStream.pIO)
+	{
+		fsCloseStream(&pData->mCacheStream);
+	}
+	else
+	{
+		tf_free(pData->pIndexData);
+		for (uint32_t i = 0; i < MAX_VERTEX_BINDINGS; ++i)
+		{
+			tf_free(pData->pVertexData[i]);
+		}
+	}
+	pData->pIndexData = NULL;
+	memset(pData->pVertexData, 0, sizeof(pData->pVertexData));
+}
+
+// count elements of elementSize bytes at offset lie inside the file. Written without products that could wrap
+static inline bool isGeometryCacheRangeValid(uint64_t fileSize, uint64_t offset, uint64_t count, uint64_t elementSize)
+{
+	return offset <= fileSize && (!elementSize || count <= (fileSize - offset) / elementSize);
+}
+
+// Every section the header points to lies inside the file, so a truncated or corrupt cache is reloaded instead of read past the mapping
+static bool isGeometryCacheHeaderValid(const GeometryCacheHeader* pHeader)
+{
+	const uint64_t fileSize = pHeader->mFileSize;
+	if (sizeof(uint16_t) != pHeader->mIndexStride && sizeof(uint32_t) != pHeader->mIndexStride)
+		return false;
+
+	bool valid = isGeometryCacheRangeValid(fileSize, pHeader->mDependencyOffset, pHeader->mDependencyCount, sizeof(GeometryCacheDependency)) &&
+		isGeometryCacheRangeValid(fileSize, pHeader->mIndexOffset, pHeader->mIndexCount, pHeader->mIndexStride) &&
+		isGeometryCacheRangeValid(fileSize, pHeader->mDrawArgsOffset, pHeader->mDrawArgCount, sizeof(IndirectDrawIndexArguments)) &&
+		isGeometryCacheRangeValid(fileSize, pHeader->mInverseBindPosesOffset, pHeader->mJointCount, sizeof(mat4)) &&
+		isGeometryCacheRangeValid(fileSize, pHeader->mJointRemapsOffset, pHeader->mJointCount, sizeof(uint32_t)) &&
+		isGeometryCacheRangeValid(fileSize, pHeader->mMeshletsOffset, pHeader->mMeshletCount, sizeof(Geometry::Meshlet));
+
+	for (uint32_t i = 0; i < MAX_VERTEX_BINDINGS && valid; ++i)
+	{
+		valid = isGeometryCacheRangeValid(fileSize, pHeader->mVertexOffsets[i], pHeader->mVertexCount, pHeader->mVertexStrides[i]);
+	}
+
+	// Positions and normals of the shadow copy point into the shadow section
+	if (valid && pHeader->mShadowSize)
+	{
+		valid = isGeometryCacheRangeValid(fileSize, pHeader->mShadowOffset, pHeader->mShadowSize, 1) &&
+			pHeader->mShadowPositionOffset < pHeader->mShadowSize && pHeader->mShadowNormalOffset < pHeader->mShadowSize;
+	}
+
+	return valid;
+}
+
+static bool areGeometryCacheDependenciesValid(const GeometryCacheDependency* pDependencies, uint32_t dependencyCount)
+{
+	for (uint32_t i = 0; i < dependencyCount; ++i)
+	{
+		if (!memchr(pDependencies[i].mPath, 0, sizeof(pDependencies[i].mPath)))
+			return false;
+	}
+	return true;
+}
+
+// Warm path: index / vertex data is used directly from the mapped cache file, skipping gltf parsing and packing
+static bool loadGeometryCache(const GeometryLoadDesc* pDesc, const char* pCacheName, uint64_t layoutHash, GeometryDecodeData* pOut)
+{
+	FileStream cache = {};
+	if (!fsOpenMappedStreamFromPath(RD_GEOMETRY_CACHE, pCacheName, &cache))
+	{
+		return false;
+	}
+
+	const uint8_t* pData = cache.mMemory.pBuffer;
+	const GeometryCacheHeader* pHeader = (const GeometryCacheHeader*)pData;
+	bool valid = cache.mSize >= (ssize_t)sizeof(GeometryCacheHeader) &&
+		GEOMETRY_CACHE_MAGIC == pHeader->mMagic &&
+		GEOMETRY_CACHE_VERSION == pHeader->mVersion &&
+		layoutHash == pHeader->mLayoutHash;
+
+	if (valid && ((uint64_t)cache.mSize != pHeader->mFileSize || !isGeometryCacheHeaderValid(pHeader) ||
+				  !areGeometryCacheDependenciesValid((const GeometryCacheDependency*)(pData + pHeader->mDependencyOffset), pHeader->mDependencyCount)))
+	{
+		LOGF(eWARNING, "Geometry cache %s is truncated or corrupt, reloading %s", pCacheName, pDesc->pFileName);
+		valid = false;
+	}
+
+	// Source files edited since the cache was written invalidate it
+	uint64_t sourceHash = 0;
+	valid = valid &&
+		hashGeometrySource(pDesc->pFileName, (const GeometryCacheDependency*)(pData + pHeader->mDependencyOffset), pHeader->mDependencyCount, &sourceHash) &&
+		sourceHash == pHeader->mSourceHash;
+
+	if (!valid)
+	{
+		fsCloseStream(&cache);
+		return false;
+	}
+
+	const uint32_t drawCount = pHeader->mDrawArgCount;
+	const uint32_t jointCount = pHeader->mJointCount;
+
+	Geometry* geom = allocGeometry(drawCount, jointCount);
+	memcpy(geom->pDrawArgs, pData + pHeader->mDrawArgsOffset, drawCount * sizeof(*geom->pDrawArgs));
+	memcpy((void*)geom->pInverseBindPoses, pData + pHeader->mInverseBindPosesOffset, jointCount * sizeof(*geom->pInverseBindPoses));
+	memcpy(geom->pJointRemaps, pData + pHeader->mJointRemapsOffset, jointCount * sizeof(*geom->pJointRemaps));
+
+	if (pHeader->mMeshletCount)
+	{
+		geom->pMeshlets = (Geometry::Meshlet*)tf_malloc(pHeader->mMeshletCount * sizeof(Geometry::Meshlet));
+		geom->mMeshletCount = pHeader->mMeshletCount;
+		memcpy(geom->pMeshlets, pData + pHeader->mMeshletsOffset, pHeader->mMeshletCount * sizeof(Geometry::Meshlet));
+	}
+
+	if (pHeader->mShadowSize)
+	{
+		geom->pShadow = (Geometry::ShadowData*)tf_calloc(1, sizeof(Geometry::ShadowData) + pHeader->mShadowSize);
+		geom->pShadow->pIndices = geom->pShadow + 1;
+		geom->pShadow->pAttributes[SEMANTIC_POSITION] = (uint8_t*)geom->pShadow->pIndices + pHeader->mShadowPositionOffset;
+		geom->pShadow->pAttributes[SEMANTIC_NORMAL] = (uint8_t*)geom->pShadow->pIndices + pHeader->mShadowNormalOffset;
+		memcpy(geom->pShadow->pIndices, pData + pHeader->mShadowOffset, pHeader->mShadowSize);
+	}
+
+	pOut->pIndexData = (void*)(pData + pHeader->mIndexOffset);
+	pOut->mIndexStride = pHeader->mIndexStride;
+
+	uint32_t bufferCounter = 0;
+	for (uint32_t i = 0; i < MAX_VERTEX_BINDINGS; ++i)
+	{
+		if (!pHeader->mVertexStrides[i])
+			continue;
+
+		pOut->pVertexData[i] = (void*)(pData + pHeader->mVertexOffsets[i]);
+		pOut->mVertexStrides[i] = pHeader->mVertexStrides[i];
+		geom->mVertexStrides[bufferCounter] = pHeader->mVertexStrides[i];
+		++bufferCounter;
+	}
+
+	geom->mVertexBufferCount = bufferCounter;
+	geom->mDrawArgCount = drawCount;
+	geom->mIndexCount = pHeader->mIndexCount;
+	geom->mVertexCount = pHeader->mVertexCount;
+	geom->mIndexType = (sizeof(uint16_t) == pHeader->mIndexStride) ? INDEX_TYPE_UINT16 : INDEX_TYPE_UINT32;
+	geom->mJointCount = jointCount;
+	geom->mHair = pHeader->mHair;
+	memcpy(geom->mDequantization, pHeader->mDequantization, sizeof(geom->mDequantization));
+
+	pOut->pGeometry = geom;
+	pOut->mCacheStream = cache;
+
+	return true;
+}
+
+static bool writeGeometryCacheSection(FileStream* pStream, uint64_t* pCursor, uint64_t offset, const void* pData, uint64_t size)
+{
+	static const uint8_t padding[GEOMETRY_CACHE_ALIGNMENT] = {};
+	ASSERT(offset >= *pCursor && offset - *pCursor < GEOMETRY_CACHE_ALIGNMENT);
+
+	const size_t paddingSize = (size_t)(offset - *pCursor);
+	if (paddingSize && fsWriteToStream(pStream, padding, paddingSize) != paddingSize)
+		return false;
+	if (size && fsWriteToStream(pStream, pData, (size_t)size) != size)
+		return false;
+
+	*pCursor = offset + size;
+	return true;
+}
+
+static void saveGeometryCache(
+	const char* pCacheName, const GeometryDecodeData* pDecoded, uint32_t shadowSize, uint64_t sourceHash, uint64_t layoutHash,
+	const eastl::vector<GeometryCacheDependency>& dependencies)
+{
+	const Geometry* geom = pDecoded->pGeometry;
+	const uint64_t align = GEOMETRY_CACHE_ALIGNMENT;
+
+	GeometryCacheHeader header = {};
+	header.mMagic = GEOMETRY_CACHE_MAGIC;
+	header.mVersion = GEOMETRY_CACHE_VERSION;
+	header.mSourceHash = sourceHash;
+	header.mLayoutHash = layoutHash;
+	header.mDependencyCount = (uint32_t)dependencies.size();
+	header.mIndexStride = pDecoded->mIndexStride;
+	header.mIndexCount = geom->mIndexCount;
+	header.mVertexCount = geom->mVertexCount;
+	header.mDrawArgCount = geom->mDrawArgCount;
+	header.mJointCount = geom->mJointCount;
+	header.mMeshletCount = geom->mMeshletCount;
+	header.mHair = geom->mHair;
+	memcpy(header.mDequantization, geom->mDequantization, sizeof(header.mDequantization));
+	memcpy(header.mVertexStrides, pDecoded->mVertexStrides, sizeof(header.mVertexStrides));
+
+	uint64_t offset = round_up_64(sizeof(GeometryCacheHeader), align);
+	header.mDependencyOffset = offset;
+	offset = round_up_64(offset + dependencies.size() * sizeof(GeometryCacheDependency), align);
+	header.mIndexOffset = offset;
+	offset = round_up_64(offset + (uint64_t)header.mIndexCount * header.mIndexStride, align);
+	for (uint32_t i = 0; i < MAX_VERTEX_BINDINGS; ++i)
+	{
+		header.mVertexOffsets[i] = offset;
+		offset = round_up_64(offset + (uint64_t)header.mVertexCount * header.mVertexStrides[i], align);
+	}
+	header.mDrawArgsOffset = offset;
+	offset = round_up_64(offset + header.mDrawArgCount * sizeof(*geom->pDrawArgs), align);
+	header.mInverseBindPosesOffset = offset;
+	offset = round_up_64(offset + header.mJointCount * sizeof(*geom->pInverseBindPoses), align);
+	header.mJointRemapsOffset = offset;
+	offset = round_up_64(offset + header.mJointCount * sizeof(*geom->pJointRemaps), align);
+	header.mMeshletsOffset = offset;
+	offset = round_up_64(offset + header.mMeshletCount * sizeof(*geom->pMeshlets), align);
+	if (geom->pShadow)
+	{
+		header.mShadowOffset = offset;
+		header.mShadowSize = shadowSize;
+		header.mShadowPositionOffset = (uint8_t*)geom->pShadow->pAttributes[SEMANTIC_POSITION] - (uint8_t*)geom->pShadow->pIndices;
+		header.mShadowNormalOffset = (uint8_t*)geom->pShadow->pAttributes[SEMANTIC_NORMAL] - (uint8_t*)geom->pShadow->pIndices;
+		offset = round_up_64(offset + shadowSize, align);
+	}
+	header.mFileSize = offset;
+
+	// Write under a unique temporary name first so concurrent loads never observe a partially written file
+	char tempName[FS_MAX_PATH] = { 0 };
+	snprintf(tempName, sizeof(tempName), "%s.%llx.tmp", pCacheName, (unsigned long long)(uintptr_t)Thread::GetCurrentThreadID());
+
+	FileStream stream = {};
+	if (!fsOpenStreamFromPath(RD_GEOMETRY_CACHE, tempName, FM_WRITE_BINARY, &stream))
+	{
+		LOGF(eWARNING, "Failed to write geometry cache %s", pCacheName);
+		return;
+	}
+
+	uint64_t cursor = 0;
+	bool success = writeGeometryCacheSection(&stream, &cursor, 0, &header, sizeof(header));
+	success = success && writeGeometryCacheSection(&stream, &cursor, header.mDependencyOffset, dependencies.data(), dependencies.size() * sizeof(GeometryCacheDependency));
+	success = success && writeGeometryCacheSection(&stream, &cursor, header.mIndexOffset, pDecoded->pIndexData, (uint64_t)header.mIndexCount * header.mIndexStride);
+	for (uint32_t i = 0; i < MAX_VERTEX_BINDINGS; ++i)
+		success = success && writeGeometryCacheSection(&stream, &cursor, header.mVertexOffsets[i], pDecoded->pVertexData[i], (uint64_t)header.mVertexCount * header.mVertexStrides[i]);
+	success = success && writeGeometryCacheSection(&stream, &cursor, header.mDrawArgsOffset, geom->pDrawArgs, header.mDrawArgCount * sizeof(*geom->pDrawArgs));
+	success = success && writeGeometryCacheSection(&stream, &cursor, header.mInverseBindPosesOffset, geom->pInverseBindPoses, header.mJointCount * sizeof(*geom->pInverseBindPoses));
+	success = success && writeGeometryCacheSection(&stream, &cursor, header.mJointRemapsOffset, geom->pJointRemaps, header.mJointCount * sizeof(*geom->pJointRemaps));
+	success = success && writeGeometryCacheSection(&stream, &cursor, header.mMeshletsOffset, geom->pMeshlets, header.mMeshletCount * sizeof(*geom->pMeshlets));
+	if (geom->pShadow)
+		success = success && writeGeometryCacheSection(&stream, &cursor, header.mShadowOffset, geom->pShadow->pIndices, shadowSize);
+	success = success && writeGeometryCacheSection(&stream, &cursor, header.mFileSize, NULL, 0);
+	fsCloseStream(&stream);
+
+	if (!success || !fsRenameFile(RD_GEOMETRY_CACHE, tempName, pCacheName))
+	{
+		LOGF(eWARNING, "Failed to write geometry cache %s", pCacheName);
+		fsRemoveFile(RD_GEOMETRY_CACHE, tempName);
+	}
+}
+
+static inline uint32_t readGeometryIndex(const void* pIndices, uint32_t indexStride, uint32_t index)
+{
+	return sizeof(uint16_t) == indexStride ? ((const uint16_t*)pIndices)[index] : ((const uint32_t*)pIndices)[index];
+}
+
+static inline void writeGeometryIndex(void* pIndices, uint32_t indexStride, uint32_t index, uint32_t value)
+{
+	if (sizeof(uint16_t) == indexStride)
+		((uint16_t*)pIndices)[index] = (uint16_t)value;
+	else
+		((uint32_t*)pIndices)[index] = value;
+}
+
+// Runs the requested meshoptimizer passes on each draw of the packed geometry
+// Draws keep their index ranges. Vertices of each draw are compacted behind the previous draw once duplicates / unused ones are gone
+// Positions for the overdraw pass come from the packed position stream, the float3 scratch positions or the shadow copy
+// Scratch positions are only read by the passes but get remapped along with the vertex streams
+static void optimizeGeometry(
+	GeometryLoadFlags flags, GeometryDecodeData* pData, const uint32_t* pDrawVertexCounts, uint32_t positionBinding, uint32_t positionOffset,
+	float* pScratchPositions, uint32_t shadowPositionStride, uint32_t shadowNormalStride)
+{
+	Geometry* geom = pData->pGeometry;
+	Geometry::ShadowData* pShadow = geom->pShadow;
+	const uint32_t indexStride = pData->mIndexStride;
+
+	uint8_t* pStreamBase[MAX_VERTEX_BINDINGS + 3] = {};
+	uint32_t streamStrides[MAX_VERTEX_BINDINGS + 3] = {};
+	uint32_t streamCount = 0;
+	uint32_t positionStream = UINT_MAX;
+	for (uint32_t i = 0; i < MAX_VERTEX_BINDINGS; ++i)
+	{
+		if (!pData->mVertexStrides[i])
+			continue;
+
+		if (i == positionBinding)
+			positionStream = streamCount;
+		pStreamBase[streamCount] = (uint8_t*)pData->pVertexData[i];
+		streamStrides[streamCount] = pData->mVertexStrides[i];
+		++streamCount;
+	}
+	if (pScratchPositions)
+	{
+		if (UINT_MAX == positionStream)
+		{
+			positionStream = streamCount;
+			positionOffset = 0;
+		}
+		pStreamBase[streamCount] = (uint8_t*)pScratchPositions;
+		streamStrides[streamCount] = sizeof(float[3]);
+		++streamCount;
+	}
+	// Shadow copies are remapped along with the packed streams so both stay indexable by the same indices
+	if (pShadow)
+	{
+		if (UINT_MAX == positionStream)
+		{
+			positionStream = streamCount;
+			positionOffset = 0;
+		}
+		pStreamBase[streamCount] = (uint8_t*)pShadow->pAttributes[SEMANTIC_POSITION];
+		streamStrides[streamCount] = shadowPositionStride;
+		++streamCount;
+		pStreamBase[streamCount] = (uint8_t*)pShadow->pAttributes[SEMANTIC_NORMAL];
+		streamStrides[streamCount] = shadowNormalStride;
+		++streamCount;
+	}
+
+	eastl::vector<uint32_t> indices;
+	eastl::vector<uint32_t> remap;
+	uint32_t srcBase = 0;
+	uint32_t dstBase = 0;
+
+	for (uint32_t d = 0; d < geom->mDrawArgCount; ++d)
+	{
+		IndirectDrawIndexArguments* pDraw = &geom->pDrawArgs[d];
+		const uint32_t srcVertexCount = pDrawVertexCounts[d];
+		const uint32_t indexCount = pDraw->mIndexCount;
+		uint32_t vertexCount = srcVertexCount;
+
+		meshopt_Stream streams[MAX_VERTEX_BINDINGS + 3] = {};
+		for (uint32_t s = 0; s < streamCount; ++s)
+		{
+			streams[s].data = pStreamBase[s] + (size_t)srcBase * streamStrides[s];
+			streams[s].size = streamStrides[s];
+			streams[s].stride = streamStrides[s];
+		}
+
+		indices.resize(indexCount);
+		for (uint32_t i = 0; i < indexCount; ++i)
+			indices[i] = readGeometryIndex(pData->pIndexData, indexStride, pDraw->mStartIndex + i) - srcBase;
+
+		remap.resize(srcVertexCount);
+		if (flags & GEOMETRY_LOAD_FLAG_REMOVE_DUPLICATE_VERTICES)
+		{
+			vertexCount = (uint32_t)meshopt_generateVertexRemapMulti(remap.data(), indices.data(), indexCount, srcVertexCount, streams, streamCount);
+			meshopt_remapIndexBuffer(indices.data(), indices.data(), indexCount, remap.data());
+			for (uint32_t s = 0; s < streamCount; ++s)
+				meshopt_remapVertexBuffer((void*)streams[s].data, streams[s].data, srcVertexCount, streams[s].stride, remap.data());
+		}
+
+		if (flags & (GEOMETRY_LOAD_FLAG_OPTIMIZE_VERTEX_CACHE | GEOMETRY_LOAD_FLAG_OPTIMIZE_OVERDRAW))
+		{
+			meshopt_optimizeVertexCache(indices.data(), indices.data(), indexCount, vertexCount);
+		}
+
+		if ((flags & GEOMETRY_LOAD_FLAG_OPTIMIZE_OVERDRAW) && positionStream != UINT_MAX)
+		{
+			const float* pPositions = (const float*)((const uint8_t*)streams[positionStream].data + positionOffset);
+			meshopt_optimizeOverdraw(
+				indices.data(), indices.data(), indexCount, pPositions, vertexCount, streams[positionStream].stride, 1.05f);
+		}
+
+		if (flags & GEOMETRY_LOAD_FLAG_OPTIMIZE_VERTEX_FETCH)
+		{
+			const uint32_t fetchVertexCount = (uint32_t)meshopt_optimizeVertexFetchRemap(remap.data(), indices.data(), indexCount, vertexCount);
+			meshopt_remapIndexBuffer(indices.data(), indices.data(), indexCount, remap.data());
+			for (uint32_t s = 0; s < streamCount; ++s)
+				meshopt_remapVertexBuffer((void*)streams[s].data, streams[s].data, vertexCount, streams[s].stride, remap.data());
+			vertexCount = fetchVertexCount;
+		}
+
+		// Move the remaining vertices behind the previous draw and rebase the indices onto them
+		for (uint32_t s = 0; s < streamCount; ++s)
+			memmove(pStreamBase[s] + (size_t)dstBase * streamStrides[s], streams[s].data, (size_t)vertexCount * streamStrides[s]);
+
+		for (uint32_t i = 0; i < indexCount; ++i)
+		{
+			writeGeometryIndex(pData->pIndexData, indexStride, pDraw->mStartIndex + i, dstBase + indices[i]);
+			if (pShadow)
+				writeGeometryIndex(pShadow->pIndices, indexStride, pDraw->mStartIndex + i, dstBase + indices[i]);
+		}
+
+		srcBase += srcVertexCount;
+		dstBase += vertexCount;
+	}
+
+	geom->mVertexCount = dstBase;
+}
+
+#define GEOMETRY_MESHLET_MAX_VERTICES 64
+#define GEOMETRY_MESHLET_MAX_TRIANGLES 124
+
+typedef struct MeshletBuildData
+{
+	GeometryDecodeData*               pData;
+	const uint8_t*                    pPositions;
+	uint32_t                          mPositionStride;
+	/// Meshlets of each draw, concatenated once all draws are done
+	eastl::vector<Geometry::Meshlet>* pDrawMeshlets;
+} MeshletBuildData;
+
+// Splits one draw into meshlets. Draws touch disjoint index ranges so they are built in parallel
+static void buildDrawMeshlets(void* pUserData, uint32_t drawIndex)
+{
+	MeshletBuildData* pBuild = (MeshletBuildData*)pUserData;
+	GeometryDecodeData* pData = pBuild->pData;
+	Geometry::ShadowData* pShadow = pData->pGeometry->pShadow;
+	const IndirectDrawIndexArguments* pDraw = &pData->pGeometry->pDrawArgs[drawIndex];
+	const uint32_t indexStride = pData->mIndexStride;
+	const uint32_t indexCount = pDraw->mIndexCount;
+	const uint32_t positionStride = pBuild->mPositionStride;
+
+	if (!indexCount)
+		return;
+
+	// Rebase the draw onto the vertex range it references
+	eastl::vector<uint32_t> indices(indexCount);
+	uint32_t minVertex = UINT_MAX;
+	uint32_t maxVertex = 0;
+	for (uint32_t i = 0; i < indexCount; ++i)
+	{
+		indices[i] = readGeometryIndex(pData->pIndexData, indexStride, pDraw->mStartIndex + i);
+		minVertex = min(minVertex, indices[i]);
+		maxVertex = max(maxVertex, indices[i]);
+	}
+	for (uint32_t i = 0; i < indexCount; ++i)
+		indices[i] -= minVertex;
+
+	const uint32_t vertexCount = maxVertex - minVertex + 1;
+	const float* pPositions = (const float*)(pBuild->pPositions + (size_t)minVertex * positionStride);
+
+	// The meshlet builder walks triangles in order. Sorting them spatially first keeps each meshlet compact
+	meshopt_spatialSortTriangles(indices.data(), indices.data(), indexCount, pPositions, vertexCount, positionStride);
+	meshopt_optimizeVertexCache(indices.data(), indices.data(), indexCount, vertexCount);
+
+	eastl::vector<meshopt_Meshlet> meshlets(meshopt_buildMeshletsBound(indexCount, GEOMETRY_MESHLET_MAX_VERTICES, GEOMETRY_MESHLET_MAX_TRIANGLES));
+	meshlets.resize(meshopt_buildMeshlets(
+		meshlets.data(), indices.data(), indexCount, vertexCount, GEOMETRY_MESHLET_MAX_VERTICES, GEOMETRY_MESHLET_MAX_TRIANGLES));
+
+	eastl::vector<Geometry::Meshlet>& drawMeshlets = pBuild->pDrawMeshlets[drawIndex];
+	drawMeshlets.resize(meshlets.size());
+
+	// Meshlets cover consecutive triangles of the reordered index list, which is written back over the draw's index range
+	uint32_t indexStart = pDraw->mStartIndex;
+	for (uint32_t m = 0; m < (uint32_t)meshlets.size(); ++m)
+	{
+		const meshopt_Meshlet* pSrc = &meshlets[m];
+		const meshopt_Bounds bounds = meshopt_computeMeshletBounds(pSrc, pPositions, vertexCount, positionStride);
+
+		Geometry::Meshlet* pDst = &drawMeshlets[m];
+		pDst->mIndexStart = indexStart;
+		pDst->mTriangleCount = pSrc->triangle_count;
+		pDst->mDrawIndex = drawIndex;
+		memcpy(pDst->mCenter, bounds.center, sizeof(pDst->mCenter));
+		pDst->mRadius = bounds.radius;
+		memcpy(pDst->mConeApex, bounds.cone_apex, sizeof(pDst->mConeApex));
+		memcpy(pDst->mConeAxis, bounds.cone_axis, sizeof(pDst->mConeAxis));
+		pDst->mConeCutoff = bounds.cone_cutoff;
+
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			pDst->mAabbMin[c] = FLT_MAX;
+			pDst->mAabbMax[c] = -FLT_MAX;
+		}
+		for (uint32_t v = 0; v < pSrc->vertex_count; ++v)
+		{
+			const float* pPosition = (const float*)((const uint8_t*)pPositions + (size_t)pSrc->vertices[v] * positionStride);
+			for (uint32_t c = 0; c < 3; ++c)
+			{
+				pDst->mAabbMin[c] = min(pDst->mAabbMin[c], pPosition[c]);
+				pDst->mAabbMax[c] = max(pDst->mAabbMax[c], pPosition[c]);
+			}
+		}
+
+		for (uint32_t t = 0; t < pSrc->triangle_count; ++t)
+		{
+			for (uint32_t k = 0; k < 3; ++k)
+			{
+				const uint32_t index = minVertex + pSrc->vertices[pSrc->indices[t][k]];
+				writeGeometryIndex(pData->pIndexData, indexStride, indexStart, index);
+				if (pShadow)
+					writeGeometryIndex(pShadow->pIndices, indexStride, indexStart, index);
+				++indexStart;
+			}
+		}
+	}
+	ASSERT(indexStart == pDraw->mStartIndex + indexCount);
+}
+
+static void buildGeometryMeshlets(GeometryDecodeData* pData, const uint8_t* pPositions, uint32_t positionStride)
+{
+	Geometry* geom = pData->pGeometry;
+
+	eastl::vector<eastl::vector<Geometry::Meshlet> > drawMeshlets(geom->mDrawArgCount);
+
+	MeshletBuildData build = {};
+	build.pData = pData;
+	build.pPositions = pPositions;
+	build.mPositionStride = positionStride;
+	build.pDrawMeshlets = drawMeshlets.data();
+
+	runDecodeTask(pResourceLoader, buildDrawMeshlets, &build, geom->mDrawArgCount);
+
+	uint32_t meshletCount = 0;
+	for (uint32_t d = 0; d < geom->mDrawArgCount; ++d)
+		meshletCount += (uint32_t)drawMeshlets[d].size();
+
+	geom->pMeshlets = (Geometry::Meshlet*)tf_malloc(meshletCount * sizeof(Geometry::Meshlet));
+	geom->mMeshletCount = meshletCount;
+
+	meshletCount = 0;
+	for (uint32_t d = 0; d < geom->mDrawArgCount; ++d)
+	{
+		if (!drawMeshlets[d].empty())
+			memcpy(geom->pMeshlets + meshletCount, drawMeshlets[d].data(), drawMeshlets[d].size() * sizeof(Geometry::Meshlet));
+		meshletCount += (uint32_t)drawMeshlets[d].size();
+	}
+}
+
+static bool isValidGeometryQuantization(GeometryQuantization quantization, TinyImageFormat format)
+{
+	switch (quantization)
+	{
+	case GEOMETRY_QUANTIZATION_SNORM16_BOUNDS: return TinyImageFormat_R16G16B16A16_SNORM == format;
+	case GEOMETRY_QUANTIZATION_OCTAHEDRAL:
+		return TinyImageFormat_R8G8_SNORM == format || TinyImageFormat_R16G16_SNORM == format || TinyImageFormat_R16G16B16A16_SNORM == format;
+	case GEOMETRY_QUANTIZATION_UNORM16_BOUNDS: return TinyImageFormat_R16G16_UNORM == format;
+	case GEOMETRY_QUANTIZATION_UNORM8_WEIGHTS: return TinyImageFormat_R8G8B8A8_UNORM == format;
+	default: return false;
+	}
+}
+
+// The bounds of attributes quantized relative to them become their dequantization parameters
+static void computeQuantizationBounds(const cgltf_data* data, const GeometryQuantization* pQuantization, Geometry::Dequantization* pDequantization)
+{
+	float boundsMin[SEMANTIC_TEXCOORD9 + 1][4];
+	float boundsMax[SEMANTIC_TEXCOORD9 + 1][4];
+	for (uint32_t s = 0; s < SEMANTIC_TEXCOORD9 + 1; ++s)
+	{
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			boundsMin[s][c] = FLT_MAX;
+			boundsMax[s][c] = -FLT_MAX;
+		}
+	}
+
+	for (uint32_t i = 0; i < data->meshes_count; ++i)
+	{
+		for (uint32_t p = 0; p < data->meshes[i].primitives_count; ++p)
+		{
+			const cgltf_primitive* prim = &data->meshes[i].primitives[p];
+			for (uint32_t a = 0; a < prim->attributes_count; ++a)
+			{
+				const uint32_t semantic = util_cgltf_attrib_type_to_semantic(prim->attributes[a].type, prim->attributes[a].index);
+				const GeometryQuantization quantization = pQuantization[semantic];
+				if (GEOMETRY_QUANTIZATION_SNORM16_BOUNDS != quantization && GEOMETRY_QUANTIZATION_UNORM16_BOUNDS != quantization)
+					continue;
+
+				const cgltf_accessor* accessor = prim->attributes[a].data;
+				const uint32_t componentCount = min((uint32_t)cgltf_num_components(accessor->type), 4u);
+				for (uint32_t e = 0; e < accessor->count; ++e)
+				{
+					float v[4] = {};
+					cgltf_accessor_read_float(accessor, e, v, 4);
+					for (uint32_t c = 0; c < componentCount; ++c)
+					{
+						boundsMin[semantic][c] = min(boundsMin[semantic][c], v[c]);
+						boundsMax[semantic][c] = max(boundsMax[semantic][c], v[c]);
+					}
+				}
+			}
+		}
+	}
+
+	for (uint32_t s = 0; s < SEMANTIC_TEXCOORD9 + 1; ++s)
+	{
+		const GeometryQuantization quantization = pQuantization[s];
+		if (GEOMETRY_QUANTIZATION_SNORM16_BOUNDS != quantization && GEOMETRY_QUANTIZATION_UNORM16_BOUNDS != quantization)
+			continue;
+
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			// Components missing from the source keep the identity mapping
+			if (boundsMin[s][c] > boundsMax[s][c])
+				continue;
+
+			if (GEOMETRY_QUANTIZATION_SNORM16_BOUNDS == quantization)
+			{
+				pDequantization[s].mScale[c] = (boundsMax[s][c] - boundsMin[s][c]) * 0.5f;
+				pDequantization[s].mOffset[c] = (boundsMax[s][c] + boundsMin[s][c]) * 0.5f;
+			}
+			else
+			{
+				pDequantization[s].mScale[c] = boundsMax[s][c] - boundsMin[s][c];
+				pDequantization[s].mOffset[c] = boundsMin[s][c];
+			}
+		}
+	}
+}
+
+// Encodes every element of the accessor into the vertex stream. dst points at the attribute of the first vertex
+static void quantizeVertexAttribute(
+	GeometryQuantization quantization, TinyImageFormat format, const cgltf_accessor* accessor, const Geometry::Dequantization* pDequantization,
+	uint8_t* dst, uint32_t dstStride)
+{
+	const uint32_t componentCount = min((uint32_t)cgltf_num_components(accessor->type), 4u);
+	const uint32_t count = (uint32_t)accessor->count;
+	const float* scale = pDequantization->mScale;
+	const float* offset = pDequantization->mOffset;
+
+	// Plain float streams go straight to the packing kernels, anything else is unpacked to floats first
+	const uint8_t* src = NULL;
+	uint32_t srcStride = 0;
+	float* pUnpacked = NULL;
+	if (cgltf_component_type_r_32f == accessor->component_type && !accessor->is_sparse && accessor->buffer_view)
+	{
+		src = (const uint8_t*)accessor->buffer_view->buffer->data + accessor->offset + accessor->buffer_view->offset;
+		srcStride = (uint32_t)accessor->stride;
+	}
+	else
+	{
+		const uint32_t floatCount = (uint32_t)cgltf_num_components(accessor->type);
+		pUnpacked = (float*)tf_malloc((size_t)count * floatCount * sizeof(float));
+		cgltf_accessor_unpack_floats(accessor, pUnpacked, (cgltf_size)count * floatCount);
+		src = (const uint8_t*)pUnpacked;
+		srcStride = floatCount * sizeof(float);
+	}
+
+	switch (quantization)
+	{
+	case GEOMETRY_QUANTIZATION_SNORM16_BOUNDS:
+	{
+		packFloatToNorm(PACKED_NORM_FORMAT_SNORM16, count, componentCount, scale, offset, src, srcStride, dst, dstStride);
+		for (uint32_t e = 0; e < count; ++e)
+		{
+			int16_t* q = (int16_t*)(dst + (size_t)e * dstStride);
+			for (uint32_t c = componentCount; c < 4; ++c)
+				q[c] = INT16_MAX;
+		}
+		break;
+	}
+	case GEOMETRY_QUANTIZATION_OCTAHEDRAL:
+	{
+		packOctahedral(
+			TinyImageFormat_R8G8_SNORM == format ? PACKED_NORM_FORMAT_SNORM8 : PACKED_NORM_FORMAT_SNORM16, count, src, srcStride, dst, dstStride);
+		if (TinyImageFormat_R16G16B16A16_SNORM == format)
+		{
+			for (uint32_t e = 0; e < count; ++e)
+			{
+				float w = 1.0f;
+				if (componentCount == 4)
+					memcpy(&w, src + (size_t)e * srcStride + 3 * sizeof(float), sizeof(float));
+				int16_t* q = (int16_t*)(dst + (size_t)e * dstStride);
+				q[2] = 0;
+				q[3] = w < 0.0f ? -INT16_MAX : INT16_MAX;
+			}
+		}
+		break;
+	}
+	case GEOMETRY_QUANTIZATION_UNORM16_BOUNDS:
+		packFloatToNorm(PACKED_NORM_FORMAT_UNORM16, count, min(componentCount, 2u), scale, offset, src, srcStride, dst, dstStride);
+		break;
+	case GEOMETRY_QUANTIZATION_UNORM8_WEIGHTS:
+	{
+		for (uint32_t e = 0; e < count; ++e)
+		{
+			float v[4] = {};
+			memcpy(v, src + (size_t)e * srcStride, componentCount * sizeof(float));
+			uint8_t* pDst = dst + (size_t)e * dstStride;
+
+			// Rounding error goes to the largest weight so the quantized weights still sum to one
+			const float sum = v[0] + v[1] + v[2] + v[3];
+			uint32_t total = 0;
+			uint32_t largest = 0;
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				pDst[c] = sum > 0.0f ? (uint8_t)round(clamp(v[c] / sum, 0.0f, 1.0f) * 255.0f) : 0;
+				total += pDst[c];
+				largest = v[c] > v[largest] ? c : largest;
+			}
+			if (sum > 0.0f)
+				pDst[largest] = (uint8_t)(pDst[largest] + 255 - (int32_t)total);
+		}
+		break;
+	}
+	default: break;
+	}
+
+	tf_free(pUnpacked);
+}
+
+// Parses the gltf file and packs index / vertex data into CPU memory in the layout requested by the vertex layout
+static bool decodeGeometry(const GeometryLoadDesc* pDesc, GeometryDecodeData* pOut, uint64_t* pReadTimeUs)
+{
+	char iext[FS_MAX_PATH] = { 0 };
+	fsGetPathExtension(pDesc->pFileName, iext);
+
+	// Geometry in gltf container
+	if (iext[0] != 0 && (stricmp(iext, "gltf") == 0 || stricmp(iext, "glb") == 0))
+	{
+		// Processed geometry from a previous run is reused while the source files and vertex layout are unchanged
+		const bool useCache = fsIsResourceDirectorySet(RD_GEOMETRY_CACHE);
+		uint64_t layoutHash = 0;
+		char cacheName[FS_MAX_PATH] = { 0 };
+		if (useCache)
+		{
+			layoutHash = getGeometryLayoutHash(pDesc);
+			getGeometryCacheName(pDesc, layoutHash, cacheName);
+			int64_t cacheStart = getUSec();
+			bool cached = loadGeometryCache(pDesc, cacheName, layoutHash, pOut);
+			*pReadTimeUs += getUSec() - cacheStart;
+			if (cached)
+			{
+				tf_free(pDesc->pVertexLayout);
+				return true;
+			}
+		}
+
+		int64_t readStart = getUSec();
+		FileStream file = {};
+		if (!fsOpenStreamFromPath(RD_MESHES, pDesc->pFileName, FM_READ_BINARY, &file))
+		{
+			LOGF(eERROR, "Failed to open gltf file %s", pDesc->pFileName);
+			ASSERT(false);
+			return false;
+		}
+
+		ssize_t fileSize = fsGetStreamFileSize(&file);
+		void* fileData = tf_malloc(fileSize);
+
+		fsReadFromStream(&file, fileData, fileSize);
+		*pReadTimeUs += getUSec() - readStart;
+
+		bool cacheable = useCache;
+		uint64_t sourceHash = cacheable ? hashData(fileData, fileSize, 0) : 0;
+		eastl::vector<GeometryCacheDependency> dependencies;
+
+		cgltf_options options = {};
+		cgltf_data* data = NULL;
+		options.memory_alloc = [](void* user, cgltf_size size) { return tf_malloc(size); };
+		options.memory_free = [](void* user, void* ptr) { tf_free(ptr); };
+		cgltf_result result = cgltf_parse(&options, fileData, fileSize, &data);
+		fsCloseStream(&file);
+
+		if (cgltf_result_success != result)
+		{
+			LOGF(eERROR, "Failed to parse gltf file %s with error %u", pDesc->pFileName, (uint32_t)result);
+			ASSERT(false);
+			tf_free(fileData);
+			return false;
+		}
+
+#if defined(FORGE_DEBUG)
+		result = cgltf_validate(data);
+		if (cgltf_result_success != result)
+		{
+			LOGF(eWARNING, "GLTF validation finished with error %u for file %s", (uint32_t)result, pDesc->pFileName);
+		}
+#endif
+
+		// Load buffers located in separate files (.bin) using our file system
+		for (uint32_t i = 0; i < data->buffers_count; ++i)
+		{
+			const char* uri = data->buffers[i].uri;
+
+			if (!uri || data->buffers[i].data)
+			{
+				continue;
+			}
+
+			if (strncmp(uri, "data:", 5) != 0 && !strstr(uri, "://"))
+			{
+				char parent[FS_MAX_PATH] = { 0 };
+				fsGetParentPath(pDesc->pFileName, parent);
+				char path[FS_MAX_PATH] = { 0 };
+				fsAppendPathComponent(parent, uri, path);
+				readStart = getUSec();
+				FileStream fs = {};
+				if (fsOpenStreamFromPath(RD_MESHES, path, FM_READ_BINARY, &fs))
+				{
+					ASSERT(fsGetStreamFileSize(&fs) >= (ssize_t)data->buffers[i].size);
+					data->buffers[i].data = tf_malloc(data->buffers[i].size);
+					fsReadFromStream(&fs, data->buffers[i].data, data->buffers[i].size);
+					*pReadTimeUs += getUSec() - readStart;
+
+					if (cacheable)
+					{
+						GeometryCacheDependency dependency = {};
+						strncpy(dependency.mPath, path, FS_MAX_PATH - 1);
+						dependency.mSize = data->buffers[i].size;
+						dependencies.push_back(dependency);
+						sourceHash = hashData(data->buffers[i].data, dependency.mSize, sourceHash);
+					}
+				}
+				else
+				{
+					cacheable = false;
+				}
+				fsCloseStream(&fs);
+			}
+			else if (strncmp(uri, "data:", 5) != 0)
+			{
+				// Buffers outside our file system can not be validated against the cache
+				cacheable = false;
+			}
+		}
+
+		result = cgltf_load_buffers(&options, data, pDesc->pFileName);
+		if (cgltf_result_success != result)
+		{
+			LOGF(eERROR, "Failed to load buffers from gltf file %s with error %u", pDesc->pFileName, (uint32_t)result);
+			ASSERT(false);
+			tf_free(fileData);
+			return false;
+		}
+
+		typedef void (*PackingFunction)(uint32_t count, uint32_t srcStride, const uint8_t* src, uint8_t* dst, uint32_t dstStride);
+
+		uint32_t vertexStrides[SEMANTIC_TEXCOORD9 + 1] = {};
+		uint32_t vertexAttribCount[SEMANTIC_TEXCOORD9 + 1] = {};
+		uint32_t vertexOffsets[SEMANTIC_TEXCOORD9 + 1] = {};
+		uint32_t vertexBindings[SEMANTIC_TEXCOORD9 + 1] = {};
+		cgltf_attribute* vertexAttribs[SEMANTIC_TEXCOORD9 + 1] = {};
+		PackingFunction vertexPacking[SEMANTIC_TEXCOORD9 + 1] = {};
+		GeometryQuantization vertexQuantization[SEMANTIC_TEXCOORD9 + 1] = {};
+		TinyImageFormat vertexFormats[SEMANTIC_TEXCOORD9 + 1] = {};
+		for (uint32_t i = 0; i < SEMANTIC_TEXCOORD9 + 1; ++i)
+			vertexOffsets[i] = UINT_MAX;
+
+		uint32_t indexCount = 0;
+		uint32_t vertexCount = 0;
+		uint32_t drawCount = 0;
+		uint32_t jointCount = 0;
+		uint32_t vertexBufferCount = 0;
+
+		// Find number of traditional draw calls required to draw this piece of geometry
+		// Find total index count, total vertex count
+		for (uint32_t i = 0; i < data->meshes_count; ++i)
+		{
+			for (uint32_t p = 0; p < data->meshes[i].primitives_count; ++p)
+			{
+				const cgltf_primitive* prim = &data->meshes[i].primitives[p];
+				indexCount += (uint32_t)prim->indices->count;
+				vertexCount += (uint32_t)prim->attributes->data->count;
+				++drawCount;
+
+				for (uint32_t i = 0; i < prim->attributes_count; ++i)
+					vertexAttribs[util_cgltf_attrib_type_to_semantic(prim->attributes[i].type, prim->attributes[i].index)] = &prim->attributes[i];
+			}
+		}
+
+		uint32_t defaultTexcoordSemantic = SEMANTIC_UNDEFINED;
+		uint32_t defaultTexcoordStride = 0;
+
+		// Determine vertex stride for each binding
+		for (uint32_t i = 0; i < pDesc->pVertexLayout->mAttribCount; ++i)
+		{
+			const VertexAttrib* attr = &pDesc->pVertexLayout->mAttribs[i];
+			const cgltf_attribute* cgltfAttr = vertexAttribs[attr->mSemantic];
+			
+			bool defaultTexcoords = !cgltfAttr && (attr->mSemantic >= SEMANTIC_TEXCOORD0 && attr->mSemantic <= SEMANTIC_TEXCOORD9);
+			ASSERT(cgltfAttr || defaultTexcoords);
+
+			const uint32_t dstFormatSize = TinyImageFormat_BitSizeOfBlock(attr->mFormat) >> 3;
+
+			if (defaultTexcoords)
+			{
+				// Make sure there are only 1 set of default texcoords
+				ASSERT(defaultTexcoordSemantic == SEMANTIC_UNDEFINED);
+
+				defaultTexcoordStride = dstFormatSize ? dstFormatSize : 2 * sizeof(float); // (0.f, 0.f)
+				defaultTexcoordSemantic = attr->mSemantic;
+
+				vertexStrides[attr->mBinding] += defaultTexcoordStride;
+				vertexOffsets[defaultTexcoordSemantic] = attr->mOffset;
+				vertexBindings[defaultTexcoordSemantic] = attr->mBinding;
+				++vertexAttribCount[attr->mBinding];
+				
+				continue;
+			}
+
+			const uint32_t srcFormatSize = (uint32_t)cgltfAttr->data->stride; //-V522
+
+			vertexStrides[attr->mBinding] += dstFormatSize ? dstFormatSize : srcFormatSize;
+			vertexOffsets[attr->mSemantic] = attr->mOffset;
+			vertexBindings[attr->mSemantic] = attr->mBinding;
+			++vertexAttribCount[attr->mBinding];
+
+			// Quantized attributes are encoded straight from the accessor values instead of going through a packing function
+			const GeometryQuantization quantization = pDesc->mQuantization[attr->mSemantic];
+			if (GEOMETRY_QUANTIZATION_NONE != quantization)
+			{
+				if (isValidGeometryQuantization(quantization, attr->mFormat))
+				{
+					vertexQuantization[attr->mSemantic] = quantization;
+					vertexFormats[attr->mSemantic] = attr->mFormat;
+					continue;
+				}
+				LOGF(eWARNING, "Vertex format %s does not match quantization mode %u of semantic %u in %s",
+					TinyImageFormat_Name(attr->mFormat), (uint32_t)quantization, (uint32_t)attr->mSemantic, pDesc->pFileName);
+			}
+
+			// Compare vertex attrib format to the gltf attrib type
+			// Select a packing function if dst format is packed version
+			// Texcoords - Pack float2 to half2
+			// Directions - Pack float3 to float2 to unorm2x16 (Normal, Tangent)
+			// Position - No packing yet
+			const TinyImageFormat srcFormat = util_cgltf_type_to_image_format(cgltfAttr->data->type, cgltfAttr->data->component_type);
+			const TinyImageFormat dstFormat = attr->mFormat == TinyImageFormat_UNDEFINED ? srcFormat : attr->mFormat;
+
+			if (dstFormat != srcFormat)
+			{
+				// Select appropriate packing function which will be used when filling the vertex buffer
+				switch (cgltfAttr->type)
+				{
+				case cgltf_attribute_type_texcoord:
+				{
+					if (sizeof(uint32_t) == dstFormatSize && sizeof(float[2]) == srcFormatSize)
+						vertexPacking[attr->mSemantic] = util_pack_float2_to_half2;
+					// #TODO: Add more variations if needed
+					break;
+				}
+				case cgltf_attribute_type_normal:
+				case cgltf_attribute_type_tangent:
+				{
+					if (sizeof(uint32_t) == dstFormatSize && (sizeof(float[3]) == srcFormatSize || sizeof(float[4]) == srcFormatSize))
+						vertexPacking[attr->mSemantic] = util_pack_float3_direction_to_half2;
+					// #TODO: Add more variations if needed
+					break;
+				}
+				default:
+					break;
+				}
+			}
+		}
+
+		// Determine number of vertex buffers needed based on number of unique bindings found
+		// For each unique binding the vertex stride will be non zero
+		for (uint32_t i = 0; i < MAX_VERTEX_BINDINGS; ++i)
+			if (vertexStrides[i])
+				++vertexBufferCount;
+
+		for (uint32_t i = 0; i < data->skins_count; ++i)
+			jointCount += (uint32_t)data->skins[i].joints_count;
+
+		// Determine index stride
+		// This depends on vertex count rather than the stride specified in gltf
+		// since gltf assumes we have index buffer per primitive which is non optimal
+		const uint32_t indexStride = vertexCount > UINT16_MAX ? sizeof(uint32_t) : sizeof(uint16_t);
+
+		Geometry* geom = allocGeometry(drawCount, jointCount);
+
+		uint32_t shadowSize = 0;
+		if (pDesc->mFlags & GEOMETRY_LOAD_FLAG_SHADOWED)
+		{
+			shadowSize += (uint32_t)vertexAttribs[SEMANTIC_POSITION]->data->stride * vertexCount;
+			shadowSize += (uint32_t)vertexAttribs[SEMANTIC_NORMAL]->data->stride   * vertexCount;
+			shadowSize += indexCount * indexStride;
+
+			geom->pShadow = (Geometry::ShadowData*)tf_calloc(1, sizeof(Geometry::ShadowData) + shadowSize);
+			geom->pShadow->pIndices = geom->pShadow + 1;
+			geom->pShadow->pAttributes[SEMANTIC_POSITION] = (uint8_t*)geom->pShadow->pIndices + (indexCount * indexStride);
+			geom->pShadow->pAttributes[SEMANTIC_NORMAL] = (uint8_t*)geom->pShadow->pAttributes[SEMANTIC_POSITION]
+				+ ((uint32_t)vertexAttribs[SEMANTIC_POSITION]->data->stride * vertexCount);
+			// #TODO: Add more if needed
+		}
+
+		geom->mVertexBufferCount = vertexBufferCount;
+		geom->mDrawArgCount = drawCount;
+		geom->mIndexCount = indexCount;
+		geom->mVertexCount = vertexCount;
+		geom->mIndexType = (sizeof(uint16_t) == indexStride) ? INDEX_TYPE_UINT16 : INDEX_TYPE_UINT32;
+		geom->mJointCount = jointCount;
+
+		computeQuantizationBounds(data, vertexQuantization, geom->mDequantization);
+
+		// The overdraw and meshlet passes need float3 positions. Keep a copy if the packed stream does not hold them
+		const bool floatPositions = UINT_MAX != vertexOffsets[SEMANTIC_POSITION] && GEOMETRY_QUANTIZATION_NONE == vertexQuantization[SEMANTIC_POSITION];
+		eastl::vector<float> scratchPositions;
+		if (!floatPositions && (pDesc->mFlags & (GEOMETRY_LOAD_FLAG_OPTIMIZE_OVERDRAW | GEOMETRY_LOAD_FLAG_MESHLETS)) && vertexAttribs[SEMANTIC_POSITION])
+		{
+			scratchPositions.resize((size_t)vertexCount * 3);
+		}
+
+		// Pack into CPU memory. Buffers and staging memory are allocated by the streamer thread
+		pOut->pIndexData = tf_malloc(indexCount * indexStride);
+		pOut->mIndexStride = indexStride;
+
+		uint32_t bufferCounter = 0;
+		for (uint32_t i = 0; i < MAX_VERTEX_BINDINGS; ++i)
+		{
+			if (!vertexStrides[i])
+				continue;
+
+			pOut->pVertexData[i] = tf_malloc(vertexStrides[i] * vertexCount);
+			pOut->mVertexStrides[i] = vertexStrides[i];
+			geom->mVertexStrides[bufferCounter] = vertexStrides[i];
+			++bufferCounter;
+		}
+
+		indexCount = 0;
+		vertexCount = 0;
+		drawCount = 0;
+
+		eastl::vector<uint32_t> drawVertexCounts;
+		drawVertexCounts.reserve(geom->mDrawArgCount);
+
+		for (uint32_t i = 0; i < data->meshes_count; ++i)
+		{
+			for (uint32_t p = 0; p < data->meshes[i].primitives_count; ++p)
+			{
+				const cgltf_primitive* prim = &data->meshes[i].primitives[p];
+				/************************************************************************/
+				// Fill index buffer for this primitive
+				/************************************************************************/
+				if (sizeof(uint16_t) == indexStride)
+				{
+					uint16_t* dst = (uint16_t*)pOut->pIndexData;
+					for (uint32_t idx = 0; idx < prim->indices->count; ++idx)
+						dst[indexCount + idx] = vertexCount + (uint16_t)cgltf_accessor_read_index(prim->indices, idx);
+				}
+				else
+				{
+					uint32_t* dst = (uint32_t*)pOut->pIndexData;
+					for (uint32_t idx = 0; idx < prim->indices->count; ++idx)
+						dst[indexCount + idx] = vertexCount + (uint32_t)cgltf_accessor_read_index(prim->indices, idx);
+				}
+				/************************************************************************/
+				// Fill vertex buffers for this primitive
+				/************************************************************************/
+				for (uint32_t a = 0; a < prim->attributes_count; ++a)
+				{
+					cgltf_attribute* attr = &prim->attributes[a];
+					uint32_t index = util_cgltf_attrib_type_to_semantic(attr->type, attr->index);
+
+					if (vertexOffsets[index] != UINT_MAX)
+					{
+						const uint32_t binding = vertexBindings[index];
+						const uint32_t offset = vertexOffsets[index];
+						const uint32_t stride = vertexStrides[binding];
+						const uint8_t* src = (uint8_t*)attr->data->buffer_view->buffer->data + attr->data->offset + attr->data->buffer_view->offset;
+
+						if (GEOMETRY_QUANTIZATION_NONE != vertexQuantization[index])
+						{
+							uint8_t* dst = (uint8_t*)pOut->pVertexData[binding] + vertexCount * stride + offset;
+							quantizeVertexAttribute(vertexQuantization[index], vertexFormats[index], attr->data, &geom->mDequantization[index], dst, stride);
+						}
+						// If this vertex attribute is not interleaved with any other attribute use fast path instead of copying one by one
+						// In this case a simple memcpy will be enough to transfer the data to the buffer
+						else if (1 == vertexAttribCount[binding])
+						{
+							uint8_t* dst = (uint8_t*)pOut->pVertexData[binding] + vertexCount * stride;
+							if (vertexPacking[index])
+								vertexPacking[index]((uint32_t)attr->data->count, (uint32_t)attr->data->stride, src, dst, stride);
+							else
+								memcpy(dst, src, attr->data->count * attr->data->stride);
+						}
+						else
+						{
+							uint8_t* dst = (uint8_t*)pOut->pVertexData[binding] + vertexCount * stride;
+							// Loop through all vertices copying into the correct place in the vertex buffer
+							// Example:
+							// [ POSITION | NORMAL | TEXCOORD ] => [ 0 | 12 | 24 ], [ 32 | 44 | 52 ], ... (vertex stride of 32 => 12 + 12 + 8)
+							if (vertexPacking[index])
+								vertexPacking[index]((uint32_t)attr->data->count, (uint32_t)attr->data->stride, src, dst + offset, stride);
+							else
+								for (uint32_t e = 0; e < attr->data->count; ++e)
+									memcpy(dst + e * stride + offset, src + e * attr->data->stride, attr->data->stride);
+						}
+					}
+
+					if (!scratchPositions.empty() && cgltf_attribute_type_position == attr->type)
+					{
+						for (uint32_t e = 0; e < attr->data->count; ++e)
+							cgltf_accessor_read_float(attr->data, e, &scratchPositions[(size_t)(vertexCount + e) * 3], 3);
+					}
+				}
+
+				// If used, set default texcoords in buffer to (0.f, 0.f) - assume copy engine does not give us zero'd memory
+				if (defaultTexcoordSemantic != SEMANTIC_UNDEFINED)
+				{
+					const uint32_t binding = vertexBindings[defaultTexcoordSemantic];
+					const uint32_t offset = vertexOffsets[defaultTexcoordSemantic];
+					const uint32_t stride = vertexStrides[binding];
+
+					uint8_t* dst = (uint8_t*)pOut->pVertexData[binding] + vertexCount * stride;
+					const uint32_t count = (uint32_t)prim->attributes[0].data->count;
+
+					for (uint32_t i = 0; i < count; ++i)
+						memset(dst + i * stride + offset, 0, defaultTexcoordStride);
+				}
+
+				/************************************************************************/
+				// Fill draw arguments for this primitive
+				/************************************************************************/
+				geom->pDrawArgs[drawCount].mIndexCount = (uint32_t)prim->indices->count;
+				geom->pDrawArgs[drawCount].mInstanceCount = 1;
+				geom->pDrawArgs[drawCount].mStartIndex = indexCount;
+				geom->pDrawArgs[drawCount].mStartInstance = 0;
+				// Since we already offset indices when creating the index buffer, vertex offset will be zero
+				// With this approach, we can draw everything in one draw call or use the traditional draw per subset without the
+				// need for changing shader code
+				geom->pDrawArgs[drawCount].mVertexOffset = 0;
+
+				drawVertexCounts.push_back((uint32_t)prim->attributes->data->count);
+
+				indexCount += (uint32_t)prim->indices->count;
+				vertexCount += (uint32_t)prim->attributes->data->count;
+				++drawCount;
+			}
+		}
+
+		// Load the remap joint indices generated in the offline process
+		uint32_t remapCount = 0;
+		for (uint32_t i = 0; i < data->skins_count; ++i)
+		{
+			const cgltf_skin* skin = &data->skins[i];
+			uint32_t extrasSize = (uint32_t)(skin->extras.end_offset - skin->extras.start_offset);
+			if (extrasSize)
+			{
+				const char* jointRemaps = (const char*)data->json + skin->extras.start_offset;
+				jsmn_parser parser = {};
+				jsmntok_t* tokens = (jsmntok_t*)tf_malloc((skin->joints_count + 1) * sizeof(jsmntok_t));
+				jsmn_parse(&parser, (const char*)jointRemaps, extrasSize, tokens, skin->joints_count + 1);
+				ASSERT(tokens[0].size == skin->joints_count + 1);
+				cgltf_accessor_unpack_floats(skin->inverse_bind_matrices, (cgltf_float*)geom->pInverseBindPoses, skin->joints_count * sizeof(float[16]) / sizeof(float));
+				for (uint32_t r = 0; r < skin->joints_count; ++r)
+					geom->pJointRemaps[remapCount + r] = atoi(jointRemaps + tokens[1 + r].start);
+				tf_free(tokens);
+			}
+
+			remapCount += (uint32_t)skin->joints_count;
+		}
+
+		// Load the tressfx specific data generated in the offline process
+		if (stricmp(data->asset.generator, "tressfx") == 0)
+		{
+			// { "mVertexCountPerStrand" : "16", "mGuideCountPerStrand" : "3456" }
+			uint32_t extrasSize = (uint32_t)(data->asset.extras.end_offset - data->asset.extras.start_offset);
+			const char* json = data->json + data->asset.extras.start_offset;
+			jsmn_parser parser = {};
+			jsmntok_t tokens[5] = {};
+			jsmn_parse(&parser, (const char*)json, extrasSize, tokens, 5);
+			geom->mHair.mVertexCountPerStrand = atoi(json + tokens[2].start);
+			geom->mHair.mGuideCountPerStrand = atoi(json + tokens[4].start);
 		}
 
-		// Determine number of vertex buffers needed based on number of unique bindings found
-		// For each unique binding the vertex stride will be non zero
-		for (uint32_t i = 0; i < MAX_VERTEX_BINDINGS; ++i)
-			if (vertexStrides[i])
-				++vertexBufferCount;
+		if (pDesc->mFlags & GEOMETRY_LOAD_FLAG_SHADOWED)
+		{
+			indexCount = 0;
+			vertexCount = 0;
 
-		for (uint32_t i = 0; i < data->skins_count; ++i)
-			jointCount += (uint32_t)data->skins[i].joints_count;
+			for (uint32_t i = 0; i < data->meshes_count; ++i)
+			{
+				for (uint32_t p = 0; p < data->meshes[i].primitives_count; ++p)
+				{
+					const cgltf_primitive* prim = &data->meshes[i].primitives[p];
+					/************************************************************************/
+					// Fill index buffer for this primitive
+					/************************************************************************/
+					if (sizeof(uint16_t) == indexStride)
+					{
+						uint16_t* dst = (uint16_t*)geom->pShadow->pIndices;
+						for (uint32_t idx = 0; idx < prim->indices->count; ++idx)
+							dst[indexCount + idx] = vertexCount + (uint16_t)cgltf_accessor_read_index(prim->indices, idx);
+					}
+					else
+					{
+						uint32_t* dst = (uint32_t*)geom->pShadow->pIndices;
+						for (uint32_t idx = 0; idx < prim->indices->count; ++idx)
+							dst[indexCount + idx] = vertexCount + (uint32_t)cgltf_accessor_read_index(prim->indices, idx);
+					}
 
-		// Determine index stride
-		// This depends on vertex count rather than the stride specified in gltf
-		// since gltf assumes we have index buffer per primitive which is non optimal
-		const uint32_t indexStride = vertexCount > UINT16_MAX ? sizeof(uint32_t) : sizeof(uint16_t);
+					for (uint32_t a = 0; a < prim->attributes_count; ++a)
+					{
+						cgltf_attribute* attr = &prim->attributes[a];
+						if (cgltf_attribute_type_position == attr->type)
+						{
+							const uint8_t* src = (uint8_t*)attr->data->buffer_view->buffer->data + attr->data->offset + attr->data->buffer_view->offset;
+							uint8_t* dst = (uint8_t*)geom->pShadow->pAttributes[SEMANTIC_POSITION] + vertexCount * attr->data->stride;
+							memcpy(dst, src, attr->data->count * attr->data->stride);
+						}
+						else if (cgltf_attribute_type_normal == attr->type)
+						{
+							const uint8_t* src = (uint8_t*)attr->data->buffer_view->buffer->data + attr->data->offset + attr->data->buffer_view->offset;
+							uint8_t* dst = (uint8_t*)geom->pShadow->pAttributes[SEMANTIC_NORMAL] + vertexCount * attr->data->stride;
+							memcpy(dst, src, attr->data->count * attr->data->stride);
+						}
+					}
+
+					indexCount += (uint32_t)prim->indices->count;
+					vertexCount += (uint32_t)prim->attributes->data->count;
+				}
+			}
+		}
 
-		uint32_t totalSize = 0;
-		totalSize += round_up(sizeof(Geometry), 16);
-		totalSize += round_up(drawCount * sizeof(IndirectDrawIndexArguments), 16);
-		totalSize += round_up(jointCount * sizeof(mat4), 16);
-		totalSize += round_up(jointCount * sizeof(uint32_t), 16);
+		pOut->pGeometry = geom;
 
-		Geometry* geom = (Geometry*)tf_calloc(1, totalSize);
-		ASSERT(geom);
+		// Optimize after packing so the optimized layout is what gets cached and uploaded
+		const GeometryLoadFlags optimizeFlags = pDesc->mFlags &
+			(GEOMETRY_LOAD_FLAG_REMOVE_DUPLICATE_VERTICES | GEOMETRY_LOAD_FLAG_OPTIMIZE_VERTEX_CACHE | GEOMETRY_LOAD_FLAG_OPTIMIZE_OVERDRAW |
+			 GEOMETRY_LOAD_FLAG_OPTIMIZE_VERTEX_FETCH);
+		if (optimizeFlags)
+		{
+			const uint32_t positionBinding = floatPositions ? vertexBindings[SEMANTIC_POSITION] : UINT_MAX;
+			const uint32_t shadowPositionStride = geom->pShadow ? (uint32_t)vertexAttribs[SEMANTIC_POSITION]->data->stride : 0;
+			const uint32_t shadowNormalStride = geom->pShadow ? (uint32_t)vertexAttribs[SEMANTIC_NORMAL]->data->stride : 0;
+			optimizeGeometry(
+				optimizeFlags, pOut, drawVertexCounts.data(), positionBinding, vertexOffsets[SEMANTIC_POSITION],
+				scratchPositions.empty() ? NULL : scratchPositions.data(), shadowPositionStride, shadowNormalStride);
+		}
 
-		geom->pDrawArgs = (IndirectDrawIndexArguments*)(geom + 1); //-V1027
-		geom->pInverseBindPoses = (mat4*)((uint8_t*)geom->pDrawArgs + round_up(drawCount * sizeof(*geom->pDrawArgs), 16));
-		geom->pJointRemaps = (uint32_t*)((uint8_t*)geom->pInverseBindPoses + round_up(jointCount * sizeof(*geom->pInverseBindPoses), 16));
+		if (pDesc->mFlags & GEOMETRY_LOAD_FLAG_MESHLETS)
+		{
+			// Meshlet bounds need float3 positions from the packed stream holding them or from the scratch copy
+			if (floatPositions)
+			{
+				const uint32_t binding = vertexBindings[SEMANTIC_POSITION];
+				buildGeometryMeshlets(
+					pOut, (const uint8_t*)pOut->pVertexData[binding] + vertexOffsets[SEMANTIC_POSITION], pOut->mVertexStrides[binding]);
+			}
+			else if (!scratchPositions.empty())
+			{
+				buildGeometryMeshlets(pOut, (const uint8_t*)scratchPositions.data(), sizeof(float[3]));
+			}
+			else
+			{
+				LOGF(eWARNING, "Meshlets of %s need vertex positions", pDesc->pFileName);
+			}
+		}
 
-		uint32_t shadowSize = 0;
-		if (pDesc->mFlags & GEOMETRY_LOAD_FLAG_SHADOWED)
+		data->file_data = fileData;
+		cgltf_free(data);
+
+		if (cacheable)
 		{
-			shadowSize += (uint32_t)vertexAttribs[SEMANTIC_POSITION]->data->stride * vertexCount;
-			shadowSize += (uint32_t)vertexAttribs[SEMANTIC_NORMAL]->data->stride   * vertexCount;
-			shadowSize += indexCount * indexStride;
+			saveGeometryCache(cacheName, pOut, shadowSize, sourceHash, layoutHash, dependencies);
+		}
 
-			geom->pShadow = (Geometry::ShadowData*)tf_calloc(1, sizeof(Geometry::ShadowData) + shadowSize);
-			geom->pShadow->pIndices = geom->pShadow + 1;
-			geom->pShadow->pAttributes[SEMANTIC_POSITION] = (uint8_t*)geom->pShadow->pIndices + (indexCount * indexStride);
-			geom->pShadow->pAttributes[SEMANTIC_NORMAL] = (uint8_t*)geom->pShadow->pAttributes[SEMANTIC_POSITION]
-				+ ((uint32_t)vertexAttribs[SEMANTIC_POSITION]->data->stride * vertexCount);
-			// #TODO: Add more if needed
+		tf_free(pDesc->pVertexLayout);
+
+		return true;
+	}
+
+	return false;
+}
+
+static UploadFunctionResult loadGeometry(Renderer* pRenderer, CopyEngine* pCopyEngine, size_t activeSet, UpdateRequest& pGeometryLoad)
+{
+	GeometryLoadDesc* pDesc = &pGeometryLoad.geomLoadDesc;
+
+	GeometryDecodeData decoded = {};
+	GeometryDecodeData* pDecoded = &decoded;
+	if (pGeometryLoad.pDecodeJob)
+	{
+		// File was parsed and packed by a decode thread
+		if (!waitDecodeJob(pResourceLoader, pGeometryLoad.pDecodeJob))
+		{
+			return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+		}
+		pDecoded = &pGeometryLoad.pDecodeJob->mGeometry;
+	}
+	else
+	{
+		int64_t decodeStart = getUSec();
+		uint64_t readTimeUs = 0;
+		bool success = decodeGeometry(pDesc, &decoded, &readTimeUs);
+		uint64_t decodeTimeUs = getUSec() - decodeStart;
+		addStreamerLoadTime(pResourceLoader, RESOURCE_LOAD_STAGE_FILE_READ, readTimeUs);
+		addStreamerLoadTime(pResourceLoader, RESOURCE_LOAD_STAGE_DECODE, decodeTimeUs - min(readTimeUs, decodeTimeUs));
+		if (!success)
+		{
+			return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
 		}
+	}
 
-		geom->mVertexBufferCount = vertexBufferCount;
-		geom->mDrawArgCount = drawCount;
-		geom->mIndexCount = indexCount;
-		geom->mVertexCount = vertexCount;
-		geom->mIndexType = (sizeof(uint16_t) == indexStride) ? INDEX_TYPE_UINT16 : INDEX_TYPE_UINT32;
-		geom->mJointCount = jointCount;
+	Geometry* geom = pDecoded->pGeometry;
+	const uint32_t indexStride = pDecoded->mIndexStride;
+	const uint32_t indexCount = geom->mIndexCount;
+	const uint32_t vertexCount = geom->mVertexCount;
+
+	// Allocate buffer memory
+	const bool structuredBuffers = (pDesc->mFlags & GEOMETRY_LOAD_FLAG_STRUCTURED_BUFFERS);
+
+	// Index buffer
+	BufferDesc indexBufferDesc = {};
+	indexBufferDesc.mDescriptors = DESCRIPTOR_TYPE_INDEX_BUFFER |
+		(structuredBuffers ?
+		(DESCRIPTOR_TYPE_BUFFER | DESCRIPTOR_TYPE_RW_BUFFER) :
+			(DESCRIPTOR_TYPE_BUFFER_RAW | DESCRIPTOR_TYPE_RW_BUFFER_RAW));
+	indexBufferDesc.mSize = indexStride * indexCount;
+	indexBufferDesc.mElementCount = indexBufferDesc.mSize / (structuredBuffers ? indexStride : sizeof(uint32_t));
+	indexBufferDesc.mStructStride = indexStride;
+	indexBufferDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_GPU_ONLY;
+#if UMA
+	indexBufferDesc.mStartState = RESOURCE_STATE_INDEX_BUFFER;
+#endif
+	addBuffer(pRenderer, &indexBufferDesc, &geom->pIndexBuffer);
+	uploadBufferData(pRenderer, pCopyEngine, activeSet, geom->pIndexBuffer, pDecoded->pIndexData, indexBufferDesc.mSize);
 
-		// Allocate buffer memory
-		const bool structuredBuffers = (pDesc->mFlags & GEOMETRY_LOAD_FLAG_STRUCTURED_BUFFERS);
+	uint32_t bufferCounter = 0;
+	for (uint32_t i = 0; i < MAX_VERTEX_BINDINGS; ++i)
+	{
+		const uint32_t vertexStride = pDecoded->mVertexStrides[i];
+		if (!vertexStride)
+			continue;
 
-		// Index buffer
-		BufferDesc indexBufferDesc = {};
-		indexBufferDesc.mDescriptors = DESCRIPTOR_TYPE_INDEX_BUFFER |
+		BufferDesc vertexBufferDesc = {};
+		vertexBufferDesc.mDescriptors = DESCRIPTOR_TYPE_VERTEX_BUFFER |
 			(structuredBuffers ?
 			(DESCRIPTOR_TYPE_BUFFER | DESCRIPTOR_TYPE_RW_BUFFER) :
 				(DESCRIPTOR_TYPE_BUFFER_RAW | DESCRIPTOR_TYPE_RW_BUFFER_RAW));
-		indexBufferDesc.mSize = indexStride * indexCount;
-		indexBufferDesc.mElementCount = indexBufferDesc.mSize / (structuredBuffers ? indexStride : sizeof(uint32_t));
-		indexBufferDesc.mStructStride = indexStride;
-		indexBufferDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_GPU_ONLY;
+		vertexBufferDesc.mSize = vertexStride * vertexCount;
+		vertexBufferDesc.mElementCount = vertexBufferDesc.mSize / (structuredBuffers ? vertexStride : sizeof(uint32_t));
+		vertexBufferDesc.mStructStride = vertexStride;
+		vertexBufferDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_GPU_ONLY;
 #if UMA
-		indexBufferDesc.mStartState = RESOURCE_STATE_INDEX_BUFFER;
+		vertexBufferDesc.mStartState = RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
 #endif
-		addBuffer(pRenderer, &indexBufferDesc, &geom->pIndexBuffer);
+		addBuffer(pRenderer, &vertexBufferDesc, &geom->pVertexBuffers[bufferCounter]);
+		uploadBufferData(pRenderer, pCopyEngine, activeSet, geom->pVertexBuffers[bufferCounter], pDecoded->pVertexData[i], vertexBufferDesc.mSize);
+		++bufferCounter;
+	}
 
-		BufferUpdateDesc indexUpdateDesc = {};
-		BufferUpdateDesc vertexUpdateDesc[MAX_VERTEX_BINDINGS] = {};
+	freeGeometryDecodeData(pDecoded);
+	*pDecoded = {};
 
-		indexUpdateDesc.mSize = indexCount * indexStride;
-		indexUpdateDesc.pBuffer = geom->pIndexBuffer;
-#if UMA
-		indexUpdateDesc.mInternal.mMappedRange = { (uint8_t*)geom->pIndexBuffer->pCpuMappedAddress };
-#else
-		indexUpdateDesc.mInternal.mMappedRange = allocateStagingMemory(indexUpdateDesc.mSize, RESOURCE_BUFFER_ALIGNMENT);
-#endif
-		indexUpdateDesc.pMappedData = indexUpdateDesc.mInternal.mMappedRange.pData;
+	*pDesc->ppGeometry = geom;
+
+	return UPLOAD_FUNCTION_RESULT_COMPLETED;
+}
+/************************************************************************/
+// Request Submission Queue
+/************************************************************************/
+static inline RequestNode* getRequestNode(RequestNodePool* pPool, uint32_t index)
+{
+	return &pPool->pChunks[index / REQUEST_NODE_CHUNK_SIZE][index % REQUEST_NODE_CHUNK_SIZE];
+}
+
+// Pushes the nodes pFirst..pLast already linked through mNextFree to the free list
+static void freeRequestNodes(RequestNodePool* pPool, RequestNode* pFirst, RequestNode* pLast)
+{
+	for (;;)
+	{
+		uint64_t head = tfrg_atomic64_load_acquire(&pPool->mFreeHead);
+		tfrg_atomic32_store_relaxed(&pLast->mNextFree, (uint32_t)head);
+		uint64_t newHead = (((head >> 32) + 1) << 32) | (pFirst->mIndex + 1);
+		if ((uint64_t)tfrg_atomic64_cas_relaxed(&pPool->mFreeHead, head, newHead) == head)
+		{
+			return;
+		}
+	}
+}
+
+static RequestNode* allocRequestNode(RequestNodePool* pPool)
+{
+	for (;;)
+	{
+		uint64_t head = tfrg_atomic64_load_acquire(&pPool->mFreeHead);
+		uint32_t index = (uint32_t)head;
+		if (index)
+		{
+			// The node can be taken by another thread in the meantime. Chunks stay alive and the tag makes the CAS fail in that case
+			RequestNode* pNode = getRequestNode(pPool, index - 1);
+			uint64_t newHead = (((head >> 32) + 1) << 32) | tfrg_atomic32_load_relaxed(&pNode->mNextFree);
+			if ((uint64_t)tfrg_atomic64_cas_relaxed(&pPool->mFreeHead, head, newHead) == head)
+			{
+				return pNode;
+			}
+			continue;
+		}
+
+		// Free list is empty. Keep the first node of a new chunk and hand the rest to the free list
+		uint32_t chunk = tfrg_atomic32_add_relaxed(&pPool->mChunkCount, 1);
+		if (chunk >= MAX_REQUEST_NODE_CHUNKS)
+		{
+			// Too many requests in flight. Wait for the streamer to return nodes
+			tfrg_atomic32_add_relaxed(&pPool->mChunkCount, -1);
+			Thread::Sleep(1);
+			continue;
+		}
+
+		RequestNode* pChunk = (RequestNode*)tf_calloc(REQUEST_NODE_CHUNK_SIZE, sizeof(RequestNode));
+		for (uint32_t i = 0; i < REQUEST_NODE_CHUNK_SIZE; ++i)
+		{
+			pChunk[i].mIndex = chunk * REQUEST_NODE_CHUNK_SIZE + i;
+			pChunk[i].mNextFree = pChunk[i].mIndex + 2;
+		}
+		pPool->pChunks[chunk] = pChunk;
+		freeRequestNodes(pPool, &pChunk[1], &pChunk[REQUEST_NODE_CHUNK_SIZE - 1]);
+		return &pChunk[0];
+	}
+}
+
+static void initRequestQueue(RequestNodePool* pPool, RequestQueue* pQueue)
+{
+	RequestNode* pStub = allocRequestNode(pPool);
+	pStub->mNext = 0;
+	pQueue->pHead = pStub;
+	pQueue->mTail = (uintptr_t)pStub;
+}
+
+// Safe to call from any thread
+// Appends an already linked chain of nodes
+static void pushRequestNodes(RequestQueue* pQueue, RequestNode* pFirst, RequestNode* pLast)
+{
+	// Become the new tail, then link the previous tail to the chain. The consumer sees the chain once the link is written
+	uintptr_t prev = tfrg_atomicptr_load_relaxed(&pQueue->mTail);
+	for (;;)
+	{
+		uintptr_t cur = tfrg_atomicptr_cas_relaxed(&pQueue->mTail, prev, (uintptr_t)pLast);
+		if (cur == prev)
+		{
+			break;
+		}
+		prev = cur;
+	}
+	tfrg_atomicptr_store_release(&((RequestNode*)prev)->mNext, (uintptr_t)pFirst);
+}
+
+static void pushUpdateRequest(RequestNodePool* pPool, RequestQueue* pQueue, const UpdateRequest& request)
+{
+	RequestNode* pNode = allocRequestNode(pPool);
+	pNode->mRequest = request;
+	pNode->mNext = 0;
+	pushRequestNodes(pQueue, pNode, pNode);
+}
+
+// Moves everything submitted so far to the pending lists. Caller must hold mQueueMutex
+static void drainRequestQueues(ResourceLoader* pLoader)
+{
+	for (uint32_t i = 0; i < MAX_LINKED_GPUS; ++i)
+	{
+		RequestQueue* pQueue = &pLoader->mRequestQueue[i];
+		RequestNode* pFirst = pQueue->pHead;
+		RequestNode* pNext = (RequestNode*)tfrg_atomicptr_load_acquire(&pFirst->mNext);
+		if (!pNext)
+		{
+			continue;
+		}
+
+		// Consumed nodes are chained through mNextFree and returned to the pool in one go
+		RequestNode* pLast = NULL;
+		while (pNext)
+		{
+			pLoader->mPendingRequests[i].push_back(pNext->mRequest);
+			if (pLast)
+			{
+				pLast->mNextFree = pQueue->pHead->mIndex + 1;
+			}
+			pLast = pQueue->pHead;
+			pQueue->pHead = pNext;
+			pNext = (RequestNode*)tfrg_atomicptr_load_acquire(&pNext->mNext);
+		}
+		freeRequestNodes(&pLoader->mRequestNodePool, pFirst, pLast);
+	}
+}
+
+// Batched wakeup. Only the first submission after the streamer went to sleep signals it
+static void wakeStreamer(ResourceLoader* pLoader)
+{
+	if (1 == tfrg_atomic32_cas_relaxed(&pLoader->mStreamerSleeping, 1, 0))
+	{
+		pLoader->mQueueMutex.Acquire();
+		pLoader->mQueueMutex.Release();
+		pLoader->mQueueCond.WakeOne();
+	}
+}
+
+// Requests complete out of submission order. A token is signaled once every lower token is done
+// Caller must hold mQueueMutex
+static void markTokenCompleted(ResourceLoader* pLoader, SyncToken token)
+{
+	eastl::vector<SyncToken>& completed = pLoader->mCompletedTokens;
+	completed.push_back(token);
+	eastl::push_heap(completed.begin(), completed.end(), eastl::greater<SyncToken>());
+	while (!completed.empty() && completed.front() == pLoader->mTokenWatermark + 1)
+	{
+		eastl::pop_heap(completed.begin(), completed.end(), eastl::greater<SyncToken>());
+		completed.pop_back();
+		++pLoader->mTokenWatermark;
+	}
+}
+/************************************************************************/
+// Internal Resource Loader Implementation
+/************************************************************************/
+// Caller must hold mTokenMutex
+static void popReadyTokenCallbacks(ResourceLoader* pLoader, SyncToken completed, eastl::vector<TokenCallback>& ready)
+{
+	eastl::vector<TokenCallback>& callbacks = pLoader->mTokenCallbacks;
+	while (!callbacks.empty() && callbacks.front().mToken <= completed)
+	{
+		ready.push_back(callbacks.front());
+		eastl::pop_heap(callbacks.begin(), callbacks.end(), eastl::greater<TokenCallback>());
+		callbacks.pop_back();
+	}
+}
+
+// Caller must hold mQueueMutex
+static bool areTasksAvailable(ResourceLoader* pLoader)
+{
+	for (size_t i = 0; i < MAX_LINKED_GPUS; ++i)
+	{
+		if (!pLoader->mPendingRequests[i].empty() || tfrg_atomicptr_load_acquire(&pLoader->mRequestQueue[i].pHead->mNext))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool isStagingBudgetExhausted(ResourceLoader* pLoader)
+{
+	// Staging memory is always allocated from the copy engine of GPU 0
+	const CopyEngine* pCopyEngine = &pLoader->pCopyEngines[0];
+	return pCopyEngine->resourceSets[pLoader->mNextSet].mStagedSize >= pCopyEngine->bufferSize;
+}
+
+static void runDecodeJob(DecodeJob* pJob)
+{
+	PROFILER_SET_CPU_SCOPE("ResourceLoader", "Decode", 0x33ee55);
+	int64_t decodeStart = getUSec();
+	if (UPDATE_REQUEST_LOAD_TEXTURE == pJob->mType)
+	{
+		pJob->mSuccess = decodeTexture(&pJob->mTexLoadDesc, &pJob->mTexture, &pJob->mReadTimeUs);
+	}
+	else
+	{
+		pJob->mSuccess = decodeGeometry(&pJob->mGeomLoadDesc, &pJob->mGeometry, &pJob->mReadTimeUs);
+	}
+	pJob->mDecodeTimeUs = getUSec() - decodeStart;
+}
+
+static void runDecodeTaskItems(DecodeTask* pTask)
+{
+	for (uint32_t index = tfrg_atomic32_add_relaxed(&pTask->mNextIndex, 1); index < pTask->mCount;
+		 index = tfrg_atomic32_add_relaxed(&pTask->mNextIndex, 1))
+	{
+		pTask->pFunc(pTask->pUserData, index);
+	}
+}
+
+// Caller must hold mDecodeMutex
+static void removeDecodeTask(ResourceLoader* pLoader, DecodeTask* pTask)
+{
+	eastl::vector<DecodeTask*>::iterator it = eastl::find(pLoader->mDecodeTasks.begin(), pLoader->mDecodeTasks.end(), pTask);
+	if (it != pLoader->mDecodeTasks.end())
+	{
+		pLoader->mDecodeTasks.erase(it);
+	}
+}
+
+// Runs pFunc for every index in [0, count). Idle decode threads join in while the calling thread works through the items
+static void runDecodeTask(ResourceLoader* pLoader, DecodeTaskFunc pFunc, void* pUserData, uint32_t count)
+{
+	if (!pLoader || !pLoader->mDecodeThreadCount || count < 2)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+			pFunc(pUserData, i);
+		return;
+	}
+
+	DecodeTask task = {};
+	task.pFunc = pFunc;
+	task.pUserData = pUserData;
+	task.mCount = count;
+
+	pLoader->mDecodeMutex.Acquire();
+	pLoader->mDecodeTasks.push_back(&task);
+	pLoader->mDecodeCond.WakeAll();
+	pLoader->mDecodeMutex.Release();
+
+	runDecodeTaskItems(&task);
+
+	// Items claimed by helpers are finished once they leave the task
+	pLoader->mDecodeMutex.Acquire();
+	removeDecodeTask(pLoader, &task);
+	while (task.mHelperCount)
+	{
+		pLoader->mDecodeDoneCond.Wait(pLoader->mDecodeMutex);
+	}
+	pLoader->mDecodeMutex.Release();
+}
+
+static void decodeThreadFunc(void* pThreadData)
+{
+	ResourceLoader* pLoader = (ResourceLoader*)pThreadData;
+	ASSERT(pLoader);
+
+	pLoader->mDecodeMutex.Acquire();
+	while (pLoader->mRun)
+	{
+		if (!pLoader->mDecodeTasks.empty())
+		{
+			DecodeTask* pTask = pLoader->mDecodeTasks.back();
+			++pTask->mHelperCount;
+			pLoader->mDecodeMutex.Release();
+
+			runDecodeTaskItems(pTask);
+
+			pLoader->mDecodeMutex.Acquire();
+			// All items are claimed. Keep other threads from picking the task up again
+			removeDecodeTask(pLoader, pTask);
+			--pTask->mHelperCount;
+			pLoader->mDecodeDoneCond.WakeAll();
+			continue;
+		}
 
-		uint32_t bufferCounter = 0;
-		for (uint32_t i = 0; i < MAX_VERTEX_BINDINGS; ++i)
+		if (pLoader->mDecodeQueue.empty())
 		{
-			if (!vertexStrides[i])
-				continue;
+			pLoader->mDecodeCond.Wait(pLoader->mDecodeMutex);
+			continue;
+		}
 
-			BufferDesc vertexBufferDesc = {};
-			vertexBufferDesc.mDescriptors = DESCRIPTOR_TYPE_VERTEX_BUFFER |
-				(structuredBuffers ?
-				(DESCRIPTOR_TYPE_BUFFER | DESCRIPTOR_TYPE_RW_BUFFER) :
-					(DESCRIPTOR_TYPE_BUFFER_RAW | DESCRIPTOR_TYPE_RW_BUFFER_RAW));
-			vertexBufferDesc.mSize = vertexStrides[i] * vertexCount;
-			vertexBufferDesc.mElementCount = vertexBufferDesc.mSize / (structuredBuffers ? vertexStrides[i] : sizeof(uint32_t));
-			vertexBufferDesc.mStructStride = vertexStrides[i];
-			vertexBufferDesc.mMemoryUsage = RESOURCE_MEMORY_USAGE_GPU_ONLY;
-#if UMA
-			vertexBufferDesc.mStartState = RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
-#endif
-			addBuffer(pRenderer, &vertexBufferDesc, &geom->pVertexBuffers[bufferCounter]);
+		DecodeJob* pJob = pLoader->mDecodeQueue.front();
+		pLoader->mDecodeQueue.erase(pLoader->mDecodeQueue.begin());
+		pJob->mState = DECODE_JOB_RUNNING;
+		pLoader->mDecodeMutex.Release();
 
-			geom->mVertexStrides[bufferCounter] = vertexStrides[i];
+		runDecodeJob(pJob);
 
-			vertexUpdateDesc[i].pBuffer = geom->pVertexBuffers[bufferCounter];
-			vertexUpdateDesc[i].mSize = vertexBufferDesc.mSize;
-#if UMA
-			vertexUpdateDesc[i].mInternal.mMappedRange = { (uint8_t*)geom->pVertexBuffers[bufferCounter]->pCpuMappedAddress, 0 };
-#else
-			vertexUpdateDesc[i].mInternal.mMappedRange = allocateStagingMemory(vertexUpdateDesc[i].mSize, RESOURCE_BUFFER_ALIGNMENT);
-#endif
-			vertexUpdateDesc[i].pMappedData = vertexUpdateDesc[i].mInternal.mMappedRange.pData;
-			++bufferCounter;
+		pLoader->mDecodeMutex.Acquire();
+		pJob->mState = DECODE_JOB_DONE;
+		pLoader->mDecodeDoneCond.WakeAll();
+	}
+	pLoader->mDecodeMutex.Release();
+}
+
+// Caller must hold mDecodeMutex
+static void removeDecodeJob(ResourceLoader* pLoader, DecodeJob* pJob)
+{
+	for (uint32_t i = 0; i < (uint32_t)pLoader->mDecodeQueue.size(); ++i)
+	{
+		if (pLoader->mDecodeQueue[i] == pJob)
+		{
+			pLoader->mDecodeQueue.erase(pLoader->mDecodeQueue.begin() + i);
+			break;
 		}
+	}
+}
 
-		indexCount = 0;
-		vertexCount = 0;
-		drawCount = 0;
+// Blocks the streamer thread until the job is decoded
+// A job no decode thread picked up yet is run on the calling thread instead of waiting for a free worker
+static bool waitDecodeJob(ResourceLoader* pLoader, DecodeJob* pJob)
+{
+	PROFILER_SET_CPU_SCOPE("ResourceLoader", "WaitDecode", 0xee9933);
+	int64_t waitStart = getUSec();
+	pLoader->mDecodeMutex.Acquire();
+	if (DECODE_JOB_PENDING == pJob->mState)
+	{
+		removeDecodeJob(pLoader, pJob);
+		pJob->mState = DECODE_JOB_RUNNING;
+		pLoader->mDecodeMutex.Release();
 
-		for (uint32_t i = 0; i < data->meshes_count; ++i)
+		runDecodeJob(pJob);
+		pJob->mState = DECODE_JOB_DONE;
+	}
+	else
+	{
+		while (DECODE_JOB_DONE != pJob->mState)
 		{
-			for (uint32_t p = 0; p < data->meshes[i].primitives_count; ++p)
-			{
-				const cgltf_primitive* prim = &data->meshes[i].primitives[p];
-				/************************************************************************/
-				// Fill index buffer for this primitive
-				/************************************************************************/
-				if (sizeof(uint16_t) == indexStride)
-				{
-					uint16_t* dst = (uint16_t*)indexUpdateDesc.pMappedData;
-					for (uint32_t idx = 0; idx < prim->indices->count; ++idx)
-						dst[indexCount + idx] = vertexCount + (uint16_t)cgltf_accessor_read_index(prim->indices, idx);
-				}
-				else
-				{
-					uint32_t* dst = (uint32_t*)indexUpdateDesc.pMappedData;
-					for (uint32_t idx = 0; idx < prim->indices->count; ++idx)
-						dst[indexCount + idx] = vertexCount + (uint32_t)cgltf_accessor_read_index(prim->indices, idx);
-				}
-				/************************************************************************/
-				// Fill vertex buffers for this primitive
-				/************************************************************************/
-				for (uint32_t a = 0; a < prim->attributes_count; ++a)
-				{
-					cgltf_attribute* attr = &prim->attributes[a];
-					uint32_t index = util_cgltf_attrib_type_to_semantic(attr->type, attr->index);
+			pLoader->mDecodeDoneCond.Wait(pLoader->mDecodeMutex);
+		}
+		pLoader->mDecodeMutex.Release();
+	}
 
-					if (vertexOffsets[index] != UINT_MAX)
-					{
-						const uint32_t binding = vertexBindings[index];
-						const uint32_t offset = vertexOffsets[index];
-						const uint32_t stride = vertexStrides[binding];
-						const uint8_t* src = (uint8_t*)attr->data->buffer_view->buffer->data + attr->data->offset + attr->data->buffer_view->offset;
+	// The job ran ahead on a decode thread. Only the time the streamer thread waited for it is taken off the staging copy
+	RequestTiming* pTiming = &pLoader->mActiveTiming;
+	pTiming->mReadUs += pJob->mReadTimeUs;
+	pTiming->mDecodeUs += pJob->mDecodeTimeUs - min(pJob->mReadTimeUs, pJob->mDecodeTimeUs);
+	pTiming->mStreamerUs += getUSec() - waitStart;
+	return pJob->mSuccess;
+}
 
-						// If this vertex attribute is not interleaved with any other attribute use fast path instead of copying one by one
-						// In this case a simple memcpy will be enough to transfer the data to the buffer
-						if (1 == vertexAttribCount[binding])
-						{
-							uint8_t* dst = (uint8_t*)vertexUpdateDesc[binding].pMappedData + vertexCount * stride;
-							if (vertexPacking[index])
-								vertexPacking[index]((uint32_t)attr->data->count, (uint32_t)attr->data->stride, 0, src, dst);
-							else
-								memcpy(dst, src, attr->data->count * attr->data->stride);
-						}
-						else
-						{
-							uint8_t* dst = (uint8_t*)vertexUpdateDesc[binding].pMappedData + vertexCount * stride;
-							// Loop through all vertices copying into the correct place in the vertex buffer
-							// Example:
-							// [ POSITION | NORMAL | TEXCOORD ] => [ 0 | 12 | 24 ], [ 32 | 44 | 52 ], ... (vertex stride of 32 => 12 + 12 + 8)
-							if (vertexPacking[index])
-								vertexPacking[index]((uint32_t)attr->data->count, (uint32_t)attr->data->stride, offset, src, dst);
-							else
-								for (uint32_t e = 0; e < attr->data->count; ++e)
-									memcpy(dst + e * stride + offset, src + e * attr->data->stride, attr->data->stride);
-						}
-					}
-				}
+// Takes the job out of the decode queue or waits for the decode thread working on it
+// Returns whether the job was run
+static bool cancelDecodeJob(ResourceLoader* pLoader, DecodeJob* pJob)
+{
+	pLoader->mDecodeMutex.Acquire();
+	bool run = DECODE_JOB_PENDING != pJob->mState;
+	if (!run)
+	{
+		removeDecodeJob(pLoader, pJob);
+	}
+	while (run && DECODE_JOB_DONE != pJob->mState)
+	{
+		pLoader->mDecodeDoneCond.Wait(pLoader->mDecodeMutex);
+	}
+	pLoader->mDecodeMutex.Release();
+	return run;
+}
 
-				// If used, set default texcoords in buffer to (0.f, 0.f) - assume copy engine does not give us zero'd memory
-				if (defaultTexcoordSemantic != SEMANTIC_UNDEFINED)
-				{
-					const uint32_t binding = vertexBindings[defaultTexcoordSemantic];
-					const uint32_t offset = vertexOffsets[defaultTexcoordSemantic];
-					const uint32_t stride = vertexStrides[binding];
+// Frees decoded data which was not consumed by the streamer thread. Job must not be in the decode queue
+static void releaseDecodeJob(DecodeJob* pJob)
+{
+	if (pJob->mTexture.mUpdateDesc.mStream.pIO)
+	{
+		fsCloseStream(&pJob->mTexture.mUpdateDesc.mStream);
+	}
+	if (pJob->mTexture.mUpdateDesc.pBasisTexture)
+	{
+		tf_delete(pJob->mTexture.mUpdateDesc.pBasisTexture);
+	}
 
-					uint8_t* dst = (uint8_t*)vertexUpdateDesc[binding].pMappedData + vertexCount * stride;
-					const uint32_t count = (uint32_t)prim->attributes[0].data->count;
+	GeometryDecodeData* pGeometry = &pJob->mGeometry;
+	freeGeometryDecodeData(pGeometry);
+	if (pGeometry->pGeometry)
+	{
+		tf_free(pGeometry->pGeometry->pShadow);
+		tf_free(pGeometry->pGeometry->pMeshlets);
+		tf_free(pGeometry->pGeometry);
+	}
 
-					for (uint32_t i = 0; i < count; ++i)
-						memset(dst + i * stride + offset, 0, defaultTexcoordStride);
-				}
+	tf_free(pJob);
+}
 
-				/************************************************************************/
-				// Fill draw arguments for this primitive
-				/************************************************************************/
-				geom->pDrawArgs[drawCount].mIndexCount = (uint32_t)prim->indices->count;
-				geom->pDrawArgs[drawCount].mInstanceCount = 1;
-				geom->pDrawArgs[drawCount].mStartIndex = indexCount;
-				geom->pDrawArgs[drawCount].mStartInstance = 0;
-				// Since we already offset indices when creating the index buffer, vertex offset will be zero
-				// With this approach, we can draw everything in one draw call or use the traditional draw per subset without the
-				// need for changing shader code
-				geom->pDrawArgs[drawCount].mVertexOffset = 0;
+static bool needsDecodeJob(ResourceLoader* pLoader, const UpdateRequest& request)
+{
+	if (!pLoader->mDecodeThreadCount)
+	{
+		return false;
+	}
+	if (UPDATE_REQUEST_LOAD_TEXTURE == request.mType)
+	{
+		return util_is_decodable_texture_container(util_get_texture_container(&request.texLoadDesc));
+	}
+	return UPDATE_REQUEST_LOAD_GEOMETRY == request.mType;
+}
 
-				indexCount += (uint32_t)prim->indices->count;
-				vertexCount += (uint32_t)prim->attributes->data->count;
-				++drawCount;
-			}
-		}
+static DecodeJob* createDecodeJob(UpdateRequest* pRequest)
+{
+	DecodeJob* pJob = (DecodeJob*)tf_calloc(1, sizeof(DecodeJob));
+	pJob->mType = pRequest->mType;
+	pJob->mState = DECODE_JOB_PENDING;
+	if (UPDATE_REQUEST_LOAD_TEXTURE == pRequest->mType)
+	{
+		pJob->mTexLoadDesc = pRequest->texLoadDesc;
+	}
+	else
+	{
+		pJob->mGeomLoadDesc = pRequest->geomLoadDesc;
+	}
+	pRequest->pDecodeJob = pJob;
+	return pJob;
+}
 
-		UploadFunctionResult uploadResult = UPLOAD_FUNCTION_RESULT_COMPLETED;
-#if !UMA
-		uploadResult = updateBuffer(pRenderer, pCopyEngine, activeSet, indexUpdateDesc);
+static void queueDecodeJob(ResourceLoader* pLoader, UpdateRequest* pRequest)
+{
+	DecodeJob* pJob = createDecodeJob(pRequest);
 
-		for (uint32_t i = 0; i < MAX_VERTEX_BINDINGS; ++i)
-		{
-			if (vertexUpdateDesc[i].pMappedData)
-			{
-				uploadResult = updateBuffer(pRenderer, pCopyEngine, activeSet, vertexUpdateDesc[i]);
-			}
-		}
-#endif
+	pLoader->mDecodeMutex.Acquire();
+	pLoader->mDecodeQueue.push_back(pJob);
+	pLoader->mDecodeMutex.Release();
+	pLoader->mDecodeCond.WakeOne();
+}
 
-		// Load the remap joint indices generated in the offline process
-		uint32_t remapCount = 0;
-		for (uint32_t i = 0; i < data->skins_count; ++i)
-		{
-			const cgltf_skin* skin = &data->skins[i];
-			uint32_t extrasSize = (uint32_t)(skin->extras.end_offset - skin->extras.start_offset);
-			if (extrasSize)
-			{
-				const char* jointRemaps = (const char*)data->json + skin->extras.start_offset;
-				jsmn_parser parser = {};
-				jsmntok_t* tokens = (jsmntok_t*)tf_malloc((skin->joints_count + 1) * sizeof(jsmntok_t));
-				jsmn_parse(&parser, (const char*)jointRemaps, extrasSize, tokens, skin->joints_count + 1);
-				ASSERT(tokens[0].size == skin->joints_count + 1);
-				cgltf_accessor_unpack_floats(skin->inverse_bind_matrices, (cgltf_float*)geom->pInverseBindPoses, skin->joints_count * sizeof(float[16]) / sizeof(float));
-				for (uint32_t r = 0; r < skin->joints_count; ++r)
-					geom->pJointRemaps[remapCount + r] = atoi(jointRemaps + tokens[1 + r].start);
-				tf_free(tokens);
-			}
+/************************************************************************/
+// Load Statistics
+/************************************************************************/
+static uint64_t getStagedBytes(ResourceLoader* pLoader)
+{
+	// Staging memory is always allocated from the copy engine of GPU 0
+	StagingCounters* pCounters = &pLoader->pCopyEngines[0].mCounters;
+	return tfrg_atomic64_load_relaxed(&pCounters->mStagedBytes) + tfrg_atomic64_load_relaxed(&pCounters->mTempBufferBytes);
+}
 
-			remapCount += (uint32_t)skin->joints_count;
-		}
+// Called by the streamer thread once it processed the request. The GPU completion stage is filled in by retireLoadRecords
+static void recordRequestTiming(ResourceLoader* pLoader, CopyResourceSet* pResourceSet, const UpdateRequest& request, int64_t startUs, uint64_t stagedBytes)
+{
+	if (UPDATE_REQUEST_BUFFER_BARRIER == request.mType || UPDATE_REQUEST_TEXTURE_BARRIER == request.mType)
+	{
+		return;
+	}
 
-		// Load the tressfx specific data generated in the offline process
-		if (stricmp(data->asset.generator, "tressfx") == 0)
-		{
-			// { "mVertexCountPerStrand" : "16", "mGuideCountPerStrand" : "3456" }
-			uint32_t extrasSize = (uint32_t)(data->asset.extras.end_offset - data->asset.extras.start_offset);
-			const char* json = data->json + data->asset.extras.start_offset;
-			jsmn_parser parser = {};
-			jsmntok_t tokens[5] = {};
-			jsmn_parse(&parser, (const char*)json, extrasSize, tokens, 5);
-			geom->mHair.mVertexCountPerStrand = atoi(json + tokens[2].start);
-			geom->mHair.mGuideCountPerStrand = atoi(json + tokens[4].start);
-		}
+	const RequestTiming& timing = pLoader->mActiveTiming;
+	uint64_t processUs = getUSec() - startUs;
 
-		if (pDesc->mFlags & GEOMETRY_LOAD_FLAG_SHADOWED)
-		{
-			indexCount = 0;
-			vertexCount = 0;
+	LoadRecord record = {};
+	record.mType = request.mType;
+	record.mStageTimeUs[RESOURCE_LOAD_STAGE_QUEUE_WAIT] = request.mQueueTimeUs ? startUs - request.mQueueTimeUs : 0;
+	record.mStageTimeUs[RESOURCE_LOAD_STAGE_FILE_READ] = timing.mReadUs;
+	record.mStageTimeUs[RESOURCE_LOAD_STAGE_DECODE] = timing.mDecodeUs;
+	record.mStageTimeUs[RESOURCE_LOAD_STAGE_STAGING_COPY] = processUs - min(timing.mStreamerUs, processUs);
+	record.mBytes = getStagedBytes(pLoader) - stagedBytes;
 
-			for (uint32_t i = 0; i < data->meshes_count; ++i)
-			{
-				for (uint32_t p = 0; p < data->meshes[i].primitives_count; ++p)
-				{
-					const cgltf_primitive* prim = &data->meshes[i].primitives[p];
-					/************************************************************************/
-					// Fill index buffer for this primitive
-					/************************************************************************/
-					if (sizeof(uint16_t) == indexStride)
-					{
-						uint16_t* dst = (uint16_t*)geom->pShadow->pIndices;
-						for (uint32_t idx = 0; idx < prim->indices->count; ++idx)
-							dst[indexCount + idx] = vertexCount + (uint16_t)cgltf_accessor_read_index(prim->indices, idx);
-					}
-					else
-					{
-						uint32_t* dst = (uint32_t*)geom->pShadow->pIndices;
-						for (uint32_t idx = 0; idx < prim->indices->count; ++idx)
-							dst[indexCount + idx] = vertexCount + (uint32_t)cgltf_accessor_read_index(prim->indices, idx);
-					}
+	const char* pName = UPDATE_REQUEST_LOAD_TEXTURE == request.mType ? request.texLoadDesc.pFileName :
+		UPDATE_REQUEST_LOAD_GEOMETRY == request.mType ? request.geomLoadDesc.pFileName : NULL;
+	if (pLoader->mDesc.mRecordLoadReport && pName)
+	{
+		record.mName = pName;
+	}
+	pResourceSet->mLoadRecords.push_back(record);
+}
 
-					for (uint32_t a = 0; a < prim->attributes_count; ++a)
-					{
-						cgltf_attribute* attr = &prim->attributes[a];
-						if (cgltf_attribute_type_position == attr->type)
-						{
-							const uint8_t* src = (uint8_t*)attr->data->buffer_view->buffer->data + attr->data->offset + attr->data->buffer_view->offset;
-							uint8_t* dst = (uint8_t*)geom->pShadow->pAttributes[SEMANTIC_POSITION] + vertexCount * attr->data->stride;
-							memcpy(dst, src, attr->data->count * attr->data->stride);
-						}
-						else if (cgltf_attribute_type_normal == attr->type)
-						{
-							const uint8_t* src = (uint8_t*)attr->data->buffer_view->buffer->data + attr->data->offset + attr->data->buffer_view->offset;
-							uint8_t* dst = (uint8_t*)geom->pShadow->pAttributes[SEMANTIC_NORMAL] + vertexCount * attr->data->stride;
-							memcpy(dst, src, attr->data->count * attr->data->stride);
-						}
-					}
+static void publishLoaderCounters(ResourceLoader* pLoader)
+{
+	const ProfileToken* pCounters = pLoader->mCounters;
+	const ResourceLoaderThroughputStats& stats = pLoader->mStats;
+	setProfileCounter(pCounters[LOADER_COUNTER_BYTES_PER_SECOND], (int64_t)stats.mBytesPerSecond);
+	setProfileCounter(pCounters[LOADER_COUNTER_UPLOADED_BYTES], (int64_t)stats.mUploadedBytes);
+	for (uint32_t stage = 0; stage < RESOURCE_LOAD_STAGE_COUNT; ++stage)
+	{
+		setProfileCounter(pCounters[LOADER_COUNTER_STAGE_TIME + stage], (int64_t)stats.mStageTimeUs[stage]);
+	}
 
-					indexCount += (uint32_t)prim->indices->count;
-					vertexCount += (uint32_t)prim->attributes->data->count;
-				}
-			}
-		}
+	StagingCounters* pStaging = &pLoader->pCopyEngines[0].mCounters;
+	setProfileCounter(pCounters[LOADER_COUNTER_STAGING_RING_USED], (int64_t)tfrg_atomic64_load_relaxed(&pStaging->mRingUsed));
+	setProfileCounter(pCounters[LOADER_COUNTER_TEMP_BUFFER_COUNT], (int64_t)tfrg_atomic64_load_relaxed(&pStaging->mTempBufferCount));
+	setProfileCounter(pCounters[LOADER_COUNTER_TEMP_BUFFER_BYTES], (int64_t)tfrg_atomic64_load_relaxed(&pStaging->mTempBufferBytes));
+	setProfileCounter(pCounters[LOADER_COUNTER_STALL_COUNT], (int64_t)tfrg_atomic64_load_relaxed(&pStaging->mStallCount));
+}
 
-		data->file_data = fileData;
-		cgltf_free(data);
+// The fence of the set completed. Everything recorded into it is on the GPU now
+static void retireLoadRecords(ResourceLoader* pLoader, CopyResourceSet* pResourceSet)
+{
+	if (pResourceSet->mLoadRecords.empty())
+	{
+		return;
+	}
 
-		tf_free(pDesc->pVertexLayout);
+	int64_t now = getUSec();
+	uint64_t gpuUs = pResourceSet->mSubmitTimeUs ? (uint64_t)max(now - pResourceSet->mSubmitTimeUs, (int64_t)0) : 0;
+	pResourceSet->mSubmitTimeUs = 0;
+
+	pLoader->mStatsMutex.Acquire();
+	ResourceLoaderThroughputStats& stats = pLoader->mStats;
+	for (LoadRecord& record : pResourceSet->mLoadRecords)
+	{
+		record.mStageTimeUs[RESOURCE_LOAD_STAGE_GPU_COMPLETION] = gpuUs;
+		for (uint32_t stage = 0; stage < RESOURCE_LOAD_STAGE_COUNT; ++stage)
+		{
+			stats.mStageTimeUs[stage] += record.mStageTimeUs[stage];
+			stats.mMaxStageTimeUs[stage] = max(stats.mMaxStageTimeUs[stage], record.mStageTimeUs[stage]);
+		}
+		stats.mUploadedBytes += record.mBytes;
+		pLoader->mWindowBytes += record.mBytes;
+		++stats.mCompletedRequests;
 
-		*pDesc->ppGeometry = geom;
+		if (!record.mName.empty())
+		{
+			pLoader->mLoadReport.push_back(record);
+		}
+	}
 
-		return uploadResult;
+	// Throughput over windows of at least a second
+	if (now - pLoader->mWindowStartUs >= 1000000)
+	{
+		stats.mBytesPerSecond = pLoader->mWindowBytes * 1000000 / (uint64_t)(now - pLoader->mWindowStartUs);
+		pLoader->mWindowStartUs = now;
+		pLoader->mWindowBytes = 0;
 	}
+	publishLoaderCounters(pLoader);
+	pLoader->mStatsMutex.Release();
 
-	return UPLOAD_FUNCTION_RESULT_INVALID_REQUEST;
+	pResourceSet->mLoadRecords.clear();
+}
+
+// Buffer / texture a request writes, or the output of a load. Requests on the same resource must keep their order
+static const void* getRequestResource(const UpdateRequest& request)
+{
+	switch (request.mType)
+	{
+	case UPDATE_REQUEST_UPDATE_BUFFER: return request.bufUpdateDesc.pBuffer;
+	case UPDATE_REQUEST_UPDATE_TEXTURE: return request.texUpdateDesc.pTexture;
+	case UPDATE_REQUEST_BUFFER_BARRIER: return request.bufferBarrier.pBuffer;
+	case UPDATE_REQUEST_TEXTURE_BARRIER: return request.textureBarrier.pTexture;
+	case UPDATE_REQUEST_LOAD_TEXTURE: return request.texLoadDesc.ppTexture;
+	case UPDATE_REQUEST_LOAD_GEOMETRY: return request.geomLoadDesc.ppGeometry;
+	default: return NULL;
+	}
 }
-/************************************************************************/
-// Internal Resource Loader Implementation
-/************************************************************************/
-static bool areTasksAvailable(ResourceLoader* pLoader)
+
+// Highest priority first, equal priorities in submission order.
+// A request never gets ahead of an earlier request on the same resource: its priority is capped by the ones before it,
+// so a high priority update of a buffer still lands after the low priority update submitted before it.
+static void sortRequestQueue(eastl::vector<UpdateRequest>& queue)
 {
-	for (size_t i = 0; i < MAX_LINKED_GPUS; ++i)
+	// Requests put back after the staging memory ran out are sorted by priority, restore submission order first
+	eastl::sort(queue.begin(), queue.end(), [](const UpdateRequest& a, const UpdateRequest& b) { return a.mWaitIndex < b.mWaitIndex; });
+
+	eastl::hash_map<const void*, uint32_t> resourcePriorities;
+	for (UpdateRequest& request : queue)
 	{
-		if (!pLoader->mRequestQueue[i].empty())
+		request.mOrderPriority = request.mPriority;
+		const void* pResource = getRequestResource(request);
+		if (!pResource)
+			continue;
+
+		eastl::pair<eastl::hash_map<const void*, uint32_t>::iterator, bool> it =
+			resourcePriorities.insert(eastl::make_pair(pResource, request.mPriority));
+		if (!it.second)
 		{
-			return true;
+			request.mOrderPriority = min(request.mPriority, it.first->second);
+			it.first->second = request.mOrderPriority;
 		}
 	}
 
-	return false;
+	eastl::sort(queue.begin(), queue.end(), [](const UpdateRequest& a, const UpdateRequest& b)
+	{
+		return a.mOrderPriority > b.mOrderPriority || (a.mOrderPriority == b.mOrderPriority && a.mWaitIndex < b.mWaitIndex);
+	});
 }
 
 static void streamerThreadFunc(void* pThreadData)
@@ -1631,14 +4301,15 @@ static void streamerThreadFunc(void* pThreadData)
 
 	uint32_t linkedGPUCount = pLoader->pRenderer->mLinkedNodeCount;
 
-	SyncToken      maxToken = {};
+	eastl::vector<SyncToken> completedTokens;
+	eastl::vector<TokenCallback> readyCallbacks;
 
 	while (pLoader->mRun)
 	{
 		pLoader->mQueueMutex.Acquire();
 
 		// Check for pending tokens
-		// Safe to use mTokenCounter as we are inside critical section
+		// A token can be handed out before its request shows up in the queue. The streamer keeps spinning until it arrives
 		bool allTokensSignaled = (pLoader->mTokenCompleted == tfrg_atomic64_load_relaxed(&pLoader->mTokenCounter));
 
 		while (!areTasksAvailable(pLoader) && allTokensSignaled && pLoader->mRun)
@@ -1649,31 +4320,50 @@ static void streamerThreadFunc(void* pThreadData)
 				return;
 			}
 			// Sleep until someone adds an update request to the queue
+			// Producers only signal while the flag is set so check again after setting it
+			tfrg_atomic32_store_relaxed(&pLoader->mStreamerSleeping, 1);
+			if (areTasksAvailable(pLoader))
+			{
+				break;
+			}
+			setProfileCounter(pLoader->mCounters[LOADER_COUNTER_BYTES_PER_SECOND], 0);
 			pLoader->mQueueCond.Wait(pLoader->mQueueMutex);
 		}
+		tfrg_atomic32_store_relaxed(&pLoader->mStreamerSleeping, 0);
 
 		pLoader->mQueueMutex.Release();
 
 		pLoader->mNextSet = (pLoader->mNextSet + 1) % pLoader->mDesc.mBufferCount;
 		for (uint32_t nodeIndex = 0; nodeIndex < linkedGPUCount; ++nodeIndex)
 		{
+			PROFILER_SET_CPU_SCOPE("ResourceLoader", "WaitCopy", 0xee3333);
 			waitCopyEngineSet(pLoader->pRenderer, &pLoader->pCopyEngines[nodeIndex], pLoader->mNextSet, true);
+			retireLoadRecords(pLoader, &pLoader->pCopyEngines[nodeIndex].resourceSets[pLoader->mNextSet]);
 			resetCopyEngineSet(pLoader->pRenderer, &pLoader->pCopyEngines[nodeIndex], pLoader->mNextSet);
 		}
 
 		// Signal pending tokens from previous frames
 		pLoader->mTokenMutex.Acquire();
 		tfrg_atomic64_store_release(&pLoader->mTokenCompleted, pLoader->mCurrentTokenState[pLoader->mNextSet]);
+		popReadyTokenCallbacks(pLoader, pLoader->mCurrentTokenState[pLoader->mNextSet], readyCallbacks);
 		pLoader->mTokenMutex.Release();
 		pLoader->mTokenCond.WakeAll();
 
+		// Run outside of mTokenMutex so callbacks can queue new requests or query tokens
+		for (const TokenCallback& callback : readyCallbacks)
+		{
+			callback.pCallback(callback.pUserData, callback.mToken);
+		}
+		readyCallbacks.clear();
+
 		uint64_t completionMask = 0;
 
 		for (uint32_t nodeIndex = 0; nodeIndex < linkedGPUCount; ++nodeIndex)
 		{
 			pLoader->mQueueMutex.Acquire();
+			drainRequestQueues(pLoader);
 
-			eastl::vector<UpdateRequest>& requestQueue = pLoader->mRequestQueue[nodeIndex];
+			eastl::vector<UpdateRequest>& requestQueue = pLoader->mPendingRequests[nodeIndex];
 			CopyEngine& copyEngine = pLoader->pCopyEngines[nodeIndex];
 
 			if (!requestQueue.size())
@@ -1686,21 +4376,43 @@ static void streamerThreadFunc(void* pThreadData)
 			eastl::swap(requestQueue, activeQueue);
 			pLoader->mQueueMutex.Release();
 
+			sortRequestQueue(activeQueue);
+
 			size_t requestCount = activeQueue.size();
 
 			for (size_t j = 0; j < requestCount; ++j)
 			{
+				// Staging memory of this set is used up. Put the rest back so requests submitted in the meantime get sorted in
+				if (j && !pLoader->mDesc.mSingleThreaded && isStagingBudgetExhausted(pLoader))
+				{
+					pLoader->mQueueMutex.Acquire();
+					requestQueue.insert(requestQueue.begin(), activeQueue.begin() + j, activeQueue.end());
+					pLoader->mQueueMutex.Release();
+					break;
+				}
+
 				UpdateRequest updateState = activeQueue[j];
+				addQueueDepth(pLoader, -1);
+
+				int64_t startUs = getUSec();
+				uint64_t stagedBytes = getStagedBytes(pLoader);
+				pLoader->mActiveTiming = {};
 
 				UploadFunctionResult result = UPLOAD_FUNCTION_RESULT_COMPLETED;
 				switch (updateState.mType)
 				{
 				case UPDATE_REQUEST_UPDATE_BUFFER:
+				{
+					PROFILER_SET_CPU_SCOPE("ResourceLoader", "UpdateBuffer", 0x3355ee);
 					result = updateBuffer(pLoader->pRenderer, &copyEngine, pLoader->mNextSet, updateState.bufUpdateDesc);
 					break;
+				}
 				case UPDATE_REQUEST_UPDATE_TEXTURE:
+				{
+					PROFILER_SET_CPU_SCOPE("ResourceLoader", "UpdateTexture", 0x3355ee);
 					result = updateTexture(pLoader->pRenderer, &copyEngine, pLoader->mNextSet, updateState.texUpdateDesc);
 					break;
+				}
 				case UPDATE_REQUEST_BUFFER_BARRIER:
 					cmdResourceBarrier(acquireCmd(&copyEngine, pLoader->mNextSet), 1, &updateState.bufferBarrier, 0, NULL, 0, NULL);
 					result = UPLOAD_FUNCTION_RESULT_COMPLETED;
@@ -1710,15 +4422,42 @@ static void streamerThreadFunc(void* pThreadData)
 					result = UPLOAD_FUNCTION_RESULT_COMPLETED;
 					break;
 				case UPDATE_REQUEST_LOAD_TEXTURE:
+				{
+					PROFILER_SET_CPU_SCOPE("ResourceLoader", "LoadTexture", 0x3355ee);
 					result = loadTexture(pLoader->pRenderer, &copyEngine, pLoader->mNextSet, updateState);
 					break;
+				}
 				case UPDATE_REQUEST_LOAD_GEOMETRY:
+				{
+					PROFILER_SET_CPU_SCOPE("ResourceLoader", "LoadGeometry", 0x3355ee);
 					result = loadGeometry(pLoader->pRenderer, &copyEngine, pLoader->mNextSet, updateState);
 					break;
+				}
 				case UPDATE_REQUEST_INVALID:
 					break;
 				}
 
+				if (updateState.pDecodeJob)
+				{
+					releaseDecodeJob(updateState.pDecodeJob);
+				}
+
+				if (UPLOAD_FUNCTION_RESULT_COMPLETED == result)
+				{
+					recordRequestTiming(pLoader, &copyEngine.resourceSets[pLoader->mNextSet], updateState, startUs, stagedBytes);
+				}
+
+				if (updateState.pSharedResource)
+				{
+					void* pResource = NULL;
+					if (UPLOAD_FUNCTION_RESULT_COMPLETED == result)
+					{
+						pResource = UPDATE_REQUEST_LOAD_TEXTURE == updateState.mType ? (void*)*updateState.texLoadDesc.ppTexture
+																					 : (void*)*updateState.geomLoadDesc.ppGeometry;
+					}
+					resolveSharedResource(pLoader, updateState.pSharedResource, pResource);
+				}
+
 				if (updateState.pUploadBuffer)
 				{
 					CopyResourceSet& resourceSet = copyEngine.resourceSets[pLoader->mNextSet];
@@ -1731,8 +4470,7 @@ static void streamerThreadFunc(void* pThreadData)
 
 				if (updateState.mWaitIndex && completed)
 				{
-					ASSERT(maxToken < updateState.mWaitIndex);
-					maxToken = updateState.mWaitIndex;
+					completedTokens.push_back(updateState.mWaitIndex);
 				}
 
 				ASSERT(result != UPLOAD_FUNCTION_RESULT_STAGING_BUFFER_FULL);
@@ -1753,7 +4491,15 @@ static void streamerThreadFunc(void* pThreadData)
 			}
 		}
 
-		SyncToken nextToken = max(maxToken, getLastTokenCompleted());
+		pLoader->mQueueMutex.Acquire();
+		for (SyncToken completedToken : completedTokens)
+		{
+			markTokenCompleted(pLoader, completedToken);
+		}
+		SyncToken nextToken = pLoader->mTokenWatermark;
+		pLoader->mQueueMutex.Release();
+		completedTokens.clear();
+
 		pLoader->mCurrentTokenState[pLoader->mNextSet] = nextToken;
 		if (pResourceLoader->mDesc.mSingleThreaded)
 		{
@@ -1795,15 +4541,52 @@ static void addResourceLoader(Renderer* pRenderer, ResourceLoaderDesc* pDesc, Re
 
 	pLoader->mRun = true; //-V601
 	pLoader->mDesc = pDesc ? *pDesc : gDefaultResourceLoaderDesc;
+	if (!pLoader->mDesc.mStreamingMipTailSize)
+	{
+		pLoader->mDesc.mStreamingMipTailSize = DEFAULT_STREAMING_MIP_TAIL_SIZE;
+	}
+
+	// Lookup tables of the Basis transcoder
+	basist::basisu_transcoder_init();
+	initSourceImageTables();
+
+	// Scratch memory of the geometry optimization passes
+	meshopt_setAllocator([](size_t size) { return tf_malloc(size); }, [](void* ptr) { tf_free(ptr); });
 
 	pLoader->mQueueMutex.Init();
 	pLoader->mTokenMutex.Init();
 	pLoader->mQueueCond.Init();
 	pLoader->mTokenCond.Init();
 	pLoader->mSemaphoreMutex.Init();
+	pLoader->mStreamingMutex.Init();
+	pLoader->mStreamingFrame = 0;
+	pLoader->mSharedMutex.Init();
+
+	pLoader->mActiveTiming = {};
+	pLoader->mQueueDepth = 0;
+	pLoader->mPeakQueueDepth = 0;
+	pLoader->mStatsMutex.Init();
+	pLoader->mStats = {};
+	pLoader->mWindowStartUs = getUSec();
+	pLoader->mWindowBytes = 0;
+	for (uint32_t i = 0; i < LOADER_COUNTER_COUNT; ++i)
+	{
+		bool bytes = LOADER_COUNTER_BYTES_PER_SECOND == i || LOADER_COUNTER_UPLOADED_BYTES == i ||
+			LOADER_COUNTER_STAGING_RING_USED == i || LOADER_COUNTER_TEMP_BUFFER_BYTES == i;
+		pLoader->mCounters[i] = getProfileCounterToken(gLoaderCounterNames[i], bytes);
+	}
 
 	pLoader->mTokenCounter = 0;
 	pLoader->mTokenCompleted = 0;
+	pLoader->mTokenWatermark = 0;
+	pLoader->mStreamerSleeping = 0;
+
+	pLoader->mRequestNodePool.mChunkCount = 0;
+	pLoader->mRequestNodePool.mFreeHead = 0;
+	for (uint32_t i = 0; i < MAX_LINKED_GPUS; ++i)
+	{
+		initRequestQueue(&pLoader->mRequestNodePool, &pLoader->mRequestQueue[i]);
+	}
 
 	uint32_t linkedGPUCount = pLoader->pRenderer->mLinkedNodeCount;
 	for (uint32_t i = 0; i < linkedGPUCount; ++i)
@@ -1832,6 +4615,35 @@ static void addResourceLoader(Renderer* pRenderer, ResourceLoaderDesc* pDesc, Re
 		pLoader->mThread = create_thread(&pLoader->mThreadDesc);
 	}
 
+	// Create decode threads. They read and decode texture / geometry files so the streamer thread only records copies
+	pLoader->mDecodeMutex.Init();
+	pLoader->mDecodeCond.Init();
+	pLoader->mDecodeDoneCond.Init();
+
+	uint32_t decodeThreadCount = pLoader->mDesc.mDecodeThreadCount;
+	if (RESOURCE_LOADER_DECODE_THREADS_AUTO == decodeThreadCount)
+	{
+		// Leave one core for the main thread and one for the streamer thread
+		uint32_t coreCount = Thread::GetNumCPUCores();
+		decodeThreadCount = coreCount > 2 ? coreCount - 2 : 1;
+	}
+#if defined(NX64)
+	// Thread stacks have to be provided by the caller on NX
+	decodeThreadCount = 0;
+#endif
+	if (pLoader->mDesc.mSingleThreaded)
+	{
+		decodeThreadCount = 0;
+	}
+	pLoader->mDecodeThreadCount = min(decodeThreadCount, MAX_DECODE_THREADS);
+
+	pLoader->mDecodeThreadDesc.pFunc = decodeThreadFunc;
+	pLoader->mDecodeThreadDesc.pData = pLoader;
+	for (uint32_t i = 0; i < pLoader->mDecodeThreadCount; ++i)
+	{
+		pLoader->mDecodeThreads[i] = create_thread(&pLoader->mDecodeThreadDesc);
+	}
+
 	*ppLoader = pLoader;
 }
 
@@ -1839,6 +4651,15 @@ static void removeResourceLoader(ResourceLoader* pLoader)
 {
 	pLoader->mRun = false; //-V601
 
+	// Stop decode threads first. The streamer thread frees the jobs left in the request queue
+	pLoader->mDecodeMutex.Acquire();
+	pLoader->mDecodeMutex.Release();
+	pLoader->mDecodeCond.WakeAll();
+	for (uint32_t i = 0; i < pLoader->mDecodeThreadCount; ++i)
+	{
+		destroy_thread(pLoader->mDecodeThreads[i]);
+	}
+
 	if (pLoader->mDesc.mSingleThreaded)
 	{
 		streamerThreadFunc(pLoader);
@@ -1849,58 +4670,242 @@ static void removeResourceLoader(ResourceLoader* pLoader)
 		destroy_thread(pLoader->mThread);
 	}
 
+	// The streamer is stopped, nothing writes to the streamed textures anymore
+	for (RetiredTexture& retired : pLoader->mRetiredTextures)
+	{
+		removeTexture(pLoader->pRenderer, retired.pTexture);
+	}
+	for (StreamedTexture* pStreamed : pLoader->mStreamedTextures)
+	{
+		LOGF(eWARNING, "Streamed texture %s was not removed", pStreamed->pFileName);
+		if (pStreamed->pPendingTexture)
+			removeTexture(pLoader->pRenderer, pStreamed->pPendingTexture);
+		if (pStreamed->pTexture)
+			removeTexture(pLoader->pRenderer, pStreamed->pTexture);
+		tf_free(pStreamed->pFileName);
+		tf_free(pStreamed);
+	}
+	pLoader->mStreamingMutex.Destroy();
+
+	for (eastl::pair<const eastl::string, SharedResource*>& shared : pLoader->mSharedResources)
+	{
+		LOGF(eWARNING, "Shared resource %s still has %u references", shared.first.c_str(), shared.second->mRefCount);
+		tf_delete(shared.second);
+	}
+	pLoader->mSharedMutex.Destroy();
+	pLoader->mStatsMutex.Destroy();
+
 	pLoader->mQueueCond.Destroy();
 	pLoader->mTokenCond.Destroy();
 	pLoader->mQueueMutex.Destroy();
 	pLoader->mTokenMutex.Destroy();
 	pLoader->mSemaphoreMutex.Destroy();
+	pLoader->mDecodeCond.Destroy();
+	pLoader->mDecodeDoneCond.Destroy();
+	pLoader->mDecodeMutex.Destroy();
+
+	for (uint32_t i = 0; i < pLoader->mRequestNodePool.mChunkCount; ++i)
+	{
+		tf_free(pLoader->mRequestNodePool.pChunks[i]);
+	}
 
 	tf_delete(pLoader);
 }
 
-static void queueBufferUpdate(ResourceLoader* pLoader, BufferUpdateDesc* pBufferUpdate, SyncToken* token)
+// Joins the load of an existing shared resource with the same key. Returns true if the load was joined and must not be queued.
+// Otherwise *ppShared is the new entry the load has to be queued with, and mSharedMutex stays locked until that is done.
+// *ppShared is NULL if the first load of key is still collected in the batch of another thread, the load is not shared then
+static bool joinSharedResource(ResourceLoader* pLoader, const char* key, void** ppOutput, RequestBatch* pBatch, SyncToken* token, SharedResource** ppShared)
 {
-	uint32_t nodeIndex = pBufferUpdate->pBuffer->mNodeIndex;
-	pLoader->mQueueMutex.Acquire();
+	*ppShared = NULL;
+
+	pLoader->mSharedMutex.Acquire();
+	eastl::hash_map<eastl::string, SharedResource*>::iterator it = pLoader->mSharedResources.find_as(key);
+	if (it == pLoader->mSharedResources.end())
+	{
+		SharedResource* pShared = tf_new(SharedResource);
+		pShared->mKey = key;
+		pShared->pResource = NULL;
+		pShared->mRefCount = 1;
+		pShared->mToken = 0;
+		pShared->pBatch = pBatch;
+		pLoader->mSharedResources[pShared->mKey] = pShared;
+		*ppShared = pShared;
+		return false;
+	}
+
+	SharedResource* pShared = it->second;
+	if (!pShared->mToken && pShared->pBatch != pBatch)
+	{
+		pLoader->mSharedMutex.Release();
+		return false;
+	}
+
+	++pShared->mRefCount;
+	if (pShared->pResource)
+	{
+		*ppOutput = pShared->pResource;
+	}
+	else
+	{
+		pShared->mOutputs.push_back(ppOutput);
+	}
+	// Loads joined inside the same batch are covered by the token of the batch
+	if (token && pShared->mToken)
+	{
+		*token = max(pShared->mToken, *token);
+	}
+	pLoader->mSharedMutex.Release();
+	return true;
+}
+
+// Publishes the result of a shared load to the loads which joined it. A failed load drops the entry so the next load retries
+static void resolveSharedResource(ResourceLoader* pLoader, SharedResource* pShared, void* pResource)
+{
+	pLoader->mSharedMutex.Acquire();
+	if (pResource)
+	{
+		pShared->pResource = pResource;
+		for (void** ppOutput : pShared->mOutputs)
+		{
+			*ppOutput = pResource;
+		}
+		pShared->mOutputs.set_capacity(0);
+		pLoader->mSharedLookup[pResource] = pShared;
+	}
+	else
+	{
+		pLoader->mSharedResources.erase(pShared->mKey);
+		tf_delete(pShared);
+	}
+	pLoader->mSharedMutex.Release();
+}
+
+// Drops one reference of a shared resource. Returns false once the resource has to be freed, which includes resources that are not shared
+static bool releaseSharedResource(ResourceLoader* pLoader, const void* pResource)
+{
+	pLoader->mSharedMutex.Acquire();
+	eastl::hash_map<const void*, SharedResource*>::iterator it = pLoader->mSharedLookup.find(pResource);
+	if (it == pLoader->mSharedLookup.end())
+	{
+		pLoader->mSharedMutex.Release();
+		return false;
+	}
+
+	SharedResource* pShared = it->second;
+	if (--pShared->mRefCount)
+	{
+		pLoader->mSharedMutex.Release();
+		return true;
+	}
+
+	pLoader->mSharedLookup.erase(it);
+	pLoader->mSharedResources.erase(pShared->mKey);
+	pLoader->mSharedMutex.Release();
+	tf_delete(pShared);
+	return false;
+}
+
+static void queueUpdateRequest(ResourceLoader* pLoader, uint32_t nodeIndex, UpdateRequest& request, RequestBatch* pBatch, SyncToken* token)
+{
+	if (pBatch)
+	{
+		BatchedRequest batched = { request, nodeIndex, (uint32_t)pBatch->mRequests.size() };
+		pBatch->mRequests.push_back(batched);
+		return;
+	}
+
+	if (needsDecodeJob(pLoader, request))
+	{
+		queueDecodeJob(pLoader, &request);
+	}
 
 	SyncToken t = tfrg_atomic64_add_relaxed(&pLoader->mTokenCounter, 1) + 1;
 
-	pLoader->mRequestQueue[nodeIndex].emplace_back(UpdateRequest(*pBufferUpdate));
-	pLoader->mRequestQueue[nodeIndex].back().mWaitIndex = t;
-	pLoader->mRequestQueue[nodeIndex].back().pUploadBuffer =
+	request.mWaitIndex = t;
+	request.mQueueTimeUs = getUSec();
+	// The caller holds mSharedMutex
+	if (request.pSharedResource)
+	{
+		request.pSharedResource->mToken = t;
+	}
+	addQueueDepth(pLoader, 1);
+	pushUpdateRequest(&pLoader->mRequestNodePool, &pLoader->mRequestQueue[nodeIndex], request);
+	wakeStreamer(pLoader);
+	if (token) *token = max(t, *token);
+}
+
+// Forwards the token of a public addResource / endUpdateResource call and registers its completion callback
+static void onRequestQueued(ResourceLoader* pLoader, SyncToken callToken, SyncToken* token, ResourceLoadCallback pCallback, void* pUserData)
+{
+	if (token) *token = max(callToken, *token);
+	if (!pCallback)
+		return;
+
+	pLoader->mTokenMutex.Acquire();
+	bool completed = callToken <= tfrg_atomic64_load_acquire(&pLoader->mTokenCompleted);
+	if (!completed)
+	{
+		TokenCallback callback = { callToken, pCallback, pUserData };
+		pLoader->mTokenCallbacks.push_back(callback);
+		eastl::push_heap(pLoader->mTokenCallbacks.begin(), pLoader->mTokenCallbacks.end(), eastl::greater<TokenCallback>());
+	}
+	pLoader->mTokenMutex.Release();
+
+	if (completed)
+	{
+		pCallback(pUserData, callToken);
+	}
+}
+
+static void queueBufferUpdate(ResourceLoader* pLoader, BufferUpdateDesc* pBufferUpdate, RequestBatch* pBatch, SyncToken* token)
+{
+	uint32_t nodeIndex = pBufferUpdate->pBuffer->mNodeIndex;
+
+	UpdateRequest request(*pBufferUpdate);
+	request.mPriority = pBufferUpdate->mInternal.mPriority;
+	request.pUploadBuffer =
 		(pBufferUpdate->mInternal.mMappedRange.mFlags & MAPPED_RANGE_FLAG_TEMP_BUFFER) ? pBufferUpdate->mInternal.mMappedRange.pBuffer
 																					   : NULL;
-	pLoader->mQueueMutex.Release();
-	pLoader->mQueueCond.WakeOne();
-	if (token) *token = max(t, *token);
+	queueUpdateRequest(pLoader, nodeIndex, request, pBatch, token);
 }
 
-static void queueTextureLoad(ResourceLoader* pLoader, TextureLoadDesc* pTextureUpdate, SyncToken* token)
+static void queueTextureLoad(ResourceLoader* pLoader, TextureLoadDesc* pTextureUpdate, SharedResource* pShared, RequestBatch* pBatch, SyncToken* token)
 {
 	uint32_t nodeIndex = pTextureUpdate->mNodeIndex;
-	pLoader->mQueueMutex.Acquire();
 
-	SyncToken t = tfrg_atomic64_add_relaxed(&pLoader->mTokenCounter, 1) + 1;
+	UpdateRequest request(*pTextureUpdate);
+	request.mPriority = pTextureUpdate->mPriority;
+	request.pSharedResource = pShared;
+	queueUpdateRequest(pLoader, nodeIndex, request, pBatch, token);
+}
 
-	pLoader->mRequestQueue[nodeIndex].emplace_back(UpdateRequest(*pTextureUpdate));
-	pLoader->mRequestQueue[nodeIndex].back().mWaitIndex = t;
-	pLoader->mQueueMutex.Release();
-	pLoader->mQueueCond.WakeOne();
-	if (token) *token = max(t, *token);
+// Loads mipLevels mips of a streamed texture from its file into pPendingTexture. 0 mip levels loads the mip tail into pTexture
+static void queueStreamedTextureLoad(ResourceLoader* pLoader, StreamedTexture* pStreamed, uint32_t mipLevels, RequestBatch* pBatch, SyncToken* token)
+{
+	TextureLoadDesc loadDesc = {};
+	loadDesc.ppTexture = mipLevels ? &pStreamed->pPendingTexture : &pStreamed->pTexture;
+	loadDesc.pFileName = pStreamed->pFileName;
+	loadDesc.mNodeIndex = pStreamed->mNodeIndex;
+	loadDesc.mCreationFlag = pStreamed->mCreationFlag;
+	loadDesc.mContainer = pStreamed->mContainer;
+	loadDesc.mPriority = pStreamed->mPriority;
+
+	UpdateRequest request(loadDesc);
+	request.mPriority = pStreamed->mPriority;
+	request.pStreamedTexture = pStreamed;
+	request.mStreamMipLevels = mipLevels;
+	queueUpdateRequest(pLoader, pStreamed->mNodeIndex, request, pBatch, token);
 }
 
-static void queueGeometryLoad(ResourceLoader* pLoader, GeometryLoadDesc* pGeometryLoad, SyncToken* token)
+static void queueGeometryLoad(ResourceLoader* pLoader, GeometryLoadDesc* pGeometryLoad, SharedResource* pShared, RequestBatch* pBatch, SyncToken* token)
 {
 	uint32_t nodeIndex = pGeometryLoad->mNodeIndex;
-	pLoader->mQueueMutex.Acquire();
-
-	SyncToken t = tfrg_atomic64_add_relaxed(&pLoader->mTokenCounter, 1) + 1;
 
-	pLoader->mRequestQueue[nodeIndex].emplace_back(UpdateRequest(*pGeometryLoad));
-	pLoader->mRequestQueue[nodeIndex].back().mWaitIndex = t;
-	pLoader->mQueueMutex.Release();
-	pLoader->mQueueCond.WakeOne();
-	if (token) *token = max(t, *token);
+	UpdateRequest request(*pGeometryLoad);
+	request.mPriority = pGeometryLoad->mPriority;
+	request.pSharedResource = pShared;
+	queueUpdateRequest(pLoader, nodeIndex, request, pBatch, token);
 }
 
 static void queueTextureUpdate(ResourceLoader* pLoader, TextureUpdateDescInternal* pTextureUpdate, SyncToken* token)
@@ -1908,46 +4913,29 @@ static void queueTextureUpdate(ResourceLoader* pLoader, TextureUpdateDescInterna
 	ASSERT(pTextureUpdate->mRange.pBuffer);
 
 	uint32_t nodeIndex = pTextureUpdate->pTexture->mNodeIndex;
-	pLoader->mQueueMutex.Acquire();
-
-	SyncToken t = tfrg_atomic64_add_relaxed(&pLoader->mTokenCounter, 1) + 1;
 
-	pLoader->mRequestQueue[nodeIndex].emplace_back(UpdateRequest(*pTextureUpdate));
-	pLoader->mRequestQueue[nodeIndex].back().mWaitIndex = t;
-	pLoader->mRequestQueue[nodeIndex].back().pUploadBuffer =
-		(pTextureUpdate->mRange.mFlags & MAPPED_RANGE_FLAG_TEMP_BUFFER) ? pTextureUpdate->mRange.pBuffer : NULL;
-	pLoader->mQueueMutex.Release();
-	pLoader->mQueueCond.WakeOne();
-	if (token) *token = max(t, *token);
+	UpdateRequest request(*pTextureUpdate);
+	request.pUploadBuffer = (pTextureUpdate->mRange.mFlags & MAPPED_RANGE_FLAG_TEMP_BUFFER) ? pTextureUpdate->mRange.pBuffer : NULL;
+	queueUpdateRequest(pLoader, nodeIndex, request, NULL, token);
 }
 
 #if defined(VULKAN)
-static void queueBufferBarrier(ResourceLoader* pLoader, Buffer* pBuffer, ResourceState state, SyncToken* token)
+static void queueBufferBarrier(ResourceLoader* pLoader, Buffer* pBuffer, ResourceState state, uint32_t priority, RequestBatch* pBatch, SyncToken* token)
 {
 	uint32_t nodeIndex = pBuffer->mNodeIndex;
-	pLoader->mQueueMutex.Acquire();
-
-	SyncToken t = tfrg_atomic64_add_relaxed(&pLoader->mTokenCounter, 1) + 1;
 
-	pLoader->mRequestQueue[nodeIndex].emplace_back(UpdateRequest{ BufferBarrier{ pBuffer, RESOURCE_STATE_UNDEFINED, state } });
-	pLoader->mRequestQueue[nodeIndex].back().mWaitIndex = t;
-	pLoader->mQueueMutex.Release();
-	pLoader->mQueueCond.WakeOne();
-	if (token) *token = max(t, *token);
+	UpdateRequest request{ BufferBarrier{ pBuffer, RESOURCE_STATE_UNDEFINED, state } };
+	request.mPriority = priority;
+	queueUpdateRequest(pLoader, nodeIndex, request, pBatch, token);
 }
 
-static void queueTextureBarrier(ResourceLoader* pLoader, Texture* pTexture, ResourceState state, SyncToken* token)
+static void queueTextureBarrier(ResourceLoader* pLoader, Texture* pTexture, ResourceState state, uint32_t priority, RequestBatch* pBatch, SyncToken* token)
 {
 	uint32_t nodeIndex = pTexture->mNodeIndex;
-	pLoader->mQueueMutex.Acquire();
-
-	SyncToken t = tfrg_atomic64_add_relaxed(&pLoader->mTokenCounter, 1) + 1;
 
-	pLoader->mRequestQueue[nodeIndex].emplace_back(UpdateRequest{ TextureBarrier{ pTexture, RESOURCE_STATE_UNDEFINED, state } });
-	pLoader->mRequestQueue[nodeIndex].back().mWaitIndex = t;
-	pLoader->mQueueMutex.Release();
-	pLoader->mQueueCond.WakeOne();
-	if (token) *token = max(t, *token);
+	UpdateRequest request{ TextureBarrier{ pTexture, RESOURCE_STATE_UNDEFINED, state } };
+	request.mPriority = priority;
+	queueUpdateRequest(pLoader, nodeIndex, request, pBatch, token);
 }
 #endif
 
@@ -1964,20 +4952,134 @@ static void waitForToken(ResourceLoader* pLoader, const SyncToken* token)
 	}
 	pLoader->mTokenMutex.Release();
 }
+// Finds a request the streamer has not picked up yet. Caller must hold mQueueMutex
+static UpdateRequest* findPendingRequest(ResourceLoader* pLoader, SyncToken token, uint32_t* pOutNodeIndex)
+{
+	drainRequestQueues(pLoader);
+
+	for (uint32_t i = 0; i < MAX_LINKED_GPUS; ++i)
+	{
+		for (UpdateRequest& request : pLoader->mPendingRequests[i])
+		{
+			if (request.mWaitIndex == token)
+			{
+				*pOutNodeIndex = i;
+				return &request;
+			}
+		}
+	}
+	return NULL;
+}
+
+static bool setRequestPriority(ResourceLoader* pLoader, const SyncToken* token, uint32_t priority)
+{
+	uint32_t nodeIndex = 0;
+	pLoader->mQueueMutex.Acquire();
+	UpdateRequest* pRequest = findPendingRequest(pLoader, *token, &nodeIndex);
+	if (pRequest)
+	{
+		pRequest->mPriority = priority;
+	}
+	pLoader->mQueueMutex.Release();
+	return pRequest != NULL;
+}
+
+static bool cancelRequest(ResourceLoader* pLoader, const SyncToken* token)
+{
+	uint32_t nodeIndex = 0;
+	// Same lock order as addResource, which queues shared loads while holding mSharedMutex
+	pLoader->mSharedMutex.Acquire();
+	pLoader->mQueueMutex.Acquire();
+	UpdateRequest* pRequest = findPendingRequest(pLoader, *token, &nodeIndex);
+	// Buffer / texture updates already have their data in upload memory. Only file loads can be dropped
+	if (!pRequest || (UPDATE_REQUEST_LOAD_TEXTURE != pRequest->mType && UPDATE_REQUEST_LOAD_GEOMETRY != pRequest->mType))
+	{
+		pLoader->mQueueMutex.Release();
+		pLoader->mSharedMutex.Release();
+		return false;
+	}
+
+	// Loads which joined a shared load share its token. A cancel drops one reference, the load goes on for the others
+	SharedResource* pShared = pRequest->pSharedResource;
+	if (pShared && --pShared->mRefCount)
+	{
+		pLoader->mQueueMutex.Release();
+		pLoader->mSharedMutex.Release();
+		return true;
+	}
+
+	UpdateRequest request = *pRequest;
+	pLoader->mPendingRequests[nodeIndex].erase(pRequest);
+	markTokenCompleted(pLoader, request.mWaitIndex);
+	pLoader->mQueueMutex.Release();
+	// Every load sharing the entry was cancelled. Drop it while still locked so no new load joins it
+	if (pShared)
+	{
+		pLoader->mSharedResources.erase(pShared->mKey);
+		tf_delete(pShared);
+	}
+	pLoader->mSharedMutex.Release();
+	addQueueDepth(pLoader, -1);
+	// Wake the streamer so the token gets signaled
+	pLoader->mQueueCond.WakeOne();
+
+	bool decoded = false;
+	if (request.pDecodeJob)
+	{
+		decoded = cancelDecodeJob(pLoader, request.pDecodeJob);
+		releaseDecodeJob(request.pDecodeJob);
+	}
+
+	// decodeGeometry frees the vertex layout copy made in addResource
+	if (UPDATE_REQUEST_LOAD_GEOMETRY == request.mType && !decoded)
+	{
+		tf_free(request.geomLoadDesc.pVertexLayout);
+	}
+
+	return true;
+}
 /************************************************************************/
 // Resource Loader Interfae Implementation
 /************************************************************************/
+static void initShaderCache();
+static void exitShaderCache();
+
 void initResourceLoaderInterface(Renderer* pRenderer, ResourceLoaderDesc* pDesc)
 {
 	addResourceLoader(pRenderer, pDesc, &pResourceLoader);
+	initShaderCache();
 }
 
 void exitResourceLoaderInterface(Renderer* pRenderer)
 {
+	exitShaderCache();
 	removeResourceLoader(pResourceLoader);
 }
 
-void addResource(BufferLoadDesc* pBufferDesc, SyncToken* token)
+// Requests are collected in pBatch instead of being queued if it is non NULL
+static void endBufferUpdate(BufferUpdateDesc* pBufferUpdate, RequestBatch* pBatch, SyncToken* token)
+{
+	if (pBufferUpdate->mInternal.mMappedRange.mFlags & MAPPED_RANGE_FLAG_UNMAP_BUFFER)
+	{
+		unmapBuffer(pResourceLoader->pRenderer, pBufferUpdate->pBuffer);
+	}
+
+	ResourceMemoryUsage memoryUsage = (ResourceMemoryUsage)pBufferUpdate->pBuffer->mMemoryUsage;
+	if (!UMA && memoryUsage == RESOURCE_MEMORY_USAGE_GPU_ONLY)
+	{
+		queueBufferUpdate(pResourceLoader, pBufferUpdate, pBatch, token);
+	}
+
+	// Restore the state to before the beginUpdateResource call.
+	pBufferUpdate->pMappedData = NULL;
+	pBufferUpdate->mInternal = {};
+	if (!pBatch && pResourceLoader->mDesc.mSingleThreaded)
+	{
+		streamerThreadFunc(pResourceLoader);
+	}
+}
+
+static void addBufferResource(BufferLoadDesc* pBufferDesc, RequestBatch* pBatch, SyncToken* token)
 {
 	uint64_t stagingBufferSize = pResourceLoader->pCopyEngines[0].bufferSize;
 	bool update = pBufferDesc->pData || pBufferDesc->mForceReset;
@@ -2014,6 +5116,7 @@ void addResource(BufferLoadDesc* pBufferDesc, SyncToken* token)
 				updateDesc.mSize = chunkSize;
 				updateDesc.mDstOffset = offset;
 				beginUpdateResource(&updateDesc);
+				updateDesc.mInternal.mPriority = pBufferDesc->mPriority;
 				if (pBufferDesc->mForceReset)
 				{
 					memset(updateDesc.pMappedData, 0, chunkSize);
@@ -2023,7 +5126,7 @@ void addResource(BufferLoadDesc* pBufferDesc, SyncToken* token)
 					ASSERT(data);
 					memcpy(updateDesc.pMappedData, (char*)data + offset, chunkSize); //-V769
 				}
-				endUpdateResource(&updateDesc, token);
+				endBufferUpdate(&updateDesc, pBatch, token);
 			}
 		}
 		else
@@ -2031,6 +5134,7 @@ void addResource(BufferLoadDesc* pBufferDesc, SyncToken* token)
 			BufferUpdateDesc updateDesc = {};
 			updateDesc.pBuffer = *pBufferDesc->ppBuffer;
 			beginUpdateResource(&updateDesc);
+			updateDesc.mInternal.mPriority = pBufferDesc->mPriority;
 			if (pBufferDesc->mForceReset)
 			{
 				memset(updateDesc.pMappedData, 0, (size_t)pBufferDesc->mDesc.mSize);
@@ -2041,7 +5145,7 @@ void addResource(BufferLoadDesc* pBufferDesc, SyncToken* token)
 				if (pBufferDesc->pData)
 					memcpy(updateDesc.pMappedData, pBufferDesc->pData, (size_t)pBufferDesc->mDesc.mSize);
 			}
-			endUpdateResource(&updateDesc, token);
+			endBufferUpdate(&updateDesc, pBatch, token);
 		}
 	}
 	else
@@ -2052,13 +5156,40 @@ void addResource(BufferLoadDesc* pBufferDesc, SyncToken* token)
 			pBufferDesc->mDesc.mMemoryUsage == RESOURCE_MEMORY_USAGE_GPU_ONLY &&
 			// Check whether this is required (user specified a state other than undefined / common)
 			(pBufferDesc->mDesc.mStartState != RESOURCE_STATE_UNDEFINED && pBufferDesc->mDesc.mStartState != RESOURCE_STATE_COMMON))
-			queueBufferBarrier(pResourceLoader, *pBufferDesc->ppBuffer, pBufferDesc->mDesc.mStartState, token);
+			queueBufferBarrier(pResourceLoader, *pBufferDesc->ppBuffer, pBufferDesc->mDesc.mStartState, pBufferDesc->mPriority, pBatch, token);
 #endif
 	}
-}
+}
+
+static void addTextureResource(TextureLoadDesc* pTextureDesc, RequestBatch* pBatch, SyncToken* token)
+{
+	if (pTextureDesc->mFlags & TEXTURE_LOAD_FLAG_STREAM_MIPS)
+	{
+		ASSERT(pTextureDesc->ppStreamedTexture && pTextureDesc->pFileName);
+
+		StreamedTexture* pStreamed = (StreamedTexture*)tf_calloc(1, sizeof(StreamedTexture));
+		size_t fileNameSize = strlen(pTextureDesc->pFileName) + 1;
+		pStreamed->pFileName = (char*)tf_malloc(fileNameSize);
+		memcpy(pStreamed->pFileName, pTextureDesc->pFileName, fileNameSize);
+		pStreamed->mContainer = util_get_texture_container(pTextureDesc);
+		pStreamed->mCreationFlag = pTextureDesc->mCreationFlag;
+		pStreamed->mNodeIndex = pTextureDesc->mNodeIndex;
+		pStreamed->mPriority = pTextureDesc->mPriority;
+		pStreamed->mRequestedMipLevels = UINT32_MAX;
+		*pTextureDesc->ppStreamedTexture = pStreamed;
+
+		pResourceLoader->mStreamingMutex.Acquire();
+		pResourceLoader->mStreamedTextures.push_back(pStreamed);
+		pResourceLoader->mStreamingMutex.Release();
+
+		queueStreamedTextureLoad(pResourceLoader, pStreamed, 0, pBatch, token);
+		if (!pBatch && pResourceLoader->mDesc.mSingleThreaded)
+		{
+			streamerThreadFunc(pResourceLoader);
+		}
+		return;
+	}
 
-void addResource(TextureLoadDesc* pTextureDesc, SyncToken* token)
-{
 	ASSERT(pTextureDesc->ppTexture);
 
 	if (!pTextureDesc->pFileName && pTextureDesc->pDesc)
@@ -2078,34 +5209,257 @@ void addResource(TextureLoadDesc* pTextureDesc, SyncToken* token)
 			{
 				startState = util_determine_resource_start_state(pTextureDesc->pDesc->mDescriptors & DESCRIPTOR_TYPE_RW_TEXTURE);
 			}
-			queueTextureBarrier(pResourceLoader, *pTextureDesc->ppTexture, startState, token);
+			queueTextureBarrier(pResourceLoader, *pTextureDesc->ppTexture, startState, pTextureDesc->mPriority, pBatch, token);
 		}
 #endif
 	}
 	else
 	{
+		SharedResource* pShared = NULL;
+		if (pTextureDesc->mFlags & TEXTURE_LOAD_FLAG_SHARED)
+		{
+			char key[FS_MAX_PATH + 64] = {};
+			snprintf(key, sizeof(key), "%s|%u|%u|%u", pTextureDesc->pFileName, (uint32_t)util_get_texture_container(pTextureDesc),
+				(uint32_t)pTextureDesc->mCreationFlag, pTextureDesc->mNodeIndex);
+			if (joinSharedResource(pResourceLoader, key, (void**)pTextureDesc->ppTexture, pBatch, token, &pShared))
+			{
+				return;
+			}
+		}
+
 		TextureLoadDesc updateDesc = *pTextureDesc;
-		queueTextureLoad(pResourceLoader, &updateDesc, token);
-		if (pResourceLoader->mDesc.mSingleThreaded) 
+		queueTextureLoad(pResourceLoader, &updateDesc, pShared, pBatch, token);
+		if (pShared)
+		{
+			pResourceLoader->mSharedMutex.Release();
+		}
+		if (!pBatch && pResourceLoader->mDesc.mSingleThreaded)
 		{
 			streamerThreadFunc(pResourceLoader);
 		}
 	}
 }
 
-void addResource(GeometryLoadDesc* pDesc, SyncToken* token)
+static void addGeometryResource(GeometryLoadDesc* pDesc, RequestBatch* pBatch, SyncToken* token)
 {
 	ASSERT(pDesc->ppGeometry);
 
+	SharedResource* pShared = NULL;
+	if (pDesc->mFlags & GEOMETRY_LOAD_FLAG_SHARED)
+	{
+		char key[FS_MAX_PATH + 64] = {};
+		snprintf(key, sizeof(key), "%s|%u|%u|%016llx", pDesc->pFileName, (uint32_t)pDesc->mFlags, pDesc->mNodeIndex,
+			(unsigned long long)getGeometryLayoutHash(pDesc));
+		if (joinSharedResource(pResourceLoader, key, (void**)pDesc->ppGeometry, pBatch, token, &pShared))
+		{
+			return;
+		}
+	}
+
 	GeometryLoadDesc updateDesc = *pDesc;
 	updateDesc.pFileName = pDesc->pFileName;
 	updateDesc.pVertexLayout = (VertexLayout*)tf_calloc(1, sizeof(VertexLayout));
 	memcpy(updateDesc.pVertexLayout, pDesc->pVertexLayout, sizeof(VertexLayout));
-	queueGeometryLoad(pResourceLoader, &updateDesc, token);
+	queueGeometryLoad(pResourceLoader, &updateDesc, pShared, pBatch, token);
+	if (pShared)
+	{
+		pResourceLoader->mSharedMutex.Release();
+	}
+	if (!pBatch && pResourceLoader->mDesc.mSingleThreaded)
+	{
+		streamerThreadFunc(pResourceLoader);
+	}
+}
+
+static const char* getBatchedRequestFileName(const UpdateRequest& request)
+{
+	if (UPDATE_REQUEST_LOAD_TEXTURE == request.mType)
+	{
+		return request.texLoadDesc.pFileName;
+	}
+	if (UPDATE_REQUEST_LOAD_GEOMETRY == request.mType)
+	{
+		return request.geomLoadDesc.pFileName;
+	}
+	return NULL;
+}
+
+static uint64_t getBatchedRequestSize(const UpdateRequest& request)
+{
+	if (UPDATE_REQUEST_UPDATE_BUFFER == request.mType)
+	{
+		const BufferUpdateDesc& desc = request.bufUpdateDesc;
+		return desc.mSize ? desc.mSize : desc.pBuffer->mSize - desc.mDstOffset;
+	}
+	return 0;
+}
+
+// Uploads from memory go first, largest first so they pack well into the staging sets.
+// File loads follow in path order so reads from the same directory or archive stay together
+static bool compareBatchedRequests(const BatchedRequest& lhs, const BatchedRequest& rhs)
+{
+	const char* lhsFile = getBatchedRequestFileName(lhs.mRequest);
+	const char* rhsFile = getBatchedRequestFileName(rhs.mRequest);
+	if (!lhsFile != !rhsFile)
+	{
+		return !lhsFile;
+	}
+	if (lhsFile)
+	{
+		int cmp = strcmp(lhsFile, rhsFile);
+		if (cmp)
+		{
+			return cmp < 0;
+		}
+	}
+	else
+	{
+		uint64_t lhsSize = getBatchedRequestSize(lhs.mRequest);
+		uint64_t rhsSize = getBatchedRequestSize(rhs.mRequest);
+		if (lhsSize != rhsSize)
+		{
+			return lhsSize > rhsSize;
+		}
+	}
+	return lhs.mOrder < rhs.mOrder;
+}
+
+// Submits a batch with a single token counter bump, one queue append per GPU and one streamer wake up
+static void submitRequestBatch(ResourceLoader* pLoader, RequestBatch* pBatch, SyncToken* token)
+{
+	eastl::vector<BatchedRequest>& requests = pBatch->mRequests;
+	if (requests.empty())
+	{
+		return;
+	}
+
+	eastl::sort(requests.begin(), requests.end(), compareBatchedRequests);
+
+	SyncToken firstToken = tfrg_atomic64_add_relaxed(&pLoader->mTokenCounter, requests.size()) + 1;
+	int64_t queueTimeUs = getUSec();
+
+	// Decode jobs are queued in sorted order as well, the decode threads do the actual reads
+	eastl::vector<DecodeJob*> decodeJobs;
+	bool shared = false;
+	for (uint32_t i = 0; i < (uint32_t)requests.size(); ++i)
+	{
+		UpdateRequest& request = requests[i].mRequest;
+		request.mWaitIndex = firstToken + i;
+		request.mQueueTimeUs = queueTimeUs;
+		shared |= request.pSharedResource != NULL;
+		if (needsDecodeJob(pLoader, request))
+		{
+			decodeJobs.push_back(createDecodeJob(&request));
+		}
+	}
+
+	// Loads sharing a resource of the batch from now on wait for its token
+	if (shared)
+	{
+		pLoader->mSharedMutex.Acquire();
+		for (BatchedRequest& batched : requests)
+		{
+			if (batched.mRequest.pSharedResource)
+			{
+				batched.mRequest.pSharedResource->mToken = batched.mRequest.mWaitIndex;
+				batched.mRequest.pSharedResource->pBatch = NULL;
+			}
+		}
+		pLoader->mSharedMutex.Release();
+	}
+
+	if (!decodeJobs.empty())
+	{
+		pLoader->mDecodeMutex.Acquire();
+		pLoader->mDecodeQueue.insert(pLoader->mDecodeQueue.end(), decodeJobs.begin(), decodeJobs.end());
+		pLoader->mDecodeMutex.Release();
+		pLoader->mDecodeCond.WakeAll();
+	}
+
+	addQueueDepth(pLoader, (int32_t)requests.size());
+	for (uint32_t nodeIndex = 0; nodeIndex < MAX_LINKED_GPUS; ++nodeIndex)
+	{
+		RequestNode* pFirst = NULL;
+		RequestNode* pLast = NULL;
+		for (const BatchedRequest& batched : requests)
+		{
+			if (batched.mNodeIndex != nodeIndex)
+			{
+				continue;
+			}
+
+			RequestNode* pNode = allocRequestNode(&pLoader->mRequestNodePool);
+			pNode->mRequest = batched.mRequest;
+			pNode->mNext = 0;
+			if (pLast)
+			{
+				tfrg_atomicptr_store_relaxed(&pLast->mNext, (uintptr_t)pNode);
+			}
+			else
+			{
+				pFirst = pNode;
+			}
+			pLast = pNode;
+		}
+
+		if (pFirst)
+		{
+			pushRequestNodes(&pLoader->mRequestQueue[nodeIndex], pFirst, pLast);
+		}
+	}
+
+	wakeStreamer(pLoader);
+	if (token) *token = max(firstToken + requests.size() - 1, *token);
+}
+
+void addResource(BufferLoadDesc* pBufferDesc, SyncToken* token, ResourceLoadCallback pCallback, void* pUserData)
+{
+	SyncToken callToken = 0;
+	addBufferResource(pBufferDesc, NULL, &callToken);
+	onRequestQueued(pResourceLoader, callToken, token, pCallback, pUserData);
+}
+
+void addResource(TextureLoadDesc* pTextureDesc, SyncToken* token, ResourceLoadCallback pCallback, void* pUserData)
+{
+	SyncToken callToken = 0;
+	addTextureResource(pTextureDesc, NULL, &callToken);
+	onRequestQueued(pResourceLoader, callToken, token, pCallback, pUserData);
+}
+
+void addResource(GeometryLoadDesc* pDesc, SyncToken* token, ResourceLoadCallback pCallback, void* pUserData)
+{
+	SyncToken callToken = 0;
+	addGeometryResource(pDesc, NULL, &callToken);
+	onRequestQueued(pResourceLoader, callToken, token, pCallback, pUserData);
+}
+
+void addResources(ResourceLoadBatchDesc* pBatchDesc, SyncToken* token, ResourceLoadCallback pCallback, void* pUserData)
+{
+	ASSERT(pBatchDesc);
+
+	RequestBatch batch;
+	batch.mRequests.reserve(pBatchDesc->mBufferLoadCount + pBatchDesc->mTextureLoadCount + pBatchDesc->mGeometryLoadCount);
+	for (uint32_t i = 0; i < pBatchDesc->mBufferLoadCount; ++i)
+	{
+		addBufferResource(&pBatchDesc->pBufferLoads[i], &batch, NULL);
+	}
+	for (uint32_t i = 0; i < pBatchDesc->mTextureLoadCount; ++i)
+	{
+		addTextureResource(&pBatchDesc->pTextureLoads[i], &batch, NULL);
+	}
+	for (uint32_t i = 0; i < pBatchDesc->mGeometryLoadCount; ++i)
+	{
+		addGeometryResource(&pBatchDesc->pGeometryLoads[i], &batch, NULL);
+	}
+
+	SyncToken callToken = 0;
+	submitRequestBatch(pResourceLoader, &batch, &callToken);
 	if (pResourceLoader->mDesc.mSingleThreaded)
 	{
 		streamerThreadFunc(pResourceLoader);
 	}
+
+	onRequestQueued(pResourceLoader, callToken, token, pCallback, pUserData);
 }
 
 void removeResource(Buffer* pBuffer)
@@ -2115,16 +5469,63 @@ void removeResource(Buffer* pBuffer)
 
 void removeResource(Texture* pTexture)
 {
+	if (releaseSharedResource(pResourceLoader, pTexture))
+	{
+		return;
+	}
 	removeTexture(pResourceLoader->pRenderer, pTexture);
 }
 
+// Waits until a load of the streamed texture is processed and its upload is done
+static void waitStreamedTextureLoad(ResourceLoader* pLoader, SyncToken token)
+{
+	if (pLoader->mDesc.mSingleThreaded)
+	{
+		// Tokens only get signaled while the streamer runs
+		while (!isTokenCompleted(&token))
+		{
+			streamerThreadFunc(pLoader);
+		}
+		return;
+	}
+	waitForToken(pLoader, &token);
+}
+
+void removeResource(StreamedTexture* pStreamedTexture)
+{
+	ResourceLoader* pLoader = pResourceLoader;
+
+	pLoader->mStreamingMutex.Acquire();
+	pLoader->mStreamedTextures.erase(eastl::find(pLoader->mStreamedTextures.begin(), pLoader->mStreamedTextures.end(), pStreamedTexture));
+	pLoader->mStreamingMutex.Release();
+
+	if (pStreamedTexture->mPendingToken && !cancelRequest(pLoader, &pStreamedTexture->mPendingToken))
+	{
+		waitStreamedTextureLoad(pLoader, pStreamedTexture->mPendingToken);
+	}
+
+	if (pStreamedTexture->pPendingTexture)
+		removeTexture(pLoader->pRenderer, pStreamedTexture->pPendingTexture);
+	if (pStreamedTexture->pTexture)
+		removeTexture(pLoader->pRenderer, pStreamedTexture->pTexture);
+
+	tf_free(pStreamedTexture->pFileName);
+	tf_free(pStreamedTexture);
+}
+
 void removeResource(Geometry* pGeom)
 {
+	if (releaseSharedResource(pResourceLoader, pGeom))
+	{
+		return;
+	}
+
 	removeResource(pGeom->pIndexBuffer);
 
 	for (uint32_t i = 0; i < pGeom->mVertexBufferCount; ++i)
 		removeResource(pGeom->pVertexBuffers[i]);
 
+	tf_free(pGeom->pMeshlets);
 	tf_free(pGeom);
 }
 
@@ -2160,26 +5561,11 @@ void beginUpdateResource(BufferUpdateDesc* pBufferUpdate)
 	}
 }
 
-void endUpdateResource(BufferUpdateDesc* pBufferUpdate, SyncToken* token)
+void endUpdateResource(BufferUpdateDesc* pBufferUpdate, SyncToken* token, ResourceLoadCallback pCallback, void* pUserData)
 {
-	if (pBufferUpdate->mInternal.mMappedRange.mFlags & MAPPED_RANGE_FLAG_UNMAP_BUFFER)
-	{
-		unmapBuffer(pResourceLoader->pRenderer, pBufferUpdate->pBuffer);
-	}
-
-	ResourceMemoryUsage memoryUsage = (ResourceMemoryUsage)pBufferUpdate->pBuffer->mMemoryUsage;
-	if (!UMA && memoryUsage == RESOURCE_MEMORY_USAGE_GPU_ONLY)
-	{
-		queueBufferUpdate(pResourceLoader, pBufferUpdate, token);
-	}
-
-	// Restore the state to before the beginUpdateResource call.
-	pBufferUpdate->pMappedData = NULL;
-	pBufferUpdate->mInternal = {};
-	if (pResourceLoader->mDesc.mSingleThreaded)
-	{
-		streamerThreadFunc(pResourceLoader);
-	}
+	SyncToken callToken = 0;
+	endBufferUpdate(pBufferUpdate, NULL, &callToken);
+	onRequestQueued(pResourceLoader, callToken, token, pCallback, pUserData);
 }
 
 void beginUpdateResource(TextureUpdateDesc* pTextureUpdate)
@@ -2211,8 +5597,10 @@ void beginUpdateResource(TextureUpdateDesc* pTextureUpdate)
 	pTextureUpdate->pMappedData = pTextureUpdate->mInternal.mMappedRange.pData;
 }
 
-void endUpdateResource(TextureUpdateDesc* pTextureUpdate, SyncToken* token)
+void endUpdateResource(TextureUpdateDesc* pTextureUpdate, SyncToken* token, ResourceLoadCallback pCallback, void* pUserData)
 {
+	SyncToken callToken = 0;
+
 	TextureUpdateDescInternal desc = {};
 	desc.pTexture = pTextureUpdate->pTexture;
 	desc.mRange = pTextureUpdate->mInternal.mMappedRange;
@@ -2220,56 +5608,388 @@ void endUpdateResource(TextureUpdateDesc* pTextureUpdate, SyncToken* token)
 	desc.mMipLevels = 1;
 	desc.mBaseArrayLayer = pTextureUpdate->mArrayLayer;
 	desc.mLayerCount = 1;
-	queueTextureUpdate(pResourceLoader, &desc, token);
+	queueTextureUpdate(pResourceLoader, &desc, &callToken);
 
 	// Restore the state to before the beginUpdateResource call.
 	pTextureUpdate->pMappedData = NULL;
 	pTextureUpdate->mInternal = {};
 	if (pResourceLoader->mDesc.mSingleThreaded)
 	{
-		streamerThreadFunc(pResourceLoader);
+		streamerThreadFunc(pResourceLoader);
+	}
+
+	onRequestQueued(pResourceLoader, callToken, token, pCallback, pUserData);
+}
+
+SyncToken getLastTokenCompleted()
+{
+	return tfrg_atomic64_load_acquire(&pResourceLoader->mTokenCompleted);
+}
+
+bool isTokenCompleted(const SyncToken* token)
+{
+	return *token <= tfrg_atomic64_load_acquire(&pResourceLoader->mTokenCompleted);
+}
+
+void waitForToken(const SyncToken* token)
+{
+	waitForToken(pResourceLoader, token);
+}
+
+bool setResourceLoadPriority(const SyncToken* token, uint32_t priority)
+{
+	return setRequestPriority(pResourceLoader, token, priority);
+}
+
+bool cancelResourceLoad(const SyncToken* token)
+{
+	return cancelRequest(pResourceLoader, token);
+}
+
+bool allResourceLoadsCompleted()
+{
+	SyncToken token = tfrg_atomic64_load_relaxed(&pResourceLoader->mTokenCounter);
+	return token <= tfrg_atomic64_load_acquire(&pResourceLoader->mTokenCompleted);
+}
+
+void waitForAllResourceLoads()
+{
+	SyncToken token = tfrg_atomic64_load_relaxed(&pResourceLoader->mTokenCounter);
+	waitForToken(pResourceLoader, &token);
+}
+
+bool isResourceLoaderSingleThreaded()
+{
+	ASSERT(pResourceLoader);
+	return pResourceLoader->mDesc.mSingleThreaded;
+}
+
+Semaphore* getLastSemaphoreCompleted(uint32_t nodeIndex)
+{
+	pResourceLoader->mSemaphoreMutex.Acquire();
+	Semaphore* sem = pResourceLoader->pCopyEngines[nodeIndex].pLastCompletedSemaphore;
+	pResourceLoader->mSemaphoreMutex.Release();
+	return sem;
+}
+
+void getResourceLoaderStagingStats(ResourceLoaderStagingStats* pOutStats)
+{
+	ASSERT(pOutStats);
+	// Staging memory is always allocated from the copy engine of GPU 0
+	CopyEngine* pCopyEngine = &pResourceLoader->pCopyEngines[0];
+	StagingCounters* pCounters = &pCopyEngine->mCounters;
+	pOutStats->mRingSize = pCopyEngine->mRingSize;
+	pOutStats->mRingUsed = tfrg_atomic64_load_relaxed(&pCounters->mRingUsed);
+	pOutStats->mRingPeakUsed = tfrg_atomic64_load_relaxed(&pCounters->mRingPeakUsed);
+	pOutStats->mStagedBytes = tfrg_atomic64_load_relaxed(&pCounters->mStagedBytes);
+	pOutStats->mTempBufferBytes = tfrg_atomic64_load_relaxed(&pCounters->mTempBufferBytes);
+	pOutStats->mTempBufferCount = tfrg_atomic64_load_relaxed(&pCounters->mTempBufferCount);
+	pOutStats->mStallCount = tfrg_atomic64_load_relaxed(&pCounters->mStallCount);
+	pOutStats->mStallTimeUs = tfrg_atomic64_load_relaxed(&pCounters->mStallTimeUs);
+}
+
+void getResourceLoaderThroughputStats(ResourceLoaderThroughputStats* pOutStats)
+{
+	ASSERT(pOutStats);
+	pResourceLoader->mStatsMutex.Acquire();
+	*pOutStats = pResourceLoader->mStats;
+	// Decays while nothing is uploaded instead of keeping the rate of the last busy window
+	int64_t windowUs = getUSec() - pResourceLoader->mWindowStartUs;
+	if (windowUs >= 1000000)
+	{
+		pOutStats->mBytesPerSecond = pResourceLoader->mWindowBytes * 1000000 / (uint64_t)windowUs;
+	}
+	pResourceLoader->mStatsMutex.Release();
+	pOutStats->mQueueDepth = tfrg_atomic32_load_relaxed(&pResourceLoader->mQueueDepth);
+	pOutStats->mPeakQueueDepth = tfrg_atomic32_load_relaxed(&pResourceLoader->mPeakQueueDepth);
+}
+
+static uint64_t getLoadRecordTime(const LoadRecord& record)
+{
+	uint64_t total = 0;
+	for (uint32_t stage = 0; stage < RESOURCE_LOAD_STAGE_COUNT; ++stage)
+	{
+		total += record.mStageTimeUs[stage];
+	}
+	return total;
+}
+
+static void appendJsonString(eastl::string& output, const char* pString)
+{
+	output.push_back('"');
+	for (const char* c = pString; *c; ++c)
+	{
+		if ('"' == *c || '\\' == *c)
+		{
+			output.push_back('\\');
+		}
+		output.push_back(*c);
+	}
+	output.push_back('"');
+}
+
+bool saveResourceLoadReport(const char* pFileName)
+{
+	ASSERT(pResourceLoader);
+	ASSERT(pFileName);
+	if (!pResourceLoader->mDesc.mRecordLoadReport)
+	{
+		LOGF(eWARNING, "Resource load report %s needs ResourceLoaderDesc::mRecordLoadReport", pFileName);
+		return false;
+	}
+
+	pResourceLoader->mStatsMutex.Acquire();
+	eastl::vector<LoadRecord> records = pResourceLoader->mLoadReport;
+	pResourceLoader->mStatsMutex.Release();
+
+	eastl::sort(records.begin(), records.end(), [](const LoadRecord& lhs, const LoadRecord& rhs)
+	{
+		return getLoadRecordTime(lhs) > getLoadRecordTime(rhs);
+	});
+
+	char extension[FS_MAX_PATH] = {};
+	fsGetPathExtension(pFileName, extension);
+	const bool json = !stricmp(extension, "json");
+
+	eastl::string output;
+	if (json)
+	{
+		output.append("[\n");
+	}
+	else
+	{
+		output.append("Name,Type");
+		for (uint32_t stage = 0; stage < RESOURCE_LOAD_STAGE_COUNT; ++stage)
+		{
+			output.append_sprintf(",%sUs", gResourceLoadStageNames[stage]);
+		}
+		output.append(",TotalUs,Bytes\n");
+	}
+
+	for (uint32_t i = 0; i < (uint32_t)records.size(); ++i)
+	{
+		const LoadRecord& record = records[i];
+		const char* pType = UPDATE_REQUEST_LOAD_TEXTURE == record.mType ? "Texture" : "Geometry";
+		if (json)
+		{
+			output.append("\t{ \"Name\": ");
+			appendJsonString(output, record.mName.c_str());
+			output.append_sprintf(", \"Type\": \"%s\"", pType);
+			for (uint32_t stage = 0; stage < RESOURCE_LOAD_STAGE_COUNT; ++stage)
+			{
+				output.append_sprintf(", \"%sUs\": %llu", gResourceLoadStageNames[stage], (unsigned long long)record.mStageTimeUs[stage]);
+			}
+			output.append_sprintf(", \"TotalUs\": %llu, \"Bytes\": %llu }%s\n", (unsigned long long)getLoadRecordTime(record),
+				(unsigned long long)record.mBytes, i + 1 < (uint32_t)records.size() ? "," : "");
+		}
+		else
+		{
+			output.append_sprintf("\"%s\",%s", record.mName.c_str(), pType);
+			for (uint32_t stage = 0; stage < RESOURCE_LOAD_STAGE_COUNT; ++stage)
+			{
+				output.append_sprintf(",%llu", (unsigned long long)record.mStageTimeUs[stage]);
+			}
+			output.append_sprintf(",%llu,%llu\n", (unsigned long long)getLoadRecordTime(record), (unsigned long long)record.mBytes);
+		}
+	}
+	if (json)
+	{
+		output.append("]\n");
 	}
-}
 
-SyncToken getLastTokenCompleted()
-{
-	return tfrg_atomic64_load_acquire(&pResourceLoader->mTokenCompleted);
+	FileStream stream = {};
+	if (!fsOpenStreamFromPath(RD_LOG, pFileName, FM_WRITE, &stream))
+	{
+		LOGF(eERROR, "Failed to open resource load report %s for writing", pFileName);
+		return false;
+	}
+	fsWriteToStream(&stream, output.c_str(), output.size());
+	fsCloseStream(&stream);
+	LOGF(eINFO, "Saved the timings of %u resource loads to %s", (uint32_t)records.size(), pFileName);
+	return true;
 }
 
-bool isTokenCompleted(const SyncToken* token)
+static bool isStreamedTextureReady(StreamedTexture* pStreamed)
 {
-	return *token <= tfrg_atomic64_load_acquire(&pResourceLoader->mTokenCompleted);
+	return STREAMED_TEXTURE_STATE_READY == tfrg_atomic32_load_acquire(&pStreamed->mState);
 }
 
-void waitForToken(const SyncToken* token)
+// Reloads the streamed texture with mipLevels mips. There is no texture to texture copy, so the resident mips are read from the file again
+static void queueStreamedTextureMips(ResourceLoader* pLoader, StreamedTexture* pStreamed, uint32_t mipLevels)
 {
-	waitForToken(pResourceLoader, token);
+	pStreamed->mPendingMipLevels = mipLevels;
+	pStreamed->mPendingToken = 0;
+	queueStreamedTextureLoad(pLoader, pStreamed, mipLevels, NULL, &pStreamed->mPendingToken);
 }
 
-bool allResourceLoadsCompleted()
+// Evicts textures below priority down to their mip tail until size bytes are freed. Returns the freed size. Caller holds mStreamingMutex
+static uint64_t evictStreamedTextures(ResourceLoader* pLoader, uint32_t priority, uint64_t size)
 {
-	SyncToken token = tfrg_atomic64_load_relaxed(&pResourceLoader->mTokenCounter);
-	return token <= tfrg_atomic64_load_acquire(&pResourceLoader->mTokenCompleted);
-}
+	eastl::vector<StreamedTexture*> evictable;
+	for (StreamedTexture* pStreamed : pLoader->mStreamedTextures)
+	{
+		if (pStreamed->mPriority < priority && isStreamedTextureReady(pStreamed) && !pStreamed->mPendingToken &&
+			pStreamed->mResidentMipLevels > pStreamed->mTailMipLevels)
+		{
+			evictable.push_back(pStreamed);
+		}
+	}
+	eastl::sort(evictable.begin(), evictable.end(), [](const StreamedTexture* a, const StreamedTexture* b) { return a->mPriority < b->mPriority; });
 
-void waitForAllResourceLoads()
-{
-	SyncToken token = tfrg_atomic64_load_relaxed(&pResourceLoader->mTokenCounter);
-	waitForToken(pResourceLoader, &token);
+	uint64_t freed = 0;
+	for (uint32_t i = 0; i < (uint32_t)evictable.size() && freed < size; ++i)
+	{
+		StreamedTexture* pStreamed = evictable[i];
+		freed += util_get_streamed_texture_size(pStreamed, pStreamed->mResidentMipLevels) - util_get_streamed_texture_size(pStreamed, pStreamed->mTailMipLevels);
+		queueStreamedTextureMips(pLoader, pStreamed, pStreamed->mTailMipLevels);
+	}
+	return freed;
 }
 
-bool isResourceLoaderSingleThreaded()
+uint32_t updateTextureStreaming()
 {
-	ASSERT(pResourceLoader);
-	return pResourceLoader->mDesc.mSingleThreaded;
+	ResourceLoader* pLoader = pResourceLoader;
+	Renderer* pRenderer = pLoader->pRenderer;
+
+	if (pLoader->mDesc.mSingleThreaded)
+	{
+		// Signals the tokens of finished uploads
+		streamerThreadFunc(pLoader);
+	}
+
+	// The GPU may still be reading replaced textures for the frames in flight
+	++pLoader->mStreamingFrame;
+	for (uint32_t i = 0; i < (uint32_t)pLoader->mRetiredTextures.size();)
+	{
+		RetiredTexture& retired = pLoader->mRetiredTextures[i];
+		if (pLoader->mStreamingFrame - retired.mFrame < MAX_FRAMES)
+		{
+			++i;
+			continue;
+		}
+		removeTexture(pRenderer, retired.pTexture);
+		retired = pLoader->mRetiredTextures.back();
+		pLoader->mRetiredTextures.pop_back();
+	}
+
+	uint32_t changedCount = 0;
+	uint32_t queuedCount = 0;
+	uint64_t committedSize = 0;
+	eastl::vector<StreamedTexture*>& candidates = pLoader->mStreamingCandidates;
+	candidates.clear();
+
+	pLoader->mStreamingMutex.Acquire();
+
+	for (StreamedTexture* pStreamed : pLoader->mStreamedTextures)
+	{
+		if (!isStreamedTextureReady(pStreamed))
+		{
+			continue;
+		}
+
+		if (pStreamed->mPendingToken)
+		{
+			if (!isTokenCompleted(&pStreamed->mPendingToken))
+			{
+				committedSize += util_get_streamed_texture_size(pStreamed, pStreamed->mPendingMipLevels);
+				continue;
+			}
+
+			pStreamed->mPendingToken = 0;
+			if (pStreamed->pPendingTexture)
+			{
+				RetiredTexture retired = { pStreamed->pTexture, pLoader->mStreamingFrame };
+				pLoader->mRetiredTextures.push_back(retired);
+				pStreamed->pTexture = pStreamed->pPendingTexture;
+				pStreamed->pPendingTexture = NULL;
+				pStreamed->mResidentMipLevels = pStreamed->mPendingMipLevels;
+				++pStreamed->mVersion;
+				++changedCount;
+			}
+			else
+			{
+				// Reading the file failed. Stay at the current mips instead of retrying every frame
+				pStreamed->mRequestedMipLevels = pStreamed->mResidentMipLevels;
+			}
+		}
+
+		uint32_t requestedMipLevels = util_get_streamable_mip_levels(pStreamed, pStreamed->mRequestedMipLevels);
+		if (requestedMipLevels < pStreamed->mResidentMipLevels)
+		{
+			queueStreamedTextureMips(pLoader, pStreamed, requestedMipLevels);
+			committedSize += util_get_streamed_texture_size(pStreamed, requestedMipLevels);
+			++queuedCount;
+			continue;
+		}
+
+		committedSize += util_get_streamed_texture_size(pStreamed, pStreamed->mResidentMipLevels);
+		if (requestedMipLevels > pStreamed->mResidentMipLevels)
+		{
+			candidates.push_back(pStreamed);
+		}
+	}
+
+	// One mip per request so textures sharpen progressively. Higher priorities go first and get the budget
+	eastl::sort(candidates.begin(), candidates.end(), [](const StreamedTexture* a, const StreamedTexture* b) { return a->mPriority > b->mPriority; });
+
+	const uint64_t budget = pLoader->mDesc.mStreamingBudget;
+	for (StreamedTexture* pStreamed : candidates)
+	{
+		// Evicted by a higher priority texture in this loop
+		if (pStreamed->mPendingToken)
+		{
+			continue;
+		}
+
+		uint32_t mipLevels = util_get_streamable_mip_levels(pStreamed, pStreamed->mResidentMipLevels + 1);
+		uint64_t growth = util_get_streamed_texture_size(pStreamed, mipLevels) - util_get_streamed_texture_size(pStreamed, pStreamed->mResidentMipLevels);
+		if (budget && committedSize + growth > budget)
+		{
+			committedSize -= evictStreamedTextures(pLoader, pStreamed->mPriority, committedSize + growth - budget);
+			if (committedSize + growth > budget)
+			{
+				continue;
+			}
+		}
+
+		queueStreamedTextureMips(pLoader, pStreamed, mipLevels);
+		committedSize += growth;
+		++queuedCount;
+	}
+
+	pLoader->mStreamingMutex.Release();
+
+	if (queuedCount && pLoader->mDesc.mSingleThreaded)
+	{
+		streamerThreadFunc(pLoader);
+	}
+
+	return changedCount;
 }
 
-Semaphore* getLastSemaphoreCompleted(uint32_t nodeIndex)
+void getTextureStreamingStats(ResourceLoaderStreamingStats* pOutStats)
 {
-	pResourceLoader->mSemaphoreMutex.Acquire();
-	Semaphore* sem = pResourceLoader->pCopyEngines[nodeIndex].pLastCompletedSemaphore;
-	pResourceLoader->mSemaphoreMutex.Release();
-	return sem;
+	ASSERT(pOutStats);
+	*pOutStats = {};
+	pOutStats->mBudget = pResourceLoader->mDesc.mStreamingBudget;
+
+	pResourceLoader->mStreamingMutex.Acquire();
+	for (StreamedTexture* pStreamed : pResourceLoader->mStreamedTextures)
+	{
+		++pOutStats->mTextureCount;
+		if (!isStreamedTextureReady(pStreamed))
+		{
+			continue;
+		}
+		uint32_t mipLevels = pStreamed->mResidentMipLevels;
+		if (pStreamed->mPendingToken)
+		{
+			++pOutStats->mPendingCount;
+			mipLevels = pStreamed->mPendingMipLevels;
+		}
+		pOutStats->mResidentSize += util_get_streamed_texture_size(pStreamed, mipLevels);
+	}
+	pResourceLoader->mStreamingMutex.Release();
 }
 
 /************************************************************************/
@@ -2616,7 +6336,10 @@ static eastl::string fsReadFromStreamSTLLine(FileStream* stream)
 
 // Function to generate the timestamp of this shader source file considering all include file timestamp
 #if !defined(NX64)
-static bool process_source_file(const char* pAppName, FileStream* original, const char* filePath, FileStream* file, time_t& outTimeStamp, eastl::string& outCode)
+// outSourceHash covers the contents of the source and every file it includes
+static bool process_source_file(
+	const char* pAppName, FileStream* original, const char* filePath, FileStream* file, time_t& outTimeStamp, uint64_t& outSourceHash,
+	eastl::string& outCode)
 {
 	// If the source if a non-packaged file, store the timestamp
 	if (file)
@@ -2635,6 +6358,7 @@ static bool process_source_file(const char* pAppName, FileStream* original, cons
 	while (!fsStreamAtEnd(file))
 	{
 		eastl::string line = fsReadFromStreamSTLLine(file);
+		outSourceHash = hashData(line.c_str(), line.size() + 1, outSourceHash);
 
 		size_t        filePos = line.find(pIncludeDirective, 0);
 		const size_t  commentPosCpp = line.find("//", 0);
@@ -2687,43 +6411,390 @@ static bool process_source_file(const char* pAppName, FileStream* original, cons
 				continue;
 			}
 
-			// Add the include file into the current code recursively
-			if (!process_source_file(pAppName, original, includePath, &fHandle, outTimeStamp, outCode))
-			{
-				fsCloseStream(&fHandle);
-				return false;
-			}
+			// Add the include file into the current code recursively
+			if (!process_source_file(pAppName, original, includePath, &fHandle, outTimeStamp, outSourceHash, outCode))
+			{
+				fsCloseStream(&fHandle);
+				return false;
+			}
+
+			fsCloseStream(&fHandle);
+		}
+
+#if defined(TARGET_IOS) || defined(ANDROID)
+		// iOS doesn't have support for resolving user header includes in shader code
+		// when compiling with shader source using Metal runtime.
+		// https://developer.apple.com/library/archive/documentation/3DDrawing/Conceptual/MTLBestPracticesGuide/FunctionsandLibraries.html
+		//
+		// Here we write out the contents of the header include into the original source
+		// where its included from -- we're expanding the headers as the pre-processor
+		// would do.
+		//
+		//const bool bAreWeProcessingAnIncludedHeader = file != original;
+		if (!bLineHasIncludeDirective)
+		{
+			outCode += line + "\n";
+		}
+#else
+		// Simply write out the current line if we are not in a header file
+		const bool bAreWeProcessingTheShaderSource = file == original;
+		if (bAreWeProcessingTheShaderSource)
+		{
+			outCode += line + "\n";
+		}
+#endif
+	}
+
+	return true;
+}
+#endif
+
+/************************************************************************/
+// Shader Binary Cache
+/************************************************************************/
+// Byte code of every compiled shader stage lives in one file in RD_SHADER_BINARIES. It is append only:
+// [ShaderCacheRecord][byte code padded to SHADER_CACHE_ALIGNMENT] ...
+// Appends are a single atomic write. Records superseded by a newer one for the same key stay in the file until
+// their size passes SHADER_CACHE_COMPACT_THRESHOLD and the file gets rebuilt
+#define SHADER_CACHE_FILE_NAME "ShaderCache.bin"
+#define SHADER_CACHE_MAGIC 0x42534654u // "TFSB"
+#define SHADER_CACHE_VERSION 1u
+#define SHADER_CACHE_ALIGNMENT 16u
+#define SHADER_CACHE_COMPACT_THRESHOLD (16ull << 20)
+
+typedef struct ShaderCacheRecord
+{
+	uint32_t mMagic;
+	uint32_t mByteCodeSize;
+	/// Hash of the preprocessed sources, macros, target and entry point. See getShaderCacheKey
+	uint64_t mKey;
+	uint64_t mChecksum;
+	uint64_t mPadding;
+} ShaderCacheRecord;
+
+typedef struct ShaderCacheEntry
+{
+	uint64_t mOffset;
+	uint32_t mByteCodeSize;
+} ShaderCacheEntry;
+
+typedef struct ShaderCache
+{
+	Mutex                                       mMutex;
+	/// Mapped while lookups run. Closed around appends since not every platform can write to a mapped file
+	FileStream                                  mMapping;
+	/// File size covered by mIndex. Appends of other processes past it are picked up by the next mapping
+	uint64_t                                    mScannedSize;
+	/// Bytes of superseded records and damaged ranges below mScannedSize
+	uint64_t                                    mStaleSize;
+	eastl::hash_map<uint64_t, ShaderCacheEntry> mIndex;
+} ShaderCache;
+
+static ShaderCache* pShaderCache = NULL;
+
+static void initShaderCache()
+{
+	pShaderCache = tf_new(ShaderCache);
+	pShaderCache->mMutex.Init();
+	pShaderCache->mMapping = {};
+	pShaderCache->mScannedSize = 0;
+	pShaderCache->mStaleSize = 0;
+}
+
+static void unmapShaderCache(ShaderCache* pCache)
+{
+	if (pCache->mMapping.pIO)
+	{
+		fsCloseStream(&pCache->mMapping);
+		pCache->mMapping = {};
+	}
+}
+
+static void exitShaderCache()
+{
+	unmapShaderCache(pShaderCache);
+	pShaderCache->mMutex.Destroy();
+	tf_delete(pShaderCache);
+	pShaderCache = NULL;
+}
+
+static uint64_t getShaderCacheRecordSize(uint32_t byteCodeSize)
+{
+	return sizeof(ShaderCacheRecord) + (((uint64_t)byteCodeSize + SHADER_CACHE_ALIGNMENT - 1) & ~(uint64_t)(SHADER_CACHE_ALIGNMENT - 1));
+}
+
+// Returns the size of the complete and intact record at offset, 0 if there is none
+static uint64_t getShaderCacheRecordSizeAt(const uint8_t* pData, uint64_t size, uint64_t offset)
+{
+	if (offset > size || size - offset < sizeof(ShaderCacheRecord))
+	{
+		return 0;
+	}
+
+	// Offsets past damaged ranges are not aligned
+	ShaderCacheRecord record;
+	memcpy(&record, pData + offset, sizeof(record));
+	if (SHADER_CACHE_MAGIC != record.mMagic || record.mByteCodeSize > size - offset - sizeof(ShaderCacheRecord))
+	{
+		return 0;
+	}
+
+	const uint64_t recordSize = getShaderCacheRecordSize(record.mByteCodeSize);
+	if (recordSize > size - offset || record.mChecksum != hashData(pData + offset + sizeof(ShaderCacheRecord), record.mByteCodeSize, record.mKey))
+	{
+		return 0;
+	}
+	return recordSize;
+}
+
+static void resetShaderCacheIndex(ShaderCache* pCache)
+{
+	pCache->mIndex.clear();
+	pCache->mScannedSize = 0;
+	pCache->mStaleSize = 0;
+}
+
+// Indexes the records appended since the last scan
+static void scanShaderCache(ShaderCache* pCache)
+{
+	const uint8_t* pData = pCache->mMapping.mMemory.pBuffer;
+	const uint64_t size = (uint64_t)pCache->mMapping.mSize;
+	uint64_t offset = pCache->mScannedSize;
+	while (offset < size)
+	{
+		uint64_t recordSize = getShaderCacheRecordSizeAt(pData, size, offset);
+		if (!recordSize)
+		{
+			// A write cut short by a crash is followed by the intact appends of later runs. Without one after it this is a tail
+			// another process is still writing, it is left for the next scan
+			uint64_t next = offset + 1;
+			while (next < size && !(recordSize = getShaderCacheRecordSizeAt(pData, size, next)))
+			{
+				++next;
+			}
+			if (!recordSize)
+			{
+				break;
+			}
+			pCache->mStaleSize += next - offset;
+			offset = next;
+		}
+
+		ShaderCacheRecord record;
+		memcpy(&record, pData + offset, sizeof(record));
+		ShaderCacheEntry& entry = pCache->mIndex[record.mKey];
+		if (entry.mByteCodeSize)
+		{
+			pCache->mStaleSize += getShaderCacheRecordSize(entry.mByteCodeSize);
+		}
+		entry.mOffset = offset + sizeof(ShaderCacheRecord);
+		entry.mByteCodeSize = record.mByteCodeSize;
+		offset += recordSize;
+	}
+	pCache->mScannedSize = offset;
+}
+
+static bool compareShaderCacheEntryOffset(const ShaderCacheEntry* pLhs, const ShaderCacheEntry* pRhs)
+{
+	return pLhs->mOffset < pRhs->mOffset;
+}
+
+// Rewrites the cache file with only the live records. The file is left alone if another process appended to it since it was mapped,
+// an append racing with the rename itself is lost and gets compiled again
+static void compactShaderCache(ShaderCache* pCache)
+{
+	LOGF(eINFO, "Rebuilding shader cache %s to drop %llu stale bytes", SHADER_CACHE_FILE_NAME, (unsigned long long)pCache->mStaleSize);
+
+	const uint8_t* pData = pCache->mMapping.mMemory.pBuffer;
+	eastl::vector<ShaderCacheEntry*> entries;
+	entries.reserve(pCache->mIndex.size());
+	for (eastl::hash_map<uint64_t, ShaderCacheEntry>::iterator it = pCache->mIndex.begin(); it != pCache->mIndex.end(); ++it)
+	{
+		// Entries indexed before another process rebuilt the file point at other records
+		const uint64_t recordSize = getShaderCacheRecordSize(it->second.mByteCodeSize);
+		if (getShaderCacheRecordSizeAt(pData, (uint64_t)pCache->mMapping.mSize, it->second.mOffset - sizeof(ShaderCacheRecord)) != recordSize)
+		{
+			resetShaderCacheIndex(pCache);
+			scanShaderCache(pCache);
+			return;
+		}
+		entries.push_back(&it->second);
+	}
+	eastl::sort(entries.begin(), entries.end(), compareShaderCacheEntryOffset);
+
+	const char* tempName = SHADER_CACHE_FILE_NAME ".tmp";
+	eastl::vector<uint64_t> offsets(entries.size());
+	uint64_t compactSize = 0;
+	FileStream temp = {};
+	bool success = fsOpenStreamFromPath(RD_SHADER_BINARIES, tempName, FM_WRITE_BINARY, &temp);
+	if (success)
+	{
+		for (uint32_t i = 0; success && i < (uint32_t)entries.size(); ++i)
+		{
+			const uint64_t recordSize = getShaderCacheRecordSize(entries[i]->mByteCodeSize);
+			success = fsWriteToStream(&temp, pData + entries[i]->mOffset - sizeof(ShaderCacheRecord), recordSize) == recordSize;
+			offsets[i] = compactSize + sizeof(ShaderCacheRecord);
+			compactSize += recordSize;
+		}
+		fsCloseStream(&temp);
+	}
+
+	FileStream current = {};
+	if (success && fsOpenStreamFromPath(RD_SHADER_BINARIES, SHADER_CACHE_FILE_NAME, FM_READ_BINARY, &current))
+	{
+		success = fsGetStreamFileSize(&current) == pCache->mMapping.mSize;
+		fsCloseStream(&current);
+	}
+	else
+	{
+		success = false;
+	}
+
+	unmapShaderCache(pCache);
+	if (success && fsRenameFile(RD_SHADER_BINARIES, tempName, SHADER_CACHE_FILE_NAME))
+	{
+		for (uint32_t i = 0; i < (uint32_t)entries.size(); ++i)
+		{
+			entries[i]->mOffset = offsets[i];
+		}
+		pCache->mScannedSize = compactSize;
+	}
+	else
+	{
+		fsRemoveFile(RD_SHADER_BINARIES, tempName);
+	}
+	// Not retried before the next run when the rebuild lost a race
+	pCache->mStaleSize = 0;
+
+	if (!fsOpenMappedStreamFromPath(RD_SHADER_BINARIES, SHADER_CACHE_FILE_NAME, &pCache->mMapping))
+	{
+		pCache->mMapping = {};
+		return;
+	}
+	scanShaderCache(pCache);
+}
+
+// Maps the cache file and indexes records added since the last scan. Caller must hold mMutex
+static bool mapShaderCache(ShaderCache* pCache)
+{
+	if (pCache->mMapping.pIO)
+	{
+		return true;
+	}
+	if (!fsOpenMappedStreamFromPath(RD_SHADER_BINARIES, SHADER_CACHE_FILE_NAME, &pCache->mMapping))
+	{
+		pCache->mMapping = {};
+		return false;
+	}
+
+	// Shrunk, another process rebuilt it
+	if ((uint64_t)pCache->mMapping.mSize < pCache->mScannedSize)
+	{
+		resetShaderCacheIndex(pCache);
+	}
+	scanShaderCache(pCache);
+	// Not while a tail is still being written
+	if (pCache->mStaleSize > SHADER_CACHE_COMPACT_THRESHOLD && pCache->mScannedSize == (uint64_t)pCache->mMapping.mSize)
+	{
+		compactShaderCache(pCache);
+	}
+	return pCache->mMapping.pIO != NULL;
+}
+
+static uint64_t getShaderCacheKey(
+	const char* rendererApi, ShaderTarget target, ShaderStage stage, const ShaderStageLoadDesc& loadDesc, uint32_t macroCount,
+	const ShaderMacro* pMacros, uint32_t featureLevel, uint64_t sourceHash)
+{
+	eastl::string key;
+	key.sprintf(
+		"%u|%s|%u|%u|%u|%u|%s|", SHADER_CACHE_VERSION, rendererApi, (uint32_t)target, (uint32_t)stage, featureLevel,
+		(uint32_t)loadDesc.mFlags, loadDesc.pEntryPointName ? loadDesc.pEntryPointName : "");
+	for (uint32_t i = 0; i < macroCount; ++i)
+	{
+		key.append_sprintf("%s=%s;", pMacros[i].definition, pMacros[i].value);
+	}
+#ifdef _DEBUG
+	key += "_DEBUG";
+#else
+	key += "NDEBUG";
+#endif
+	return hashData(key.c_str(), key.size(), sourceHash);
+}
+
+static bool loadCachedByteCode(uint64_t key, BinaryShaderStageDesc* pOut)
+{
+	if (!pShaderCache)
+	{
+		return false;
+	}
+
+	ShaderCache* pCache = pShaderCache;
+	MutexLock lock(pCache->mMutex);
+	if (!mapShaderCache(pCache))
+	{
+		return false;
+	}
+
+	eastl::hash_map<uint64_t, ShaderCacheEntry>::const_iterator it = pCache->mIndex.find(key);
+	if (it == pCache->mIndex.end())
+	{
+		return false;
+	}
+
+	// Entries indexed before another process rebuilt the file point at other records
+	const ShaderCacheEntry& entry = it->second;
+	const uint64_t recordOffset = entry.mOffset - sizeof(ShaderCacheRecord);
+	const uint8_t* pData = pCache->mMapping.mMemory.pBuffer;
+	ShaderCacheRecord record = {};
+	if (getShaderCacheRecordSizeAt(pData, (uint64_t)pCache->mMapping.mSize, recordOffset) == getShaderCacheRecordSize(entry.mByteCodeSize))
+	{
+		memcpy(&record, pData + recordOffset, sizeof(record));
+	}
+	if (record.mKey != key || record.mByteCodeSize != entry.mByteCodeSize)
+	{
+		unmapShaderCache(pCache);
+		resetShaderCacheIndex(pCache);
+		return false;
+	}
+
+	pOut->mByteCodeSize = entry.mByteCodeSize;
+	pOut->pByteCode = tf_memalign(256, entry.mByteCodeSize);
+	memcpy(pOut->pByteCode, pCache->mMapping.mMemory.pBuffer + entry.mOffset, entry.mByteCodeSize);
+	return true;
+}
 
-			fsCloseStream(&fHandle);
-		}
+static void storeCachedByteCode(uint64_t key, const void* pByteCode, uint32_t byteCodeSize)
+{
+	if (!pShaderCache || !pByteCode || !byteCodeSize)
+	{
+		return;
+	}
 
-#if defined(TARGET_IOS) || defined(ANDROID)
-		// iOS doesn't have support for resolving user header includes in shader code
-		// when compiling with shader source using Metal runtime.
-		// https://developer.apple.com/library/archive/documentation/3DDrawing/Conceptual/MTLBestPracticesGuide/FunctionsandLibraries.html
-		//
-		// Here we write out the contents of the header include into the original source
-		// where its included from -- we're expanding the headers as the pre-processor
-		// would do.
-		//
-		//const bool bAreWeProcessingAnIncludedHeader = file != original;
-		if (!bLineHasIncludeDirective)
-		{
-			outCode += line + "\n";
-		}
-#else
-		// Simply write out the current line if we are not in a header file
-		const bool bAreWeProcessingTheShaderSource = file == original;
-		if (bAreWeProcessingTheShaderSource)
+	// Record and byte code go out in one write so concurrent appends can not interleave
+	const uint64_t recordSize = getShaderCacheRecordSize(byteCodeSize);
+	uint8_t* pRecordData = (uint8_t*)tf_calloc(1, recordSize);
+	ShaderCacheRecord* pRecord = (ShaderCacheRecord*)pRecordData;
+	pRecord->mMagic = SHADER_CACHE_MAGIC;
+	pRecord->mByteCodeSize = byteCodeSize;
+	pRecord->mKey = key;
+	pRecord->mChecksum = hashData(pByteCode, byteCodeSize, key);
+	memcpy(pRecord + 1, pByteCode, byteCodeSize);
+
+	ShaderCache* pCache = pShaderCache;
+	MutexLock lock(pCache->mMutex);
+	unmapShaderCache(pCache);
+
+	FileStream stream = {};
+	if (fsOpenStreamFromPath(RD_SHADER_BINARIES, SHADER_CACHE_FILE_NAME, FM_APPEND_BINARY, &stream))
+	{
+		if (fsWriteToStream(&stream, pRecordData, recordSize) != recordSize)
 		{
-			outCode += line + "\n";
+			LOGF(eWARNING, "Failed to append to shader cache %s", SHADER_CACHE_FILE_NAME);
 		}
-#endif
+		fsCloseStream(&stream);
 	}
-
-	return true;
+	tf_free(pRecordData);
 }
-#endif
 
 // Loads the bytecode from file if the binary shader file is newer than the source
 bool check_for_byte_code(Renderer* pRenderer, const char* binaryShaderPath, time_t sourceTimeStamp, BinaryShaderStageDesc* pOut)
@@ -2761,52 +6832,75 @@ bool check_for_byte_code(Renderer* pRenderer, const char* binaryShaderPath, time
 	return true;
 }
 
-// Saves bytecode to a file
-bool save_byte_code(const char* binaryShaderPath, char* byteCode, uint32_t byteCodeSize)
-{
-	if (!byteCodeSize)
-		return false;
-
-	FileStream fh = {};
-
-	if (!fsOpenStreamFromPath(RD_SHADER_BINARIES, binaryShaderPath, FM_WRITE_BINARY, &fh))
-		return false;
-
-	fsWriteToStream(&fh, byteCode, byteCodeSize);
-	fsCloseStream(&fh);
-
-	return true;
-}
-
-bool load_shader_stage_byte_code(
-	Renderer* pRenderer, ShaderTarget target, ShaderStage stage, ShaderStage allStages, const ShaderStageLoadDesc& loadDesc, uint32_t macroCount,
-	ShaderMacro* pMacros, BinaryShaderStageDesc* pOut)
+static const char* getShaderRendererApiName()
 {
-	eastl::string rendererApi;
 	switch (gSelectedRendererApi)
 	{
 #if defined(DIRECT3D12)
-	case RENDERER_API_D3D12:
-		rendererApi = "DIRECT3D12"; break;
+	case RENDERER_API_D3D12: return "DIRECT3D12";
 #endif
 #if defined(DIRECT3D11)
-	case RENDERER_API_D3D11: rendererApi = "DIRECT3D11"; break;
+	case RENDERER_API_D3D11: return "DIRECT3D11";
 #endif
 #if defined(VULKAN)
-	case RENDERER_API_VULKAN: rendererApi = "VULKAN"; break;
+	case RENDERER_API_VULKAN: return "VULKAN";
 #endif
 #if defined(METAL)
-	case RENDERER_API_METAL: rendererApi = "Metal"; break;
+	case RENDERER_API_METAL: return "Metal";
 #endif
 #if defined(GLES)
-	case RENDERER_API_GLES: rendererApi = "GLES"; break;
+	case RENDERER_API_GLES: return "GLES";
 #endif
-	default: break;
+	default: return "";
+	}
+}
+
+// Name of the per stage binary in RD_SHADER_BINARIES. The external compilers write their output there,
+// and ORBIS / PROSPERO keep their compiled byte code under it
+static eastl::string getShaderBinaryName(
+	Renderer* pRenderer, ShaderTarget target, const ShaderStageLoadDesc& loadDesc, uint32_t macroCount, const ShaderMacro* pMacros)
+{
+	// Only the D3D11 feature level goes into the name
+	UNREF_PARAM(pRenderer);
+
+	eastl::string shaderDefines;
+	// Apply user specified macros
+	for (uint32_t i = 0; i < macroCount; ++i)
+	{
+		shaderDefines += (eastl::string(pMacros[i].definition) + pMacros[i].value);
 	}
+#ifdef _DEBUG
+	shaderDefines += "_DEBUG";
+#else
+	shaderDefines += "NDEBUG";
+#endif
+
+	char extension[FS_MAX_PATH] = { 0 };
+	fsGetPathExtension(loadDesc.pFileName, extension);
+	char fileName[FS_MAX_PATH] = { 0 };
+	fsGetPathFileName(loadDesc.pFileName, fileName);
+
+	eastl::string binaryShaderComponent = eastl::string(getShaderRendererApiName()) + "_" + fileName +
+		eastl::string().sprintf("_%zu", eastl::string_hash<eastl::string>()(shaderDefines)) + extension +
+		eastl::string().sprintf("%u", target);
+#ifdef DIRECT3D11
+	if (gSelectedRendererApi == RENDERER_API_D3D11)
+		binaryShaderComponent += eastl::string().sprintf("%u", pRenderer->mD3D11.mFeatureLevel);
+#endif
+	binaryShaderComponent += ".bin";
+	return binaryShaderComponent;
+}
+
+bool load_shader_stage_byte_code(
+	Renderer* pRenderer, ShaderTarget target, ShaderStage stage, ShaderStage allStages, const ShaderStageLoadDesc& loadDesc, uint32_t macroCount,
+	ShaderMacro* pMacros, BinaryShaderStageDesc* pOut)
+{
+	eastl::string rendererApi = getShaderRendererApiName();
 
 	eastl::string code;
 #if !defined(NX64)
 	time_t          timeStamp = 0;
+	uint64_t        sourceHash = 0;
 #endif
 
 #if !defined(METAL) && !defined(NX64)
@@ -2815,7 +6909,7 @@ bool load_shader_stage_byte_code(
 	bool sourceExists = fsOpenStreamFromPath(RD_SHADER_SOURCES, pFileNameAPI.c_str(), FM_READ_BINARY, &sourceFileStream);
 	ASSERT(sourceExists && "No source shader present for file");
 
-	if (!process_source_file(pRenderer->pName, &sourceFileStream, pFileNameAPI.c_str(), &sourceFileStream, timeStamp, code))
+	if (!process_source_file(pRenderer->pName, &sourceFileStream, pFileNameAPI.c_str(), &sourceFileStream, timeStamp, sourceHash, code))
 	{
 		fsCloseStream(&sourceFileStream);
 		return false;
@@ -2861,7 +6955,7 @@ bool load_shader_stage_byte_code(
 	FileStream sourceFileStream = {};
 	bool sourceExists = fsOpenStreamFromPath(RD_SHADER_SOURCES, metalShaderPath, FM_READ_BINARY, &sourceFileStream);
 	ASSERT(sourceExists);
-	if (!process_source_file(pRenderer->pName, &sourceFileStream, metalShaderPath, &sourceFileStream, timeStamp, code))
+	if (!process_source_file(pRenderer->pName, &sourceFileStream, metalShaderPath, &sourceFileStream, timeStamp, sourceHash, code))
 	{
 		fsCloseStream(&sourceFileStream);
 		return false;
@@ -2869,40 +6963,21 @@ bool load_shader_stage_byte_code(
 #endif
 
 #ifndef NX64
-	eastl::string shaderDefines;
-	// Apply user specified macros
-	for (uint32_t i = 0; i < macroCount; ++i)
-	{
-		shaderDefines += (eastl::string(pMacros[i].definition) + pMacros[i].value);
-	}
-#ifdef _DEBUG
-	shaderDefines += "_DEBUG";
-#else
-	shaderDefines += "NDEBUG";
-#endif
-
-	char extension[FS_MAX_PATH] = { 0 };
-	fsGetPathExtension(loadDesc.pFileName, extension);
-	char fileName[FS_MAX_PATH] = { 0 };
-	fsGetPathFileName(loadDesc.pFileName, fileName);
-	eastl::string appName(pRenderer->pName);
+	eastl::string binaryShaderComponent = getShaderBinaryName(pRenderer, target, loadDesc, macroCount, pMacros);
 
-#ifdef __linux__
-	appName.make_lower();
-	appName = appName != pRenderer->pName ? appName : appName + "_";
-#endif
-
-	eastl::string binaryShaderComponent = rendererApi + "_" + fileName +
-		eastl::string().sprintf("_%zu", eastl::string_hash<eastl::string>()(shaderDefines)) + extension +
-		eastl::string().sprintf("%u", target);
+#if defined(ORBIS) || defined(PROSPERO)
+	// Shader source is newer than binary
+	if (!check_for_byte_code(pRenderer, binaryShaderComponent.c_str(), timeStamp, pOut))
+#else
+	uint32_t featureLevel = 0;
 #ifdef DIRECT3D11
 	if (gSelectedRendererApi == RENDERER_API_D3D11)
-		binaryShaderComponent += eastl::string().sprintf("%u", pRenderer->mD3D11.mFeatureLevel);
+		featureLevel = (uint32_t)pRenderer->mD3D11.mFeatureLevel;
+#endif
+	// Any change to the sources, includes or macros yields a new key, so hits never need a timestamp check
+	const uint64_t cacheKey = getShaderCacheKey(rendererApi.c_str(), target, stage, loadDesc, macroCount, pMacros, featureLevel, sourceHash);
+	if (!loadCachedByteCode(cacheKey, pOut))
 #endif
-		binaryShaderComponent += ".bin";
-
-	// Shader source is newer than binary
-	if (!check_for_byte_code(pRenderer, binaryShaderComponent.c_str(), timeStamp, pOut))
 	{
 		switch (gSelectedRendererApi)
 		{
@@ -2914,10 +6989,6 @@ bool load_shader_stage_byte_code(
 				macroCount, pMacros,
 				pOut, loadDesc.pEntryPointName);
 
-			if (!save_byte_code(binaryShaderComponent.c_str(), (char*)(pOut->pByteCode), pOut->mByteCodeSize))
-			{
-				LOGF(LogLevel::eWARNING, "Failed to save byte code for file %s", loadDesc.pFileName);
-			}
 			break;
 #endif
 #if defined(DIRECT3D11)
@@ -2928,20 +6999,12 @@ bool load_shader_stage_byte_code(
 				macroCount, pMacros,
 				pOut, loadDesc.pEntryPointName);
 
-			if (!save_byte_code(binaryShaderComponent.c_str(), (char*)(pOut->pByteCode), pOut->mByteCodeSize))
-			{
-				LOGF(LogLevel::eWARNING, "Failed to save byte code for file %s", loadDesc.pFileName);
-			}
 			break;
 #endif
 #if defined(VULKAN)
 		case RENDERER_API_VULKAN:
 #if defined(__ANDROID__)
 			vk_compileShader(pRenderer, stage, (uint32_t)code.size(), code.c_str(), binaryShaderComponent.c_str(), macroCount, pMacros, pOut, loadDesc.pEntryPointName);
-			if (!save_byte_code(binaryShaderComponent.c_str(), (char*)(pOut->pByteCode), pOut->mByteCodeSize))
-			{
-				LOGF(LogLevel::eWARNING, "Failed to save byte code for file %s", loadDesc.pFileName);
-			}
 #else
 			vk_compileShader(pRenderer, target, stage, pFileNameAPI.c_str(), binaryShaderComponent.c_str(), macroCount, pMacros, pOut, loadDesc.pEntryPointName);
 #endif
@@ -2990,6 +7053,7 @@ bool load_shader_stage_byte_code(
 			ASSERT(false);
 			return false;
 		}
+		storeCachedByteCode(cacheKey, pOut->pByteCode, pOut->mByteCodeSize);
 #endif
 	}
 #else // ndef NX64
@@ -3093,7 +7157,7 @@ bool find_shader_stage(
 	return true;
 }
 #endif
-void addShader(Renderer* pRenderer, const ShaderLoadDesc* pDesc, Shader** ppShader)
+static bool isShaderTargetSupported(Renderer* pRenderer, const ShaderLoadDesc* pDesc)
 {
 #ifndef DIRECT3D11
 	if ((uint32_t)pDesc->mTarget > pRenderer->mShaderTarget)
@@ -3101,16 +7165,41 @@ void addShader(Renderer* pRenderer, const ShaderLoadDesc* pDesc, Shader** ppShad
 		eastl::string error = eastl::string().sprintf("Requested shader target (%u) is higher than the shader target that the renderer supports (%u). Shader wont be compiled",
 			(uint32_t)pDesc->mTarget, (uint32_t)pRenderer->mShaderTarget);
 		LOGF(LogLevel::eERROR, error.c_str());
-		return;
+		return false;
 	}
 #endif
+	return true;
+}
 
 #ifndef TARGET_IOS
-	BinaryShaderDesc      binaryDesc = {};
-#if defined(METAL)
-	char* pSources[SHADER_STAGE_COUNT] = {};
+/// One stage of a ShaderLoadDesc. addShaders runs the jobs of a whole batch before creating any shader
+typedef struct ShaderStageCompileJob
+{
+	const ShaderLoadDesc*  pDesc;
+	uint32_t               mStageIndex;
+	ShaderStage            mStage;
+	ShaderStage            mAllStages;
+	BinaryShaderStageDesc* pOut;
+	/// Earlier job of the batch building the same byte code. UINT32_MAX if there is none
+	uint32_t               mSameAsJob;
+	bool                   mSuccess;
+} ShaderStageCompileJob;
+
+#if !defined(ORBIS) && !defined(PROSPERO)
+/// Task items are groups of jobs writing the same intermediate file. Jobs of item i are
+/// pJobIndices[pGroupOffsets[i]] to pJobIndices[pGroupOffsets[i + 1] - 1] and run one after another
+typedef struct ShaderCompileTask
+{
+	Renderer*              pRenderer;
+	ShaderStageCompileJob* pJobs;
+	const uint32_t*        pJobIndices;
+	const uint32_t*        pGroupOffsets;
+} ShaderCompileTask;
 #endif
 
+// Appends a job per stage of pDesc. Byte code goes to the matching stage of pBinaryDesc
+static void addShaderStageCompileJobs(const ShaderLoadDesc* pDesc, BinaryShaderDesc* pBinaryDesc, eastl::vector<ShaderStageCompileJob>& jobs)
+{
 	ShaderStage stages = SHADER_STAGE_NONE;
 	for (uint32_t i = 0; i < SHADER_STAGE_COUNT; ++i)
 	{
@@ -3120,7 +7209,7 @@ void addShader(Renderer* pRenderer, const ShaderLoadDesc* pDesc, Shader** ppShad
 			BinaryShaderStageDesc* pStage = NULL;
 			char ext[FS_MAX_PATH] = { 0 };
 			fsGetPathExtension(pDesc->mStages[i].pFileName, ext);
-			if (find_shader_stage(ext, &binaryDesc, &pStage, &stage))
+			if (find_shader_stage(ext, pBinaryDesc, &pStage, &stage))
 				stages |= stage;
 		}
 	}
@@ -3128,60 +7217,134 @@ void addShader(Renderer* pRenderer, const ShaderLoadDesc* pDesc, Shader** ppShad
 	{
 		if (pDesc->mStages[i].pFileName && strlen(pDesc->mStages[i].pFileName) != 0)
 		{
-			const char* fileName = pDesc->mStages[i].pFileName;
-
-			ShaderStage            stage;
-			BinaryShaderStageDesc* pStage = NULL;
+			ShaderStageCompileJob job = {};
 			char ext[FS_MAX_PATH] = { 0 };
-			fsGetPathExtension(fileName, ext);
-			if (find_shader_stage(ext, &binaryDesc, &pStage, &stage))
-			{
-				const uint32_t macroCount = pDesc->mStages[i].mMacroCount + pRenderer->mBuiltinShaderDefinesCount;
-				eastl::vector<ShaderMacro> macros(macroCount);
-				for (uint32_t macro = 0; macro < pRenderer->mBuiltinShaderDefinesCount; ++macro)
-					macros[macro] = pRenderer->pBuiltinShaderDefines[macro];
-				for (uint32_t macro = 0; macro < pDesc->mStages[i].mMacroCount; ++macro)
-					macros[pRenderer->mBuiltinShaderDefinesCount + macro] = pDesc->mStages[i].pMacros[macro];
-
-				if (!load_shader_stage_byte_code(
-					pRenderer, pDesc->mTarget, stage, stages, pDesc->mStages[i], macroCount, macros.data(),
-					pStage))
-					return;
-
-				binaryDesc.mStages |= stage;
+			fsGetPathExtension(pDesc->mStages[i].pFileName, ext);
+			if (find_shader_stage(ext, pBinaryDesc, &job.pOut, &job.mStage))
+			{
+				job.pDesc = pDesc;
+				job.mStageIndex = i;
+				job.mAllStages = stages;
+				job.mSameAsJob = UINT32_MAX;
+				jobs.push_back(job);
+			}
+		}
+	}
+}
+
+// Renderer builtin macros followed by the macros of the stage
+static void getShaderStageMacros(Renderer* pRenderer, const ShaderStageLoadDesc& stageDesc, eastl::vector<ShaderMacro>& macros)
+{
+	macros.resize(stageDesc.mMacroCount + pRenderer->mBuiltinShaderDefinesCount);
+	for (uint32_t macro = 0; macro < pRenderer->mBuiltinShaderDefinesCount; ++macro)
+		macros[macro] = pRenderer->pBuiltinShaderDefines[macro];
+	for (uint32_t macro = 0; macro < stageDesc.mMacroCount; ++macro)
+		macros[pRenderer->mBuiltinShaderDefinesCount + macro] = stageDesc.pMacros[macro];
+}
+
+static void runShaderStageCompileJob(Renderer* pRenderer, ShaderStageCompileJob* pJob)
+{
+	const ShaderStageLoadDesc& stageDesc = pJob->pDesc->mStages[pJob->mStageIndex];
+	eastl::vector<ShaderMacro> macros;
+	getShaderStageMacros(pRenderer, stageDesc, macros);
+
+	pJob->mSuccess = load_shader_stage_byte_code(
+		pRenderer, pJob->pDesc->mTarget, pJob->mStage, pJob->mAllStages, stageDesc, (uint32_t)macros.size(), macros.data(), pJob->pOut);
+}
+
+#if !defined(ORBIS) && !defined(PROSPERO)
+static void compileShaderStage(void* pUserData, uint32_t index)
+{
+	ShaderCompileTask* pTask = (ShaderCompileTask*)pUserData;
+	for (uint32_t i = pTask->pGroupOffsets[index]; i < pTask->pGroupOffsets[index + 1]; ++i)
+	{
+		runShaderStageCompileJob(pTask->pRenderer, &pTask->pJobs[pTask->pJobIndices[i]]);
+	}
+}
+#endif
+
+static void freeShaderByteCode(BinaryShaderDesc* pBinaryDesc)
+{
+#if !defined(PROSPERO)
+	if (pBinaryDesc->mStages & SHADER_STAGE_VERT)
+		tf_free(pBinaryDesc->mVert.pByteCode);
+	if (pBinaryDesc->mStages & SHADER_STAGE_FRAG)
+		tf_free(pBinaryDesc->mFrag.pByteCode);
+	if (pBinaryDesc->mStages & SHADER_STAGE_COMP)
+		tf_free(pBinaryDesc->mComp.pByteCode);
+#if !defined(METAL)
+	if (pBinaryDesc->mStages & SHADER_STAGE_TESC)
+		tf_free(pBinaryDesc->mHull.pByteCode);
+	if (pBinaryDesc->mStages & SHADER_STAGE_TESE)
+		tf_free(pBinaryDesc->mDomain.pByteCode);
+	if (pBinaryDesc->mStages & SHADER_STAGE_GEOM)
+		tf_free(pBinaryDesc->mGeom.pByteCode);
+	if (pBinaryDesc->mStages & SHADER_STAGE_RAYTRACING)
+		tf_free(pBinaryDesc->mComp.pByteCode);
+#endif
+#endif
+}
+
+// Creates the shader once every stage job of pDesc finished. A failed stage leaves ppShader untouched
+static void addShaderFromCompileJobs(
+	Renderer* pRenderer, const ShaderLoadDesc* pDesc, BinaryShaderDesc* pBinaryDesc, const ShaderStageCompileJob* pJobs,
+	uint32_t jobCount, Shader** ppShader)
+{
+	bool success = true;
+	for (uint32_t i = 0; i < jobCount; ++i)
+	{
+		if (pJobs[i].mSuccess)
+			pBinaryDesc->mStages |= pJobs[i].mStage;
+		else
+			success = false;
+	}
+	if (!success)
+	{
+		freeShaderByteCode(pBinaryDesc);
+		return;
+	}
+
 #if defined(METAL)
-				if (pDesc->mStages[i].pEntryPointName)
-					pStage->pEntryPoint = pDesc->mStages[i].pEntryPointName;
-				else
-					pStage->pEntryPoint = "stageMain";
+	char* pSources[SHADER_STAGE_COUNT] = {};
+#endif
+#if !defined(ORBIS) && !defined(PROSPERO)
+	for (uint32_t i = 0; i < jobCount; ++i)
+	{
+		const ShaderStageLoadDesc& stageDesc = pDesc->mStages[pJobs[i].mStageIndex];
+		BinaryShaderStageDesc*     pStage = pJobs[i].pOut;
+#if defined(METAL)
+		if (stageDesc.pEntryPointName)
+			pStage->pEntryPoint = stageDesc.pEntryPointName;
+		else
+			pStage->pEntryPoint = "stageMain";
 
-				char metalFileName[FS_MAX_PATH] = {0};
-				fsAppendPathExtension(fileName, "metal", metalFileName);
+		char metalFileName[FS_MAX_PATH] = {0};
+		fsAppendPathExtension(stageDesc.pFileName, "metal", metalFileName);
 
-				FileStream fh = {};
-				fsOpenStreamFromPath(RD_SHADER_SOURCES, metalFileName, FM_READ_BINARY, &fh);
-				size_t metalFileSize = fsGetStreamFileSize(&fh);
-				pSources[i] = (char*)tf_malloc(metalFileSize + 1);
-				pStage->pSource = pSources[i];
-				pStage->mSourceSize = (uint32_t)metalFileSize;
-				fsReadFromStream(&fh, pSources[i], metalFileSize);
-				pSources[i][metalFileSize] = 0; // Ensure the shader text is null-terminated
-				fsCloseStream(&fh);
-#elif !defined(ORBIS) && !defined(PROSPERO)
-				if (pDesc->mStages[i].pEntryPointName)
-					pStage->pEntryPoint = pDesc->mStages[i].pEntryPointName;
-				else
-					pStage->pEntryPoint = "main";
+		char*& pSource = pSources[pJobs[i].mStageIndex];
+		FileStream fh = {};
+		fsOpenStreamFromPath(RD_SHADER_SOURCES, metalFileName, FM_READ_BINARY, &fh);
+		size_t metalFileSize = fsGetStreamFileSize(&fh);
+		pSource = (char*)tf_malloc(metalFileSize + 1);
+		pStage->pSource = pSource;
+		pStage->mSourceSize = (uint32_t)metalFileSize;
+		fsReadFromStream(&fh, pSource, metalFileSize);
+		pSource[metalFileSize] = 0; // Ensure the shader text is null-terminated
+		fsCloseStream(&fh);
+#else
+		if (stageDesc.pEntryPointName)
+			pStage->pEntryPoint = stageDesc.pEntryPointName;
+		else
+			pStage->pEntryPoint = "main";
 #endif
-			}
-		}
 	}
+#endif
 
 #if defined(PROSPERO)
-	binaryDesc.mOwnByteCode = true;
+	pBinaryDesc->mOwnByteCode = true;
 #endif
 
-	addShaderBinary(pRenderer, &binaryDesc, ppShader);
+	addShaderBinary(pRenderer, pBinaryDesc, ppShader);
 
 #if defined(METAL)
 	for (uint32_t i = 0; i < SHADER_STAGE_COUNT; ++i)
@@ -3192,24 +7355,28 @@ void addShader(Renderer* pRenderer, const ShaderLoadDesc* pDesc, Shader** ppShad
 		}
 	}
 #endif
-#if !defined(PROSPERO)
-	if (binaryDesc.mStages & SHADER_STAGE_VERT)
-		tf_free(binaryDesc.mVert.pByteCode);
-	if (binaryDesc.mStages & SHADER_STAGE_FRAG)
-		tf_free(binaryDesc.mFrag.pByteCode);
-	if (binaryDesc.mStages & SHADER_STAGE_COMP)
-		tf_free(binaryDesc.mComp.pByteCode);
-#if !defined(METAL)
-	if (binaryDesc.mStages & SHADER_STAGE_TESC)
-		tf_free(binaryDesc.mHull.pByteCode);
-	if (binaryDesc.mStages & SHADER_STAGE_TESE)
-		tf_free(binaryDesc.mDomain.pByteCode);
-	if (binaryDesc.mStages & SHADER_STAGE_GEOM)
-		tf_free(binaryDesc.mGeom.pByteCode);
-	if (binaryDesc.mStages & SHADER_STAGE_RAYTRACING)
-		tf_free(binaryDesc.mComp.pByteCode);
-#endif
+	freeShaderByteCode(pBinaryDesc);
+}
 #endif
+
+void addShader(Renderer* pRenderer, const ShaderLoadDesc* pDesc, Shader** ppShader)
+{
+	if (!isShaderTargetSupported(pRenderer, pDesc))
+		return;
+
+#ifndef TARGET_IOS
+	BinaryShaderDesc                     binaryDesc = {};
+	eastl::vector<ShaderStageCompileJob> jobs;
+	addShaderStageCompileJobs(pDesc, &binaryDesc, jobs);
+
+	for (uint32_t i = 0; i < (uint32_t)jobs.size(); ++i)
+	{
+		runShaderStageCompileJob(pRenderer, &jobs[i]);
+		if (!jobs[i].mSuccess)
+			break;
+	}
+
+	addShaderFromCompileJobs(pRenderer, pDesc, &binaryDesc, jobs.data(), (uint32_t)jobs.size(), ppShader);
 #else
 	// Binary shaders are not supported on iOS.
 	ShaderDesc desc = {};
@@ -3231,7 +7398,8 @@ void addShader(Renderer* pRenderer, const ShaderLoadDesc* pDesc, Shader** ppShad
 
 				pStage->pName = pDesc->mStages[i].pFileName;
 				time_t timestamp = 0;
-				process_source_file(pRenderer->pName, &fh, metalFileName, &fh, timestamp, codes[i]);
+				uint64_t sourceHash = 0;
+				process_source_file(pRenderer->pName, &fh, metalFileName, &fh, timestamp, sourceHash, codes[i]);
 				pStage->pCode = codes[i].c_str();
 				if (pDesc->mStages[i].pEntryPointName)
 					pStage->pEntryPoint = pDesc->mStages[i].pEntryPointName;
@@ -3257,6 +7425,118 @@ void addShader(Renderer* pRenderer, const ShaderLoadDesc* pDesc, Shader** ppShad
 	addIosShader(pRenderer, &desc, ppShader);
 #endif
 }
+
+void addShaders(Renderer* pRenderer, uint32_t shaderCount, const ShaderLoadDesc* pDescs, Shader** ppShaders)
+{
+#if !defined(TARGET_IOS) && !defined(ORBIS) && !defined(PROSPERO)
+	bool parallel = shaderCount > 1;
+#if defined(GLES)
+	// GL compiles through the context current on the calling thread
+	parallel = parallel && gSelectedRendererApi != RENDERER_API_GLES;
+#endif
+	if (parallel)
+	{
+		eastl::vector<BinaryShaderDesc>      binaryDescs(shaderCount);
+		eastl::vector<ShaderStageCompileJob> jobs;
+		eastl::vector<uint32_t>              firstJobs(shaderCount + 1, 0);
+		eastl::vector<bool>                  supported(shaderCount, false);
+		for (uint32_t i = 0; i < shaderCount; ++i)
+		{
+			firstJobs[i] = (uint32_t)jobs.size();
+			supported[i] = isShaderTargetSupported(pRenderer, &pDescs[i]);
+			if (supported[i])
+				addShaderStageCompileJobs(&pDescs[i], &binaryDescs[i], jobs);
+		}
+		firstJobs[shaderCount] = (uint32_t)jobs.size();
+
+		// Stages shared between shaders, like a common vertex shader, are built once
+		eastl::hash_map<eastl::string, uint32_t> uniqueJobs;
+		eastl::vector<uint32_t>                  pendingJobs;
+		for (uint32_t i = 0; i < (uint32_t)jobs.size(); ++i)
+		{
+			const ShaderStageLoadDesc& stageDesc = jobs[i].pDesc->mStages[jobs[i].mStageIndex];
+			eastl::string              key;
+			key.sprintf(
+				"%s|%s|%u|%u|", stageDesc.pFileName, stageDesc.pEntryPointName ? stageDesc.pEntryPointName : "",
+				(uint32_t)stageDesc.mFlags, (uint32_t)jobs[i].pDesc->mTarget);
+			for (uint32_t macro = 0; macro < stageDesc.mMacroCount; ++macro)
+			{
+				key.append_sprintf("%s=%s;", stageDesc.pMacros[macro].definition, stageDesc.pMacros[macro].value);
+			}
+
+			eastl::pair<eastl::hash_map<eastl::string, uint32_t>::iterator, bool> it = uniqueJobs.insert(eastl::make_pair(key, i));
+			if (it.second)
+				pendingJobs.push_back(i);
+			else
+				jobs[i].mSameAsJob = it.first->second;
+		}
+
+		// The intermediate file name only has the base file name, the macros and the target. Stages differing in entry point,
+		// flags or directory can map to the same file, those run one after another
+		eastl::hash_map<eastl::string, uint32_t> groupIndices;
+		eastl::vector<uint32_t>                  jobGroups(pendingJobs.size());
+		eastl::vector<uint32_t>                  groupOffsets(1, 0);
+		eastl::vector<ShaderMacro>               macros;
+		for (uint32_t i = 0; i < (uint32_t)pendingJobs.size(); ++i)
+		{
+			const ShaderStageCompileJob& job = jobs[pendingJobs[i]];
+			const ShaderStageLoadDesc&   stageDesc = job.pDesc->mStages[job.mStageIndex];
+			getShaderStageMacros(pRenderer, stageDesc, macros);
+			eastl::string name = getShaderBinaryName(pRenderer, job.pDesc->mTarget, stageDesc, (uint32_t)macros.size(), macros.data());
+
+			eastl::pair<eastl::hash_map<eastl::string, uint32_t>::iterator, bool> it =
+				groupIndices.insert(eastl::make_pair(name, (uint32_t)groupOffsets.size() - 1));
+			if (it.second)
+				groupOffsets.push_back(0);
+			jobGroups[i] = it.first->second;
+			++groupOffsets[jobGroups[i] + 1];
+		}
+		for (uint32_t group = 1; group < (uint32_t)groupOffsets.size(); ++group)
+		{
+			groupOffsets[group] += groupOffsets[group - 1];
+		}
+
+		eastl::vector<uint32_t> groupedJobs(pendingJobs.size());
+		eastl::vector<uint32_t> groupCursors(groupOffsets.begin(), groupOffsets.end() - 1);
+		for (uint32_t i = 0; i < (uint32_t)pendingJobs.size(); ++i)
+		{
+			groupedJobs[groupCursors[jobGroups[i]]++] = pendingJobs[i];
+		}
+
+		ShaderCompileTask task = { pRenderer, jobs.data(), groupedJobs.data(), groupOffsets.data() };
+		runDecodeTask(pResourceLoader, compileShaderStage, &task, (uint32_t)groupOffsets.size() - 1);
+
+		for (uint32_t i = 0; i < (uint32_t)jobs.size(); ++i)
+		{
+			ShaderStageCompileJob& job = jobs[i];
+			if (UINT32_MAX == job.mSameAsJob || !jobs[job.mSameAsJob].mSuccess)
+				continue;
+
+			const BinaryShaderStageDesc* pSrc = jobs[job.mSameAsJob].pOut;
+			job.pOut->mByteCodeSize = pSrc->mByteCodeSize;
+			job.pOut->pByteCode = tf_memalign(256, pSrc->mByteCodeSize);
+			memcpy(job.pOut->pByteCode, pSrc->pByteCode, pSrc->mByteCodeSize);
+			job.mSuccess = true;
+		}
+
+		// Creation stays on the calling thread and in submission order
+		for (uint32_t i = 0; i < shaderCount; ++i)
+		{
+			if (supported[i])
+			{
+				addShaderFromCompileJobs(
+					pRenderer, &pDescs[i], &binaryDescs[i], jobs.data() + firstJobs[i], firstJobs[i + 1] - firstJobs[i], &ppShaders[i]);
+			}
+		}
+		return;
+	}
+#endif
+
+	for (uint32_t i = 0; i < shaderCount; ++i)
+	{
+		addShader(pRenderer, &pDescs[i], &ppShaders[i]);
+	}
+}
 /************************************************************************/
 // Pipeline cache save, load
 /************************************************************************/
@@ -2051,7 +2051,7 @@ bool TinyKtx_WriteImageGL(TinyKtx_WriteCallbacks const *callbacks,
 			uint32_t const snl = s * n * w;
 			uint32_t const k = ((snl + 3u) & ~3u);
 
-			uint32_t const size = (k * h * d * snl);
+			uint32_t const size = (k * h * d * sl);
 			if (size < mipmapsizes[i]) {
 				callbacks->errorFn(user, "Internal size error, padding should only ever expand");
 				return false;
@@ -0,0 +1,91 @@
+"""
+Compares two benchmark files written by dumpBenchmarkData and exits with a non-zero code when the current run
+regressed against the baseline.
+
+A metric regresses when it grew by more than the relative tolerance and by more than the absolute tolerance,
+the latter keeps sub-millisecond noise of tiny scopes from failing the comparison.
+
+Usage: python compare_benchmarks.py baseline.txt current.txt [--tolerance 5] [--abs-tolerance 0.05]
+                                    [--metrics Average,P50,P99] [--filter REGEX] [--fail-on-missing]
+"""
+
+import argparse, json, re, sys
+
+DEFAULT_METRICS = ['Average', 'P50', 'P90', 'P99', 'Hitches']
+# Counts are compared with their own absolute tolerance, everything else is in milliseconds
+COUNT_METRICS = {'Hitches', 'Frames'}
+
+def load(path):
+    with open(path) as f:
+        data = json.load(f)
+    entries = {}
+    for key, value in data.items():
+        if key == 'Timers' and isinstance(value, dict):
+            for name, stats in value.items():
+                entries[name] = stats
+        elif isinstance(value, dict):
+            entries[key] = value
+    return data, entries
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('baseline')
+    parser.add_argument('current')
+    parser.add_argument('--tolerance', type=float, default=5.0, help='allowed relative growth in percent (default 5)')
+    parser.add_argument('--abs-tolerance', type=float, default=0.05, help='allowed absolute growth in ms (default 0.05)')
+    parser.add_argument('--hitch-tolerance', type=int, default=0, help='allowed additional hitches (default 0)')
+    parser.add_argument('--metrics', default=','.join(DEFAULT_METRICS), help='comma separated metrics to compare')
+    parser.add_argument('--filter', help='only compare timers whose name matches this regular expression')
+    parser.add_argument('--fail-on-missing', action='store_true', help='treat timers missing from the current run as a regression')
+    parser.add_argument('-v', '--verbose', action='store_true', help='print every compared metric, not only regressions')
+    args = parser.parse_args()
+
+    metrics = [m.strip() for m in args.metrics.split(',') if m.strip()]
+    name_filter = re.compile(args.filter) if args.filter else None
+
+    baseline_info, baseline = load(args.baseline)
+    current_info, current = load(args.current)
+    for key in ('GpuName', 'Width', 'Height'):
+        if baseline_info.get(key) != current_info.get(key):
+            print('warning: %s differs, baseline %r, current %r' % (key, baseline_info.get(key), current_info.get(key)))
+
+    regressions = 0
+    improvements = 0
+    for name in sorted(baseline):
+        if name_filter and not name_filter.search(name):
+            continue
+        if name not in current:
+            print('%-48s missing from current run' % name)
+            regressions += args.fail_on_missing
+            continue
+
+        for metric in metrics:
+            old = baseline[name].get(metric)
+            new = current[name].get(metric)
+            if not isinstance(old, (int, float)) or not isinstance(new, (int, float)):
+                continue
+
+            delta = new - old
+            relative = (delta / old * 100.0) if old else (0.0 if not delta else float('inf'))
+            if metric in COUNT_METRICS:
+                regressed = delta > args.hitch_tolerance
+                improved = delta < -args.hitch_tolerance
+            else:
+                regressed = relative > args.tolerance and delta > args.abs_tolerance
+                improved = relative < -args.tolerance and -delta > args.abs_tolerance
+
+            if regressed or improved or args.verbose:
+                status = 'REGRESSION' if regressed else ('improved' if improved else '')
+                print('%-48s %-8s %10.4f -> %10.4f (%+7.2f%%) %s' % (name, metric, old, new, relative, status))
+            regressions += regressed
+            improvements += improved
+
+    for name in sorted(set(current) - set(baseline)):
+        if args.verbose and (not name_filter or name_filter.search(name)):
+            print('%-48s new in current run' % name)
+
+    print('%d regressions, %d improvements' % (regressions, improvements))
+    sys.exit(1 if regressions else 0)
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,146 @@
+"""
+Decodes a .binlog file written by Log::SetBinaryLogging into the text format of the regular log file.
+
+Usage: python decode_binlog.py App.binlog [-o App.decoded.log]
+"""
+
+import argparse, re, struct, sys, time
+
+MAGIC = b'TFBL'
+VERSION = 1
+MAX_THREAD_NAME_LENGTH = 31
+
+# Keep in sync with BinaryLogArgType in Common_3/OS/Logging/Log.h
+ARG_INT32, ARG_UINT32, ARG_INT64, ARG_UINT64, ARG_DOUBLE, ARG_POINTER, ARG_STRING = range(7)
+
+# Keep in sync with logLevelPrefixes in Common_3/OS/Logging/Log.cpp
+LEVEL_PREFIXES = [(8, 'WARN| '), (4, 'INFO| '), (2, ' DBG| '), (16, ' ERR| ')]
+
+FORMAT_SPEC = re.compile(r'%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d+))?(hh|h|ll|l|L|z|j|t|I64|I32|I)?([diouxXeEfFgGaAcspn%])')
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def read(self, fmt):
+        values = struct.unpack_from('<' + fmt, self.data, self.pos)
+        self.pos += struct.calcsize('<' + fmt)
+        return values if len(values) > 1 else values[0]
+
+    def bytes(self, size):
+        value = self.data[self.pos:self.pos + size]
+        self.pos += size
+        return value
+
+    def at_end(self):
+        return self.pos >= len(self.data)
+
+def read_args(reader, end):
+    args = []
+    while reader.pos < end:
+        tag = reader.read('B')
+        if tag == ARG_INT32:
+            args.append(reader.read('i'))
+        elif tag == ARG_UINT32:
+            args.append(reader.read('I'))
+        elif tag == ARG_INT64:
+            args.append(reader.read('q'))
+        elif tag == ARG_UINT64 or tag == ARG_POINTER:
+            args.append(reader.read('Q'))
+        elif tag == ARG_DOUBLE:
+            args.append(reader.read('d'))
+        elif tag == ARG_STRING:
+            size = reader.read('H')
+            args.append(reader.bytes(size).decode('utf-8', 'replace'))
+        else:
+            raise ValueError('unknown argument tag %d' % tag)
+    return args
+
+def format_message(fmt, args):
+    args = list(args)
+    def next_arg():
+        return args.pop(0) if args else 0
+
+    def replace(match):
+        flags, width, precision, _, conversion = match.groups()
+        if conversion == '%':
+            return '%'
+        if conversion == 'n':
+            return ''
+        if width == '*':
+            width = str(next_arg())
+        if precision == '*':
+            precision = str(next_arg())
+        spec = '%' + flags + (width or '') + ('.' + precision if precision is not None else '')
+        value = next_arg()
+        if conversion == 'p':
+            return (spec + 's') % ('0x%x' % value)
+        if conversion in 'aA':
+            text = float(value).hex()
+            return (spec + 's') % (text.upper() if conversion == 'A' else text)
+        if conversion == 'c' and isinstance(value, int):
+            value = chr(value & 0xff)
+        if conversion in 'diouxX' and isinstance(value, float):
+            value = int(value)
+        if conversion == 'u':
+            conversion = 'd'
+        try:
+            return (spec + conversion) % value
+        except (TypeError, ValueError):
+            return str(value)
+
+    return FORMAT_SPEC.sub(replace, fmt)
+
+def decode(data, out):
+    reader = Reader(data)
+    if reader.bytes(4) != MAGIC:
+        raise ValueError('not a binary log file')
+    version = reader.read('I')
+    if version != VERSION:
+        raise ValueError('unsupported binary log version %d' % version)
+    start_usec, start_time = reader.read('qq')
+
+    sites = {}
+    while not reader.at_end():
+        chunk = reader.bytes(1)
+        if chunk == b'S':
+            site_id, line = reader.read('Ii')
+            file_name = reader.bytes(reader.read('H')).decode('utf-8', 'replace')
+            fmt = reader.bytes(reader.read('H')).decode('utf-8', 'replace')
+            sites[site_id] = (file_name, line, fmt)
+        elif chunk == b'T':
+            thread_name = reader.bytes(MAX_THREAD_NAME_LENGTH + 1).split(b'\0', 1)[0].decode('utf-8', 'replace')
+            end = reader.pos + reader.read('I') + 4
+            while reader.pos < end:
+                record_begin = reader.pos
+                size, site_id, level, timestamp = reader.read('HIIq')
+                args = read_args(reader, record_begin + size)
+                file_name, line, fmt = sites.get(site_id, ('unknown', 0, '<unknown site %d>' % site_id))
+                seconds = start_time + (timestamp - start_usec) // 1000000
+                preamble = time.strftime('%Y-%m-%d %H:%M:%S ', time.localtime(seconds))
+                preamble += '[%-15s]' % (thread_name or 'NoName')
+                preamble += ' %22.23s:%-5i ' % (file_name, line)
+                message = format_message(fmt, args)
+                for mask, prefix in LEVEL_PREFIXES:
+                    if level & mask:
+                        out.write(preamble + prefix + message + '\n')
+        else:
+            raise ValueError('corrupt binary log at offset %d' % (reader.pos - 1))
+
+def main():
+    parser = argparse.ArgumentParser(description='Decode a binary log file written by The Forge')
+    parser.add_argument('input', help='.binlog file')
+    parser.add_argument('-o', '--output', help='output text file, defaults to stdout')
+    args = parser.parse_args()
+
+    with open(args.input, 'rb') as f:
+        data = f.read()
+    if args.output:
+        with open(args.output, 'w') as out:
+            decode(data, out)
+    else:
+        decode(data, sys.stdout)
+
+if __name__ == '__main__':
+    main()
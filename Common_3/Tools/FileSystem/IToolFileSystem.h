@@ -69,10 +69,6 @@ void fsGetFilesWithExtension(ResourceDirectory resourceDir, const char* subDirec
 /************************************************************************/
 /************************************************************************/
 
-bool fsRemoveFile(const ResourceDirectory resourceDir, const char* fileName);
-
-bool fsRenameFile(const ResourceDirectory resourceDir, const char* fileName, const char* newFileName);
-
 bool fsCopyFile(const ResourceDirectory sourceResourceDir, const char* sourceFileName, const ResourceDirectory destResourceDir, const char* destFileName);
 
 bool fsFileExist(const ResourceDirectory resourceDir, const char* fileName);
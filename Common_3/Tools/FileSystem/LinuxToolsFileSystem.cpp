@@ -240,28 +240,6 @@ void fsGetSubDirectories(ResourceDirectory resourceDir, const char* subDirectory
 	closedir(directory);
 }
 
-bool fsRemoveFile(const ResourceDirectory resourceDir, const char* fileName)
-{
-	const char* resourcePath = fsGetResourceDirectory(resourceDir);
-	char filePath[FS_MAX_PATH] = {};
-	fsAppendPathComponent(resourcePath, fileName, filePath);
-
-	return !remove(filePath);
-}
-
-bool fsRenameFile(const ResourceDirectory resourceDir, const char* fileName, const char* newFileName)
-{
-	const char* resourcePath = fsGetResourceDirectory(resourceDir);
-
-	char filePath[FS_MAX_PATH] = {};
-	fsAppendPathComponent(resourcePath, fileName, filePath);
-
-	char newfilePath[FS_MAX_PATH] = {};
-	fsAppendPathComponent(resourcePath, newFileName, newfilePath);
-
-	return !rename(filePath, newfilePath);
-}
-
 bool fsCopyFile(const ResourceDirectory sourceResourceDir, const char* sourceFileName, const ResourceDirectory destResourceDir, const char* destFileName)
 {
 	const char* sourceResourcePath = fsGetResourceDirectory(sourceResourceDir);
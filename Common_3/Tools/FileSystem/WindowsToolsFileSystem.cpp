@@ -291,55 +291,6 @@ void fsGetSubDirectories(ResourceDirectory resourceDir, const char* subDirectory
 	}
 }
 
-bool fsRemoveFile(const ResourceDirectory resourceDir, const char* fileName)
-{
-	const char* resourcePath = fsGetResourceDirectory(resourceDir);
-	char filePath[FS_MAX_PATH] = {};
-	fsAppendPathComponent(resourcePath, fileName, filePath);
-
-	// Path utf-16 conversion
-	size_t filePathLen = strlen(filePath);
-	wchar_t* pathStr = (wchar_t*)alloca((filePathLen + 1) * sizeof(wchar_t));
-	size_t pathStrLength =
-		MultiByteToWideChar(CP_UTF8, 0, filePath, (int)filePathLen, pathStr, (int)filePathLen);
-	pathStr[pathStrLength] = 0;
-
-	return !_wremove(pathStr);
-}
-
-bool fsRenameFile(const ResourceDirectory resourceDir, const char* fileName, const char* newFileName)
-{
-	const char* resourcePath = fsGetResourceDirectory(resourceDir);
-	wchar_t* pathStr = NULL;
-	wchar_t* newpathStr = NULL;
-
-	{
-		char filePath[FS_MAX_PATH] = {};
-		fsAppendPathComponent(resourcePath, fileName, filePath);
-
-		// Path utf-16 conversion
-		size_t filePathLen = strlen(filePath);
-		pathStr = (wchar_t*)alloca((filePathLen + 1) * sizeof(wchar_t));
-		size_t pathStrLength =
-			MultiByteToWideChar(CP_UTF8, 0, filePath, (int)filePathLen, pathStr, (int)filePathLen);
-		pathStr[pathStrLength] = 0;
-	}
-
-	{
-		char newfilePath[FS_MAX_PATH] = {};
-		fsAppendPathComponent(resourcePath, newFileName, newfilePath);
-
-		// New path utf-16 conversion
-		size_t newfilePathLen = strlen(newfilePath);
-		newpathStr = (wchar_t*)alloca((newfilePathLen + 1) * sizeof(wchar_t));
-		size_t newpathStrLength =
-			MultiByteToWideChar(CP_UTF8, 0, newfilePath, (int)newfilePathLen, newpathStr, (int)newfilePathLen);
-		newpathStr[newpathStrLength] = 0;
-	}
-
-	return !_wrename(pathStr, newpathStr);
-}
-
 bool fsCopyFile(const ResourceDirectory sourceResourceDir, const char* sourceFileName, const ResourceDirectory destResourceDir, const char* destFileName)
 {
 	const char* sourceResourcePath = fsGetResourceDirectory(sourceResourceDir);
@@ -0,0 +1,180 @@
+"""
+Converts a .tfprof capture written by startProfileCapture / saveProfileCapture into Chrome trace event JSON,
+which can be opened in chrome://tracing, ui.perfetto.dev or Speedscope.
+
+Usage: python tfprof_to_trace.py App.tfprof [-o App.json] [--frames first:last]
+"""
+
+import argparse, json, struct, sys
+
+MAGIC = b'TFPS'
+VERSION = 1
+
+# Keep in sync with ProfilerBase.h
+LOG_TICK_MASK = 0x0000ffffffffffff
+LOG_LEAVE, LOG_ENTER, LOG_META, LOG_LABEL, LOG_GPU_EXTRA, LOG_LABEL_LITERAL = range(6)
+
+def log_type(entry):
+    return (entry >> 61) & 0x7
+
+def log_timer(entry):
+    return (entry >> 48) & 0x1fff
+
+def tick_difference(start, end):
+    diff = ((end << 16) - (start << 16)) & 0xffffffffffffffff
+    if diff & (1 << 63):
+        diff -= 1 << 64
+    return diff >> 16
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def read(self, fmt):
+        values = struct.unpack_from('<' + fmt, self.data, self.pos)
+        self.pos += struct.calcsize('<' + fmt)
+        return values if len(values) > 1 else values[0]
+
+    def string(self):
+        size = self.read('H')
+        value = self.data[self.pos:self.pos + size].decode('utf-8', 'replace')
+        self.pos += size
+        return value
+
+    def at_end(self):
+        return self.pos >= len(self.data)
+
+class Converter:
+    def __init__(self, frame_range):
+        self.frame_range = frame_range
+        self.groups = {}
+        self.timers = {}
+        self.threads = {}
+        self.cpu_frequency = 1
+        self.pid = 0
+        self.origin = None
+        self.dropped = 0
+        self.events = []
+        self.named_threads = set()
+
+    def timer_name(self, timer):
+        return self.timers.get(timer, ('timer %d' % timer, 0))[0]
+
+    def timer_group(self, timer):
+        group = self.timers.get(timer, ('', -1))[1]
+        return self.groups.get(group, ('', 0))[0]
+
+    def to_us(self, tick, start, frequency):
+        return tick_difference(start, tick) * 1e6 / frequency
+
+    def thread_event(self, slot):
+        if slot not in self.named_threads:
+            self.named_threads.add(slot)
+            name = self.threads.get(slot, ('thread %d' % slot, 0, 0))[0]
+            self.events.append({'ph': 'M', 'name': 'thread_name', 'pid': self.pid, 'tid': slot, 'args': {'name': name}})
+
+    def frame(self, reader, index, start, end):
+        thread_count = reader.read('I')
+        if self.origin is None:
+            self.origin = start
+        emit = self.frame_range is None or self.frame_range[0] <= index <= self.frame_range[1]
+        frame_start = tick_difference(self.origin, start) * 1e6 / self.cpu_frequency
+        frame_end = tick_difference(self.origin, end) * 1e6 / self.cpu_frequency
+        if emit:
+            self.events.append({'ph': 'X', 'name': 'Frame %d' % index, 'cat': 'Frame', 'pid': self.pid, 'tid': 'Frames',
+                                'ts': frame_start, 'dur': frame_end - frame_start})
+
+        for _ in range(thread_count):
+            slot, gpu_start, entry_count = reader.read('IqI')
+            entries = struct.unpack_from('<%dQ' % entry_count, reader.data, reader.pos)
+            reader.pos += 8 * entry_count
+            labels = [reader.string() for entry in entries if log_type(entry) in (LOG_LABEL, LOG_LABEL_LITERAL)]
+            if not emit:
+                continue
+
+            name, is_gpu, gpu_frequency = self.threads.get(slot, ('', 0, 0))
+            if is_gpu and gpu_frequency:
+                # Gpu ticks are in their own time domain, line the gpu frame start up with the cpu frame start
+                base, frequency, offset = gpu_start, gpu_frequency, frame_start
+            else:
+                base, frequency, offset = self.origin, self.cpu_frequency, 0.0
+
+            self.thread_event(slot)
+            depth, last = 0, offset
+            label_index = 0
+            for entry in entries:
+                kind = log_type(entry)
+                if kind in (LOG_ENTER, LOG_LEAVE):
+                    ts = offset + tick_difference(base, entry & LOG_TICK_MASK) * 1e6 / frequency
+                    last = max(last, ts)
+                    timer = log_timer(entry)
+                    if kind == LOG_ENTER:
+                        self.events.append({'ph': 'B', 'name': self.timer_name(timer), 'cat': self.timer_group(timer),
+                                            'pid': self.pid, 'tid': slot, 'ts': ts})
+                        depth += 1
+                    elif depth:
+                        self.events.append({'ph': 'E', 'pid': self.pid, 'tid': slot, 'ts': ts})
+                        depth -= 1
+                elif kind in (LOG_LABEL, LOG_LABEL_LITERAL):
+                    self.events.append({'ph': 'i', 's': 't', 'name': labels[label_index], 'pid': self.pid, 'tid': slot, 'ts': last})
+                    label_index += 1
+            for _ in range(depth):
+                self.events.append({'ph': 'E', 'pid': self.pid, 'tid': slot, 'ts': last})
+
+    def convert(self, data):
+        if data[:4] != MAGIC:
+            sys.exit('not a profile capture file')
+        reader = Reader(data)
+        reader.pos = 4
+        version = reader.read('I')
+        if version != VERSION:
+            sys.exit('unsupported capture version %d' % version)
+
+        while not reader.at_end():
+            record = chr(reader.read('B'))
+            if record == 'H':
+                self.cpu_frequency, self.pid = reader.read('qI')
+            elif record == 'G':
+                index, kind = reader.read('IB')
+                self.groups[index] = (reader.string(), kind)
+            elif record == 'N':
+                index, group = reader.read('II')
+                self.timers[index] = (reader.string(), group)
+            elif record == 'T':
+                slot, is_gpu, frequency = reader.read('IBQ')
+                self.threads[slot] = (reader.string(), is_gpu, frequency)
+                self.named_threads.discard(slot)
+            elif record == 'D':
+                self.dropped += reader.read('I')
+            elif record == 'F':
+                index, start, end = reader.read('Qqq')
+                self.frame(reader, index, start, end)
+            else:
+                sys.exit('corrupt capture, unknown record %r at offset %d' % (record, reader.pos - 1))
+
+        return {'displayTimeUnit': 'ms', 'traceEvents': self.events, 'otherData': {'droppedFrames': self.dropped}}
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('capture')
+    parser.add_argument('-o', '--output')
+    parser.add_argument('--frames', help='first:last frame index to convert')
+    args = parser.parse_args()
+
+    frame_range = None
+    if args.frames:
+        first, last = args.frames.split(':')
+        frame_range = (int(first or 0), int(last or sys.maxsize))
+
+    with open(args.capture, 'rb') as f:
+        trace = Converter(frame_range).convert(f.read())
+
+    output = args.output or args.capture.rsplit('.', 1)[0] + '.json'
+    with open(output, 'w') as f:
+        json.dump(trace, f)
+    if trace['otherData']['droppedFrames']:
+        print('%d frames were dropped during the capture' % trace['otherData']['droppedFrames'])
+
+if __name__ == '__main__':
+    main()
@@ -588,6 +588,11 @@ public:
 		fsSetPathForResourceDir(pSystemFileIO, RM_CONTENT, RD_SHADER_SOURCES,  "Shaders");
 		fsSetPathForResourceDir(pSystemFileIO, RM_DEBUG,   RD_SHADER_BINARIES, "CompiledShaders");
 		fsSetPathForResourceDir(pSystemFileIO, RM_DEBUG,   RD_PIPELINE_CACHE,  "PipelineCaches");
+		fsSetPathForResourceDir(pSystemFileIO, RM_DEBUG,   RD_GEOMETRY_CACHE,  "GeometryCaches");
+#if defined(_DEBUG)
+		// Loading source images directly is a development feature, release builds use processed textures only
+		fsSetPathForResourceDir(pSystemFileIO, RM_DEBUG,   RD_TEXTURE_CACHE,   "TextureCaches");
+#endif
 		fsSetPathForResourceDir(pSystemFileIO, RM_CONTENT, RD_GPU_CONFIG,      "GPUCfg");
 		fsSetPathForResourceDir(pSystemFileIO, RM_CONTENT, RD_TEXTURES,        "Textures");
 		fsSetPathForResourceDir(pSystemFileIO, RM_CONTENT, RD_FONTS,           "Fonts");
@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2018-2021 The Forge Interactive Inc.
+ *
+ * This file is part of The-Forge
+ * (see https://github.com/ConfettiFX/The-Forge).
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+*/
+
+// Unit Test for the vertex packing kernels.
+// Every instruction set the CPU supports has to produce the same bytes as the scalar reference,
+// for packed and interleaved strides and for counts that leave a partial vector at the end.
+// Timings of each kernel are written to the log. Init fails on the first mismatch.
+
+//Interfaces
+#include "../../../../Common_3/OS/Interfaces/IApp.h"
+#include "../../../../Common_3/OS/Interfaces/ILog.h"
+#include "../../../../Common_3/OS/Interfaces/ITime.h"
+#include "../../../../Common_3/OS/Interfaces/IOperatingSystem.h"
+#include "../../../../Common_3/OS/Core/VertexPacking.h"
+
+#include "../../../../Common_3/OS/Interfaces/IMemory.h"
+
+// Not a multiple of any vector width so the tail paths run as well
+const uint32_t gElementCount = 100003;
+const uint32_t gBenchmarkRuns = 20;
+// Room for a float4 element plus padding in the interleaved layouts
+const uint32_t gInterleavedSrcStride = 28;
+const uint32_t gInterleavedDstStride = 20;
+
+typedef enum KernelType
+{
+	KERNEL_HALF = 0,
+	KERNEL_NORM,
+	KERNEL_OCTAHEDRAL,
+	KERNEL_COPY,
+} KernelType;
+
+typedef struct KernelTest
+{
+	const char*      pName;
+	KernelType       mType;
+	PackedNormFormat mFormat;
+	uint32_t         mComponentCount;
+	bool             mRemap;
+} KernelTest;
+
+const KernelTest gKernelTests[] = {
+	{ "half x1", KERNEL_HALF, PACKED_NORM_FORMAT_UNORM8, 1, false },
+	{ "half x2", KERNEL_HALF, PACKED_NORM_FORMAT_UNORM8, 2, false },
+	{ "half x3", KERNEL_HALF, PACKED_NORM_FORMAT_UNORM8, 3, false },
+	{ "half x4", KERNEL_HALF, PACKED_NORM_FORMAT_UNORM8, 4, false },
+	{ "unorm8 x4", KERNEL_NORM, PACKED_NORM_FORMAT_UNORM8, 4, false },
+	{ "snorm8 x3", KERNEL_NORM, PACKED_NORM_FORMAT_SNORM8, 3, false },
+	{ "unorm16 x2 remap", KERNEL_NORM, PACKED_NORM_FORMAT_UNORM16, 2, true },
+	{ "snorm16 x4", KERNEL_NORM, PACKED_NORM_FORMAT_SNORM16, 4, false },
+	{ "snorm16 x3 remap", KERNEL_NORM, PACKED_NORM_FORMAT_SNORM16, 3, true },
+	{ "octahedral unorm8", KERNEL_OCTAHEDRAL, PACKED_NORM_FORMAT_UNORM8, 3, false },
+	{ "octahedral snorm8", KERNEL_OCTAHEDRAL, PACKED_NORM_FORMAT_SNORM8, 3, false },
+	{ "octahedral unorm16", KERNEL_OCTAHEDRAL, PACKED_NORM_FORMAT_UNORM16, 3, false },
+	{ "octahedral snorm16", KERNEL_OCTAHEDRAL, PACKED_NORM_FORMAT_SNORM16, 3, false },
+	{ "copy 12 bytes", KERNEL_COPY, PACKED_NORM_FORMAT_UNORM8, 3, false },
+	{ "copy 16 bytes", KERNEL_COPY, PACKED_NORM_FORMAT_UNORM8, 4, false },
+};
+
+const uint32_t gKernelTestCount = sizeof(gKernelTests) / sizeof(gKernelTests[0]);
+
+float*   pSourceData = NULL;
+uint8_t* pReferenceData = NULL;
+uint8_t* pResultData = NULL;
+
+// xorshift, the same input on every run and platform
+static uint32_t nextRandom(uint32_t* pState)
+{
+	uint32_t x = *pState;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*pState = x;
+	return x;
+}
+
+static float randomFloat(uint32_t* pState, float minValue, float maxValue)
+{
+	return minValue + (maxValue - minValue) * (float)(nextRandom(pState) & 0xFFFFFF) / (float)0xFFFFFF;
+}
+
+// Interleaved source layout, float4 per element. Octahedral tests read normalized directions from the first three floats
+static void fillSourceData(float* pData, uint32_t floatCount)
+{
+	uint32_t state = 0x12345678u;
+	for (uint32_t i = 0; i < floatCount; ++i)
+	{
+		pData[i] = randomFloat(&state, -2.0f, 2.0f);
+	}
+
+	// Values exercising rounding, clamping, half denormals and overflow
+	const float specials[] = { 0.0f, -0.0f, 1.0f, -1.0f, 0.5f, 65504.0f, 65520.0f, -70000.0f, 6.0e-8f, 1.0e-5f, 0.33333334f, 3.0e38f };
+	const uint32_t specialCount = sizeof(specials) / sizeof(specials[0]);
+	for (uint32_t i = 0; i < specialCount * 4 && i < floatCount; ++i)
+	{
+		pData[i] = specials[i % specialCount];
+	}
+}
+
+static void normalizeDirections(float* pData, uint32_t count, uint32_t stride)
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		float* v = (float*)((uint8_t*)pData + (size_t)i * stride);
+		float  length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		if (length < 1.0e-6f)
+		{
+			v[0] = 0.0f;
+			v[1] = 0.0f;
+			v[2] = 1.0f;
+			continue;
+		}
+		v[0] /= length;
+		v[1] /= length;
+		v[2] /= length;
+	}
+}
+
+static uint32_t getDstElementSize(const KernelTest& test)
+{
+	switch (test.mType)
+	{
+	case KERNEL_HALF: return test.mComponentCount * 2;
+	case KERNEL_NORM:
+		return test.mComponentCount * ((PACKED_NORM_FORMAT_UNORM8 == test.mFormat || PACKED_NORM_FORMAT_SNORM8 == test.mFormat) ? 1 : 2);
+	case KERNEL_OCTAHEDRAL: return (PACKED_NORM_FORMAT_UNORM8 == test.mFormat || PACKED_NORM_FORMAT_SNORM8 == test.mFormat) ? 2 : 4;
+	case KERNEL_COPY: return test.mComponentCount * sizeof(float);
+	}
+	return 0;
+}
+
+static void runKernel(const KernelTest& test, const void* src, uint32_t srcStride, void* dst, uint32_t dstStride)
+{
+	const float scale[4] = { 4.0f, 2.0f, 0.5f, 3.0f };
+	const float offset[4] = { -2.0f, -1.0f, 0.25f, 0.0f };
+
+	switch (test.mType)
+	{
+	case KERNEL_HALF: packFloatToHalf(gElementCount, test.mComponentCount, src, srcStride, dst, dstStride); break;
+	case KERNEL_NORM:
+		packFloatToNorm(
+			test.mFormat, gElementCount, test.mComponentCount, test.mRemap ? scale : NULL, test.mRemap ? offset : NULL, src, srcStride,
+			dst, dstStride);
+		break;
+	case KERNEL_OCTAHEDRAL: packOctahedral(test.mFormat, gElementCount, src, srcStride, dst, dstStride); break;
+	case KERNEL_COPY: copyStridedElements(gElementCount, test.mComponentCount * sizeof(float), src, srcStride, dst, dstStride); break;
+	}
+}
+
+// Bytes between the elements of an interleaved destination keep their fill value, so overruns show up as mismatches
+static bool validateKernel(const KernelTest& test, VertexPackingIsa isa, uint32_t srcStride, uint32_t dstStride)
+{
+	const size_t dstSize = (size_t)gElementCount * dstStride;
+
+	setVertexPackingIsa(VERTEX_PACKING_ISA_SCALAR);
+	memset(pReferenceData, 0xCD, dstSize);
+	runKernel(test, pSourceData, srcStride, pReferenceData, dstStride);
+
+	setVertexPackingIsa(isa);
+	memset(pResultData, 0xCD, dstSize);
+	runKernel(test, pSourceData, srcStride, pResultData, dstStride);
+
+	for (size_t i = 0; i < dstSize; ++i)
+	{
+		if (pReferenceData[i] != pResultData[i])
+		{
+			LOGF(
+				LogLevel::eERROR, "%s: %s differs from scalar at element %u byte %u (src stride %u, dst stride %u)", test.pName,
+				getVertexPackingIsaName(isa), (uint32_t)(i / dstStride), (uint32_t)(i % dstStride), srcStride, dstStride);
+			return false;
+		}
+	}
+	return true;
+}
+
+static float benchmarkKernel(const KernelTest& test, VertexPackingIsa isa)
+{
+	setVertexPackingIsa(isa);
+	const uint32_t srcStride = (KERNEL_COPY == test.mType ? test.mComponentCount : 4) * sizeof(float);
+	const uint32_t dstStride = getDstElementSize(test);
+
+	// Warm up caches and the dispatch before timing
+	runKernel(test, pSourceData, srcStride, pResultData, dstStride);
+
+	int64_t best = INT64_MAX;
+	for (uint32_t run = 0; run < gBenchmarkRuns; ++run)
+	{
+		int64_t start = getUSec();
+		runKernel(test, pSourceData, srcStride, pResultData, dstStride);
+		int64_t time = getUSec() - start;
+		best = time < best ? time : best;
+	}
+	// Nanoseconds per element of the fastest run
+	return (float)best * 1000.0f / (float)gElementCount;
+}
+
+class VertexPacking: public IApp
+{
+public:
+	bool Init()
+	{
+		const size_t srcSize = (size_t)gElementCount * gInterleavedSrcStride;
+		// Large enough for every destination layout
+		const size_t dstSize = (size_t)gElementCount * gInterleavedSrcStride;
+		pSourceData = (float*)tf_calloc(1, srcSize);
+		pReferenceData = (uint8_t*)tf_malloc(dstSize);
+		pResultData = (uint8_t*)tf_malloc(dstSize);
+
+		const VertexPackingIsa bestIsa = getVertexPackingIsa();
+		LOGF(LogLevel::eINFO, "Vertex packing: best instruction set is %s", getVertexPackingIsaName(bestIsa));
+
+		bool success = true;
+		for (uint32_t t = 0; t < gKernelTestCount && success; ++t)
+		{
+			const KernelTest& test = gKernelTests[t];
+			const uint32_t    packedSrcStride = (KERNEL_COPY == test.mType ? test.mComponentCount : 4) * sizeof(float);
+			const uint32_t    packedDstStride = getDstElementSize(test);
+
+			fillSourceData(pSourceData, (uint32_t)(srcSize / sizeof(float)));
+			if (KERNEL_OCTAHEDRAL == test.mType)
+			{
+				normalizeDirections(pSourceData, gElementCount, packedSrcStride);
+			}
+
+			// Every SIMD instruction set the CPU supports, AVX2 machines run the SSE2 kernels as well
+			for (uint32_t isa = VERTEX_PACKING_ISA_SCALAR + 1; isa <= (uint32_t)bestIsa && success; ++isa)
+			{
+				if (isa != (uint32_t)bestIsa && !(VERTEX_PACKING_ISA_SSE2 == isa && VERTEX_PACKING_ISA_AVX2 == bestIsa))
+					continue;
+
+				success = validateKernel(test, (VertexPackingIsa)isa, packedSrcStride, packedDstStride);
+				if (success && KERNEL_OCTAHEDRAL != test.mType)
+				{
+					success = validateKernel(test, (VertexPackingIsa)isa, gInterleavedSrcStride, gInterleavedDstStride);
+				}
+			}
+
+			if (!success)
+				break;
+
+			float scalarTime = benchmarkKernel(test, VERTEX_PACKING_ISA_SCALAR);
+			float bestTime = benchmarkKernel(test, bestIsa);
+			LOGF(
+				LogLevel::eINFO, "%-20s scalar %7.3f ns/element, %s %7.3f ns/element, %5.2fx", test.pName, scalarTime,
+				getVertexPackingIsaName(bestIsa), bestTime, bestTime > 0.0f ? scalarTime / bestTime : 0.0f);
+		}
+
+		setVertexPackingIsa(bestIsa);
+
+		if (success)
+		{
+			LOGF(LogLevel::eINFO, "Vertex packing: all %u kernels match the scalar reference", gKernelTestCount);
+		}
+		return success;
+	}
+
+	void Exit()
+	{
+		tf_free(pSourceData);
+		tf_free(pReferenceData);
+		tf_free(pResultData);
+	}
+
+	bool Load() { return true; }
+
+	void Unload() {}
+
+	// Everything runs in Init, there is nothing to show
+	void Update(float deltaTime)
+	{
+		UNREF_PARAM(deltaTime);
+		requestShutdown();
+	}
+
+	void Draw() {}
+
+	const char* GetName() { return "36_VertexPacking"; }
+};
+
+DEFINE_APPLICATION_MAIN(VertexPacking)
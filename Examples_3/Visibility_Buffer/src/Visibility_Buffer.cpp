@@ -803,6 +803,11 @@ public:
 		fsSetPathForResourceDir(pSystemFileIO, RM_CONTENT, RD_SHADER_SOURCES,  "Shaders");
 		fsSetPathForResourceDir(pSystemFileIO, RM_DEBUG,   RD_SHADER_BINARIES, "CompiledShaders");
 		fsSetPathForResourceDir(pSystemFileIO, RM_DEBUG,   RD_PIPELINE_CACHE,  "PipelineCaches");
+		fsSetPathForResourceDir(pSystemFileIO, RM_DEBUG,   RD_GEOMETRY_CACHE,  "GeometryCaches");
+#if defined(_DEBUG)
+		// Loading source images directly is a development feature, release builds use processed textures only
+		fsSetPathForResourceDir(pSystemFileIO, RM_DEBUG,   RD_TEXTURE_CACHE,   "TextureCaches");
+#endif
 		fsSetPathForResourceDir(pSystemFileIO, RM_CONTENT, RD_GPU_CONFIG,      "GPUCfg");
 		fsSetPathForResourceDir(pSystemFileIO, RM_CONTENT, RD_TEXTURES,        "Textures");
 		fsSetPathForResourceDir(pSystemFileIO, RM_CONTENT, RD_FONTS,           "Fonts");
@@ -955,6 +960,8 @@ public:
 		for (uint32_t i = 0; i < (uint32_t)gDiffuseMaps.size(); ++i)
 		{
 			TextureLoadDesc desc = {};
+			// Materials reference the same textures many times
+			desc.mFlags = TEXTURE_LOAD_FLAG_SHARED;
 			desc.pFileName = pScene->textures[i];
 			desc.ppTexture = &gDiffuseMaps[i];
 			addResource(&desc, NULL);
@@ -3664,20 +3671,16 @@ public:
 		addShader(pRenderer, &shadowPassAlpha, &pShaderShadowPass[GEOMSET_ALPHATESTED]);
 		addShader(pRenderer, &vbPass, &pShaderVisibilityBufferPass[GEOMSET_OPAQUE]);
 		addShader(pRenderer, &vbPassAlpha, &pShaderVisibilityBufferPass[GEOMSET_ALPHATESTED]);
-		for (uint32_t i = 0; i < 2 * MSAA_LEVELS_COUNT; ++i)
-			addShader(pRenderer, &vbShade[i], &pShaderVisibilityBufferShade[i]);
+		::addShaders(pRenderer, 2 * MSAA_LEVELS_COUNT, vbShade, pShaderVisibilityBufferShade);
 		addShader(pRenderer, &deferredPass, &pShaderDeferredPass[GEOMSET_OPAQUE]);
 		addShader(pRenderer, &deferredPassAlpha, &pShaderDeferredPass[GEOMSET_ALPHATESTED]);
-		for (uint32_t i = 0; i < 2 * MSAA_LEVELS_COUNT; ++i)
-			addShader(pRenderer, &deferredShade[i], &pShaderDeferredShade[i]);
-		for (uint32_t i = 0; i < MSAA_LEVELS_COUNT; ++i)
-			addShader(pRenderer, &deferredPointlights[i], &pShaderDeferredShadePointLight[i]);
+		::addShaders(pRenderer, 2 * MSAA_LEVELS_COUNT, deferredShade, pShaderDeferredShade);
+		::addShaders(pRenderer, MSAA_LEVELS_COUNT, deferredPointlights, pShaderDeferredShadePointLight);
 		addShader(pRenderer, &clearBuffer, &pShaderClearBuffers);
 		addShader(pRenderer, &triangleCulling, &pShaderTriangleFiltering);
 		addShader(pRenderer, &clearLights, &pShaderClearLightClusters);
 		addShader(pRenderer, &clusterLights, &pShaderClusterLights);
-		for (uint32_t i = 0; i < 4 * MSAA_LEVELS_COUNT; ++i)
-			addShader(pRenderer, &ao[i], &pShaderAO[i]);
+		::addShaders(pRenderer, 4 * MSAA_LEVELS_COUNT, ao, pShaderAO);
 		for (uint32_t i = 0; i < MSAA_LEVELS_COUNT; ++i)
 		{
 			addShader(pRenderer, &resolvePass[i], &pShaderResolve[i]);